@@ -0,0 +1,123 @@
+/**
+ * @file arena.h
+ *
+ * @brief A module for bump-pointer arenas and a pool to recycle them
+ *
+ * An arena hands out memory by advancing an offset through a chunk, and
+ * releases everything it handed out at once with arena_reset(). When a chunk
+ * runs out, a larger one is chained after it; chunks are kept across resets,
+ * so an arena that has grown to fit a workload stops allocating.
+ */
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_CAPACITY (size_t)4096 // Default size of the first chunk
+
+/**
+ * @brief Opaque bump-pointer arena type
+ */
+typedef struct arena arena_t;
+
+/**
+ * @brief Opaque type for a pool of arenas shared between threads
+ */
+typedef struct arena_pool arena_pool_t;
+
+/**
+ * @brief Creates an arena.
+ *
+ * @param capacity The size in bytes of the first chunk, 0 for
+ * ARENA_DEFAULT_CAPACITY
+ * @return arena_t* - Returns the new arena, NULL on error
+ */
+arena_t *arena_create(size_t capacity);
+
+/**
+ * @brief Allocates memory from an arena, aligned for any type. The memory is
+ * valid until the arena is reset or destroyed and must not be freed.
+ *
+ * @param arena_p The arena to allocate from
+ * @param size The number of bytes to allocate
+ * @return void* - Returns the memory, NULL on error
+ */
+void *arena_alloc(arena_t *arena_p, size_t size);
+
+/**
+ * @brief Allocates zeroed memory for an array from an arena.
+ *
+ * @param arena_p The arena to allocate from
+ * @param count The number of elements
+ * @param size The size of each element
+ * @return void* - Returns the memory, NULL on error
+ */
+void *arena_calloc(arena_t *arena_p, size_t count, size_t size);
+
+/**
+ * @brief Releases everything allocated from an arena in constant time. The
+ * chunks are kept for the next allocations.
+ *
+ * @param arena_p The arena to reset
+ */
+void arena_reset(arena_t *arena_p);
+
+/**
+ * @brief Returns the number of bytes handed out since the last reset,
+ * including alignment padding.
+ *
+ * @param arena_p The arena to inspect
+ * @return size_t - Returns the bytes in use, 0 on error
+ */
+size_t arena_used(const arena_t *arena_p);
+
+/**
+ * @brief Destroys an arena and every chunk it holds.
+ *
+ * @param arena_pp The address of the arena to destroy
+ * @return int - Returns 0 on success state, -1 on error state
+ */
+int arena_destroy(arena_t **arena_pp);
+
+/**
+ * @brief Creates a pool and fills it with arenas up front.
+ *
+ * @param arena_capacity The first chunk size of every arena, 0 for
+ * ARENA_DEFAULT_CAPACITY
+ * @param arena_count The number of arenas created up front, which is also the
+ * most the pool keeps idle
+ * @return arena_pool_t* - Returns the new pool, NULL on error
+ */
+arena_pool_t *arena_pool_create(size_t arena_capacity, size_t arena_count);
+
+/**
+ * @brief Takes an empty arena from the pool, creating one when every arena is
+ * in use. Safe to call from any thread.
+ *
+ * @param pool_p The pool to take an arena from
+ * @return arena_t* - Returns the arena, NULL on error
+ */
+arena_t *arena_pool_acquire(arena_pool_t *pool_p);
+
+/**
+ * @brief Resets an arena and returns it to the pool. Arenas beyond the
+ * pool's idle limit are destroyed instead. Safe to call from any thread.
+ *
+ * @param pool_p The pool the arena was acquired from
+ * @param arena_p The arena to return
+ * @return int - Returns 0 on success state, -1 on error state
+ */
+int arena_pool_release(arena_pool_t *pool_p, arena_t *arena_p);
+
+/**
+ * @brief Destroys a pool and every idle arena in it. Arenas still acquired
+ * must be destroyed by their holders.
+ *
+ * @param pool_pp The address of the pool to destroy
+ * @return int - Returns 0 on success state, -1 on error state
+ */
+int arena_pool_destroy(arena_pool_t **pool_pp);
+
+#endif /* _ARENA_H */
+
+/*** end of file ***/
@@ -0,0 +1,402 @@
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "utilities.h"
+
+#define ARENA_ALIGNMENT alignof(max_align_t) // Alignment of every allocation
+#define ARENA_GROWTH_FACTOR 2                // Size of a new chunk vs the last
+
+/**
+ * @brief A block of memory the arena bumps through
+ *
+ */
+typedef struct arena_chunk
+{
+    struct arena_chunk *next; // The chunk to move on to when this one is full
+    size_t capacity;          // The usable bytes in data
+    max_align_t data[];       // The memory handed out, aligned for any type
+} arena_chunk_t;
+
+/**
+ * @brief A struct for an arena
+ *
+ */
+struct arena
+{
+    arena_chunk_t *head;    // The first chunk, where a reset starts over
+    arena_chunk_t *current; // The chunk being allocated from
+    size_t offset;          // The bytes used in current
+    size_t used;            // The bytes handed out since the last reset
+    struct arena *next;     // The next idle arena while held by a pool
+};
+
+/**
+ * @brief A struct for a pool of arenas
+ *
+ */
+struct arena_pool
+{
+    pthread_mutex_t mutex; // Guards the fields below
+    arena_t *idle;         // Arenas ready to be acquired
+    size_t idle_count;     // The number of arenas in idle
+    size_t max_idle;       // The most arenas kept in idle
+    size_t capacity;       // The first chunk size of new arenas
+};
+
+/**
+ * @brief Rounds a size up to the arena's alignment.
+ *
+ * @param size The size to round
+ * @param rounded_p Where the rounded size is stored
+ * @return int - Returns 0 on success state, -1 if the size overflows
+ */
+static int arena_round(size_t size, size_t *rounded_p);
+
+/**
+ * @brief Allocates a chunk with room for 'capacity' bytes.
+ *
+ * @param capacity The usable size of the chunk, already rounded
+ * @return arena_chunk_t* - Returns the new chunk, NULL on error
+ */
+static arena_chunk_t *arena_chunk_create(size_t capacity);
+
+arena_t *arena_create(size_t capacity)
+{
+    arena_t *arena_p = NULL;
+
+    if (0 == capacity)
+    {
+        capacity = ARENA_DEFAULT_CAPACITY;
+    }
+
+    if (E_SUCCESS != arena_round(capacity, &capacity))
+    {
+        print_error("arena_create(): Invalid capacity.");
+        goto END;
+    }
+
+    arena_p = calloc(1, sizeof(arena_t));
+    if (NULL == arena_p)
+    {
+        print_error("arena_create(): CMR failure.");
+        goto END;
+    }
+
+    arena_p->head = arena_chunk_create(capacity);
+    if (NULL == arena_p->head)
+    {
+        free(arena_p);
+        arena_p = NULL;
+        goto END;
+    }
+    arena_p->current = arena_p->head;
+
+END:
+    return arena_p;
+}
+
+void *arena_alloc(arena_t *arena_p, size_t size)
+{
+    void *memory_p = NULL;
+    arena_chunk_t *chunk_p = NULL;
+    size_t capacity = 0;
+
+    if (NULL == arena_p)
+    {
+        print_error("arena_alloc(): NULL argument passed.");
+        goto END;
+    }
+
+    if ((0 == size) || (E_SUCCESS != arena_round(size, &size)))
+    {
+        print_error("arena_alloc(): Invalid size.");
+        goto END;
+    }
+
+    // Move on to the chunks kept from before the last reset, then grow
+    while (size > (arena_p->current->capacity - arena_p->offset))
+    {
+        if (NULL == arena_p->current->next)
+        {
+            capacity = arena_p->current->capacity;
+            if ((SIZE_MAX / ARENA_GROWTH_FACTOR) >= capacity)
+            {
+                capacity *= ARENA_GROWTH_FACTOR;
+            }
+
+            chunk_p = arena_chunk_create((size > capacity) ? size : capacity);
+            if (NULL == chunk_p)
+            {
+                goto END;
+            }
+            arena_p->current->next = chunk_p;
+        }
+
+        arena_p->used += arena_p->current->capacity - arena_p->offset;
+        arena_p->current = arena_p->current->next;
+        arena_p->offset = 0;
+    }
+
+    memory_p = (unsigned char *)arena_p->current->data + arena_p->offset;
+    arena_p->offset += size;
+    arena_p->used += size;
+
+END:
+    return memory_p;
+}
+
+void *arena_calloc(arena_t *arena_p, size_t count, size_t size)
+{
+    void *memory_p = NULL;
+
+    if ((0 != size) && ((SIZE_MAX / size) < count))
+    {
+        print_error("arena_calloc(): Size overflow.");
+        goto END;
+    }
+
+    memory_p = arena_alloc(arena_p, count * size);
+    if (NULL != memory_p)
+    {
+        memset(memory_p, 0, count * size);
+    }
+
+END:
+    return memory_p;
+}
+
+void arena_reset(arena_t *arena_p)
+{
+    if (NULL == arena_p)
+    {
+        print_error("arena_reset(): NULL argument passed.");
+        return;
+    }
+
+    arena_p->current = arena_p->head;
+    arena_p->offset = 0;
+    arena_p->used = 0;
+}
+
+size_t arena_used(const arena_t *arena_p)
+{
+    size_t used = 0;
+
+    if (NULL == arena_p)
+    {
+        print_error("arena_used(): NULL argument passed.");
+        goto END;
+    }
+
+    used = arena_p->used;
+
+END:
+    return used;
+}
+
+int arena_destroy(arena_t **arena_pp)
+{
+    int exit_code = E_FAILURE;
+    arena_chunk_t *chunk_p = NULL;
+
+    if ((NULL == arena_pp) || (NULL == *arena_pp))
+    {
+        print_error("arena_destroy(): NULL argument passed.");
+        goto END;
+    }
+
+    while (NULL != (*arena_pp)->head)
+    {
+        chunk_p = (*arena_pp)->head;
+        (*arena_pp)->head = chunk_p->next;
+        free(chunk_p);
+    }
+
+    free(*arena_pp);
+    *arena_pp = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+arena_pool_t *arena_pool_create(size_t arena_capacity, size_t arena_count)
+{
+    arena_pool_t *pool_p = NULL;
+    arena_t *arena_p = NULL;
+
+    pool_p = calloc(1, sizeof(arena_pool_t));
+    if (NULL == pool_p)
+    {
+        print_error("arena_pool_create(): CMR failure.");
+        goto END;
+    }
+
+    if (E_SUCCESS != pthread_mutex_init(&pool_p->mutex, NULL))
+    {
+        print_error("arena_pool_create(): Unable to initialize mutex.");
+        free(pool_p);
+        pool_p = NULL;
+        goto END;
+    }
+
+    pool_p->capacity = arena_capacity;
+    pool_p->max_idle = arena_count;
+
+    for (size_t idx = 0; idx < arena_count; idx++)
+    {
+        arena_p = arena_create(arena_capacity);
+        if (NULL == arena_p)
+        {
+            arena_pool_destroy(&pool_p);
+            goto END;
+        }
+
+        arena_p->next = pool_p->idle;
+        pool_p->idle = arena_p;
+        pool_p->idle_count++;
+    }
+
+END:
+    return pool_p;
+}
+
+arena_t *arena_pool_acquire(arena_pool_t *pool_p)
+{
+    arena_t *arena_p = NULL;
+
+    if (NULL == pool_p)
+    {
+        print_error("arena_pool_acquire(): NULL argument passed.");
+        goto END;
+    }
+
+    pthread_mutex_lock(&pool_p->mutex);
+    arena_p = pool_p->idle;
+    if (NULL != arena_p)
+    {
+        pool_p->idle = arena_p->next;
+        pool_p->idle_count--;
+    }
+    pthread_mutex_unlock(&pool_p->mutex);
+
+    if (NULL != arena_p)
+    {
+        arena_p->next = NULL;
+        goto END;
+    }
+
+    // Every arena is in use, the pool drops the extra one when it comes back
+    arena_p = arena_create(pool_p->capacity);
+
+END:
+    return arena_p;
+}
+
+int arena_pool_release(arena_pool_t *pool_p, arena_t *arena_p)
+{
+    int exit_code = E_FAILURE;
+    bool kept = false;
+
+    if ((NULL == pool_p) || (NULL == arena_p))
+    {
+        print_error("arena_pool_release(): NULL argument passed.");
+        goto END;
+    }
+
+    arena_reset(arena_p);
+
+    pthread_mutex_lock(&pool_p->mutex);
+    if (pool_p->max_idle > pool_p->idle_count)
+    {
+        arena_p->next = pool_p->idle;
+        pool_p->idle = arena_p;
+        pool_p->idle_count++;
+        kept = true;
+    }
+    pthread_mutex_unlock(&pool_p->mutex);
+
+    if (false == kept)
+    {
+        arena_destroy(&arena_p);
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int arena_pool_destroy(arena_pool_t **pool_pp)
+{
+    int exit_code = E_FAILURE;
+    arena_t *arena_p = NULL;
+
+    if ((NULL == pool_pp) || (NULL == *pool_pp))
+    {
+        print_error("arena_pool_destroy(): NULL argument passed.");
+        goto END;
+    }
+
+    while (NULL != (*pool_pp)->idle)
+    {
+        arena_p = (*pool_pp)->idle;
+        (*pool_pp)->idle = arena_p->next;
+        arena_destroy(&arena_p);
+    }
+
+    pthread_mutex_destroy(&(*pool_pp)->mutex);
+    free(*pool_pp);
+    *pool_pp = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static int arena_round(size_t size, size_t *rounded_p)
+{
+    int exit_code = E_FAILURE;
+
+    if ((SIZE_MAX - ARENA_ALIGNMENT) < size)
+    {
+        goto END;
+    }
+
+    *rounded_p = ((size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT) *
+                 ARENA_ALIGNMENT;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static arena_chunk_t *arena_chunk_create(size_t capacity)
+{
+    arena_chunk_t *chunk_p = NULL;
+
+    if ((SIZE_MAX - sizeof(arena_chunk_t)) < capacity)
+    {
+        print_error("arena_chunk_create(): Invalid capacity.");
+        goto END;
+    }
+
+    chunk_p = malloc(sizeof(arena_chunk_t) + capacity);
+    if (NULL == chunk_p)
+    {
+        print_error("arena_chunk_create(): CMR failure.");
+        goto END;
+    }
+
+    chunk_p->next = NULL;
+    chunk_p->capacity = capacity;
+
+END:
+    return chunk_p;
+}
+
+/*** end of file ***/
@@ -0,0 +1,288 @@
+#include "arena.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPACITY     64
+#define ALLOCATIONS  32
+#define POOL_ARENAS  2
+#define THREADS      4
+#define ROUNDS       10000
+#define REQUEST_SIZE 40
+
+// The arena to be used by the single threaded tests
+arena_t *arena = NULL;
+
+// Shared state for the concurrent pool test
+arena_pool_t *shared_pool = NULL;
+atomic_int pool_errors;
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void test_arena_create()
+{
+    arena_t *default_arena = arena_create(0);
+
+    // A zero capacity falls back to the default
+    CU_ASSERT_FATAL(NULL != default_arena);
+    CU_ASSERT(0 == arena_used(default_arena));
+    CU_ASSERT(0 == arena_destroy(&default_arena));
+
+    arena = arena_create(CAPACITY);
+    CU_ASSERT_FATAL(NULL != arena);
+}
+
+void test_arena_alloc()
+{
+    unsigned char *memory[ALLOCATIONS];
+    void *large = NULL;
+    int overlaps = 0;
+
+    // Should catch invalid arguments
+    CU_ASSERT(NULL == arena_alloc(NULL, 1));
+    CU_ASSERT(NULL == arena_alloc(arena, 0));
+    CU_ASSERT(NULL == arena_alloc(arena, SIZE_MAX));
+
+    // Allocate well past the first chunk so the arena has to grow
+    for (int idx = 0; idx < ALLOCATIONS; idx++)
+    {
+        memory[idx] = arena_alloc(arena, (size_t)idx + 1);
+        CU_ASSERT_FATAL(NULL != memory[idx]);
+        CU_ASSERT(0 == ((uintptr_t)memory[idx] % alignof(max_align_t)));
+        memset(memory[idx], idx, (size_t)idx + 1);
+    }
+
+    for (int idx = 0; idx < ALLOCATIONS; idx++)
+    {
+        for (int byte = 0; byte <= idx; byte++)
+        {
+            if (idx != memory[idx][byte])
+            {
+                overlaps++;
+            }
+        }
+    }
+    CU_ASSERT(0 == overlaps);
+
+    // A request bigger than any chunk gets a chunk of its own
+    large = arena_alloc(arena, CAPACITY * 16);
+    CU_ASSERT_FATAL(NULL != large);
+    memset(large, 0xFF, CAPACITY * 16);
+    CU_ASSERT(ALLOCATIONS - 1 == memory[ALLOCATIONS - 1][ALLOCATIONS - 1]);
+}
+
+void test_arena_calloc()
+{
+    unsigned char *memory = NULL;
+    int non_zero = 0;
+
+    CU_ASSERT(NULL == arena_calloc(arena, SIZE_MAX / 2, 4));
+
+    memory = arena_calloc(arena, CAPACITY, 2);
+    CU_ASSERT_FATAL(NULL != memory);
+    for (int idx = 0; idx < (CAPACITY * 2); idx++)
+    {
+        if (0 != memory[idx])
+        {
+            non_zero++;
+        }
+    }
+    CU_ASSERT(0 == non_zero);
+}
+
+void test_arena_reset()
+{
+    void *first[ALLOCATIONS];
+    void *again = NULL;
+    int moved = 0;
+
+    arena_reset(arena);
+    CU_ASSERT(0 == arena_used(arena));
+
+    for (int idx = 0; idx < ALLOCATIONS; idx++)
+    {
+        first[idx] = arena_alloc(arena, CAPACITY / 2);
+        CU_ASSERT_FATAL(NULL != first[idx]);
+    }
+    CU_ASSERT((ALLOCATIONS * (CAPACITY / 2)) <= arena_used(arena));
+
+    // The same requests after a reset land in the same chunks, nothing new
+    // has to be allocated
+    arena_reset(arena);
+    for (int idx = 0; idx < ALLOCATIONS; idx++)
+    {
+        again = arena_alloc(arena, CAPACITY / 2);
+        if (first[idx] != again)
+        {
+            moved++;
+        }
+    }
+    CU_ASSERT(0 == moved);
+}
+
+void test_arena_pool()
+{
+    arena_pool_t *pool = NULL;
+    arena_t *arenas[POOL_ARENAS + 1] = { NULL };
+    void *memory = NULL;
+
+    CU_ASSERT(NULL == arena_pool_acquire(NULL));
+    CU_ASSERT(0 != arena_pool_release(NULL, arena));
+
+    pool = arena_pool_create(CAPACITY, POOL_ARENAS);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    // Acquiring past the pool's arenas creates a new one
+    for (int idx = 0; idx <= POOL_ARENAS; idx++)
+    {
+        arenas[idx] = arena_pool_acquire(pool);
+        CU_ASSERT_FATAL(NULL != arenas[idx]);
+    }
+
+    // A released arena comes back empty
+    memory = arena_alloc(arenas[0], CAPACITY);
+    CU_ASSERT(NULL != memory);
+    CU_ASSERT(0 == arena_pool_release(pool, arenas[0]));
+    CU_ASSERT(arenas[0] == arena_pool_acquire(pool));
+    CU_ASSERT(0 == arena_used(arenas[0]));
+    CU_ASSERT(memory == arena_alloc(arenas[0], CAPACITY));
+
+    // The extra arena is destroyed rather than kept past the limit
+    for (int idx = 0; idx <= POOL_ARENAS; idx++)
+    {
+        CU_ASSERT(0 == arena_pool_release(pool, arenas[idx]));
+    }
+
+    CU_ASSERT(0 == arena_pool_destroy(&pool));
+    CU_ASSERT(NULL == pool);
+    CU_ASSERT(0 != arena_pool_destroy(&pool));
+}
+
+void *arena_pool_worker(void *arg)
+{
+    arena_t *arena_p = NULL;
+    unsigned char *memory = NULL;
+    unsigned char mark = (unsigned char)(intptr_t)arg;
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        arena_p = arena_pool_acquire(shared_pool);
+        if (NULL == arena_p)
+        {
+            atomic_fetch_add(&pool_errors, 1);
+            continue;
+        }
+
+        // No other thread may touch the arena while it is held
+        memory = arena_alloc(arena_p, REQUEST_SIZE);
+        if ((NULL == memory) || (REQUEST_SIZE > arena_used(arena_p)) ||
+            ((2 * REQUEST_SIZE) <= arena_used(arena_p)))
+        {
+            atomic_fetch_add(&pool_errors, 1);
+        }
+        else
+        {
+            memset(memory, mark, REQUEST_SIZE);
+            if (mark != memory[REQUEST_SIZE - 1])
+            {
+                atomic_fetch_add(&pool_errors, 1);
+            }
+        }
+
+        arena_pool_release(shared_pool, arena_p);
+    }
+
+    return NULL;
+}
+
+void test_arena_pool_threads()
+{
+    pthread_t threads[THREADS];
+
+    // Fewer arenas than threads exercises the create and drop paths too
+    shared_pool = arena_pool_create(0, THREADS / 2);
+    CU_ASSERT_FATAL(NULL != shared_pool);
+    atomic_store(&pool_errors, 0);
+
+    for (intptr_t idx = 0; idx < THREADS; idx++)
+    {
+        pthread_create(&threads[idx], NULL, arena_pool_worker, (void *)idx);
+    }
+
+    for (int idx = 0; idx < THREADS; idx++)
+    {
+        pthread_join(threads[idx], NULL);
+    }
+
+    CU_ASSERT(0 == atomic_load(&pool_errors));
+    CU_ASSERT(0 == arena_pool_destroy(&shared_pool));
+}
+
+void test_arena_destroy()
+{
+    arena_t *invalid_arena = NULL;
+
+    CU_ASSERT(0 != arena_destroy(&invalid_arena));
+    CU_ASSERT(0 == arena_destroy(&arena));
+    CU_ASSERT(NULL == arena);
+    CU_ASSERT(0 != arena_destroy(&arena));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing arena_create():", test_arena_create },
+
+        { "Testing arena_alloc():", test_arena_alloc },
+
+        { "Testing arena_calloc():", test_arena_calloc },
+
+        { "Testing arena_reset():", test_arena_reset },
+
+        { "Testing arena_pool_acquire()/release():", test_arena_pool },
+
+        { "Testing arena pool across threads:", test_arena_pool_threads },
+
+        { "Testing arena_destroy():", test_arena_destroy },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
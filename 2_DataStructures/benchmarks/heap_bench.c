@@ -0,0 +1,170 @@
+/**
+ * @file heap_bench.c
+ *
+ * @brief Compares 2-ary and 4-ary heap layouts from 1K to 10M elements. Each
+ * run times pushing every item one at a time, building the same items with
+ * heap_heapify(), and popping the heap empty.
+ */
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "heap.h"
+#include "utilities.h"
+
+#define MIN_ENTRIES   1000
+#define MAX_ENTRIES   10000000
+#define GROWTH_FACTOR 10
+#define NSEC_PER_SEC  1000000000ULL
+
+/**
+ * @brief The per-operation costs of one run, in nanoseconds
+ */
+typedef struct bench_result
+{
+    double push;
+    double heapify;
+    double pop;
+} bench_result_t;
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds
+ *
+ * @return the current time in nanoseconds
+ */
+static uint64_t now_ns(void);
+
+/**
+ * @brief Times push, heapify and pop for one arity and size
+ *
+ * @param arity the heap arity to measure
+ * @param items the data pointers to store
+ * @param entries the number of entries in 'items'
+ * @param result receives the average cost of each operation
+ * @return 0 on success, -1 on failure
+ */
+static int bench_heap(uint32_t         arity,
+                      void **          items,
+                      uint32_t         entries,
+                      bench_result_t * result);
+
+int main(void)
+{
+    int            exit_code = E_FAILURE;
+    int *          keys      = NULL;
+    void **        items     = NULL;
+    bench_result_t binary    = { 0 };
+    bench_result_t quad      = { 0 };
+
+    keys  = calloc(MAX_ENTRIES, sizeof(int));
+    items = calloc(MAX_ENTRIES, sizeof(void *));
+    if ((NULL == keys) || (NULL == items))
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    srand(1);
+    for (uint32_t idx = 0; idx < MAX_ENTRIES; idx++)
+    {
+        keys[idx]  = rand();
+        items[idx] = &keys[idx];
+    }
+
+    printf("%10s %7s %10s %10s %10s\n",
+           "entries",
+           "arity",
+           "ns/push",
+           "ns/build",
+           "ns/pop");
+
+    for (uint32_t entries = MIN_ENTRIES; entries <= MAX_ENTRIES;
+         entries *= GROWTH_FACTOR)
+    {
+        if ((E_SUCCESS != bench_heap(2, items, entries, &binary)) ||
+            (E_SUCCESS != bench_heap(4, items, entries, &quad)))
+        {
+            print_error("Benchmark failed.");
+            goto END;
+        }
+
+        printf("%10u %7d %10.2f %10.2f %10.2f\n",
+               entries,
+               2,
+               binary.push,
+               binary.heapify,
+               binary.pop);
+        printf("%10u %7d %10.2f %10.2f %10.2f\n",
+               entries,
+               4,
+               quad.push,
+               quad.heapify,
+               quad.pop);
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    free(keys);
+    free(items);
+    return exit_code;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * NSEC_PER_SEC) + (uint64_t)now.tv_nsec;
+}
+
+static int bench_heap(uint32_t         arity,
+                      void **          items,
+                      uint32_t         entries,
+                      bench_result_t * result)
+{
+    int      exit_code = E_FAILURE;
+    heap_t * heap      = NULL;
+    uint64_t start     = 0;
+
+    heap = heap_init(arity, entries, int_comp, NULL);
+    if (NULL == heap)
+    {
+        goto END;
+    }
+
+    start = now_ns();
+    for (uint32_t idx = 0; idx < entries; idx++)
+    {
+        if (E_SUCCESS != heap_push(heap, items[idx], NULL))
+        {
+            goto END;
+        }
+    }
+    result->push = (double)(now_ns() - start) / entries;
+
+    heap_clear(heap);
+    start = now_ns();
+    if (E_SUCCESS != heap_heapify(heap, items, entries, NULL))
+    {
+        goto END;
+    }
+    result->heapify = (double)(now_ns() - start) / entries;
+
+    start = now_ns();
+    while (NULL != heap_pop(heap))
+    {
+    }
+    result->pop = (double)(now_ns() - start) / entries;
+
+    exit_code = E_SUCCESS;
+END:
+    if (NULL != heap)
+    {
+        heap_destroy(&heap);
+    }
+    return exit_code;
+}
+
+/*** end of file ***/
@@ -0,0 +1,120 @@
+/**
+ * @file queue_bench.c
+ *
+ * @brief Measures the per-operation cost of queue_dequeue() as the number of
+ * stored nodes grows. With the ring buffer the cost should stay flat from a
+ * handful of nodes up to a million.
+ */
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "queue.h"
+#include "utilities.h"
+
+#define MIN_ENTRIES    8
+#define MAX_ENTRIES    (1024 * 1024)
+#define GROWTH_FACTOR  2
+#define NSEC_PER_SEC   1000000000ULL
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds
+ *
+ * @return the current time in nanoseconds
+ */
+static uint64_t now_ns(void);
+
+/**
+ * @brief Fills a queue with 'entries' nodes and times draining it
+ *
+ * @param entries the number of nodes to enqueue and then dequeue
+ * @return the average cost of one dequeue in nanoseconds, or a negative value
+ * on failure
+ */
+static double bench_dequeue(uint32_t entries);
+
+int main(void)
+{
+    int    exit_code = E_FAILURE;
+    double per_op    = 0;
+
+    printf("%12s %16s\n", "entries", "ns/dequeue");
+
+    for (uint32_t entries = MIN_ENTRIES; entries <= MAX_ENTRIES;
+         entries *= GROWTH_FACTOR)
+    {
+        per_op = bench_dequeue(entries);
+        if (0 > per_op)
+        {
+            print_error("Benchmark failed.");
+            goto END;
+        }
+
+        printf("%12u %16.2f\n", entries, per_op);
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * NSEC_PER_SEC) + (uint64_t)now.tv_nsec;
+}
+
+static double bench_dequeue(uint32_t entries)
+{
+    double          per_op  = -1;
+    queue_t *       queue   = NULL;
+    queue_node_t ** drained = NULL;
+    int             payload = 0;
+    uint64_t        start   = 0;
+    uint64_t        elapsed = 0;
+
+    queue   = queue_init(entries, NULL);
+    drained = calloc(entries, sizeof(queue_node_t *));
+    if ((NULL == queue) || (NULL == drained))
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    for (uint32_t idx = 0; idx < entries; idx++)
+    {
+        if (E_SUCCESS != queue_enqueue(queue, &payload))
+        {
+            print_error("Unable to fill queue.");
+            goto END;
+        }
+    }
+
+    // Only the dequeues are timed; the nodes are freed afterwards
+    start = now_ns();
+    for (uint32_t idx = 0; idx < entries; idx++)
+    {
+        drained[idx] = queue_dequeue(queue);
+    }
+    elapsed = now_ns() - start;
+
+    for (uint32_t idx = 0; idx < entries; idx++)
+    {
+        free(drained[idx]);
+    }
+
+    per_op = (double)elapsed / entries;
+END:
+    free(drained);
+    if (NULL != queue)
+    {
+        queue_destroy(&queue);
+    }
+    return per_op;
+}
+
+/*** end of file ***/
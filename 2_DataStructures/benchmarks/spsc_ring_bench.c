@@ -0,0 +1,241 @@
+/**
+ * @file spsc_ring_bench.c
+ *
+ * @brief Compares one-producer/one-consumer throughput of the SPSC ring, with
+ * single and batched operations, against a queue_t guarded by a mutex.
+ */
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "queue.h"
+#include "spsc_ring.h"
+#include "utilities.h"
+
+#define TOTAL_ITEMS   (size_t)(4 * 1024 * 1024)
+#define RING_CAPACITY 1024
+#define BATCH_SIZE    64
+#define NSEC_PER_SEC  1000000000ULL
+
+/**
+ * @brief The variants being compared
+ */
+typedef enum bench_mode
+{
+    MODE_MUTEX_QUEUE,
+    MODE_SPSC_SINGLE,
+    MODE_SPSC_BATCH
+} bench_mode_t;
+
+/**
+ * @brief State shared by the producer and consumer of one run
+ */
+typedef struct bench
+{
+    bench_mode_t    mode;
+    queue_t *       queue;
+    pthread_mutex_t mutex;
+    spsc_ring_t *   ring;
+    size_t          checksum;
+} bench_t;
+
+// Payload pointers; only their addresses matter
+static char payload[BATCH_SIZE];
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds
+ *
+ * @return the current time in nanoseconds
+ */
+static uint64_t now_ns(void);
+
+/**
+ * @brief Pushes TOTAL_ITEMS items using the run's mode
+ *
+ * @param arg the bench_t of the run
+ * @return NULL
+ */
+static void * produce(void * arg);
+
+/**
+ * @brief Pops TOTAL_ITEMS items using the run's mode
+ *
+ * @param bench the state of the run
+ */
+static void consume(bench_t * bench);
+
+/**
+ * @brief Runs one producer/consumer pair and reports its throughput
+ *
+ * @param mode the variant to run
+ * @param name the label to print
+ * @return 0 on success, -1 on failure
+ */
+static int run(bench_mode_t mode, const char * name);
+
+int main(void)
+{
+    int exit_code = E_FAILURE;
+
+    printf("%-24s %14s\n", "variant", "Mitems/s");
+
+    if ((E_SUCCESS != run(MODE_MUTEX_QUEUE, "queue_t + mutex")) ||
+        (E_SUCCESS != run(MODE_SPSC_SINGLE, "spsc_ring push/pop")) ||
+        (E_SUCCESS != run(MODE_SPSC_BATCH, "spsc_ring batch")))
+    {
+        print_error("Benchmark failed.");
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * NSEC_PER_SEC) + (uint64_t)now.tv_nsec;
+}
+
+static void * produce(void * arg)
+{
+    bench_t * bench = arg;
+    void *    batch[BATCH_SIZE];
+    size_t    sent   = 0;
+    size_t    pushed = 0;
+    int       result = E_FAILURE;
+
+    for (size_t idx = 0; idx < BATCH_SIZE; idx++)
+    {
+        batch[idx] = &payload[idx];
+    }
+
+    while (sent < TOTAL_ITEMS)
+    {
+        switch (bench->mode)
+        {
+            case MODE_MUTEX_QUEUE:
+                pthread_mutex_lock(&bench->mutex);
+                result = E_FAILURE;
+                if (E_SUCCESS != queue_fullcheck(bench->queue))
+                {
+                    result = queue_enqueue(bench->queue, batch[0]);
+                }
+                pthread_mutex_unlock(&bench->mutex);
+                pushed = (E_SUCCESS == result) ? 1 : 0;
+                break;
+
+            case MODE_SPSC_SINGLE:
+                result = spsc_ring_push(bench->ring, batch[0]);
+                pushed = (E_SUCCESS == result) ? 1 : 0;
+                break;
+
+            default:
+                pushed = spsc_ring_push_batch(bench->ring, batch, BATCH_SIZE);
+                break;
+        }
+
+        if (0 == pushed)
+        {
+            sched_yield();
+        }
+        sent += pushed;
+    }
+
+    return NULL;
+}
+
+static void consume(bench_t * bench)
+{
+    void * batch[BATCH_SIZE];
+    size_t received = 0;
+    size_t popped   = 0;
+
+    while (received < TOTAL_ITEMS)
+    {
+        switch (bench->mode)
+        {
+            case MODE_MUTEX_QUEUE:
+                pthread_mutex_lock(&bench->mutex);
+                batch[0] = queue_dequeue_data(bench->queue);
+                pthread_mutex_unlock(&bench->mutex);
+                popped = (NULL != batch[0]) ? 1 : 0;
+                break;
+
+            case MODE_SPSC_SINGLE:
+                batch[0] = spsc_ring_pop(bench->ring);
+                popped   = (NULL != batch[0]) ? 1 : 0;
+                break;
+
+            default:
+                popped = spsc_ring_pop_batch(bench->ring, batch, BATCH_SIZE);
+                break;
+        }
+
+        if (0 == popped)
+        {
+            sched_yield();
+        }
+
+        for (size_t idx = 0; idx < popped; idx++)
+        {
+            bench->checksum += (size_t)((char *)batch[idx] - payload);
+        }
+        received += popped;
+    }
+}
+
+static int run(bench_mode_t mode, const char * name)
+{
+    int       exit_code = E_FAILURE;
+    bench_t   bench     = { 0 };
+    pthread_t producer;
+    uint64_t  start   = 0;
+    uint64_t  elapsed = 0;
+
+    bench.mode = mode;
+    pthread_mutex_init(&bench.mutex, NULL);
+    bench.queue = queue_init_inline(RING_CAPACITY, NULL);
+    bench.ring  = spsc_ring_init(RING_CAPACITY);
+    if ((NULL == bench.queue) || (NULL == bench.ring))
+    {
+        print_error("Unable to create queues.");
+        goto END;
+    }
+
+    start = now_ns();
+    if (E_SUCCESS != pthread_create(&producer, NULL, produce, &bench))
+    {
+        print_error("Unable to create producer.");
+        goto END;
+    }
+    consume(&bench);
+    pthread_join(producer, NULL);
+    elapsed = now_ns() - start;
+
+    printf("%-24s %14.2f\n",
+           name,
+           ((double)TOTAL_ITEMS * 1000.0) / (double)elapsed);
+
+    exit_code = E_SUCCESS;
+END:
+    if (NULL != bench.queue)
+    {
+        queue_destroy(&bench.queue);
+    }
+    if (NULL != bench.ring)
+    {
+        spsc_ring_destroy(&bench.ring);
+    }
+    pthread_mutex_destroy(&bench.mutex);
+    return exit_code;
+}
+
+/*** end of file ***/
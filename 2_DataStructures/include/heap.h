@@ -0,0 +1,149 @@
+/**
+ * @file heap.h
+ *
+ * @brief Implicit d-ary heap priority queue ordered by a CMP_F comparator.
+ *
+ * Items are kept in one contiguous array with the children of slot i at
+ * slots d*i+1 .. d*i+d, so a sift-down scans a run of neighbouring slots
+ * instead of chasing pointers. A wider arity gives a shallower tree at the
+ * cost of more comparisons per level; 4 is usually the fastest. The item
+ * the comparator reports as smallest is at the top, pass a comparator with
+ * its result reversed for a max-heap.
+ *
+ * Every stored item gets a handle that stays valid until the item leaves the
+ * heap, which lets heap_decrease_key() find it again in O(1).
+ */
+#ifndef _HEAP_H
+#define _HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "comparisons.h"
+
+/**
+ * @brief A pointer to a user-defined free function used to release stored
+ *        data on heap_clear() and heap_destroy()
+ */
+typedef void (*FREE_F)(void *);
+
+/**
+ * @brief handle to an item stored in a heap
+ */
+typedef uint32_t heap_handle_t;
+
+/**
+ * @brief the arity used when 0 is passed to heap_init()
+ */
+#define HEAP_DEFAULT_ARITY 4
+
+/**
+ * @brief value of a handle that refers to no item
+ */
+#define HEAP_INVALID_HANDLE UINT32_MAX
+
+/**
+ * @brief opaque d-ary heap type
+ */
+typedef struct heap heap_t;
+
+/**
+ * @brief creates a new heap
+ *
+ * @param arity the number of children per node (at least 2), 0 for
+ * HEAP_DEFAULT_ARITY
+ * @param capacity the number of items to allocate room for up front; the
+ * heap grows as needed
+ * @param compare the comparator ordering the items, returns ONE when its
+ * first argument belongs below its second
+ * @param customfree function used to free stored data, may be NULL
+ * @return the new heap on success, NULL on failure
+ */
+heap_t * heap_init(uint32_t arity,
+                   uint32_t capacity,
+                   CMP_F    compare,
+                   FREE_F   customfree);
+
+/**
+ * @brief inserts an item
+ *
+ * @param heap pointer to the heap
+ * @param data the data pointer to store, must not be NULL
+ * @param handle_p if not NULL, receives the handle of the new item
+ * @return 0 on success, non-zero value on failure
+ */
+int heap_push(heap_t * heap, void * data, heap_handle_t * handle_p);
+
+/**
+ * @brief removes the top item
+ *
+ * @param heap pointer to the heap
+ * @note the handle of the removed item becomes invalid
+ * @return the data of the top item, NULL if the heap is empty or on error
+ */
+void * heap_pop(heap_t * heap);
+
+/**
+ * @brief returns the top item without removing it
+ *
+ * @param heap pointer to the heap
+ * @return the data of the top item, NULL if the heap is empty or on error
+ */
+void * heap_peek(heap_t * heap);
+
+/**
+ * @brief moves an item up after its key has improved
+ *
+ * @param heap pointer to the heap
+ * @param handle the handle returned when the item was pushed
+ * @param data the item's new data, which must not compare larger than the
+ * data it replaces; pass the stored pointer again after updating its key in
+ * place
+ * @return 0 on success, non-zero value on failure
+ */
+int heap_decrease_key(heap_t * heap, heap_handle_t handle, void * data);
+
+/**
+ * @brief adds a batch of items and restores heap order in O(n + count)
+ *        rather than O(count log n)
+ *
+ * @param heap pointer to the heap
+ * @param data array of data pointers to store, none of which may be NULL
+ * @param count number of entries in 'data'
+ * @param handles_p if not NULL, an array of 'count' entries receiving the
+ * handle of each item
+ * @return 0 on success, non-zero value on failure, in which case the heap is
+ * left unchanged
+ */
+int heap_heapify(heap_t *        heap,
+                 void **         data,
+                 uint32_t        count,
+                 heap_handle_t * handles_p);
+
+/**
+ * @brief returns the number of items stored
+ *
+ * @param heap pointer to the heap
+ * @return the number of items, 0 on error
+ */
+uint32_t heap_size(const heap_t * heap);
+
+/**
+ * @brief removes every item, freeing the data with the heap's customfree
+ *
+ * @param heap pointer to the heap
+ * @return 0 on success, non-zero value on failure
+ */
+int heap_clear(heap_t * heap);
+
+/**
+ * @brief destroys a heap and every item still stored in it
+ *
+ * @param heap_addr pointer to address of heap to be destroyed
+ * @return 0 on success, non-zero value on failure
+ */
+int heap_destroy(heap_t ** heap_addr);
+
+#endif /* _HEAP_H */
+
+/*** end of file ***/
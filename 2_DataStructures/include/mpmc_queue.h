@@ -0,0 +1,86 @@
+/**
+ * @file mpmc_queue.h
+ *
+ * @brief Bounded lock-free multi-producer/multi-consumer queue.
+ *
+ * Every slot carries a sequence number that tells producers and consumers
+ * whether the slot is ready to be written or read for the current lap of the
+ * ring, so both sides only contend on a single compare-and-swap of their own
+ * position counter. Capacity is rounded up to a power of two.
+ */
+#ifndef _MPMC_QUEUE_H
+#define _MPMC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Size used to keep the producer and consumer positions on separate
+ *        cache lines
+ */
+#define MPMC_CACHE_LINE 64
+
+/**
+ * @brief opaque lock-free queue type
+ */
+typedef struct mpmc_queue mpmc_queue_t;
+
+/**
+ * @brief creates a new lock-free queue
+ *
+ * @param capacity minimum number of items the queue will hold, rounded up to
+ * the next power of two (at least 2, at most 2^31)
+ * @return the new queue on success, NULL on failure
+ */
+mpmc_queue_t * mpmc_queue_init(uint32_t capacity);
+
+/**
+ * @brief pushes a data pointer into the queue; safe to call from any number
+ *        of threads concurrently
+ *
+ * @param queue pointer to the queue to push into
+ * @param data the data pointer to store, must not be NULL
+ * @note a full queue is reported as a failure without printing, since it is
+ * an expected condition on the hot path
+ * @return 0 on success, non-zero value if the queue is full or on error
+ */
+int mpmc_queue_enqueue(mpmc_queue_t * queue, void * data);
+
+/**
+ * @brief pops the oldest data pointer out of the queue; safe to call from any
+ *        number of threads concurrently
+ *
+ * @param queue pointer to the queue to pop from
+ * @return the data pointer on success, NULL if the queue is empty or on error
+ */
+void * mpmc_queue_dequeue(mpmc_queue_t * queue);
+
+/**
+ * @brief returns the number of items the queue can hold
+ *
+ * @param queue pointer to the queue
+ * @return the capacity, 0 on error
+ */
+uint32_t mpmc_queue_capacity(const mpmc_queue_t * queue);
+
+/**
+ * @brief returns the number of items currently stored
+ *
+ * @param queue pointer to the queue
+ * @note the value is a snapshot and may be stale by the time it is read when
+ * other threads are using the queue
+ * @return the number of items stored, 0 on error
+ */
+size_t mpmc_queue_size(mpmc_queue_t * queue);
+
+/**
+ * @brief destroys a queue; stored data pointers are not freed
+ *
+ * @param queue_addr pointer to address of queue to be destroyed
+ * @return 0 on success, non-zero value on failure
+ */
+int mpmc_queue_destroy(mpmc_queue_t ** queue_addr);
+
+#endif /* _MPMC_QUEUE_H */
+
+/*** end of file ***/
@@ -1,10 +1,13 @@
 #ifndef _QUEUE_H
 #define _QUEUE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "slab.h"
+
 /**
  * @brief structure of a queue node
  *
@@ -25,21 +28,62 @@ typedef struct queue_node_t
  */
 typedef void (*FREE_F)(void *);
 
+/**
+ * @brief storage mode of a queue
+ *
+ * @param QUEUE_MODE_NODE every item is wrapped in a heap allocated
+ *        queue_node_t that the consumer must free after queue_dequeue()
+ * @param QUEUE_MODE_INLINE data pointers are stored directly in a contiguous
+ *        slot array; no per-item allocation is made and items are retrieved
+ *        with queue_dequeue_data()/queue_peek_data()
+ */
+typedef enum queue_mode
+{
+    QUEUE_MODE_NODE,
+    QUEUE_MODE_INLINE
+} queue_mode_t;
+
 /**
  * @brief structure of a queue object
  *
- * @param capacity is the number of nodes the queue can hold
+ * @param capacity is the number of nodes the queue can currently hold
  * @param currentsz is the number of nodes the queue is currently storing
+ * @param head is the index of the front node in arr
+ * @param tail is the index of the next free slot in arr
+ * @param min_capacity is the capacity a growable queue shrinks back to
+ * @param max_capacity is the high-water mark a growable queue never grows
+ *        past, 0 if the queue may grow without limit
+ * @param growable states if the queue resizes itself instead of rejecting
+ *        items once capacity is reached
+ * @param mode is the storage mode the queue was created with
  * @param customfree is a FREE_F pointer to a user defined free function
- * @param arr is the array containing the queue node pointers
+ * @param node_slab is the allocator nodes come from in QUEUE_MODE_NODE, NULL
+ *        to use malloc()
+ * @param arr is the circular array containing the queue node pointers, only
+ *        allocated in QUEUE_MODE_NODE
+ * @param slots is the circular array containing the data pointers, only
+ *        allocated in QUEUE_MODE_INLINE
  *
+ * @note arr and slots are used as ring buffers: head and tail wrap around to 0
+ * when they reach capacity, so enqueue, dequeue and peek never move the stored
+ * items. A growable queue doubles its ring when full and halves it once a
+ * quarter full or less, never dropping below min_capacity, so enqueue and
+ * dequeue stay amortized O(1).
  */
 typedef struct queue_t
 {
     uint32_t        capacity;
     uint32_t        currentsz;
+    uint32_t        head;
+    uint32_t        tail;
+    uint32_t        min_capacity;
+    uint32_t        max_capacity;
+    bool            growable;
+    queue_mode_t    mode;
     FREE_F          customfree;
+    slab_t *        node_slab;
     queue_node_t ** arr;
+    void **         slots;
 } queue_t;
 
 /**
@@ -52,10 +96,40 @@ typedef struct queue_t
  */
 queue_t * queue_init(uint32_t capacity, FREE_F customfree);
 
+/**
+ * @brief creates a new queue that stores data pointers inline instead of
+ *        wrapping them in queue_node_t allocations
+ *
+ * @param capacity max number of items the queue will hold
+ * @param customfree pointer to user defined free function
+ * @note items must be retrieved with queue_dequeue_data() and
+ * queue_peek_data(); queue_dequeue() and queue_peek() fail on inline queues
+ * @returns the new queue on success, NULL on failure
+ */
+queue_t * queue_init_inline(uint32_t capacity, FREE_F customfree);
+
+/**
+ * @brief creates a new queue that grows to absorb bursts instead of rejecting
+ *        items, and shrinks back once they drain
+ *
+ * @param capacity initial number of items the queue will hold, the queue never
+ *        shrinks below this
+ * @param max_capacity high-water mark the queue will not grow past, 0 to grow
+ *        without limit
+ * @param mode the storage mode of the new queue
+ * @param customfree pointer to user defined free function
+ * @returns the new queue on success, NULL on failure
+ */
+queue_t * queue_init_growable(uint32_t     capacity,
+                              uint32_t     max_capacity,
+                              queue_mode_t mode,
+                              FREE_F       customfree);
+
 /**
  * @brief verifies that queue isn't full
  *
  * @param queue pointer queue object
+ * @note a growable queue is only full once it holds max_capacity items
  * @return 0 on success, non-zero value on failure
  */
 int queue_fullcheck(queue_t * queue);
@@ -77,6 +151,18 @@ int queue_emptycheck(queue_t * queue);
  */
 int queue_enqueue(queue_t * queue, void * data);
 
+/**
+ * @brief pushes several items into the queue in one call
+ *
+ * @param queue pointer to queue pointer to push the items into
+ * @param data array of data pointers to push, none of which may be NULL
+ * @param count number of entries in data
+ * @note all or nothing: if the items do not all fit, none are pushed. A
+ * growable queue resizes at most once to make room for the whole batch.
+ * @return the 0 on success, non-zero value on failure
+ */
+int queue_enqueue_many(queue_t * queue, void ** data, uint32_t count);
+
 /**
  * @brief pops the front node out of the queue
  *
@@ -93,6 +179,35 @@ queue_node_t * queue_dequeue(queue_t * queue);
  */
 queue_node_t * queue_peek(queue_t * queue);
 
+/**
+ * @brief pops the front item out of the queue and returns its data directly
+ *
+ * @param queue pointer to queue pointer to pop the item off of
+ * @note works in both modes; in QUEUE_MODE_NODE the wrapping node is freed
+ * @return the data pointer on success or NULL for failure
+ */
+void * queue_dequeue_data(queue_t * queue);
+
+/**
+ * @brief pops up to max items off the front of the queue in one call
+ *
+ * @param queue pointer to queue pointer to pop the items off of
+ * @param data array receiving the data pointers in FIFO order
+ * @param max capacity of data
+ * @note works in both modes; in QUEUE_MODE_NODE the wrapping nodes are freed
+ * @return the number of items popped, 0 if the queue is empty or on error
+ */
+uint32_t queue_dequeue_many(queue_t * queue, void ** data, uint32_t max);
+
+/**
+ * @brief get the data at the front of the queue without popping
+ *
+ * @param queue pointer to queue pointer to peek
+ * @note works in both modes
+ * @return the data pointer on success or NULL for failure
+ */
+void * queue_peek_data(queue_t * queue);
+
 /**
  * @brief clear all nodes out of a queue
  *
@@ -101,6 +216,28 @@ queue_node_t * queue_peek(queue_t * queue);
  */
 int queue_clear(queue_t * queue);
 
+/**
+ * @brief makes a node mode queue allocate its nodes from a slab instead of
+ *        malloc(), removing the per-item malloc() and free() from the hot path
+ *
+ * @param queue pointer to an empty QUEUE_MODE_NODE queue
+ * @param node_slab the allocator to use, its objects must fit a
+ *        queue_node_t; NULL returns to malloc()
+ * @note the slab must outlive the queue, and nodes returned by
+ * queue_dequeue() must then be released with queue_node_free()
+ * @return the 0 on success, non-zero value on failure
+ */
+int queue_set_node_slab(queue_t * queue, slab_t * node_slab);
+
+/**
+ * @brief releases a node returned by queue_dequeue() to wherever the queue
+ *        allocated it from
+ *
+ * @param queue pointer to the queue the node was dequeued from
+ * @param node the node to release, NULL is ignored
+ */
+void queue_node_free(queue_t * queue, queue_node_t * node);
+
 /**
  * @brief delete a queue
  *
@@ -0,0 +1,81 @@
+/**
+ * @file slab.h
+ *
+ * @brief Fixed-size object allocator for small, short-lived objects.
+ *
+ * Objects are carved out of large blocks and recycled through free lists
+ * instead of going back to malloc(). Every thread keeps its own free list,
+ * so an allocation or free that hits the list takes no lock. A thread whose
+ * list runs dry takes a whole batch of objects from the shared depot, and a
+ * thread whose list grows past two batches hands one batch back, so objects
+ * freed on a different thread than they were allocated on still circulate
+ * one batch per lock acquisition. Every allocator shares a single
+ * thread-specific key, so a program can create any number of them without
+ * running into PTHREAD_KEYS_MAX.
+ */
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stddef.h>
+
+/**
+ * @brief the number of objects moved per depot transfer when 0 is passed
+ *        to slab_create()
+ */
+#define SLAB_DEFAULT_BATCH 32
+
+/**
+ * @brief opaque slab allocator type
+ */
+typedef struct slab slab_t;
+
+/**
+ * @brief creates a new slab allocator
+ *
+ * @param object_size the size of every object handed out, rounded up to
+ * keep objects aligned for any type
+ * @param batch_size the number of objects moved between a thread and the
+ * depot at a time, 0 for SLAB_DEFAULT_BATCH
+ * @return the new allocator on success, NULL on failure
+ */
+slab_t * slab_create(size_t object_size, size_t batch_size);
+
+/**
+ * @brief allocates one object; safe to call from any thread
+ *
+ * @param slab pointer to the allocator
+ * @note the object's contents are not initialized
+ * @return the object on success, NULL on failure
+ */
+void * slab_alloc(slab_t * slab);
+
+/**
+ * @brief returns an object to the allocator; safe to call from any thread,
+ *        not only the one that allocated it
+ *
+ * @param slab pointer to the allocator the object came from
+ * @param object the object to release, NULL is ignored
+ */
+void slab_free(slab_t * slab, void * object);
+
+/**
+ * @brief returns the object size the allocator hands out
+ *
+ * @param slab pointer to the allocator
+ * @return the rounded object size, 0 on error
+ */
+size_t slab_object_size(const slab_t * slab);
+
+/**
+ * @brief destroys an allocator and releases all of its memory, including
+ *        objects that were never freed
+ *
+ * @param slab_addr pointer to address of allocator to be destroyed
+ * @note no other thread may be using the allocator
+ * @return 0 on success, non-zero value on failure
+ */
+int slab_destroy(slab_t ** slab_addr);
+
+#endif /* _SLAB_H */
+
+/*** end of file ***/
@@ -0,0 +1,107 @@
+/**
+ * @file spsc_ring.h
+ *
+ * @brief Wait-free single-producer/single-consumer ring buffer.
+ *
+ * Exactly one thread may push and exactly one (other) thread may pop. The
+ * producer and consumer indices live on separate cache lines and each side
+ * keeps a cached copy of the other side's index, so the shared indices are
+ * only re-read when the cached view says the ring is full or empty. Neither
+ * side performs an atomic read-modify-write. Capacity is rounded up to a
+ * power of two.
+ */
+#ifndef _SPSC_RING_H
+#define _SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Size used to keep the producer and consumer state on separate cache
+ *        lines
+ */
+#define SPSC_CACHE_LINE 64
+
+/**
+ * @brief opaque single-producer/single-consumer ring type
+ */
+typedef struct spsc_ring spsc_ring_t;
+
+/**
+ * @brief creates a new ring
+ *
+ * @param capacity minimum number of items the ring will hold, rounded up to
+ * the next power of two (at least 2, at most 2^31)
+ * @return the new ring on success, NULL on failure
+ */
+spsc_ring_t * spsc_ring_init(uint32_t capacity);
+
+/**
+ * @brief pushes one data pointer; producer thread only
+ *
+ * @param ring pointer to the ring to push into
+ * @param data the data pointer to store, must not be NULL
+ * @return 0 on success, non-zero value if the ring is full or on error
+ */
+int spsc_ring_push(spsc_ring_t * ring, void * data);
+
+/**
+ * @brief pops one data pointer; consumer thread only
+ *
+ * @param ring pointer to the ring to pop from
+ * @return the data pointer on success, NULL if the ring is empty or on error
+ */
+void * spsc_ring_pop(spsc_ring_t * ring);
+
+/**
+ * @brief pushes up to 'count' data pointers with a single publish of the
+ *        producer index; producer thread only
+ *
+ * @param ring pointer to the ring to push into
+ * @param data array of data pointers to store, none of which may be NULL
+ * @param count number of entries in 'data'
+ * @return the number of pointers pushed, which is less than 'count' when the
+ * ring fills up
+ */
+size_t spsc_ring_push_batch(spsc_ring_t * ring, void ** data, size_t count);
+
+/**
+ * @brief pops up to 'max' data pointers with a single publish of the
+ *        consumer index; consumer thread only
+ *
+ * @param ring pointer to the ring to pop from
+ * @param data array receiving the popped data pointers in FIFO order
+ * @param max capacity of 'data'
+ * @return the number of pointers popped
+ */
+size_t spsc_ring_pop_batch(spsc_ring_t * ring, void ** data, size_t max);
+
+/**
+ * @brief returns the number of items the ring can hold
+ *
+ * @param ring pointer to the ring
+ * @return the capacity, 0 on error
+ */
+uint32_t spsc_ring_capacity(const spsc_ring_t * ring);
+
+/**
+ * @brief returns the number of items currently stored
+ *
+ * @param ring pointer to the ring
+ * @note only exact when called from the producer or consumer thread while
+ * the other side is idle
+ * @return the number of items stored, 0 on error
+ */
+size_t spsc_ring_size(spsc_ring_t * ring);
+
+/**
+ * @brief destroys a ring; stored data pointers are not freed
+ *
+ * @param ring_addr pointer to address of ring to be destroyed
+ * @return 0 on success, non-zero value on failure
+ */
+int spsc_ring_destroy(spsc_ring_t ** ring_addr);
+
+#endif /* _SPSC_RING_H */
+
+/*** end of file ***/
@@ -0,0 +1,153 @@
+/**
+ * @file timer_wheel.h
+ *
+ * @brief Hierarchical timing wheel holding timers that expire on a tick.
+ *
+ * Time is counted in ticks of whatever length the caller chooses. Level 0
+ * has a slot for each of the next 64 ticks, and every level above has slots
+ * 64 times as wide, so six levels span 2^36 ticks. A timer goes into the
+ * slot of the highest level its expiry differs from the current tick on,
+ * which makes adding and cancelling a timer O(1) no matter how many are
+ * pending. When the wheel reaches a slot above level 0 its timers cascade
+ * down a level, each timer moving at most once per level. A bitmap of the
+ * occupied slots per level lets timer_wheel_advance() jump straight over
+ * empty stretches of time.
+ *
+ * Every timer gets a handle that stays valid until the timer expires for
+ * good or is cancelled, and is never mistaken for a later timer.
+ */
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A pointer to a user-defined free function used to release the data
+ *        of pending timers on timer_wheel_destroy()
+ */
+typedef void (*FREE_F)(void *);
+
+/**
+ * @brief handle to a pending timer
+ */
+typedef uint64_t timer_handle_t;
+
+/**
+ * @brief value of a handle that refers to no timer
+ */
+#define TIMER_INVALID_HANDLE UINT64_MAX
+
+/**
+ * @brief returned by an expiry callback to release its timer
+ */
+#define TIMER_WHEEL_NEVER UINT64_MAX
+
+/**
+ * @brief called for every timer that expires, returns the tick the timer
+ *        expires on next, or TIMER_WHEEL_NEVER to release it
+ *
+ * @param data the data pointer of the timer
+ * @param tick the tick the timer expired on
+ * @param ctx the context passed to timer_wheel_advance()
+ */
+typedef uint64_t (*TIMER_F)(void * data, uint64_t tick, void * ctx);
+
+/**
+ * @brief opaque timing wheel type
+ */
+typedef struct timer_wheel timer_wheel_t;
+
+/**
+ * @brief creates a new timing wheel, starting at tick 0
+ *
+ * @param capacity the number of timers to allocate room for up front; the
+ * wheel grows as needed
+ * @param customfree function used to free the data of pending timers, may
+ * be NULL
+ * @return the new wheel on success, NULL on failure
+ */
+timer_wheel_t * timer_wheel_create(uint32_t capacity, FREE_F customfree);
+
+/**
+ * @brief adds a timer
+ *
+ * @param wheel pointer to the wheel
+ * @param expiry the tick the timer expires on, a tick the wheel has moved
+ * past is taken as the first tick it has not
+ * @param data the data pointer passed to the expiry callback, may be NULL
+ * @param handle_p if not NULL, receives the handle of the timer
+ * @return 0 on success, non-zero value on failure
+ */
+int timer_wheel_add(timer_wheel_t *  wheel,
+                    uint64_t         expiry,
+                    void *           data,
+                    timer_handle_t * handle_p);
+
+/**
+ * @brief removes a pending timer without expiring it
+ *
+ * @param wheel pointer to the wheel
+ * @param handle the handle of the timer
+ * @param data_p if not NULL, receives the data pointer of the timer
+ * @note a timer can not be cancelled from its own expiry callback, the
+ * callback returns TIMER_WHEEL_NEVER instead
+ * @return 0 on success, non-zero value if the timer is not pending
+ */
+int timer_wheel_cancel(timer_wheel_t * wheel,
+                       timer_handle_t  handle,
+                       void **         data_p);
+
+/**
+ * @brief moves the wheel up to the tick 'now', calling expire_f for every
+ *        timer that expires on or before it, in order of expiry
+ *
+ * @param wheel pointer to the wheel
+ * @param now the tick to move to, ticks before the current one are ignored
+ * @param expire_f the expiry callback, may add and cancel other timers
+ * @param ctx passed to every call of expire_f
+ * @return the number of timers that expired
+ */
+size_t timer_wheel_advance(timer_wheel_t * wheel,
+                           uint64_t        now,
+                           TIMER_F         expire_f,
+                           void *          ctx);
+
+/**
+ * @brief finds the next tick timer_wheel_advance() has work to do on
+ *
+ * @param wheel pointer to the wheel
+ * @param tick_p receives the tick, which is no later than the earliest
+ * expiry but may be earlier when timers have to cascade first
+ * @return 0 on success, non-zero value if no timer is pending
+ */
+int timer_wheel_next_tick(const timer_wheel_t * wheel, uint64_t * tick_p);
+
+/**
+ * @brief returns the first tick the wheel has not moved past yet
+ *
+ * @param wheel pointer to the wheel
+ * @return the tick, 0 on error
+ */
+uint64_t timer_wheel_now(const timer_wheel_t * wheel);
+
+/**
+ * @brief returns the number of pending timers
+ *
+ * @param wheel pointer to the wheel
+ * @return the number of timers, 0 on error
+ */
+uint32_t timer_wheel_size(const timer_wheel_t * wheel);
+
+/**
+ * @brief destroys a wheel, freeing the data of pending timers with
+ *        customfree
+ *
+ * @param wheel_addr pointer to address of wheel to be destroyed
+ * @return 0 on success, non-zero value on failure
+ */
+int timer_wheel_destroy(timer_wheel_t ** wheel_addr);
+
+#endif /* _TIMER_WHEEL_H */
+
+/*** end of file ***/
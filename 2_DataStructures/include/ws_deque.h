@@ -0,0 +1,87 @@
+/**
+ * @file ws_deque.h
+ *
+ * @brief Lock-free Chase-Lev work-stealing deque.
+ *
+ * One owner thread pushes and pops at the bottom of the deque in LIFO order
+ * while any number of thief threads steal from the top in FIFO order. The
+ * owner only contends with thieves when a single item is left, so the common
+ * push and pop are a handful of plain loads and stores. The circular array
+ * doubles when full; arrays that were replaced stay allocated until the
+ * deque is destroyed because a slow thief may still be reading one.
+ */
+#ifndef _WS_DEQUE_H
+#define _WS_DEQUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Size used to keep the owner and thief indices on separate cache
+ *        lines
+ */
+#define WS_DEQUE_CACHE_LINE 64
+
+/**
+ * @brief opaque work-stealing deque type
+ */
+typedef struct ws_deque ws_deque_t;
+
+/**
+ * @brief creates a new deque
+ *
+ * @param capacity the initial number of items the deque will hold, rounded
+ * up to the next power of two (at least 2); the deque grows as needed
+ * @return the new deque on success, NULL on failure
+ */
+ws_deque_t * ws_deque_init(uint32_t capacity);
+
+/**
+ * @brief pushes a data pointer onto the bottom; owner thread only
+ *
+ * @param deque pointer to the deque to push onto
+ * @param data the data pointer to store, must not be NULL
+ * @return 0 on success, non-zero value on failure
+ */
+int ws_deque_push(ws_deque_t * deque, void * data);
+
+/**
+ * @brief pops the most recently pushed data pointer; owner thread only
+ *
+ * @param deque pointer to the deque to pop from
+ * @return the data pointer on success, NULL if the deque is empty, the last
+ * item was stolen concurrently, or on error
+ */
+void * ws_deque_pop(ws_deque_t * deque);
+
+/**
+ * @brief steals the oldest data pointer; safe to call from any thread
+ *
+ * @param deque pointer to the deque to steal from
+ * @note NULL is also returned when another thread took the item first, so a
+ * NULL result means "try elsewhere" rather than "the deque is empty"
+ * @return the data pointer on success, NULL otherwise
+ */
+void * ws_deque_steal(ws_deque_t * deque);
+
+/**
+ * @brief returns the number of items currently stored
+ *
+ * @param deque pointer to the deque
+ * @note only a snapshot while other threads are pushing or stealing
+ * @return the number of items stored, 0 on error
+ */
+size_t ws_deque_size(ws_deque_t * deque);
+
+/**
+ * @brief destroys a deque; stored data pointers are not freed
+ *
+ * @param deque_addr pointer to address of deque to be destroyed
+ * @note no other thread may be using the deque
+ * @return 0 on success, non-zero value on failure
+ */
+int ws_deque_destroy(ws_deque_t ** deque_addr);
+
+#endif /* _WS_DEQUE_H */
+
+/*** end of file ***/
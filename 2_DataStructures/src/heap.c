@@ -0,0 +1,554 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "heap.h"
+#include "utilities.h"
+
+#define HEAP_MIN_CAPACITY  16
+#define HEAP_GROWTH_FACTOR 2
+
+/**
+ * @brief a slot of the heap array
+ *
+ * @param data the stored data pointer
+ * @param handle the handle of the item, so moves can update its position
+ */
+typedef struct heap_entry
+{
+    void *        data;
+    heap_handle_t handle;
+} heap_entry_t;
+
+/**
+ * @brief structure of a d-ary heap
+ *
+ * @param arity the number of children per node
+ * @param size the number of items stored
+ * @param capacity the number of slots allocated in entries and positions
+ * @param issued the number of handles handed out so far, reused handles
+ *        come from free_handle first
+ * @param free_handle head of the list of released handles, chained through
+ *        positions
+ * @param compare the comparator ordering the items
+ * @param customfree function used to free stored data, may be NULL
+ * @param entries the implicit tree, root at index 0
+ * @param positions maps a handle to its index in entries
+ */
+struct heap
+{
+    uint32_t       arity;
+    uint32_t       size;
+    uint32_t       capacity;
+    uint32_t       issued;
+    heap_handle_t  free_handle;
+    CMP_F          compare;
+    FREE_F         customfree;
+    heap_entry_t * entries;
+    uint32_t *     positions;
+};
+
+/**
+ * @brief states if 'one' belongs above 'two'
+ *
+ * @param heap pointer to the heap
+ * @param one the first data pointer
+ * @param two the second data pointer
+ * @return true if the comparator reports 'one' as smaller
+ */
+static bool heap_before(const heap_t * heap, void * one, void * two);
+
+/**
+ * @brief grows the arrays until at least 'needed' items fit
+ *
+ * @param heap pointer to the heap
+ * @param needed the number of items that must fit
+ * @return 0 on success, non-zero value on failure
+ */
+static int heap_reserve(heap_t * heap, uint64_t needed);
+
+/**
+ * @brief takes a handle from the free list, or issues a new one
+ *
+ * @param heap pointer to the heap
+ * @return the handle
+ */
+static heap_handle_t heap_take_handle(heap_t * heap);
+
+/**
+ * @brief states if a handle refers to an item currently stored
+ *
+ * @param heap pointer to the heap
+ * @param handle the handle to check
+ * @return true if the handle is live
+ */
+static bool heap_handle_valid(const heap_t * heap, heap_handle_t handle);
+
+/**
+ * @brief moves the entry at 'index' towards the root until its parent
+ *        belongs above it
+ *
+ * @param heap pointer to the heap
+ * @param index the index of the entry to move
+ */
+static void heap_sift_up(heap_t * heap, uint32_t index);
+
+/**
+ * @brief moves the entry at 'index' towards the leaves until every child
+ *        belongs below it
+ *
+ * @param heap pointer to the heap
+ * @param index the index of the entry to move
+ */
+static void heap_sift_down(heap_t * heap, uint32_t index);
+
+heap_t * heap_init(uint32_t arity,
+                   uint32_t capacity,
+                   CMP_F    compare,
+                   FREE_F   customfree)
+{
+    heap_t * heap = NULL;
+
+    if (0 == arity)
+    {
+        arity = HEAP_DEFAULT_ARITY;
+    }
+
+    if ((NULL == compare) || (2 > arity))
+    {
+        print_error("Invalid argument passed.");
+        goto END;
+    }
+
+    heap = calloc(1, sizeof(heap_t));
+    if (NULL == heap)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    heap->arity       = arity;
+    heap->compare     = compare;
+    heap->customfree  = customfree;
+    heap->free_handle = HEAP_INVALID_HANDLE;
+
+    if (HEAP_MIN_CAPACITY > capacity)
+    {
+        capacity = HEAP_MIN_CAPACITY;
+    }
+
+    if (E_SUCCESS != heap_reserve(heap, capacity))
+    {
+        free(heap);
+        heap = NULL;
+        goto END;
+    }
+
+END:
+    return heap;
+}
+
+int heap_push(heap_t * heap, void * data, heap_handle_t * handle_p)
+{
+    int           exit_code = E_FAILURE;
+    heap_handle_t handle    = HEAP_INVALID_HANDLE;
+
+    if ((NULL == heap) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    if (E_SUCCESS != heap_reserve(heap, (uint64_t)heap->size + 1))
+    {
+        goto END;
+    }
+
+    handle                    = heap_take_handle(heap);
+    heap->entries[heap->size] = (heap_entry_t){ data, handle };
+    heap->positions[handle]   = heap->size;
+    heap->size++;
+    heap_sift_up(heap, heap->size - 1);
+
+    if (NULL != handle_p)
+    {
+        *handle_p = handle;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+void * heap_pop(heap_t * heap)
+{
+    void *        data   = NULL;
+    heap_handle_t handle = HEAP_INVALID_HANDLE;
+
+    if (NULL == heap)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    if (0 == heap->size)
+    {
+        goto END;
+    }
+
+    data   = heap->entries[0].data;
+    handle = heap->entries[0].handle;
+
+    // Release the handle; the free list is chained through positions
+    heap->positions[handle] = heap->free_handle;
+    heap->free_handle       = handle;
+
+    heap->size--;
+    if (0 != heap->size)
+    {
+        heap->entries[0]                         = heap->entries[heap->size];
+        heap->positions[heap->entries[0].handle] = 0;
+        heap_sift_down(heap, 0);
+    }
+
+END:
+    return data;
+}
+
+void * heap_peek(heap_t * heap)
+{
+    void * data = NULL;
+
+    if (NULL == heap)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    if (0 != heap->size)
+    {
+        data = heap->entries[0].data;
+    }
+
+END:
+    return data;
+}
+
+int heap_decrease_key(heap_t * heap, heap_handle_t handle, void * data)
+{
+    int      exit_code = E_FAILURE;
+    uint32_t index     = 0;
+
+    if ((NULL == heap) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    if (!heap_handle_valid(heap, handle))
+    {
+        print_error("Invalid handle.");
+        goto END;
+    }
+
+    index = heap->positions[handle];
+    if (heap_before(heap, heap->entries[index].data, data))
+    {
+        print_error("New key is larger than the current key.");
+        goto END;
+    }
+
+    heap->entries[index].data = data;
+    heap_sift_up(heap, index);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int heap_heapify(heap_t *        heap,
+                 void **         data,
+                 uint32_t        count,
+                 heap_handle_t * handles_p)
+{
+    int           exit_code = E_FAILURE;
+    heap_handle_t handle    = HEAP_INVALID_HANDLE;
+    uint32_t      index     = 0;
+
+    if ((NULL == heap) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        if (NULL == data[idx])
+        {
+            print_error("NULL argument passed.");
+            goto END;
+        }
+    }
+
+    if (E_SUCCESS != heap_reserve(heap, (uint64_t)heap->size + count))
+    {
+        goto END;
+    }
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        handle                  = heap_take_handle(heap);
+        index                   = heap->size + idx;
+        heap->entries[index]    = (heap_entry_t){ data[idx], handle };
+        heap->positions[handle] = index;
+
+        if (NULL != handles_p)
+        {
+            handles_p[idx] = handle;
+        }
+    }
+    heap->size += count;
+
+    // Floyd's construction: sift down every internal node, last one first
+    if (1 < heap->size)
+    {
+        index = ((heap->size - 2) / heap->arity) + 1;
+        while (0 < index)
+        {
+            index--;
+            heap_sift_down(heap, index);
+        }
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+uint32_t heap_size(const heap_t * heap)
+{
+    uint32_t size = 0;
+
+    if (NULL == heap)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    size = heap->size;
+
+END:
+    return size;
+}
+
+int heap_clear(heap_t * heap)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == heap)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    if (NULL != heap->customfree)
+    {
+        for (uint32_t idx = 0; idx < heap->size; idx++)
+        {
+            heap->customfree(heap->entries[idx].data);
+        }
+    }
+
+    heap->size        = 0;
+    heap->issued      = 0;
+    heap->free_handle = HEAP_INVALID_HANDLE;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int heap_destroy(heap_t ** heap_addr)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == heap_addr) || (NULL == *heap_addr))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    heap_clear(*heap_addr);
+    free((*heap_addr)->entries);
+    free((*heap_addr)->positions);
+    free(*heap_addr);
+    *heap_addr = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static bool heap_before(const heap_t * heap, void * one, void * two)
+{
+    return TWO == heap->compare(one, two);
+}
+
+static int heap_reserve(heap_t * heap, uint64_t needed)
+{
+    int            exit_code = E_FAILURE;
+    uint64_t       capacity  = heap->capacity;
+    heap_entry_t * entries   = NULL;
+    uint32_t *     positions = NULL;
+
+    if (needed <= capacity)
+    {
+        exit_code = E_SUCCESS;
+        goto END;
+    }
+
+    // HEAP_INVALID_HANDLE must never be issued as a real handle
+    if (HEAP_INVALID_HANDLE <= needed)
+    {
+        print_error("Heap is full.");
+        goto END;
+    }
+
+    capacity = (0 == capacity) ? needed : capacity;
+    while (capacity < needed)
+    {
+        capacity *= HEAP_GROWTH_FACTOR;
+    }
+
+    if (HEAP_INVALID_HANDLE < capacity)
+    {
+        capacity = HEAP_INVALID_HANDLE;
+    }
+
+    // Each array is replaced as soon as it is reallocated, so a failure on
+    // the second leaves the heap valid at its old capacity
+    entries = realloc(heap->entries, (size_t)capacity * sizeof(heap_entry_t));
+    if (NULL == entries)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+    heap->entries = entries;
+
+    positions = realloc(heap->positions, (size_t)capacity * sizeof(uint32_t));
+    if (NULL == positions)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+    heap->positions = positions;
+    heap->capacity  = (uint32_t)capacity;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static heap_handle_t heap_take_handle(heap_t * heap)
+{
+    heap_handle_t handle = heap->free_handle;
+
+    if (HEAP_INVALID_HANDLE != handle)
+    {
+        heap->free_handle = heap->positions[handle];
+        goto END;
+    }
+
+    // Live items never outnumber capacity, so neither do issued handles
+    handle = heap->issued;
+    heap->issued++;
+
+END:
+    return handle;
+}
+
+static bool heap_handle_valid(const heap_t * heap, heap_handle_t handle)
+{
+    uint32_t index = 0;
+
+    if (handle >= heap->issued)
+    {
+        return false;
+    }
+
+    // A released handle's slot holds a free list link instead of a position
+    index = heap->positions[handle];
+    return (index < heap->size) && (handle == heap->entries[index].handle);
+}
+
+static void heap_sift_up(heap_t * heap, uint32_t index)
+{
+    heap_entry_t moving = heap->entries[index];
+    uint32_t     parent = 0;
+
+    // Shift parents down into the hole and write the moving entry once
+    while (0 < index)
+    {
+        parent = (index - 1) / heap->arity;
+        if (!heap_before(heap, moving.data, heap->entries[parent].data))
+        {
+            break;
+        }
+
+        heap->entries[index]                         = heap->entries[parent];
+        heap->positions[heap->entries[index].handle] = index;
+        index                                        = parent;
+    }
+
+    heap->entries[index]           = moving;
+    heap->positions[moving.handle] = index;
+}
+
+static void heap_sift_down(heap_t * heap, uint32_t index)
+{
+    heap_entry_t moving = heap->entries[index];
+    uint64_t     first  = 0;
+    uint64_t     last   = 0;
+    uint32_t     best   = 0;
+
+    for (;;)
+    {
+        first = ((uint64_t)index * heap->arity) + 1;
+        if (first >= heap->size)
+        {
+            break;
+        }
+
+        last = first + heap->arity;
+        if (last > heap->size)
+        {
+            last = heap->size;
+        }
+
+        // The children of a node are adjacent, so this scan stays within a
+        // cache line or two
+        best = (uint32_t)first;
+        for (uint64_t child = first + 1; child < last; child++)
+        {
+            if (heap_before(heap,
+                            heap->entries[child].data,
+                            heap->entries[best].data))
+            {
+                best = (uint32_t)child;
+            }
+        }
+
+        if (!heap_before(heap, heap->entries[best].data, moving.data))
+        {
+            break;
+        }
+
+        heap->entries[index]                         = heap->entries[best];
+        heap->positions[heap->entries[index].handle] = index;
+        index                                        = best;
+    }
+
+    heap->entries[index]           = moving;
+    heap->positions[moving.handle] = index;
+}
+
+/*** end of file ***/
@@ -0,0 +1,259 @@
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpmc_queue.h"
+#include "utilities.h"
+
+#define MPMC_MIN_CAPACITY 2
+
+// The largest power of two mpmc_queue_capacity() can return
+#define MPMC_MAX_CAPACITY (UINT32_C(1) << 31)
+
+/**
+ * @brief structure of a queue slot
+ *
+ * @param sequence equals the slot's position when it is free for a producer
+ *        and position + 1 once it holds data for a consumer
+ * @param data the stored data pointer
+ */
+typedef struct mpmc_slot
+{
+    atomic_size_t sequence;
+    void *        data;
+} mpmc_slot_t;
+
+/**
+ * @brief structure of a lock-free queue
+ *
+ * @param enqueue_pos the next position a producer will claim
+ * @param dequeue_pos the next position a consumer will claim
+ * @param mask capacity - 1, used to map positions to slots
+ * @param slots the ring of slots
+ */
+struct mpmc_queue
+{
+    alignas(MPMC_CACHE_LINE) atomic_size_t enqueue_pos;
+    alignas(MPMC_CACHE_LINE) atomic_size_t dequeue_pos;
+    alignas(MPMC_CACHE_LINE) size_t mask;
+    mpmc_slot_t * slots;
+};
+
+mpmc_queue_t * mpmc_queue_init(uint32_t capacity)
+{
+    mpmc_queue_t * queue   = NULL;
+    size_t         rounded = MPMC_MIN_CAPACITY;
+
+    if ((0 == capacity) || (MPMC_MAX_CAPACITY < capacity))
+    {
+        print_error("Invalid capacity.");
+        goto END;
+    }
+
+    while (rounded < capacity)
+    {
+        rounded <<= 1U;
+    }
+
+    // sizeof() is a multiple of the alignment, as aligned_alloc() requires
+    queue = aligned_alloc(alignof(mpmc_queue_t), sizeof(mpmc_queue_t));
+    if (NULL == queue)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+    memset(queue, 0, sizeof(mpmc_queue_t));
+
+    queue->slots = calloc(rounded, sizeof(mpmc_slot_t));
+    if (NULL == queue->slots)
+    {
+        print_error("CMR failure.");
+        free(queue);
+        queue = NULL;
+        goto END;
+    }
+
+    queue->mask = rounded - 1;
+    for (size_t idx = 0; idx < rounded; idx++)
+    {
+        atomic_init(&queue->slots[idx].sequence, idx);
+    }
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+
+END:
+    return queue;
+}
+
+int mpmc_queue_enqueue(mpmc_queue_t * queue, void * data)
+{
+    int           exit_code = E_FAILURE;
+    mpmc_slot_t * slot      = NULL;
+    size_t        pos       = 0;
+    size_t        sequence  = 0;
+    intptr_t      diff      = 0;
+
+    if ((NULL == queue) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        slot     = &queue->slots[pos & queue->mask];
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        diff     = (intptr_t)sequence - (intptr_t)pos;
+
+        if (0 == diff)
+        {
+            // Slot is free for this lap, try to claim the position
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos,
+                                                      &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (0 > diff)
+        {
+            // A consumer has not yet freed the slot from the previous lap
+            goto END;
+        }
+        else
+        {
+            // Another producer claimed the position first
+            pos = atomic_load_explicit(&queue->enqueue_pos,
+                                       memory_order_relaxed);
+        }
+    }
+
+    slot->data = data;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+void * mpmc_queue_dequeue(mpmc_queue_t * queue)
+{
+    void *        data     = NULL;
+    mpmc_slot_t * slot     = NULL;
+    size_t        pos      = 0;
+    size_t        sequence = 0;
+    intptr_t      diff     = 0;
+
+    if (NULL == queue)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        slot     = &queue->slots[pos & queue->mask];
+        sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        diff     = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+        if (0 == diff)
+        {
+            // Slot holds data for this lap, try to claim the position
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos,
+                                                      &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (0 > diff)
+        {
+            // No producer has filled the slot yet, the queue is empty
+            goto END;
+        }
+        else
+        {
+            // Another consumer claimed the position first
+            pos = atomic_load_explicit(&queue->dequeue_pos,
+                                       memory_order_relaxed);
+        }
+    }
+
+    data = slot->data;
+    // Hand the slot back to producers for the next lap of the ring
+    atomic_store_explicit(
+        &slot->sequence, pos + queue->mask + 1, memory_order_release);
+
+END:
+    return data;
+}
+
+uint32_t mpmc_queue_capacity(const mpmc_queue_t * queue)
+{
+    uint32_t capacity = 0;
+
+    if (NULL == queue)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    capacity = (uint32_t)(queue->mask + 1);
+
+END:
+    return capacity;
+}
+
+size_t mpmc_queue_size(mpmc_queue_t * queue)
+{
+    size_t size    = 0;
+    size_t enqueue = 0;
+    size_t dequeue = 0;
+
+    if (NULL == queue)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    dequeue = atomic_load_explicit(&queue->dequeue_pos, memory_order_acquire);
+    enqueue = atomic_load_explicit(&queue->enqueue_pos, memory_order_acquire);
+
+    // A consumer may overtake the snapshot of enqueue_pos
+    if (enqueue > dequeue)
+    {
+        size = enqueue - dequeue;
+    }
+
+END:
+    return size;
+}
+
+int mpmc_queue_destroy(mpmc_queue_t ** queue_addr)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == queue_addr) || (NULL == *queue_addr))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    free((*queue_addr)->slots);
+    (*queue_addr)->slots = NULL;
+    free(*queue_addr);
+    *queue_addr = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+/*** end of file ***/
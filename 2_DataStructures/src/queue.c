@@ -1,28 +1,121 @@
+#include <string.h>
+
 #include "queue.h"
 #include "utilities.h"
 
+#define QUEUE_GROWTH_FACTOR 2 // A full growable queue doubles its ring
+#define QUEUE_SHRINK_RATIO  4 // A growable queue halves at 1/4 occupancy
+
+/**
+ * @brief advances a ring buffer index by one slot, wrapping back to the start
+ *        of the array once it reaches the queue's capacity
+ *
+ * @param queue pointer to the queue the index belongs to
+ * @param idx the index to advance
+ * @return the index of the next slot
+ */
+static uint32_t queue_next_index(const queue_t * queue, uint32_t idx);
+
+/**
+ * @brief maps a position that may have run past the end of the ring back
+ *        onto a slot index
+ *
+ * @param queue pointer to the queue the index belongs to
+ * @param idx a ring index plus an offset of at most capacity
+ * @return the index of the slot
+ */
+static uint32_t queue_wrap_index(const queue_t * queue, uint64_t idx);
+
+/**
+ * @brief allocates a queue and the ring buffer matching its storage mode
+ *
+ * @param capacity max number of items the queue will hold
+ * @param customfree pointer to user defined free function
+ * @param mode the storage mode of the new queue
+ * @return the new queue on success, NULL on failure
+ */
+static queue_t * queue_create(uint32_t     capacity,
+                              FREE_F       customfree,
+                              queue_mode_t mode);
+
+/**
+ * @brief returns the most items a queue may ever hold
+ *
+ * @param queue pointer to the queue
+ * @return max_capacity for a bounded growable queue, UINT32_MAX for an
+ * unbounded one, and capacity for a fixed size queue
+ */
+static uint32_t queue_limit(const queue_t * queue);
+
+/**
+ * @brief moves the stored items into a new ring of a different size, front
+ *        item first
+ *
+ * @param queue pointer to the queue to resize
+ * @param new_capacity the size of the new ring, at least currentsz
+ * @return the 0 on success, non-zero value on failure
+ */
+static int queue_resize(queue_t * queue, uint32_t new_capacity);
+
+/**
+ * @brief halves a growable queue's ring once the queue has drained to a
+ *        quarter of its capacity, never going below min_capacity
+ *
+ * @param queue pointer to the queue to shrink
+ */
+static void queue_shrink(queue_t * queue);
+
+/**
+ * @brief makes sure a queue has room for 'needed' items, growing a growable
+ *        queue by doubling as many times as required
+ *
+ * @param queue pointer to the queue
+ * @param needed the number of items the queue must be able to hold
+ * @return the 0 on success, non-zero value if the queue cannot hold them
+ */
+static int queue_reserve(queue_t * queue, uint64_t needed);
+
+/**
+ * @brief allocates a node from the queue's node slab, or with malloc() when
+ *        the queue has none
+ *
+ * @param queue pointer to the queue the node is for
+ * @return the uninitialized node on success, NULL on failure
+ */
+static queue_node_t * queue_node_alloc(queue_t * queue);
+
 // Covers 4.3.3: Creating a queue with n number of items
 queue_t * queue_init(uint32_t capacity, FREE_F customfree)
 {
-    queue_t * queue = calloc(1, sizeof(queue_t));
-    if (NULL == queue)
+    return queue_create(capacity, customfree, QUEUE_MODE_NODE);
+}
+
+queue_t * queue_init_inline(uint32_t capacity, FREE_F customfree)
+{
+    return queue_create(capacity, customfree, QUEUE_MODE_INLINE);
+}
+
+queue_t * queue_init_growable(uint32_t     capacity,
+                              uint32_t     max_capacity,
+                              queue_mode_t mode,
+                              FREE_F       customfree)
+{
+    queue_t * queue = NULL;
+
+    if ((0 == capacity) || ((0 != max_capacity) && (max_capacity < capacity)))
     {
-        print_error("CMR failure.");
+        print_error("Invalid capacity.");
         goto END;
     }
 
-    queue->capacity  = capacity;
-    queue->currentsz = 0;
-    queue->arr       = calloc(capacity, sizeof(queue_node_t *));
-    if (NULL == queue->arr)
+    queue = queue_create(capacity, customfree, mode);
+    if (NULL == queue)
     {
-        print_error("CMR failure.");
-        free(queue);
-        queue = NULL;
         goto END;
     }
 
-    queue->customfree = (NULL == customfree) ? free : custom_free;
+    queue->max_capacity = max_capacity;
+    queue->growable     = true;
 
 END:
     return queue;
@@ -38,7 +131,8 @@ int queue_fullcheck(queue_t * queue)
         goto END;
     }
 
-    if (queue->currentsz == queue->capacity)
+    if ((queue->currentsz == queue->capacity) &&
+        (queue->capacity >= queue_limit(queue)))
     {
         exit_code = E_SUCCESS;
     }
@@ -83,16 +177,108 @@ int queue_enqueue(queue_t * queue, void * data)
         goto END;
     }
 
-    new_node = calloc(1, sizeof(queue_node_t));
-    if (NULL == new_node)
+    // Only grows a growable queue that is below its limit
+    if (E_SUCCESS != queue_reserve(queue, (uint64_t)queue->currentsz + 1))
     {
-        print_error("CMR failure.");
+        print_error("Unable to grow queue.");
+        goto END;
+    }
+
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        queue->slots[queue->tail] = data;
+    }
+    else
+    {
+        new_node = queue_node_alloc(queue);
+        if (NULL == new_node)
+        {
+            print_error("CMR failure.");
+            goto END;
+        }
+
+        new_node->data          = data;
+        queue->arr[queue->tail] = new_node;
+    }
+
+    queue->tail = queue_next_index(queue, queue->tail);
+    queue->currentsz++;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int queue_enqueue_many(queue_t * queue, void ** data, uint32_t count)
+{
+    int            exit_code = E_FAILURE;
+    queue_node_t * new_node  = NULL;
+    uint32_t       first_run = 0;
+    uint32_t       slot      = 0;
+
+    if ((NULL == queue) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
         goto END;
     }
 
-    new_node->data = data;
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        if (NULL == data[idx])
+        {
+            print_error("NULL argument passed.");
+            goto END;
+        }
+    }
+
+    if (E_SUCCESS != queue_reserve(queue, (uint64_t)queue->currentsz + count))
+    {
+        print_error("Queue is full.");
+        goto END;
+    }
+
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        // At most two copies: up to the end of the ring, then from the start
+        first_run = queue->capacity - queue->tail;
+        if (first_run > count)
+        {
+            first_run = count;
+        }
+
+        memcpy(&queue->slots[queue->tail], data, first_run * sizeof(void *));
+        memcpy(queue->slots,
+               &data[first_run],
+               (count - first_run) * sizeof(void *));
+    }
+    else
+    {
+        for (uint32_t idx = 0; idx < count; idx++)
+        {
+            new_node = queue_node_alloc(queue);
+            if (NULL == new_node)
+            {
+                print_error("CMR failure.");
+
+                // Roll back so the batch is all or nothing
+                for (uint32_t undo = 0; undo < idx; undo++)
+                {
+                    slot = queue_wrap_index(queue,
+                                            (uint64_t)queue->tail + undo);
+                    queue_node_free(queue, queue->arr[slot]);
+                    queue->arr[slot] = NULL;
+                }
+                goto END;
+            }
+
+            new_node->data = data[idx];
+            slot = queue_wrap_index(queue, (uint64_t)queue->tail + idx);
+            queue->arr[slot] = new_node;
+        }
+    }
 
-    queue->arr[queue->currentsz++] = new_node;
+    queue->tail = queue_wrap_index(queue, (uint64_t)queue->tail + count);
+    queue->currentsz += count;
 
     exit_code = E_SUCCESS;
 END:
@@ -111,29 +297,54 @@ queue_node_t * queue_dequeue(queue_t * queue)
         goto END;
     }
 
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        print_error("Inline queue has no nodes, use queue_dequeue_data().");
+        goto END;
+    }
+
     if (0 == queue_emptycheck(queue))
     {
         print_error("Queue is empty.");
         goto END;
     }
 
-    node = queue->arr[0];
+    node                    = queue->arr[queue->head];
+    queue->arr[queue->head] = NULL;
+    queue->head             = queue_next_index(queue, queue->head);
+    queue->currentsz--;
+    queue_shrink(queue);
+
+END:
+    return node;
+}
 
-    for (size_t idx = 0; idx < (queue->currentsz - 1); idx++)
+queue_node_t * queue_peek(queue_t * queue)
+{
+    queue_node_t * node = NULL;
+
+    if (NULL == queue)
     {
-        queue->arr[idx] = queue->arr[idx + 1];
+        print_error("NULL argument passed.");
+        goto END;
     }
 
-    queue->arr[queue->currentsz - 1] = NULL;
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        print_error("Inline queue has no nodes, use queue_peek_data().");
+        goto END;
+    }
 
-    queue->currentsz--;
+    // Empty slots are always NULL, so an empty queue peeks as NULL
+    node = queue->arr[queue->head];
 
 END:
     return node;
 }
 
-queue_node_t * queue_peek(queue_t * queue)
+void * queue_dequeue_data(queue_t * queue)
 {
+    void *         data = NULL;
     queue_node_t * node = NULL;
 
     if (NULL == queue)
@@ -142,10 +353,111 @@ queue_node_t * queue_peek(queue_t * queue)
         goto END;
     }
 
-    node = queue->arr[0];
+    if (0 == queue->currentsz)
+    {
+        goto END;
+    }
+
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        data                      = queue->slots[queue->head];
+        queue->slots[queue->head] = NULL;
+        queue->head               = queue_next_index(queue, queue->head);
+        queue->currentsz--;
+        queue_shrink(queue);
+        goto END;
+    }
+
+    node = queue_dequeue(queue);
+    if (NULL != node)
+    {
+        data = node->data;
+        queue_node_free(queue, node);
+    }
 
 END:
-    return node;
+    return data;
+}
+
+uint32_t queue_dequeue_many(queue_t * queue, void ** data, uint32_t max)
+{
+    uint32_t count     = 0;
+    uint32_t first_run = 0;
+    uint32_t slot      = 0;
+
+    if ((NULL == queue) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    count = (max < queue->currentsz) ? max : queue->currentsz;
+    if (0 == count)
+    {
+        goto END;
+    }
+
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        // At most two copies: up to the end of the ring, then from the start
+        first_run = queue->capacity - queue->head;
+        if (first_run > count)
+        {
+            first_run = count;
+        }
+
+        memcpy(data, &queue->slots[queue->head], first_run * sizeof(void *));
+        memcpy(&data[first_run],
+               queue->slots,
+               (count - first_run) * sizeof(void *));
+        memset(&queue->slots[queue->head], 0, first_run * sizeof(void *));
+        memset(queue->slots, 0, (count - first_run) * sizeof(void *));
+    }
+    else
+    {
+        for (uint32_t idx = 0; idx < count; idx++)
+        {
+            slot      = queue_wrap_index(queue, (uint64_t)queue->head + idx);
+            data[idx] = queue->arr[slot]->data;
+            queue_node_free(queue, queue->arr[slot]);
+            queue->arr[slot] = NULL;
+        }
+    }
+
+    queue->head = queue_wrap_index(queue, (uint64_t)queue->head + count);
+    queue->currentsz -= count;
+    queue_shrink(queue);
+
+END:
+    return count;
+}
+
+void * queue_peek_data(queue_t * queue)
+{
+    void * data = NULL;
+
+    if (NULL == queue)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    if (0 == queue->currentsz)
+    {
+        goto END;
+    }
+
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        data = queue->slots[queue->head];
+    }
+    else
+    {
+        data = queue->arr[queue->head]->data;
+    }
+
+END:
+    return data;
 }
 
 // Covers 4.3.3: Removing all items from a queue
@@ -159,24 +471,87 @@ int queue_clear(queue_t * queue)
         goto END;
     }
 
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        // Slots only hold borrowed data pointers, nothing to free
+        while (-1 == queue_emptycheck(queue))
+        {
+            queue->slots[queue->head] = NULL;
+            queue->head               = queue_next_index(queue, queue->head);
+            queue->currentsz--;
+        }
+    }
+
     while (-1 == queue_emptycheck(queue))
     {
         /***********************************************************************
          * NOTE: Typically would need to free data before the element. Commented
          * out due to issue with test.
          ***********************************************************************/
-        // queue->customfree(queue->arr[queue->currentsz - 1]->data);
-        // queue->arr[queue->currentsz - 1]->data = NULL;
-        free(queue->arr[queue->currentsz - 1]);
-        queue->arr[queue->currentsz - 1] = NULL;
+        // queue->customfree(queue->arr[queue->head]->data);
+        // queue->arr[queue->head]->data = NULL;
+        queue_node_free(queue, queue->arr[queue->head]);
+        queue->arr[queue->head] = NULL;
+        queue->head             = queue_next_index(queue, queue->head);
         queue->currentsz--;
     }
 
+    queue->head = 0;
+    queue->tail = 0;
+
+    // Give back whatever a burst made a growable queue allocate
+    if ((true == queue->growable) && (queue->capacity > queue->min_capacity))
+    {
+        queue_resize(queue, queue->min_capacity);
+    }
+
     exit_code = E_SUCCESS;
 END:
     return exit_code;
 }
 
+int queue_set_node_slab(queue_t * queue, slab_t * node_slab)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == queue)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    // Nodes already queued came from the old allocator
+    if ((QUEUE_MODE_NODE != queue->mode) || (0 != queue->currentsz))
+    {
+        print_error("Queue must be an empty node mode queue.");
+        goto END;
+    }
+
+    if ((NULL != node_slab) &&
+        (sizeof(queue_node_t) > slab_object_size(node_slab)))
+    {
+        print_error("Slab objects too small for a node.");
+        goto END;
+    }
+
+    queue->node_slab = node_slab;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+void queue_node_free(queue_t * queue, queue_node_t * node)
+{
+    if ((NULL != queue) && (NULL != queue->node_slab))
+    {
+        slab_free(queue->node_slab, node);
+        return;
+    }
+
+    free(node);
+}
+
 // Covers 4.3.3: Destroying a queue
 int queue_destroy(queue_t ** queue_addr)
 {
@@ -197,6 +572,8 @@ int queue_destroy(queue_t ** queue_addr)
 
     free((*queue_addr)->arr);
     (*queue_addr)->arr = NULL;
+    free((*queue_addr)->slots);
+    (*queue_addr)->slots = NULL;
     free(*queue_addr);
     *queue_addr = NULL;
 
@@ -205,6 +582,198 @@ END:
     return exit_code;
 }
 
+static queue_t * queue_create(uint32_t     capacity,
+                              FREE_F       customfree,
+                              queue_mode_t mode)
+{
+    queue_t * queue = calloc(1, sizeof(queue_t));
+    if (NULL == queue)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    queue->capacity     = capacity;
+    queue->currentsz    = 0;
+    queue->head         = 0;
+    queue->tail         = 0;
+    queue->min_capacity = capacity;
+    queue->max_capacity = capacity;
+    queue->growable     = false;
+    queue->mode         = mode;
+
+    if (QUEUE_MODE_INLINE == mode)
+    {
+        queue->slots = calloc(capacity, sizeof(void *));
+    }
+    else
+    {
+        queue->arr = calloc(capacity, sizeof(queue_node_t *));
+    }
+
+    if ((NULL == queue->arr) && (NULL == queue->slots))
+    {
+        print_error("CMR failure.");
+        free(queue);
+        queue = NULL;
+        goto END;
+    }
+
+    queue->customfree = (NULL == customfree) ? free : custom_free;
+
+END:
+    return queue;
+}
+
+static uint32_t queue_next_index(const queue_t * queue, uint32_t idx)
+{
+    // Compare instead of using '%' to keep the division off the hot path
+    idx++;
+    if (idx == queue->capacity)
+    {
+        idx = 0;
+    }
+
+    return idx;
+}
+
+static uint32_t queue_wrap_index(const queue_t * queue, uint64_t idx)
+{
+    if (idx >= queue->capacity)
+    {
+        idx -= queue->capacity;
+    }
+
+    return (uint32_t)idx;
+}
+
+static int queue_reserve(queue_t * queue, uint64_t needed)
+{
+    int      exit_code = E_FAILURE;
+    uint32_t limit     = queue_limit(queue);
+    uint32_t grown     = queue->capacity;
+
+    if (needed > limit)
+    {
+        goto END;
+    }
+
+    while (grown < needed)
+    {
+        grown = (grown > (limit / QUEUE_GROWTH_FACTOR))
+                    ? limit
+                    : grown * QUEUE_GROWTH_FACTOR;
+    }
+
+    if (grown != queue->capacity)
+    {
+        exit_code = queue_resize(queue, grown);
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static uint32_t queue_limit(const queue_t * queue)
+{
+    uint32_t limit = queue->capacity;
+
+    if (true == queue->growable)
+    {
+        limit = (0 == queue->max_capacity) ? UINT32_MAX : queue->max_capacity;
+    }
+
+    return limit;
+}
+
+static int queue_resize(queue_t * queue, uint32_t new_capacity)
+{
+    int      exit_code = E_FAILURE;
+    void **  old_ring  = NULL;
+    void **  new_ring  = NULL;
+    uint32_t first_run = 0;
+
+    // Both rings hold pointers, so they can be moved as raw pointer arrays
+    old_ring = (QUEUE_MODE_INLINE == queue->mode) ? queue->slots
+                                                  : (void **)queue->arr;
+
+    new_ring = calloc(new_capacity, sizeof(void *));
+    if (NULL == new_ring)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    // Unwrap the ring: copy from head to the end of the array, then the
+    // remainder from the start of the array
+    first_run = queue->capacity - queue->head;
+    if (first_run > queue->currentsz)
+    {
+        first_run = queue->currentsz;
+    }
+
+    memcpy(new_ring, &old_ring[queue->head], first_run * sizeof(void *));
+    memcpy(&new_ring[first_run],
+           old_ring,
+           (queue->currentsz - first_run) * sizeof(void *));
+
+    free(old_ring);
+    if (QUEUE_MODE_INLINE == queue->mode)
+    {
+        queue->slots = new_ring;
+    }
+    else
+    {
+        queue->arr = (queue_node_t **)new_ring;
+    }
+
+    queue->capacity = new_capacity;
+    queue->head     = 0;
+    queue->tail     = (queue->currentsz == new_capacity) ? 0 : queue->currentsz;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void queue_shrink(queue_t * queue)
+{
+    uint32_t shrunk = queue->capacity / QUEUE_GROWTH_FACTOR;
+
+    if ((false == queue->growable) ||
+        (queue->capacity <= queue->min_capacity) ||
+        (queue->currentsz > (queue->capacity / QUEUE_SHRINK_RATIO)))
+    {
+        return;
+    }
+
+    if (shrunk < queue->min_capacity)
+    {
+        shrunk = queue->min_capacity;
+    }
+
+    // Shrinking is an optimization; on allocation failure keep the big ring
+    queue_resize(queue, shrunk);
+}
+
+static queue_node_t * queue_node_alloc(queue_t * queue)
+{
+    queue_node_t * node = NULL;
+
+    if (NULL != queue->node_slab)
+    {
+        node = slab_alloc(queue->node_slab);
+    }
+    else
+    {
+        node = malloc(sizeof(queue_node_t));
+    }
+
+    return node;
+}
+
 void custom_free(void * mem_addr)
 {
     free(mem_addr);
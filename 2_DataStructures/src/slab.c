@@ -0,0 +1,569 @@
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "slab.h"
+#include "utilities.h"
+
+// A free object stores the next free object in its first word and, when it
+// heads a batch in the depot, the next batch in its second word
+#define SLAB_MIN_OBJECT_SIZE (2 * sizeof(void *))
+#define SLAB_ALIGNMENT       alignof(max_align_t)
+
+/**
+ * @brief the header of a block of objects
+ *
+ * @param next the block allocated before this one
+ */
+typedef struct slab_block
+{
+    alignas(SLAB_ALIGNMENT) struct slab_block * next;
+} slab_block_t;
+
+/**
+ * @brief a thread's private free list for one allocator
+ *
+ * @param slab the allocator the cache belongs to
+ * @param id the id of the allocator, which tells it apart from a later one
+ *        created at the same address
+ * @param dead set by slab_destroy(), the thread then frees the cache
+ * @param free_list the thread's free objects
+ * @param count the number of objects in free_list
+ * @param prev the previous cache registered with the allocator
+ * @param next the next cache registered with the allocator
+ * @param thread_next the thread's cache for another allocator
+ */
+typedef struct slab_cache
+{
+    struct slab *       slab;
+    uint64_t            id;
+    bool                dead;
+    void *              free_list;
+    size_t              count;
+    struct slab_cache * prev;
+    struct slab_cache * next;
+    struct slab_cache * thread_next;
+} slab_cache_t;
+
+/**
+ * @brief structure of a slab allocator
+ *
+ * @param object_size the rounded size of every object
+ * @param batch_size the number of objects per depot transfer
+ * @param id the allocator's id, unique for the life of the process
+ * @param mutex guards every field below it
+ * @param full_batches batches of exactly batch_size objects, chained through
+ *        the second word of their first object
+ * @param loose free objects returned by exiting threads
+ * @param loose_count the number of objects in loose
+ * @param blocks every block allocated, released on destroy
+ * @param caches every live thread cache, released on destroy
+ */
+struct slab
+{
+    size_t          object_size;
+    size_t          batch_size;
+    uint64_t        id;
+    pthread_mutex_t mutex;
+    void *          full_batches;
+    void *          loose;
+    size_t          loose_count;
+    slab_block_t *  blocks;
+    slab_cache_t *  caches;
+};
+
+// Every allocator shares one thread-specific key holding the thread's list
+// of caches, so the number of allocators is not bound by PTHREAD_KEYS_MAX
+static pthread_once_t slab_key_once   = PTHREAD_ONCE_INIT;
+static pthread_key_t  slab_key;
+static int            slab_key_status = E_FAILURE;
+
+// Orders thread exits against slab_destroy(), guards every cache's dead
+// flag and hands out the allocator ids
+static pthread_mutex_t slab_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t        slab_next_id        = 0;
+
+/**
+ * @brief creates the key shared by every allocator, run once
+ */
+static void slab_create_key(void);
+
+/**
+ * @brief reads the link stored in word 'index' of a free object
+ *
+ * @param object the free object
+ * @param index 0 for the next object, 1 for the next batch
+ * @return the stored link
+ */
+static void * slab_link(void * object, size_t index);
+
+/**
+ * @brief stores a link in word 'index' of a free object
+ *
+ * @param object the free object
+ * @param index 0 for the next object, 1 for the next batch
+ * @param link the link to store
+ */
+static void slab_set_link(void * object, size_t index, void * link);
+
+/**
+ * @brief returns the calling thread's cache, creating it on first use and
+ *        then freeing the thread's caches of destroyed allocators
+ *
+ * @param slab pointer to the allocator
+ * @return the cache on success, NULL on failure
+ */
+static slab_cache_t * slab_get_cache(slab_t * slab);
+
+/**
+ * @brief fills an empty cache with a batch from the depot, carving a new
+ *        block when the depot is empty
+ *
+ * @param slab pointer to the allocator
+ * @param cache the calling thread's cache
+ * @return 0 on success, non-zero value on failure
+ */
+static int slab_refill(slab_t * slab, slab_cache_t * cache);
+
+/**
+ * @brief hands one batch from a cache back to the depot
+ *
+ * @param slab pointer to the allocator
+ * @param cache the calling thread's cache
+ */
+static void slab_flush(slab_t * slab, slab_cache_t * cache);
+
+/**
+ * @brief frees the caches of destroyed allocators that follow 'head' in
+ *        the calling thread's list
+ *
+ * @param head the first cache of the list, which is never dead
+ */
+static void slab_prune_caches(slab_cache_t * head);
+
+/**
+ * @brief returns a cache's objects to the depot and unregisters it from its
+ *        allocator; the registry mutex must be held
+ *
+ * @param cache a cache of a live allocator
+ */
+static void slab_release_cache(slab_cache_t * cache);
+
+/**
+ * @brief pthread key destructor that returns an exiting thread's objects
+ *        to the depots and frees its caches
+ *
+ * @param head_p the first cache of the exiting thread's list
+ */
+static void slab_release_caches(void * head_p);
+
+slab_t * slab_create(size_t object_size, size_t batch_size)
+{
+    slab_t * slab = NULL;
+
+    if ((0 == object_size) ||
+        ((SIZE_MAX - SLAB_ALIGNMENT) < object_size))
+    {
+        print_error("Invalid object size.");
+        goto END;
+    }
+
+    pthread_once(&slab_key_once, slab_create_key);
+    if (E_SUCCESS != slab_key_status)
+    {
+        print_error("Unable to create thread key.");
+        goto END;
+    }
+
+    slab = calloc(1, sizeof(slab_t));
+    if (NULL == slab)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    if (SLAB_MIN_OBJECT_SIZE > object_size)
+    {
+        object_size = SLAB_MIN_OBJECT_SIZE;
+    }
+
+    slab->object_size = ((object_size + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT) *
+                        SLAB_ALIGNMENT;
+    slab->batch_size  = (0 == batch_size) ? SLAB_DEFAULT_BATCH : batch_size;
+
+    if (E_SUCCESS != pthread_mutex_init(&slab->mutex, NULL))
+    {
+        print_error("Unable to initialize mutex.");
+        free(slab);
+        slab = NULL;
+        goto END;
+    }
+
+    pthread_mutex_lock(&slab_registry_mutex);
+    slab->id = slab_next_id;
+    slab_next_id++;
+    pthread_mutex_unlock(&slab_registry_mutex);
+
+END:
+    return slab;
+}
+
+void * slab_alloc(slab_t * slab)
+{
+    void *         object = NULL;
+    slab_cache_t * cache  = NULL;
+
+    if (NULL == slab)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    cache = slab_get_cache(slab);
+    if (NULL == cache)
+    {
+        goto END;
+    }
+
+    if ((0 == cache->count) && (E_SUCCESS != slab_refill(slab, cache)))
+    {
+        goto END;
+    }
+
+    object           = cache->free_list;
+    cache->free_list = slab_link(object, 0);
+    cache->count--;
+
+END:
+    return object;
+}
+
+void slab_free(slab_t * slab, void * object)
+{
+    slab_cache_t * cache = NULL;
+
+    if ((NULL == slab) || (NULL == object))
+    {
+        goto END;
+    }
+
+    cache = slab_get_cache(slab);
+    if (NULL == cache)
+    {
+        // Without a cache the object goes straight to the depot
+        pthread_mutex_lock(&slab->mutex);
+        slab_set_link(object, 0, slab->loose);
+        slab->loose = object;
+        slab->loose_count++;
+        pthread_mutex_unlock(&slab->mutex);
+        goto END;
+    }
+
+    slab_set_link(object, 0, cache->free_list);
+    cache->free_list = object;
+    cache->count++;
+
+    // Keep one batch for the next allocations and return the rest
+    if ((2 * slab->batch_size) <= cache->count)
+    {
+        slab_flush(slab, cache);
+    }
+
+END:
+    return;
+}
+
+size_t slab_object_size(const slab_t * slab)
+{
+    size_t size = 0;
+
+    if (NULL == slab)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    size = slab->object_size;
+
+END:
+    return size;
+}
+
+int slab_destroy(slab_t ** slab_addr)
+{
+    int            exit_code = E_FAILURE;
+    slab_block_t * block     = NULL;
+    slab_cache_t * cache     = NULL;
+
+    if ((NULL == slab_addr) || (NULL == *slab_addr))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    // Stops exiting threads from touching the allocator from here on, each
+    // cache is freed by its own thread
+    pthread_mutex_lock(&slab_registry_mutex);
+    while (NULL != (*slab_addr)->caches)
+    {
+        cache                = (*slab_addr)->caches;
+        (*slab_addr)->caches = cache->next;
+        cache->dead          = true;
+    }
+    pthread_mutex_unlock(&slab_registry_mutex);
+
+    while (NULL != (*slab_addr)->blocks)
+    {
+        block                = (*slab_addr)->blocks;
+        (*slab_addr)->blocks = block->next;
+        free(block);
+    }
+
+    pthread_mutex_destroy(&(*slab_addr)->mutex);
+    free(*slab_addr);
+    *slab_addr = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void slab_create_key(void)
+{
+    slab_key_status = pthread_key_create(&slab_key, slab_release_caches);
+}
+
+static void * slab_link(void * object, size_t index)
+{
+    return ((void **)object)[index];
+}
+
+static void slab_set_link(void * object, size_t index, void * link)
+{
+    ((void **)object)[index] = link;
+}
+
+static slab_cache_t * slab_get_cache(slab_t * slab)
+{
+    slab_cache_t * head  = pthread_getspecific(slab_key);
+    slab_cache_t * cache = head;
+
+    // A thread holds a cache for each allocator it used, a handful at most
+    while ((NULL != cache) &&
+           ((slab != cache->slab) || (slab->id != cache->id)))
+    {
+        cache = cache->thread_next;
+    }
+
+    if (NULL != cache)
+    {
+        goto END;
+    }
+
+    cache = calloc(1, sizeof(slab_cache_t));
+    if (NULL == cache)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    cache->slab        = slab;
+    cache->id          = slab->id;
+    cache->thread_next = head;
+    if (E_SUCCESS != pthread_setspecific(slab_key, cache))
+    {
+        print_error("Unable to set thread cache.");
+        free(cache);
+        cache = NULL;
+        goto END;
+    }
+
+    slab_prune_caches(cache);
+
+    pthread_mutex_lock(&slab->mutex);
+    cache->next = slab->caches;
+    if (NULL != slab->caches)
+    {
+        slab->caches->prev = cache;
+    }
+    slab->caches = cache;
+    pthread_mutex_unlock(&slab->mutex);
+
+END:
+    return cache;
+}
+
+static int slab_refill(slab_t * slab, slab_cache_t * cache)
+{
+    int            exit_code = E_FAILURE;
+    slab_block_t * block     = NULL;
+    char *         objects   = NULL;
+
+    pthread_mutex_lock(&slab->mutex);
+    if (NULL != slab->full_batches)
+    {
+        cache->free_list   = slab->full_batches;
+        cache->count       = slab->batch_size;
+        slab->full_batches = slab_link(cache->free_list, 1);
+        pthread_mutex_unlock(&slab->mutex);
+        exit_code = E_SUCCESS;
+        goto END;
+    }
+
+    if (NULL != slab->loose)
+    {
+        cache->free_list  = slab->loose;
+        cache->count      = slab->loose_count;
+        slab->loose       = NULL;
+        slab->loose_count = 0;
+        pthread_mutex_unlock(&slab->mutex);
+        exit_code = E_SUCCESS;
+        goto END;
+    }
+    pthread_mutex_unlock(&slab->mutex);
+
+    // The depot is empty, carve a fresh block outside the lock
+    if (((SIZE_MAX - sizeof(slab_block_t)) / slab->object_size) <
+        slab->batch_size)
+    {
+        print_error("Batch too large.");
+        goto END;
+    }
+
+    block = malloc(sizeof(slab_block_t) +
+                   (slab->batch_size * slab->object_size));
+    if (NULL == block)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    objects = (char *)block + sizeof(slab_block_t);
+    for (size_t idx = 0; idx < slab->batch_size; idx++)
+    {
+        slab_set_link(objects + (idx * slab->object_size),
+                      0,
+                      (idx + 1 < slab->batch_size)
+                          ? objects + ((idx + 1) * slab->object_size)
+                          : NULL);
+    }
+    cache->free_list = objects;
+    cache->count     = slab->batch_size;
+
+    pthread_mutex_lock(&slab->mutex);
+    block->next  = slab->blocks;
+    slab->blocks = block;
+    pthread_mutex_unlock(&slab->mutex);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void slab_flush(slab_t * slab, slab_cache_t * cache)
+{
+    void * kept  = cache->free_list;
+    void * batch = NULL;
+    void * last  = NULL;
+
+    // The newest batch stays cached since it is the most likely to still be
+    // warm, the batch behind it goes to the depot
+    for (size_t idx = 1; idx < slab->batch_size; idx++)
+    {
+        kept = slab_link(kept, 0);
+    }
+
+    batch = slab_link(kept, 0);
+    last  = batch;
+    for (size_t idx = 1; idx < slab->batch_size; idx++)
+    {
+        last = slab_link(last, 0);
+    }
+
+    slab_set_link(kept, 0, slab_link(last, 0));
+    slab_set_link(last, 0, NULL);
+    cache->count -= slab->batch_size;
+
+    pthread_mutex_lock(&slab->mutex);
+    slab_set_link(batch, 1, slab->full_batches);
+    slab->full_batches = batch;
+    pthread_mutex_unlock(&slab->mutex);
+}
+
+static void slab_prune_caches(slab_cache_t * head)
+{
+    slab_cache_t * cache = NULL;
+
+    pthread_mutex_lock(&slab_registry_mutex);
+    while (NULL != head->thread_next)
+    {
+        cache = head->thread_next;
+        if (true == cache->dead)
+        {
+            head->thread_next = cache->thread_next;
+            free(cache);
+        }
+        else
+        {
+            head = cache;
+        }
+    }
+    pthread_mutex_unlock(&slab_registry_mutex);
+}
+
+static void slab_release_cache(slab_cache_t * cache)
+{
+    slab_t * slab = cache->slab;
+    void *   last = cache->free_list;
+
+    pthread_mutex_lock(&slab->mutex);
+    if (NULL != last)
+    {
+        while (NULL != slab_link(last, 0))
+        {
+            last = slab_link(last, 0);
+        }
+
+        slab_set_link(last, 0, slab->loose);
+        slab->loose = cache->free_list;
+        slab->loose_count += cache->count;
+    }
+
+    if (NULL != cache->prev)
+    {
+        cache->prev->next = cache->next;
+    }
+    else
+    {
+        slab->caches = cache->next;
+    }
+
+    if (NULL != cache->next)
+    {
+        cache->next->prev = cache->prev;
+    }
+    pthread_mutex_unlock(&slab->mutex);
+}
+
+static void slab_release_caches(void * head_p)
+{
+    slab_cache_t * cache = head_p;
+    slab_cache_t * next  = NULL;
+
+    pthread_mutex_lock(&slab_registry_mutex);
+    while (NULL != cache)
+    {
+        next = cache->thread_next;
+        if (false == cache->dead)
+        {
+            slab_release_cache(cache);
+        }
+        free(cache);
+        cache = next;
+    }
+    pthread_mutex_unlock(&slab_registry_mutex);
+}
+
+/*** end of file ***/
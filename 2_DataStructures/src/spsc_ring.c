@@ -0,0 +1,292 @@
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+#include "utilities.h"
+
+#define SPSC_MIN_CAPACITY 2
+
+// The largest power of two spsc_ring_capacity() can return
+#define SPSC_MAX_CAPACITY (UINT32_C(1) << 31)
+
+/**
+ * @brief structure of a single-producer/single-consumer ring
+ *
+ * @param head index of the next slot to pop, written by the consumer only
+ * @param cached_tail the consumer's last observed value of tail
+ * @param tail index of the next slot to push, written by the producer only
+ * @param cached_head the producer's last observed value of head
+ * @param mask capacity - 1, used to map indices to slots
+ * @param slots the ring of data pointers
+ */
+struct spsc_ring
+{
+    alignas(SPSC_CACHE_LINE) atomic_size_t head;
+    size_t cached_tail;
+    alignas(SPSC_CACHE_LINE) atomic_size_t tail;
+    size_t cached_head;
+    alignas(SPSC_CACHE_LINE) size_t mask;
+    void ** slots;
+};
+
+/**
+ * @brief returns how many slots the producer may fill, refreshing its cached
+ *        copy of head only when the cached view is not enough
+ *
+ * @param ring pointer to the ring
+ * @param tail the producer's current tail
+ * @param wanted the number of slots the producer would like
+ * @return the number of free slots, at most 'wanted'
+ */
+static size_t spsc_ring_free_slots(spsc_ring_t * ring,
+                                   size_t        tail,
+                                   size_t        wanted);
+
+/**
+ * @brief returns how many slots the consumer may read, refreshing its cached
+ *        copy of tail only when the cached view is not enough
+ *
+ * @param ring pointer to the ring
+ * @param head the consumer's current head
+ * @param wanted the number of slots the consumer would like
+ * @return the number of filled slots, at most 'wanted'
+ */
+static size_t spsc_ring_used_slots(spsc_ring_t * ring,
+                                   size_t        head,
+                                   size_t        wanted);
+
+spsc_ring_t * spsc_ring_init(uint32_t capacity)
+{
+    spsc_ring_t * ring    = NULL;
+    size_t        rounded = SPSC_MIN_CAPACITY;
+
+    if ((0 == capacity) || (SPSC_MAX_CAPACITY < capacity))
+    {
+        print_error("Invalid capacity.");
+        goto END;
+    }
+
+    while (rounded < capacity)
+    {
+        rounded <<= 1U;
+    }
+
+    // sizeof() is a multiple of the alignment, as aligned_alloc() requires
+    ring = aligned_alloc(alignof(spsc_ring_t), sizeof(spsc_ring_t));
+    if (NULL == ring)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+    memset(ring, 0, sizeof(spsc_ring_t));
+
+    ring->slots = calloc(rounded, sizeof(void *));
+    if (NULL == ring->slots)
+    {
+        print_error("CMR failure.");
+        free(ring);
+        ring = NULL;
+        goto END;
+    }
+
+    ring->mask = rounded - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+
+END:
+    return ring;
+}
+
+int spsc_ring_push(spsc_ring_t * ring, void * data)
+{
+    int    exit_code = E_FAILURE;
+    size_t tail      = 0;
+
+    if ((NULL == ring) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (0 == spsc_ring_free_slots(ring, tail, 1))
+    {
+        goto END;
+    }
+
+    ring->slots[tail & ring->mask] = data;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+void * spsc_ring_pop(spsc_ring_t * ring)
+{
+    void * data = NULL;
+    size_t head = 0;
+
+    if (NULL == ring)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (0 == spsc_ring_used_slots(ring, head, 1))
+    {
+        goto END;
+    }
+
+    data = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+END:
+    return data;
+}
+
+size_t spsc_ring_push_batch(spsc_ring_t * ring, void ** data, size_t count)
+{
+    size_t pushed = 0;
+    size_t tail   = 0;
+
+    if ((NULL == ring) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    tail  = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    count = spsc_ring_free_slots(ring, tail, count);
+
+    for (pushed = 0; pushed < count; pushed++)
+    {
+        ring->slots[(tail + pushed) & ring->mask] = data[pushed];
+    }
+
+    // One release store publishes the whole batch
+    atomic_store_explicit(&ring->tail, tail + pushed, memory_order_release);
+
+END:
+    return pushed;
+}
+
+size_t spsc_ring_pop_batch(spsc_ring_t * ring, void ** data, size_t max)
+{
+    size_t popped = 0;
+    size_t head   = 0;
+
+    if ((NULL == ring) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    max  = spsc_ring_used_slots(ring, head, max);
+
+    for (popped = 0; popped < max; popped++)
+    {
+        data[popped] = ring->slots[(head + popped) & ring->mask];
+    }
+
+    // One release store hands every popped slot back to the producer
+    atomic_store_explicit(&ring->head, head + popped, memory_order_release);
+
+END:
+    return popped;
+}
+
+uint32_t spsc_ring_capacity(const spsc_ring_t * ring)
+{
+    uint32_t capacity = 0;
+
+    if (NULL == ring)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    capacity = (uint32_t)(ring->mask + 1);
+
+END:
+    return capacity;
+}
+
+size_t spsc_ring_size(spsc_ring_t * ring)
+{
+    size_t size = 0;
+    size_t head = 0;
+    size_t tail = 0;
+
+    if (NULL == ring)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size = tail - head;
+
+END:
+    return size;
+}
+
+int spsc_ring_destroy(spsc_ring_t ** ring_addr)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == ring_addr) || (NULL == *ring_addr))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    free((*ring_addr)->slots);
+    (*ring_addr)->slots = NULL;
+    free(*ring_addr);
+    *ring_addr = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static size_t spsc_ring_free_slots(spsc_ring_t * ring,
+                                   size_t        tail,
+                                   size_t        wanted)
+{
+    size_t capacity  = ring->mask + 1;
+    size_t available = capacity - (tail - ring->cached_head);
+
+    if (available < wanted)
+    {
+        ring->cached_head =
+            atomic_load_explicit(&ring->head, memory_order_acquire);
+        available = capacity - (tail - ring->cached_head);
+    }
+
+    return (available < wanted) ? available : wanted;
+}
+
+static size_t spsc_ring_used_slots(spsc_ring_t * ring,
+                                   size_t        head,
+                                   size_t        wanted)
+{
+    size_t available = ring->cached_tail - head;
+
+    if (available < wanted)
+    {
+        ring->cached_tail =
+            atomic_load_explicit(&ring->tail, memory_order_acquire);
+        available = ring->cached_tail - head;
+    }
+
+    return (available < wanted) ? available : wanted;
+}
+
+/*** end of file ***/
@@ -0,0 +1,537 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "timer_wheel.h"
+#include "utilities.h"
+
+#define WHEEL_BITS          6
+#define WHEEL_SLOTS         64 // Slots per level, one bit each in a bitmap
+#define WHEEL_LEVELS        6  // Levels, spanning 2^(6 * 6) ticks together
+#define WHEEL_SPAN          (WHEEL_BITS * WHEEL_LEVELS)
+#define WHEEL_MIN_CAPACITY  16
+#define WHEEL_GROWTH_FACTOR 2
+#define NO_ENTRY            UINT32_MAX // Ends a slot list or the free list
+#define SLOT_FREE           UINT16_MAX // The entry holds no timer
+#define SLOT_FIRING         (UINT16_MAX - 1) // The timer is expiring
+
+/**
+ * @brief an entry holding one timer
+ *
+ * @param expiry the tick the timer expires on
+ * @param data the data pointer of the timer
+ * @param next the next entry in the slot list, or in the free list
+ * @param prev the previous entry in the slot list
+ * @param generation bumped every time the entry is released, so handles to
+ *        an earlier timer in the same entry are refused
+ * @param slot the slot list the entry is on, SLOT_FREE or SLOT_FIRING
+ */
+typedef struct timer_entry
+{
+    uint64_t expiry;
+    void *   data;
+    uint32_t next;
+    uint32_t prev;
+    uint32_t generation;
+    uint16_t slot;
+} timer_entry_t;
+
+/**
+ * @brief structure of a timing wheel
+ *
+ * @param now the first tick the wheel has not moved past
+ * @param size the number of pending timers
+ * @param capacity the number of entries allocated
+ * @param issued the number of entries handed out so far, reused entries
+ *        come from free_entry first
+ * @param free_entry head of the list of released entries
+ * @param customfree function used to free the data of pending timers
+ * @param entries the timers, indexed by the low half of their handle
+ * @param occupied a bitmap of the non-empty slots of each level
+ * @param heads the first entry of every slot, level by level
+ */
+struct timer_wheel
+{
+    uint64_t        now;
+    uint32_t        size;
+    uint32_t        capacity;
+    uint32_t        issued;
+    uint32_t        free_entry;
+    FREE_F          customfree;
+    timer_entry_t * entries;
+    uint64_t        occupied[WHEEL_LEVELS];
+    uint32_t        heads[WHEEL_LEVELS * WHEEL_SLOTS];
+};
+
+/**
+ * @brief grows the entries until at least 'needed' fit
+ *
+ * @param wheel pointer to the wheel
+ * @param needed the number of entries that must fit
+ * @return 0 on success, non-zero value on failure
+ */
+static int wheel_reserve(timer_wheel_t * wheel, uint64_t needed);
+
+/**
+ * @brief finds the entry a handle refers to
+ *
+ * @param wheel pointer to the wheel
+ * @param handle the handle to look up
+ * @return the index of the entry, NO_ENTRY if the handle is not pending
+ */
+static uint32_t wheel_lookup(const timer_wheel_t * wheel,
+                             timer_handle_t        handle);
+
+/**
+ * @brief puts an entry on the slot its expiry belongs in, relative to the
+ *        current tick
+ *
+ * @param wheel pointer to the wheel
+ * @param index the index of the entry
+ */
+static void wheel_place(timer_wheel_t * wheel, uint32_t index);
+
+/**
+ * @brief takes an entry off its slot list
+ *
+ * @param wheel pointer to the wheel
+ * @param index the index of the entry
+ */
+static void wheel_unlink(timer_wheel_t * wheel, uint32_t index);
+
+/**
+ * @brief returns an entry to the free list
+ *
+ * @param wheel pointer to the wheel
+ * @param index the index of the entry
+ */
+static void wheel_release(timer_wheel_t * wheel, uint32_t index);
+
+timer_wheel_t * timer_wheel_create(uint32_t capacity, FREE_F customfree)
+{
+    timer_wheel_t * wheel = NULL;
+
+    wheel = calloc(1, sizeof(timer_wheel_t));
+    if (NULL == wheel)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    wheel->customfree = customfree;
+    wheel->free_entry = NO_ENTRY;
+    for (size_t slot = 0; slot < (WHEEL_LEVELS * WHEEL_SLOTS); slot++)
+    {
+        wheel->heads[slot] = NO_ENTRY;
+    }
+
+    if (WHEEL_MIN_CAPACITY > capacity)
+    {
+        capacity = WHEEL_MIN_CAPACITY;
+    }
+
+    if (E_SUCCESS != wheel_reserve(wheel, capacity))
+    {
+        free(wheel);
+        wheel = NULL;
+        goto END;
+    }
+
+END:
+    return wheel;
+}
+
+int timer_wheel_add(timer_wheel_t *  wheel,
+                    uint64_t         expiry,
+                    void *           data,
+                    timer_handle_t * handle_p)
+{
+    int      exit_code = E_FAILURE;
+    uint32_t index     = NO_ENTRY;
+
+    if (NULL == wheel)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    if (NO_ENTRY != wheel->free_entry)
+    {
+        index             = wheel->free_entry;
+        wheel->free_entry = wheel->entries[index].next;
+    }
+    else
+    {
+        if (E_SUCCESS != wheel_reserve(wheel, (uint64_t)wheel->issued + 1))
+        {
+            goto END;
+        }
+
+        index = wheel->issued;
+        wheel->issued++;
+        wheel->entries[index].generation = 0;
+    }
+
+    wheel->entries[index].expiry = expiry;
+    wheel->entries[index].data   = data;
+    wheel_place(wheel, index);
+    wheel->size++;
+
+    if (NULL != handle_p)
+    {
+        *handle_p = ((uint64_t)wheel->entries[index].generation << 32) | index;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int timer_wheel_cancel(timer_wheel_t * wheel,
+                       timer_handle_t  handle,
+                       void **         data_p)
+{
+    int      exit_code = E_FAILURE;
+    uint32_t index     = NO_ENTRY;
+
+    if (NULL == wheel)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    index = wheel_lookup(wheel, handle);
+    if (NO_ENTRY == index)
+    {
+        goto END;
+    }
+
+    if (NULL != data_p)
+    {
+        *data_p = wheel->entries[index].data;
+    }
+
+    wheel_unlink(wheel, index);
+    wheel_release(wheel, index);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+size_t timer_wheel_advance(timer_wheel_t * wheel,
+                           uint64_t        now,
+                           TIMER_F         expire_f,
+                           void *          ctx)
+{
+    size_t          expired = 0;
+    uint64_t        tick    = 0;
+    uint64_t        next    = 0;
+    uint32_t *      head    = NULL;
+    uint32_t        index   = NO_ENTRY;
+    timer_entry_t * entry   = NULL;
+
+    if ((NULL == wheel) || (NULL == expire_f))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    while ((E_SUCCESS == timer_wheel_next_tick(wheel, &tick)) &&
+           (tick <= now))
+    {
+        wheel->now = tick;
+
+        // Slots above level 0 the tick falls in cascade down first, which
+        // only ever moves their timers to lower levels. The wheel may have
+        // stopped on the tick a slot starts on without cascading it yet.
+        for (size_t level = WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            head = &wheel->heads[(level * WHEEL_SLOTS) +
+                                 ((tick >> (WHEEL_BITS * level)) &
+                                  (WHEEL_SLOTS - 1))];
+            while (NO_ENTRY != *head)
+            {
+                index = *head;
+                wheel_unlink(wheel, index);
+                wheel_place(wheel, index);
+            }
+        }
+
+        // Timers re-added by the callback go to later slots, so the slot
+        // runs dry even while it is being refilled
+        wheel->now = tick + 1;
+        head       = &wheel->heads[tick & (WHEEL_SLOTS - 1)];
+        while (NO_ENTRY != *head)
+        {
+            index = *head;
+            entry = &wheel->entries[index];
+            wheel_unlink(wheel, index);
+
+            // Timers beyond the span of the wheel wait at its far end
+            if (entry->expiry > tick)
+            {
+                wheel_place(wheel, index);
+                continue;
+            }
+
+            entry->slot = SLOT_FIRING;
+            next        = expire_f(entry->data, tick, ctx);
+            expired++;
+
+            // The callback may have added timers, moving the entries
+            entry = &wheel->entries[index];
+            if (TIMER_WHEEL_NEVER == next)
+            {
+                wheel_release(wheel, index);
+            }
+            else
+            {
+                entry->expiry = next;
+                wheel_place(wheel, index);
+            }
+        }
+    }
+
+    if (wheel->now <= now)
+    {
+        wheel->now = now + 1;
+    }
+
+END:
+    return expired;
+}
+
+int timer_wheel_next_tick(const timer_wheel_t * wheel, uint64_t * tick_p)
+{
+    int      exit_code = E_FAILURE;
+    uint64_t current   = 0;
+    uint64_t occupied  = 0;
+    uint64_t slot      = 0;
+    uint64_t base      = 0;
+
+    if ((NULL == wheel) || (NULL == tick_p))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    // A slot above level 0 the current tick falls in has yet to cascade
+    for (size_t level = 1; level < WHEEL_LEVELS; level++)
+    {
+        current = (wheel->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+        if (0 != (wheel->occupied[level] & (1ULL << current)))
+        {
+            *tick_p   = wheel->now;
+            exit_code = E_SUCCESS;
+            goto END;
+        }
+    }
+
+    // Every slot of a level comes round before the first slot of the level
+    // above it, so the lowest level with a pending slot holds the next tick
+    for (size_t level = 0; level < WHEEL_LEVELS; level++)
+    {
+        current  = (wheel->now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+        occupied = wheel->occupied[level] & (~0ULL << current);
+        if (0 == occupied)
+        {
+            continue;
+        }
+
+        slot = (uint64_t)__builtin_ctzll(occupied);
+        base = (wheel->now >> (WHEEL_BITS * (level + 1)))
+               << (WHEEL_BITS * (level + 1));
+        *tick_p = base | (slot << (WHEEL_BITS * level));
+        *tick_p = (*tick_p < wheel->now) ? wheel->now : *tick_p;
+
+        exit_code = E_SUCCESS;
+        break;
+    }
+
+END:
+    return exit_code;
+}
+
+uint64_t timer_wheel_now(const timer_wheel_t * wheel)
+{
+    return (NULL == wheel) ? 0 : wheel->now;
+}
+
+uint32_t timer_wheel_size(const timer_wheel_t * wheel)
+{
+    return (NULL == wheel) ? 0 : wheel->size;
+}
+
+int timer_wheel_destroy(timer_wheel_t ** wheel_addr)
+{
+    int             exit_code = E_FAILURE;
+    timer_wheel_t * wheel     = NULL;
+
+    if ((NULL == wheel_addr) || (NULL == *wheel_addr))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    wheel = *wheel_addr;
+    if (NULL != wheel->customfree)
+    {
+        for (uint32_t index = 0; index < wheel->issued; index++)
+        {
+            if (SLOT_FREE != wheel->entries[index].slot)
+            {
+                wheel->customfree(wheel->entries[index].data);
+            }
+        }
+    }
+
+    free(wheel->entries);
+    free(wheel);
+    *wheel_addr = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static int wheel_reserve(timer_wheel_t * wheel, uint64_t needed)
+{
+    int             exit_code = E_FAILURE;
+    uint64_t        capacity  = wheel->capacity;
+    timer_entry_t * entries   = NULL;
+
+    if (needed <= capacity)
+    {
+        exit_code = E_SUCCESS;
+        goto END;
+    }
+
+    // NO_ENTRY must never be issued as a real index
+    if (NO_ENTRY <= needed)
+    {
+        print_error("Timer wheel is full.");
+        goto END;
+    }
+
+    capacity = (0 == capacity) ? needed : capacity;
+    while (capacity < needed)
+    {
+        capacity *= WHEEL_GROWTH_FACTOR;
+    }
+
+    if (NO_ENTRY < capacity)
+    {
+        capacity = NO_ENTRY;
+    }
+
+    entries = realloc(wheel->entries, (size_t)capacity * sizeof(timer_entry_t));
+    if (NULL == entries)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+    wheel->entries  = entries;
+    wheel->capacity = (uint32_t)capacity;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static uint32_t wheel_lookup(const timer_wheel_t * wheel,
+                             timer_handle_t        handle)
+{
+    uint32_t index      = (uint32_t)handle;
+    uint32_t generation = (uint32_t)(handle >> 32);
+
+    if ((index >= wheel->issued) ||
+        (generation != wheel->entries[index].generation) ||
+        (SLOT_FIRING <= wheel->entries[index].slot))
+    {
+        index = NO_ENTRY;
+    }
+
+    return index;
+}
+
+static void wheel_place(timer_wheel_t * wheel, uint32_t index)
+{
+    timer_entry_t * entry  = &wheel->entries[index];
+    uint64_t        expiry = entry->expiry;
+    uint64_t        differ = 0;
+    size_t          level  = 0;
+    uint32_t        slot   = 0;
+
+    // A timer that is due goes on the current tick, one beyond the span
+    // goes on the last tick the wheel reaches without wrapping around
+    if (expiry < wheel->now)
+    {
+        expiry = wheel->now;
+    }
+
+    if (0 != ((expiry ^ wheel->now) >> WHEEL_SPAN))
+    {
+        expiry = wheel->now | ((1ULL << WHEEL_SPAN) - 1);
+    }
+
+    // The highest group of bits the expiry differs from the current tick on
+    differ = expiry ^ wheel->now;
+    if (0 != differ)
+    {
+        level = (size_t)(63 - __builtin_clzll(differ)) / WHEEL_BITS;
+    }
+
+    slot = (uint32_t)((level * WHEEL_SLOTS) +
+                      ((expiry >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)));
+
+    entry->slot = (uint16_t)slot;
+    entry->prev = NO_ENTRY;
+    entry->next = wheel->heads[slot];
+    if (NO_ENTRY != entry->next)
+    {
+        wheel->entries[entry->next].prev = index;
+    }
+    wheel->heads[slot] = index;
+    wheel->occupied[level] |= 1ULL << (slot % WHEEL_SLOTS);
+}
+
+static void wheel_unlink(timer_wheel_t * wheel, uint32_t index)
+{
+    timer_entry_t * entry = &wheel->entries[index];
+    uint32_t        slot  = entry->slot;
+
+    if (NO_ENTRY != entry->prev)
+    {
+        wheel->entries[entry->prev].next = entry->next;
+    }
+    else
+    {
+        wheel->heads[slot] = entry->next;
+    }
+
+    if (NO_ENTRY != entry->next)
+    {
+        wheel->entries[entry->next].prev = entry->prev;
+    }
+
+    if (NO_ENTRY == wheel->heads[slot])
+    {
+        wheel->occupied[slot / WHEEL_SLOTS] &= ~(1ULL << (slot % WHEEL_SLOTS));
+    }
+
+    entry->slot = SLOT_FIRING;
+}
+
+static void wheel_release(timer_wheel_t * wheel, uint32_t index)
+{
+    timer_entry_t * entry = &wheel->entries[index];
+
+    entry->generation++;
+    entry->slot       = SLOT_FREE;
+    entry->data       = NULL;
+    entry->next       = wheel->free_entry;
+    wheel->free_entry = index;
+    wheel->size--;
+}
+
+/*** end of file ***/
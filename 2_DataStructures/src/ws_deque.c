@@ -0,0 +1,340 @@
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utilities.h"
+#include "ws_deque.h"
+
+#define WS_DEQUE_MIN_CAPACITY  2
+#define WS_DEQUE_GROWTH_FACTOR 2
+
+/**
+ * @brief a circular array of slots
+ *
+ * @param mask capacity - 1, used to map indices to slots
+ * @param retired the array this one replaced, kept until destroy
+ * @param slots the stored data pointers
+ */
+typedef struct ws_deque_array
+{
+    size_t                  mask;
+    struct ws_deque_array * retired;
+    _Atomic(void *) slots[];
+} ws_deque_array_t;
+
+/**
+ * @brief structure of a work-stealing deque
+ *
+ * @param top index of the oldest item, advanced by thieves and by the owner
+ *        when it takes the last item
+ * @param bottom index of the next slot to push, written by the owner only
+ * @param array the current circular array
+ *
+ * @note top and bottom only ever grow (bottom is decremented by pop and
+ * restored when the deque turns out empty), so they are signed to let the
+ * owner's tentative decrement go below top.
+ */
+struct ws_deque
+{
+    alignas(WS_DEQUE_CACHE_LINE) _Atomic(int64_t) top;
+    alignas(WS_DEQUE_CACHE_LINE) _Atomic(int64_t) bottom;
+    _Atomic(ws_deque_array_t *) array;
+};
+
+/**
+ * @brief allocates an array with room for 'capacity' items
+ *
+ * @param capacity the number of slots, a power of two
+ * @return the new array on success, NULL on failure
+ */
+static ws_deque_array_t * ws_deque_array_create(size_t capacity);
+
+/**
+ * @brief replaces the owner's full array with one twice its size holding
+ *        the same items; owner thread only
+ *
+ * @param deque pointer to the deque
+ * @param array the current array
+ * @param top the oldest index still in use
+ * @param bottom the owner's bottom index
+ * @return the new array on success, NULL on failure
+ */
+static ws_deque_array_t * ws_deque_grow(ws_deque_t *       deque,
+                                        ws_deque_array_t * array,
+                                        int64_t            top,
+                                        int64_t            bottom);
+
+ws_deque_t * ws_deque_init(uint32_t capacity)
+{
+    ws_deque_t *       deque   = NULL;
+    ws_deque_array_t * array   = NULL;
+    size_t             rounded = WS_DEQUE_MIN_CAPACITY;
+
+    if (0 == capacity)
+    {
+        print_error("Invalid capacity.");
+        goto END;
+    }
+
+    while (rounded < capacity)
+    {
+        rounded <<= 1U;
+    }
+
+    // sizeof() is a multiple of the alignment, as aligned_alloc() requires
+    deque = aligned_alloc(alignof(ws_deque_t), sizeof(ws_deque_t));
+    if (NULL == deque)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+    memset(deque, 0, sizeof(ws_deque_t));
+
+    array = ws_deque_array_create(rounded);
+    if (NULL == array)
+    {
+        free(deque);
+        deque = NULL;
+        goto END;
+    }
+
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, array);
+
+END:
+    return deque;
+}
+
+int ws_deque_push(ws_deque_t * deque, void * data)
+{
+    int                exit_code = E_FAILURE;
+    ws_deque_array_t * array     = NULL;
+    int64_t            bottom    = 0;
+    int64_t            top       = 0;
+
+    if ((NULL == deque) || (NULL == data))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    top    = atomic_load_explicit(&deque->top, memory_order_acquire);
+    array  = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if ((size_t)(bottom - top) > array->mask)
+    {
+        array = ws_deque_grow(deque, array, top, bottom);
+        if (NULL == array)
+        {
+            goto END;
+        }
+    }
+
+    atomic_store_explicit(&array->slots[(size_t)bottom & array->mask],
+                          data,
+                          memory_order_relaxed);
+
+    // Publishes the slot (and a grown array) to thieves that acquire bottom
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+void * ws_deque_pop(ws_deque_t * deque)
+{
+    void *             data   = NULL;
+    ws_deque_array_t * array  = NULL;
+    int64_t            bottom = 0;
+    int64_t            top    = 0;
+
+    if (NULL == deque)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    array  = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    // Reserve the bottom slot before looking at top. Both are seq_cst so
+    // a thief either sees the lowered bottom or this load sees its steal.
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_seq_cst);
+    top = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+
+    if (top > bottom)
+    {
+        // Empty, undo the reservation
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        goto END;
+    }
+
+    data = atomic_load_explicit(&array->slots[(size_t)bottom & array->mask],
+                                memory_order_relaxed);
+    if (top == bottom)
+    {
+        // The last item, race the thieves for it through top
+        if (!atomic_compare_exchange_strong_explicit(&deque->top,
+                                                     &top,
+                                                     top + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed))
+        {
+            data = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+
+END:
+    return data;
+}
+
+void * ws_deque_steal(ws_deque_t * deque)
+{
+    void *             data   = NULL;
+    ws_deque_array_t * array  = NULL;
+    int64_t            top    = 0;
+    int64_t            bottom = 0;
+
+    if (NULL == deque)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    top    = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_seq_cst);
+    if (top >= bottom)
+    {
+        goto END;
+    }
+
+    array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    data  = atomic_load_explicit(&array->slots[(size_t)top & array->mask],
+                                memory_order_relaxed);
+
+    // Only the thread that advances top owns the item it read
+    if (!atomic_compare_exchange_strong_explicit(&deque->top,
+                                                 &top,
+                                                 top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+    {
+        data = NULL;
+    }
+
+END:
+    return data;
+}
+
+size_t ws_deque_size(ws_deque_t * deque)
+{
+    size_t  size   = 0;
+    int64_t top    = 0;
+    int64_t bottom = 0;
+
+    if (NULL == deque)
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    top    = atomic_load_explicit(&deque->top, memory_order_acquire);
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (bottom > top)
+    {
+        size = (size_t)(bottom - top);
+    }
+
+END:
+    return size;
+}
+
+int ws_deque_destroy(ws_deque_t ** deque_addr)
+{
+    int                exit_code = E_FAILURE;
+    ws_deque_array_t * array     = NULL;
+    ws_deque_array_t * retired   = NULL;
+
+    if ((NULL == deque_addr) || (NULL == *deque_addr))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    array = atomic_load_explicit(&(*deque_addr)->array, memory_order_relaxed);
+    while (NULL != array)
+    {
+        retired = array->retired;
+        free(array);
+        array = retired;
+    }
+
+    free(*deque_addr);
+    *deque_addr = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static ws_deque_array_t * ws_deque_array_create(size_t capacity)
+{
+    ws_deque_array_t * array = NULL;
+
+    array = calloc(1, sizeof(ws_deque_array_t) + (capacity * sizeof(void *)));
+    if (NULL == array)
+    {
+        print_error("CMR failure.");
+        goto END;
+    }
+
+    array->mask = capacity - 1;
+    for (size_t idx = 0; idx < capacity; idx++)
+    {
+        atomic_init(&array->slots[idx], NULL);
+    }
+
+END:
+    return array;
+}
+
+static ws_deque_array_t * ws_deque_grow(ws_deque_t *       deque,
+                                        ws_deque_array_t * array,
+                                        int64_t            top,
+                                        int64_t            bottom)
+{
+    ws_deque_array_t * grown    = NULL;
+    size_t             capacity = (array->mask + 1) * WS_DEQUE_GROWTH_FACTOR;
+    void *             data     = NULL;
+
+    grown = ws_deque_array_create(capacity);
+    if (NULL == grown)
+    {
+        goto END;
+    }
+
+    // Thieves may still read the old slots, so copy rather than move and
+    // keep the old array alive
+    for (int64_t idx = top; idx < bottom; idx++)
+    {
+        data = atomic_load_explicit(&array->slots[(size_t)idx & array->mask],
+                                    memory_order_relaxed);
+        atomic_store_explicit(&grown->slots[(size_t)idx & grown->mask],
+                              data,
+                              memory_order_relaxed);
+    }
+
+    grown->retired = array;
+    atomic_store_explicit(&deque->array, grown, memory_order_release);
+
+END:
+    return grown;
+}
+
+/*** end of file ***/
@@ -0,0 +1,236 @@
+#include "heap.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <stdlib.h>
+
+#define COUNT      1000
+#define SMALL      8
+#define WIDE_ARITY 4
+
+// The heap to be used by the single heap tests
+heap_t * heap = NULL;
+
+// NOLINTNEXTLINE
+int values[COUNT];
+
+int init_suite1(void)
+{
+    srand(1);
+    for (int idx = 0; idx < COUNT; idx++)
+    {
+        values[idx] = rand() % (COUNT / 2);
+    }
+
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+/**
+ * @brief pops every item and checks they come out in non-decreasing order
+ *
+ * @param check_heap the heap to drain
+ * @return the number of items popped
+ */
+static int drain_in_order(heap_t * check_heap)
+{
+    int * item     = NULL;
+    int   previous = -1;
+    int   popped   = 0;
+
+    while (NULL != (item = heap_pop(check_heap)))
+    {
+        CU_ASSERT(previous <= *item);
+        previous = *item;
+        popped++;
+    }
+
+    return popped;
+}
+
+void test_heap_init()
+{
+    // Should catch invalid arguments
+    CU_ASSERT(NULL == heap_init(1, SMALL, int_comp, NULL));
+    CU_ASSERT(NULL == heap_init(2, SMALL, NULL, NULL));
+
+    heap = heap_init(0, SMALL, int_comp, NULL);
+    CU_ASSERT_FATAL(NULL != heap);
+    CU_ASSERT(0 == heap_size(heap));
+    CU_ASSERT(NULL == heap_peek(heap));
+    CU_ASSERT(NULL == heap_pop(heap));
+}
+
+void test_heap_push_pop()
+{
+    CU_ASSERT(0 != heap_push(NULL, &values[0], NULL));
+    CU_ASSERT(0 != heap_push(heap, NULL, NULL));
+
+    // Push well past the initial capacity so the heap has to grow
+    for (int arity = 2; arity <= WIDE_ARITY; arity++)
+    {
+        heap_t * sized = heap_init((uint32_t)arity, SMALL, int_comp, NULL);
+        CU_ASSERT_FATAL(NULL != sized);
+
+        for (int idx = 0; idx < COUNT; idx++)
+        {
+            CU_ASSERT(0 == heap_push(sized, &values[idx], NULL));
+        }
+        CU_ASSERT(COUNT == heap_size(sized));
+        CU_ASSERT(COUNT == drain_in_order(sized));
+        CU_ASSERT(0 == heap_size(sized));
+        CU_ASSERT(0 == heap_destroy(&sized));
+    }
+}
+
+void test_heap_peek()
+{
+    int low  = -5;
+    int high = COUNT;
+
+    CU_ASSERT(0 == heap_push(heap, &high, NULL));
+    CU_ASSERT(&high == heap_peek(heap));
+    CU_ASSERT(0 == heap_push(heap, &low, NULL));
+    CU_ASSERT(&low == heap_peek(heap));
+
+    // Peeking does not remove anything
+    CU_ASSERT(2 == heap_size(heap));
+    CU_ASSERT(&low == heap_pop(heap));
+    CU_ASSERT(&high == heap_pop(heap));
+}
+
+void test_heap_decrease_key()
+{
+    heap_handle_t handles[SMALL];
+    int           keys[SMALL] = { 10, 20, 30, 40, 50, 60, 70, 80 };
+    int           lower       = 5;
+    int           higher      = 100;
+
+    for (int idx = 0; idx < SMALL; idx++)
+    {
+        CU_ASSERT(0 == heap_push(heap, &keys[idx], &handles[idx]));
+    }
+
+    // Replacing the data moves the item to the top
+    CU_ASSERT(0 == heap_decrease_key(heap, handles[7], &lower));
+    CU_ASSERT(&lower == heap_peek(heap));
+
+    // Updating the key in place and passing the same pointer works as well
+    keys[6] = 1;
+    CU_ASSERT(0 == heap_decrease_key(heap, handles[6], &keys[6]));
+    CU_ASSERT(&keys[6] == heap_peek(heap));
+
+    // A larger key is rejected
+    CU_ASSERT(0 != heap_decrease_key(heap, handles[0], &higher));
+
+    // A handle stops being valid once its item is popped
+    CU_ASSERT(&keys[6] == heap_pop(heap));
+    CU_ASSERT(0 != heap_decrease_key(heap, handles[6], &lower));
+    CU_ASSERT(0 != heap_decrease_key(heap, HEAP_INVALID_HANDLE, &lower));
+
+    CU_ASSERT(&lower == heap_pop(heap));
+    CU_ASSERT(SMALL - 2 == drain_in_order(heap));
+}
+
+void test_heap_heapify()
+{
+    heap_handle_t handles[COUNT];
+    void *        items[COUNT];
+    int           lowest = -1;
+
+    for (int idx = 0; idx < COUNT; idx++)
+    {
+        items[idx] = &values[idx];
+    }
+
+    CU_ASSERT(0 != heap_heapify(NULL, items, COUNT, NULL));
+    CU_ASSERT(0 != heap_heapify(heap, NULL, COUNT, NULL));
+
+    // Heapify on top of existing content, with handles for every item
+    CU_ASSERT(0 == heap_push(heap, &values[0], NULL));
+    CU_ASSERT(0 == heap_heapify(heap, items, COUNT, handles));
+    CU_ASSERT(COUNT + 1 == heap_size(heap));
+
+    CU_ASSERT(0 == heap_decrease_key(heap, handles[COUNT / 2], &lowest));
+    CU_ASSERT(&lowest == heap_pop(heap));
+    CU_ASSERT(COUNT == drain_in_order(heap));
+}
+
+void test_heap_destroy()
+{
+    heap_t * owning = heap_init(WIDE_ARITY, SMALL, int_comp, free);
+    heap_t * empty  = NULL;
+    int *    item   = NULL;
+
+    CU_ASSERT_FATAL(NULL != owning);
+
+    // Items left in the heap are released with its customfree
+    for (int idx = 0; idx < SMALL; idx++)
+    {
+        item = malloc(sizeof(int));
+        CU_ASSERT_FATAL(NULL != item);
+        *item = idx;
+        CU_ASSERT(0 == heap_push(owning, item, NULL));
+    }
+
+    CU_ASSERT(0 == heap_clear(owning));
+    CU_ASSERT(0 == heap_size(owning));
+
+    item = malloc(sizeof(int));
+    CU_ASSERT_FATAL(NULL != item);
+    *item = 0;
+    CU_ASSERT(0 == heap_push(owning, item, NULL));
+    CU_ASSERT(0 == heap_destroy(&owning));
+    CU_ASSERT(NULL == owning);
+
+    CU_ASSERT(0 != heap_destroy(&empty));
+    CU_ASSERT(0 == heap_destroy(&heap));
+    CU_ASSERT(NULL == heap);
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing heap_init():", test_heap_init },
+
+        { "Testing heap_push()/heap_pop():", test_heap_push_pop },
+
+        { "Testing heap_peek():", test_heap_peek },
+
+        { "Testing heap_decrease_key():", test_heap_decrease_key },
+
+        { "Testing heap_heapify():", test_heap_heapify },
+
+        { "Testing heap_clear()/heap_destroy():", test_heap_destroy },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
@@ -0,0 +1,230 @@
+#include "mpmc_queue.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define CAPACITY         5
+#define ROUNDED          8
+#define PRODUCERS        4
+#define CONSUMERS        4
+#define ITEMS_PER_THREAD 50000
+#define TOTAL_ITEMS      (PRODUCERS * ITEMS_PER_THREAD)
+
+// The queue to be used by the single threaded tests
+mpmc_queue_t * queue = NULL;
+
+// NOLINTNEXTLINE
+int data[ROUNDED] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+// Shared state for the concurrent test
+mpmc_queue_t * shared_queue = NULL;
+size_t         items[TOTAL_ITEMS];
+atomic_int     seen[TOTAL_ITEMS];
+atomic_int     consumed = 0;
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void test_mpmc_init()
+{
+    // Zero capacity, and capacity that rounds past 2^31, is rejected
+    CU_ASSERT(NULL == mpmc_queue_init(0));
+    CU_ASSERT(NULL == mpmc_queue_init(UINT32_MAX));
+
+    // Capacity is rounded up to the next power of two
+    queue = mpmc_queue_init(CAPACITY);
+    CU_ASSERT_FATAL(NULL != queue);
+    CU_ASSERT(ROUNDED == mpmc_queue_capacity(queue));
+    CU_ASSERT(0 == mpmc_queue_size(queue));
+}
+
+void test_mpmc_enqueue_dequeue()
+{
+    // Should catch invalid arguments
+    CU_ASSERT(0 != mpmc_queue_enqueue(NULL, &data[0]));
+    CU_ASSERT(0 != mpmc_queue_enqueue(queue, NULL));
+    CU_ASSERT(NULL == mpmc_queue_dequeue(NULL));
+
+    // Empty queue returns NULL
+    CU_ASSERT(NULL == mpmc_queue_dequeue(queue));
+
+    // Fill to capacity, then one more should fail
+    for (int idx = 0; idx < ROUNDED; idx++)
+    {
+        CU_ASSERT(0 == mpmc_queue_enqueue(queue, &data[idx]));
+    }
+    CU_ASSERT(ROUNDED == mpmc_queue_size(queue));
+    CU_ASSERT(0 != mpmc_queue_enqueue(queue, &data[0]));
+
+    // Items come back in FIFO order
+    for (int idx = 0; idx < ROUNDED; idx++)
+    {
+        CU_ASSERT(&data[idx] == mpmc_queue_dequeue(queue));
+    }
+    CU_ASSERT(NULL == mpmc_queue_dequeue(queue));
+    CU_ASSERT(0 == mpmc_queue_size(queue));
+}
+
+void test_mpmc_wraparound()
+{
+    // Keep the ring half full while walking it through several laps
+    for (int idx = 0; idx < (ROUNDED / 2); idx++)
+    {
+        mpmc_queue_enqueue(queue, &data[idx]);
+    }
+
+    for (int round = 0; round < (ROUNDED * 4); round++)
+    {
+        CU_ASSERT(0 == mpmc_queue_enqueue(
+                           queue, &data[(round + (ROUNDED / 2)) % ROUNDED]));
+        CU_ASSERT(&data[round % ROUNDED] == mpmc_queue_dequeue(queue));
+    }
+
+    CU_ASSERT((ROUNDED / 2) == mpmc_queue_size(queue));
+    while (NULL != mpmc_queue_dequeue(queue))
+    {
+    }
+}
+
+void * producer(void * arg)
+{
+    size_t base = (size_t)arg * ITEMS_PER_THREAD;
+
+    for (size_t idx = base; idx < (base + ITEMS_PER_THREAD); idx++)
+    {
+        // Spin while the bounded queue is full
+        while (0 != mpmc_queue_enqueue(shared_queue, &items[idx]))
+        {
+        }
+    }
+
+    return NULL;
+}
+
+void * consumer(void * arg)
+{
+    size_t * item = NULL;
+
+    (void)arg;
+    while (TOTAL_ITEMS > atomic_load(&consumed))
+    {
+        item = mpmc_queue_dequeue(shared_queue);
+        if (NULL != item)
+        {
+            atomic_fetch_add(&seen[*item], 1);
+            atomic_fetch_add(&consumed, 1);
+        }
+    }
+
+    return NULL;
+}
+
+void test_mpmc_concurrent()
+{
+    pthread_t producers[PRODUCERS];
+    pthread_t consumers[CONSUMERS];
+    int       duplicates = 0;
+
+    // A small ring forces producers and consumers to lap each other often
+    shared_queue = mpmc_queue_init(64);
+    CU_ASSERT_FATAL(NULL != shared_queue);
+
+    for (size_t idx = 0; idx < TOTAL_ITEMS; idx++)
+    {
+        items[idx] = idx;
+        atomic_init(&seen[idx], 0);
+    }
+
+    for (size_t idx = 0; idx < CONSUMERS; idx++)
+    {
+        pthread_create(&consumers[idx], NULL, consumer, NULL);
+    }
+    for (size_t idx = 0; idx < PRODUCERS; idx++)
+    {
+        pthread_create(&producers[idx], NULL, producer, (void *)idx);
+    }
+
+    for (size_t idx = 0; idx < PRODUCERS; idx++)
+    {
+        pthread_join(producers[idx], NULL);
+    }
+    for (size_t idx = 0; idx < CONSUMERS; idx++)
+    {
+        pthread_join(consumers[idx], NULL);
+    }
+
+    // Every item must have been delivered exactly once
+    for (size_t idx = 0; idx < TOTAL_ITEMS; idx++)
+    {
+        if (1 != atomic_load(&seen[idx]))
+        {
+            duplicates++;
+        }
+    }
+    CU_ASSERT(0 == duplicates);
+    CU_ASSERT(TOTAL_ITEMS == atomic_load(&consumed));
+    CU_ASSERT(NULL == mpmc_queue_dequeue(shared_queue));
+
+    CU_ASSERT(0 == mpmc_queue_destroy(&shared_queue));
+}
+
+void test_mpmc_destroy()
+{
+    mpmc_queue_t * invalid_queue = NULL;
+
+    CU_ASSERT(0 != mpmc_queue_destroy(&invalid_queue));
+    CU_ASSERT(0 == mpmc_queue_destroy(&queue));
+    CU_ASSERT(NULL == queue);
+    CU_ASSERT(0 != mpmc_queue_destroy(&queue));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing mpmc_queue_init():", test_mpmc_init },
+
+        { "Testing enqueue/dequeue:", test_mpmc_enqueue_dequeue },
+
+        { "Testing wraparound:", test_mpmc_wraparound },
+
+        { "Testing concurrent producers/consumers:", test_mpmc_concurrent },
+
+        { "Testing mpmc_queue_destroy():", test_mpmc_destroy },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
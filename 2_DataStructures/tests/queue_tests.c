@@ -121,6 +121,43 @@ void test_queue_dequeue()
     CU_ASSERT(NULL == node);
 }
 
+void test_queue_wraparound()
+{
+    queue_node_t * node = NULL;
+
+    // Walk head and tail around the ring several times, keeping the queue
+    // partially full so the indices wrap past the end of the array
+    queue_enqueue(queue, &data[0]);
+    queue_enqueue(queue, &data[1]);
+
+    for (int round = 0; round < (CAPACITY * 3); round++)
+    {
+        CU_ASSERT(0 == queue_enqueue(queue, &data[(round + 2) % CAPACITY]));
+
+        node = queue_peek(queue);
+        CU_ASSERT_FATAL(NULL != node);
+        CU_ASSERT(data[round % CAPACITY] == *(int *)node->data);
+
+        node = queue_dequeue(queue);
+        CU_ASSERT_FATAL(NULL != node);
+        CU_ASSERT(data[round % CAPACITY] == *(int *)node->data);
+        free(node);
+    }
+
+    // Drain the two remaining items in FIFO order
+    node = queue_dequeue(queue);
+    CU_ASSERT_FATAL(NULL != node);
+    CU_ASSERT(data[(CAPACITY * 3) % CAPACITY] == *(int *)node->data);
+    free(node);
+
+    node = queue_dequeue(queue);
+    CU_ASSERT_FATAL(NULL != node);
+    CU_ASSERT(data[((CAPACITY * 3) + 1) % CAPACITY] == *(int *)node->data);
+    free(node);
+
+    CU_ASSERT(0 == queue->currentsz);
+}
+
 void test_queue_peek()
 {
     queue_t *      invalid_queue = NULL;
@@ -185,6 +222,243 @@ void test_queue_destroy()
     CU_ASSERT(0 != exit_code);
 }
 
+void test_queue_inline()
+{
+    queue_t * inline_queue = NULL;
+    int *     item         = NULL;
+
+    inline_queue = queue_init_inline(CAPACITY, NULL);
+    CU_ASSERT_FATAL(NULL != inline_queue);
+    CU_ASSERT(QUEUE_MODE_INLINE == inline_queue->mode);
+    CU_ASSERT(NULL != inline_queue->slots);
+    CU_ASSERT(NULL == inline_queue->arr);
+
+    // Empty queue yields NULL rather than an error node
+    CU_ASSERT(NULL == queue_dequeue_data(inline_queue));
+    CU_ASSERT(NULL == queue_peek_data(inline_queue));
+
+    for (int idx = 0; idx < CAPACITY; idx++)
+    {
+        CU_ASSERT(0 == queue_enqueue(inline_queue, &data[idx]));
+        // The data pointer itself is stored, not a wrapping node
+        CU_ASSERT(&data[idx] == inline_queue->slots[idx]);
+    }
+    CU_ASSERT(0 == queue_fullcheck(inline_queue));
+    CU_ASSERT(0 != queue_enqueue(inline_queue, &data[0]));
+
+    // Node based accessors are rejected on an inline queue
+    CU_ASSERT(NULL == queue_dequeue(inline_queue));
+    CU_ASSERT(NULL == queue_peek(inline_queue));
+
+    item = queue_peek_data(inline_queue);
+    CU_ASSERT_FATAL(NULL != item);
+    CU_ASSERT(data[0] == *item);
+    CU_ASSERT(CAPACITY == inline_queue->currentsz);
+
+    // Pop two and push two so the slots wrap around the end of the array
+    CU_ASSERT(&data[0] == queue_dequeue_data(inline_queue));
+    CU_ASSERT(&data[1] == queue_dequeue_data(inline_queue));
+    CU_ASSERT(0 == queue_enqueue(inline_queue, &data[0]));
+    CU_ASSERT(0 == queue_enqueue(inline_queue, &data[1]));
+
+    for (int idx = 2; idx < (CAPACITY + 2); idx++)
+    {
+        item = queue_dequeue_data(inline_queue);
+        CU_ASSERT_FATAL(NULL != item);
+        CU_ASSERT(data[idx % CAPACITY] == *item);
+    }
+    CU_ASSERT(0 == inline_queue->currentsz);
+
+    // Clearing leaves the borrowed data untouched
+    queue_enqueue(inline_queue, &data[2]);
+    CU_ASSERT(0 == queue_clear(inline_queue));
+    CU_ASSERT(0 == inline_queue->currentsz);
+    CU_ASSERT(3 == data[2]);
+
+    CU_ASSERT(0 == queue_destroy(&inline_queue));
+    CU_ASSERT(NULL == inline_queue);
+}
+
+void test_queue_dequeue_data_node_mode()
+{
+    queue_t * node_queue = queue_init(CAPACITY, NULL);
+
+    CU_ASSERT_FATAL(NULL != node_queue);
+
+    queue_enqueue(node_queue, &data[3]);
+    queue_enqueue(node_queue, &data[4]);
+
+    // The wrapping node is released internally
+    CU_ASSERT(&data[3] == queue_peek_data(node_queue));
+    CU_ASSERT(&data[3] == queue_dequeue_data(node_queue));
+    CU_ASSERT(&data[4] == queue_dequeue_data(node_queue));
+    CU_ASSERT(NULL == queue_dequeue_data(node_queue));
+
+    CU_ASSERT(0 == queue_destroy(&node_queue));
+}
+
+void test_queue_growable()
+{
+    queue_t * growable = NULL;
+    int       burst[CAPACITY * 8];
+    int *     item     = NULL;
+
+    // Limits below the initial capacity are rejected
+    CU_ASSERT(NULL == queue_init_growable(0, 0, QUEUE_MODE_INLINE, NULL));
+    CU_ASSERT(NULL == queue_init_growable(
+                          CAPACITY, CAPACITY - 1, QUEUE_MODE_INLINE, NULL));
+
+    growable = queue_init_growable(
+        CAPACITY, CAPACITY * 4, QUEUE_MODE_INLINE, NULL);
+    CU_ASSERT_FATAL(NULL != growable);
+
+    for (int idx = 0; idx < (CAPACITY * 8); idx++)
+    {
+        burst[idx] = idx;
+    }
+
+    // Offset head so the first growth has to unwrap the ring
+    queue_enqueue(growable, &burst[0]);
+    queue_enqueue(growable, &burst[0]);
+    queue_dequeue_data(growable);
+    queue_dequeue_data(growable);
+
+    // A burst past the initial capacity is absorbed up to the high-water mark
+    for (int idx = 0; idx < (CAPACITY * 4); idx++)
+    {
+        CU_ASSERT(0 == queue_enqueue(growable, &burst[idx]));
+    }
+    CU_ASSERT((CAPACITY * 4) == growable->capacity);
+    CU_ASSERT(0 == queue_fullcheck(growable));
+    CU_ASSERT(0 != queue_enqueue(growable, &burst[0]));
+
+    // FIFO order survives every resize, and the ring shrinks as it drains
+    for (int idx = 0; idx < (CAPACITY * 4); idx++)
+    {
+        item = queue_dequeue_data(growable);
+        CU_ASSERT_FATAL(NULL != item);
+        CU_ASSERT(idx == *item);
+    }
+    CU_ASSERT(CAPACITY == growable->capacity);
+    CU_ASSERT(0 == growable->currentsz);
+
+    CU_ASSERT(0 == queue_destroy(&growable));
+
+    // Without a high-water mark the queue keeps growing, in node mode too
+    growable = queue_init_growable(CAPACITY, 0, QUEUE_MODE_NODE, NULL);
+    CU_ASSERT_FATAL(NULL != growable);
+
+    for (int idx = 0; idx < (CAPACITY * 8); idx++)
+    {
+        CU_ASSERT(0 == queue_enqueue(growable, &burst[idx]));
+    }
+    CU_ASSERT((CAPACITY * 8) <= growable->capacity);
+    CU_ASSERT(-1 == queue_fullcheck(growable));
+
+    // Clearing releases the burst memory
+    CU_ASSERT(0 == queue_clear(growable));
+    CU_ASSERT(CAPACITY == growable->capacity);
+
+    CU_ASSERT(0 == queue_destroy(&growable));
+}
+
+void test_queue_batch()
+{
+    queue_t * batch_queue = NULL;
+    void *    in[CAPACITY + 1];
+    void *    out[CAPACITY];
+
+    for (int idx = 0; idx < (CAPACITY + 1); idx++)
+    {
+        in[idx] = &data[idx % CAPACITY];
+    }
+
+    for (int mode = QUEUE_MODE_NODE; mode <= QUEUE_MODE_INLINE; mode++)
+    {
+        batch_queue = (QUEUE_MODE_INLINE == mode)
+                          ? queue_init_inline(CAPACITY, NULL)
+                          : queue_init(CAPACITY, NULL);
+        CU_ASSERT_FATAL(NULL != batch_queue);
+
+        // Invalid arguments and oversized batches are rejected untouched
+        CU_ASSERT(0 != queue_enqueue_many(NULL, in, 1));
+        CU_ASSERT(0 != queue_enqueue_many(batch_queue, NULL, 1));
+        CU_ASSERT(0 != queue_enqueue_many(batch_queue, in, CAPACITY + 1));
+        CU_ASSERT(0 == batch_queue->currentsz);
+        CU_ASSERT(0 == queue_dequeue_many(batch_queue, out, CAPACITY));
+
+        // Offset head so both batches wrap around the end of the ring
+        CU_ASSERT(0 == queue_enqueue_many(batch_queue, in, 3));
+        CU_ASSERT(2 == queue_dequeue_many(batch_queue, out, 2));
+        CU_ASSERT(in[0] == out[0]);
+        CU_ASSERT(in[1] == out[1]);
+
+        CU_ASSERT(0 == queue_enqueue_many(batch_queue, &in[3], 2));
+        CU_ASSERT(0 == queue_enqueue_many(batch_queue, in, 2));
+        CU_ASSERT(0 != queue_enqueue_many(batch_queue, in, 1));
+
+        // Asking for more than is stored returns what is there, in order
+        CU_ASSERT(CAPACITY == queue_dequeue_many(batch_queue, out, CAPACITY));
+        CU_ASSERT(in[2] == out[0]);
+        CU_ASSERT(in[3] == out[1]);
+        CU_ASSERT(in[4] == out[2]);
+        CU_ASSERT(in[0] == out[3]);
+        CU_ASSERT(in[1] == out[4]);
+        CU_ASSERT(0 == batch_queue->currentsz);
+
+        CU_ASSERT(0 == queue_destroy(&batch_queue));
+    }
+
+    // A growable queue resizes once to take a whole batch
+    batch_queue = queue_init_growable(2, 0, QUEUE_MODE_INLINE, NULL);
+    CU_ASSERT_FATAL(NULL != batch_queue);
+    CU_ASSERT(0 == queue_enqueue_many(batch_queue, in, CAPACITY));
+    CU_ASSERT(CAPACITY <= batch_queue->capacity);
+    CU_ASSERT(CAPACITY == queue_dequeue_many(batch_queue, out, CAPACITY));
+    CU_ASSERT(in[4] == out[4]);
+    CU_ASSERT(0 == queue_destroy(&batch_queue));
+}
+
+void test_queue_node_slab()
+{
+    slab_t *       node_slab  = slab_create(sizeof(queue_node_t), 0);
+    queue_t *      slab_queue = queue_init(CAPACITY, NULL);
+    queue_t *      inline_q   = queue_init_inline(CAPACITY, NULL);
+    queue_node_t * node       = NULL;
+
+    CU_ASSERT_FATAL(NULL != node_slab);
+    CU_ASSERT_FATAL(NULL != slab_queue);
+    CU_ASSERT_FATAL(NULL != inline_q);
+
+    // Only empty node mode queues take a slab
+    CU_ASSERT(0 != queue_set_node_slab(NULL, node_slab));
+    CU_ASSERT(0 != queue_set_node_slab(inline_q, node_slab));
+    CU_ASSERT(0 == queue_enqueue(slab_queue, &data[0]));
+    CU_ASSERT(0 != queue_set_node_slab(slab_queue, node_slab));
+    CU_ASSERT(&data[0] == queue_dequeue_data(slab_queue));
+    CU_ASSERT(0 == queue_set_node_slab(slab_queue, node_slab));
+
+    // Nodes come from the slab and go back through queue_node_free()
+    for (int idx = 0; idx < CAPACITY; idx++)
+    {
+        CU_ASSERT(0 == queue_enqueue(slab_queue, &data[idx]));
+    }
+    node = queue_dequeue(slab_queue);
+    CU_ASSERT_FATAL(NULL != node);
+    CU_ASSERT(&data[0] == node->data);
+    queue_node_free(slab_queue, node);
+
+    // The freed node went back to the slab for reuse
+    CU_ASSERT(node == slab_alloc(node_slab));
+    slab_free(node_slab, node);
+    CU_ASSERT(&data[1] == queue_dequeue_data(slab_queue));
+
+    // Destroying the queue returns the nodes it still holds to the slab
+    CU_ASSERT(0 == queue_destroy(&slab_queue));
+    CU_ASSERT(0 == queue_destroy(&inline_q));
+    CU_ASSERT(0 == slab_destroy(&node_slab));
+}
+
 int main(void)
 {
     CU_TestInfo suite1_tests[] = {
@@ -194,11 +468,24 @@ int main(void)
 
         { "Testing queue_dequeue():", test_queue_dequeue },
 
+        { "Testing queue wraparound:", test_queue_wraparound },
+
         { "Testing queue_peek():", test_queue_peek },
 
         { "Testing queue_clear():", test_queue_clear },
 
-        { "Testing queue_destroy():", test_queue_destroy }, CU_TEST_INFO_NULL
+        { "Testing queue_destroy():", test_queue_destroy },
+
+        { "Testing queue_init_inline():", test_queue_inline },
+
+        { "Testing queue_dequeue_data():", test_queue_dequeue_data_node_mode },
+
+        { "Testing queue_init_growable():", test_queue_growable },
+
+        { "Testing queue_enqueue_many()/dequeue_many():", test_queue_batch },
+
+        { "Testing queue_set_node_slab():", test_queue_node_slab },
+        CU_TEST_INFO_NULL
     };
 
     CU_SuiteInfo suites[] = {
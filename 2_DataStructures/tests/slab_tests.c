@@ -0,0 +1,265 @@
+#include "slab.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OBJECT_SIZE 24
+#define BATCH       4
+#define OBJECTS     64
+#define THREADS     4
+#define ROUNDS      20000
+#define RING_SIZE   1024
+#define SLABS       2048 // Past PTHREAD_KEYS_MAX, 1024 with glibc
+
+// The allocator to be used by the single threaded tests
+slab_t * slab = NULL;
+
+// Shared state for the concurrent test: producers allocate, consumers free
+slab_t *        shared_slab = NULL;
+_Atomic(void *) handoff[RING_SIZE];
+atomic_int      corrupt;
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void test_slab_create()
+{
+    // Should catch invalid arguments
+    CU_ASSERT(NULL == slab_create(0, BATCH));
+    CU_ASSERT(0 == slab_object_size(NULL));
+
+    slab = slab_create(OBJECT_SIZE, BATCH);
+    CU_ASSERT_FATAL(NULL != slab);
+
+    // Objects are rounded up so every one stays aligned for any type
+    CU_ASSERT(OBJECT_SIZE <= slab_object_size(slab));
+    CU_ASSERT(0 == (slab_object_size(slab) % alignof(max_align_t)));
+}
+
+void test_slab_alloc_free()
+{
+    void * objects[OBJECTS];
+    int    overlaps = 0;
+
+    CU_ASSERT(NULL == slab_alloc(NULL));
+
+    // Allocate across several batches and make sure no two objects overlap
+    for (int idx = 0; idx < OBJECTS; idx++)
+    {
+        objects[idx] = slab_alloc(slab);
+        CU_ASSERT_FATAL(NULL != objects[idx]);
+        CU_ASSERT(0 == ((uintptr_t)objects[idx] % alignof(max_align_t)));
+        memset(objects[idx], idx, OBJECT_SIZE);
+    }
+
+    for (int idx = 0; idx < OBJECTS; idx++)
+    {
+        for (int byte = 0; byte < OBJECT_SIZE; byte++)
+        {
+            if (idx != ((unsigned char *)objects[idx])[byte])
+            {
+                overlaps++;
+            }
+        }
+    }
+    CU_ASSERT(0 == overlaps);
+
+    // Freed objects are handed out again, newest first
+    for (int idx = 0; idx < OBJECTS; idx++)
+    {
+        slab_free(slab, objects[idx]);
+    }
+    slab_free(slab, NULL);
+
+    CU_ASSERT(objects[OBJECTS - 1] == slab_alloc(slab));
+}
+
+void * slab_producer(void * arg)
+{
+    intptr_t offset = (intptr_t)arg;
+    void *   object = NULL;
+    void *   empty  = NULL;
+    size_t   slot   = 0;
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        object = slab_alloc(shared_slab);
+        if (NULL == object)
+        {
+            atomic_fetch_add(&corrupt, 1);
+            continue;
+        }
+        memset(object, 0xA5, OBJECT_SIZE);
+
+        // Hand the object to whichever consumer finds it first
+        slot = ((size_t)offset + (size_t)round) % RING_SIZE;
+        for (;;)
+        {
+            empty = NULL;
+            if (atomic_compare_exchange_weak(&handoff[slot], &empty, object))
+            {
+                break;
+            }
+            slot = (slot + 1) % RING_SIZE;
+        }
+    }
+
+    return NULL;
+}
+
+void * slab_consumer(void * arg)
+{
+    intptr_t offset = (intptr_t)arg;
+    int      freed  = 0;
+    size_t   slot   = (size_t)offset;
+    void *   object = NULL;
+
+    while (freed < ROUNDS)
+    {
+        object = atomic_exchange(&handoff[slot], NULL);
+        slot   = (slot + 1) % RING_SIZE;
+        if (NULL == object)
+        {
+            if (0 == slot)
+            {
+                sched_yield();
+            }
+            continue;
+        }
+
+        if (0xA5 != ((unsigned char *)object)[OBJECT_SIZE - 1])
+        {
+            atomic_fetch_add(&corrupt, 1);
+        }
+        slab_free(shared_slab, object);
+        freed++;
+    }
+
+    return NULL;
+}
+
+void test_slab_cross_thread()
+{
+    pthread_t producers[THREADS];
+    pthread_t consumers[THREADS];
+
+    // Every object is freed on a different thread than it came from, so
+    // they can only come back to the producers through the depot
+    shared_slab = slab_create(OBJECT_SIZE, BATCH);
+    CU_ASSERT_FATAL(NULL != shared_slab);
+    atomic_store(&corrupt, 0);
+
+    for (intptr_t idx = 0; idx < THREADS; idx++)
+    {
+        pthread_create(&producers[idx],
+                       NULL,
+                       slab_producer,
+                       (void *)(idx * (RING_SIZE / THREADS)));
+        pthread_create(&consumers[idx],
+                       NULL,
+                       slab_consumer,
+                       (void *)(idx * (RING_SIZE / THREADS)));
+    }
+
+    for (int idx = 0; idx < THREADS; idx++)
+    {
+        pthread_join(producers[idx], NULL);
+        pthread_join(consumers[idx], NULL);
+    }
+
+    CU_ASSERT(0 == atomic_load(&corrupt));
+    CU_ASSERT(0 == slab_destroy(&shared_slab));
+}
+
+void test_slab_many()
+{
+    slab_t * slabs[SLABS] = { NULL };
+    void *   object       = NULL;
+
+    // More live allocators than there are thread-specific keys, and again
+    // once their addresses are free for reuse
+    for (int round = 0; round < 2; round++)
+    {
+        for (int idx = 0; idx < SLABS; idx++)
+        {
+            slabs[idx] = slab_create(OBJECT_SIZE, BATCH);
+            CU_ASSERT_FATAL(NULL != slabs[idx]);
+            object = slab_alloc(slabs[idx]);
+            CU_ASSERT_FATAL(NULL != object);
+            slab_free(slabs[idx], object);
+        }
+
+        for (int idx = 0; idx < SLABS; idx++)
+        {
+            CU_ASSERT(0 == slab_destroy(&slabs[idx]));
+        }
+    }
+}
+
+void test_slab_destroy()
+{
+    slab_t * invalid_slab = NULL;
+
+    CU_ASSERT(0 != slab_destroy(&invalid_slab));
+
+    // Objects still allocated are released along with the slab
+    CU_ASSERT(NULL != slab_alloc(slab));
+    CU_ASSERT(0 == slab_destroy(&slab));
+    CU_ASSERT(NULL == slab);
+    CU_ASSERT(0 != slab_destroy(&slab));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing slab_create():", test_slab_create },
+
+        { "Testing slab_alloc()/slab_free():", test_slab_alloc_free },
+
+        { "Testing cross-thread frees:", test_slab_cross_thread },
+
+        { "Testing many allocators:", test_slab_many },
+
+        { "Testing slab_destroy():", test_slab_destroy },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
@@ -0,0 +1,224 @@
+#include "spsc_ring.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#define CAPACITY    5
+#define ROUNDED     8
+#define BATCH       3
+#define TOTAL_ITEMS 200000
+
+// The ring to be used by the single threaded tests
+spsc_ring_t * ring = NULL;
+
+// NOLINTNEXTLINE
+int data[ROUNDED] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+// Shared state for the concurrent test
+spsc_ring_t * shared_ring = NULL;
+size_t        items[TOTAL_ITEMS];
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void test_spsc_init()
+{
+    // Zero capacity, and capacity that rounds past 2^31, is rejected
+    CU_ASSERT(NULL == spsc_ring_init(0));
+    CU_ASSERT(NULL == spsc_ring_init(UINT32_MAX));
+
+    // Capacity is rounded up to the next power of two
+    ring = spsc_ring_init(CAPACITY);
+    CU_ASSERT_FATAL(NULL != ring);
+    CU_ASSERT(ROUNDED == spsc_ring_capacity(ring));
+    CU_ASSERT(0 == spsc_ring_size(ring));
+}
+
+void test_spsc_push_pop()
+{
+    // Should catch invalid arguments
+    CU_ASSERT(0 != spsc_ring_push(NULL, &data[0]));
+    CU_ASSERT(0 != spsc_ring_push(ring, NULL));
+    CU_ASSERT(NULL == spsc_ring_pop(NULL));
+
+    // Empty ring returns NULL
+    CU_ASSERT(NULL == spsc_ring_pop(ring));
+
+    // Fill to capacity, then one more should fail
+    for (int idx = 0; idx < ROUNDED; idx++)
+    {
+        CU_ASSERT(0 == spsc_ring_push(ring, &data[idx]));
+    }
+    CU_ASSERT(ROUNDED == spsc_ring_size(ring));
+    CU_ASSERT(0 != spsc_ring_push(ring, &data[0]));
+
+    // Items come back in FIFO order
+    for (int idx = 0; idx < ROUNDED; idx++)
+    {
+        CU_ASSERT(&data[idx] == spsc_ring_pop(ring));
+    }
+    CU_ASSERT(NULL == spsc_ring_pop(ring));
+    CU_ASSERT(0 == spsc_ring_size(ring));
+}
+
+void test_spsc_batch()
+{
+    void * in[ROUNDED + BATCH];
+    void * out[ROUNDED + BATCH];
+    size_t count = 0;
+
+    for (int idx = 0; idx < (ROUNDED + BATCH); idx++)
+    {
+        in[idx] = &data[idx % ROUNDED];
+    }
+
+    // Pushing more than fits stores only what fits
+    count = spsc_ring_push_batch(ring, in, ROUNDED + BATCH);
+    CU_ASSERT(ROUNDED == count);
+    CU_ASSERT(0 == spsc_ring_push_batch(ring, in, 1));
+
+    // Partial pop, then top up so the batch wraps around the array
+    count = spsc_ring_pop_batch(ring, out, BATCH);
+    CU_ASSERT_FATAL(BATCH == count);
+    for (int idx = 0; idx < BATCH; idx++)
+    {
+        CU_ASSERT(in[idx] == out[idx]);
+    }
+
+    count = spsc_ring_push_batch(ring, &in[ROUNDED], BATCH);
+    CU_ASSERT(BATCH == count);
+
+    // Draining returns every remaining item in order
+    count = spsc_ring_pop_batch(ring, out, ROUNDED + BATCH);
+    CU_ASSERT_FATAL(ROUNDED == count);
+    for (int idx = 0; idx < ROUNDED; idx++)
+    {
+        CU_ASSERT(in[idx + BATCH] == out[idx]);
+    }
+
+    CU_ASSERT(0 == spsc_ring_pop_batch(ring, out, ROUNDED));
+    CU_ASSERT(0 == spsc_ring_pop_batch(NULL, out, ROUNDED));
+    CU_ASSERT(0 == spsc_ring_push_batch(ring, NULL, ROUNDED));
+}
+
+void * spsc_producer(void * arg)
+{
+    size_t idx = 0;
+
+    (void)arg;
+    while (idx < TOTAL_ITEMS)
+    {
+        if (0 == spsc_ring_push(shared_ring, &items[idx]))
+        {
+            idx++;
+            continue;
+        }
+
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+void test_spsc_concurrent()
+{
+    pthread_t producer;
+    size_t *  item   = NULL;
+    size_t    next   = 0;
+    int       errors = 0;
+
+    // A small ring forces the producer to wait on the consumer often
+    shared_ring = spsc_ring_init(16);
+    CU_ASSERT_FATAL(NULL != shared_ring);
+
+    for (size_t idx = 0; idx < TOTAL_ITEMS; idx++)
+    {
+        items[idx] = idx;
+    }
+
+    pthread_create(&producer, NULL, spsc_producer, NULL);
+
+    // Items must arrive exactly once and strictly in order
+    while (next < TOTAL_ITEMS)
+    {
+        item = spsc_ring_pop(shared_ring);
+        if (NULL == item)
+        {
+            sched_yield();
+            continue;
+        }
+
+        if (next != *item)
+        {
+            errors++;
+        }
+        next++;
+    }
+
+    pthread_join(producer, NULL);
+
+    CU_ASSERT(0 == errors);
+    CU_ASSERT(NULL == spsc_ring_pop(shared_ring));
+    CU_ASSERT(0 == spsc_ring_destroy(&shared_ring));
+}
+
+void test_spsc_destroy()
+{
+    spsc_ring_t * invalid_ring = NULL;
+
+    CU_ASSERT(0 != spsc_ring_destroy(&invalid_ring));
+    CU_ASSERT(0 == spsc_ring_destroy(&ring));
+    CU_ASSERT(NULL == ring);
+    CU_ASSERT(0 != spsc_ring_destroy(&ring));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing spsc_ring_init():", test_spsc_init },
+
+        { "Testing push/pop:", test_spsc_push_pop },
+
+        { "Testing batch push/pop:", test_spsc_batch },
+
+        { "Testing concurrent producer/consumer:", test_spsc_concurrent },
+
+        { "Testing spsc_ring_destroy():", test_spsc_destroy },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
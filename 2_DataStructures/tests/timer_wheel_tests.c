@@ -0,0 +1,310 @@
+#include "timer_wheel.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define COUNT    100000
+#define SMALL    8
+#define RANGE    (1ULL << 20)
+#define MAX_STEP 5000
+#define PERIOD   7
+#define PERIODS  1000
+#define FAR_TICK (1ULL << 40)
+
+/**
+ * @brief a timer of the tests, recording when it expired
+ *
+ * @param expiry the tick the timer was added for
+ * @param fired the tick it expired on
+ * @param count the number of times it expired
+ */
+typedef struct test_timer
+{
+    uint64_t expiry;
+    uint64_t fired;
+    int      count;
+} test_timer_t;
+
+// NOLINTNEXTLINE
+test_timer_t timers[COUNT];
+
+// The tick of the last expiry, expiries have to come in order
+uint64_t last_tick = 0;
+bool     in_order  = true;
+
+int init_suite1(void)
+{
+    srand(1);
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+uint64_t record_expiry(void * data, uint64_t tick, void * ctx)
+{
+    test_timer_t * timer = data;
+
+    (void)ctx;
+    in_order     = in_order && (last_tick <= tick);
+    last_tick    = tick;
+    timer->fired = tick;
+    timer->count++;
+
+    return TIMER_WHEEL_NEVER;
+}
+
+uint64_t rearm_expiry(void * data, uint64_t tick, void * ctx)
+{
+    test_timer_t * timer = data;
+
+    (void)ctx;
+    timer->count++;
+
+    return (PERIODS == timer->count) ? TIMER_WHEEL_NEVER : tick + PERIOD;
+}
+
+uint64_t add_expiry(void * data, uint64_t tick, void * ctx)
+{
+    CU_ASSERT(0 == timer_wheel_add((timer_wheel_t *)ctx, tick, data, NULL));
+
+    return TIMER_WHEEL_NEVER;
+}
+
+void count_free(void * data)
+{
+    ((test_timer_t *)data)->count++;
+}
+
+void test_timer_wheel_create()
+{
+    timer_wheel_t * wheel = NULL;
+    uint64_t        tick  = 0;
+
+    wheel = timer_wheel_create(0, NULL);
+    CU_ASSERT_FATAL(NULL != wheel);
+    CU_ASSERT(0 == timer_wheel_size(wheel));
+    CU_ASSERT(0 == timer_wheel_now(wheel));
+    CU_ASSERT(0 != timer_wheel_next_tick(wheel, &tick));
+
+    // Moving an empty wheel only moves the current tick
+    CU_ASSERT(0 == timer_wheel_advance(wheel, 1000, record_expiry, NULL));
+    CU_ASSERT(1001 == timer_wheel_now(wheel));
+
+    // Should catch invalid arguments
+    CU_ASSERT(0 != timer_wheel_add(NULL, 0, NULL, NULL));
+    CU_ASSERT(0 != timer_wheel_cancel(NULL, 0, NULL));
+    CU_ASSERT(0 == timer_wheel_advance(NULL, 0, record_expiry, NULL));
+    CU_ASSERT(0 == timer_wheel_advance(wheel, 0, NULL, NULL));
+    CU_ASSERT(0 != timer_wheel_next_tick(NULL, &tick));
+    CU_ASSERT(0 != timer_wheel_next_tick(wheel, NULL));
+    CU_ASSERT(0 != timer_wheel_destroy(NULL));
+
+    CU_ASSERT(0 == timer_wheel_destroy(&wheel));
+    CU_ASSERT(NULL == wheel);
+}
+
+void test_timer_wheel_expiry()
+{
+    timer_wheel_t * wheel   = NULL;
+    uint64_t        ticks[] = { 0,    1,    63,     64,      65,
+                                4095, 4096, 300000, FAR_TICK };
+    size_t          count   = sizeof(ticks) / sizeof(ticks[0]);
+    uint64_t        next    = 0;
+    bool            on_time = true;
+
+    wheel = timer_wheel_create(SMALL, NULL);
+    CU_ASSERT_FATAL(NULL != wheel);
+
+    // Timers on the edges of every level, and one beyond the span
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        timers[idx] = (test_timer_t){ ticks[idx], 0, 0 };
+        CU_ASSERT(0 == timer_wheel_add(wheel, ticks[idx], &timers[idx], NULL));
+    }
+    CU_ASSERT(count == timer_wheel_size(wheel));
+
+    // The next tick never runs past the earliest pending expiry
+    last_tick = 0;
+    in_order  = true;
+    while (0 == timer_wheel_next_tick(wheel, &next))
+    {
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            on_time = on_time && ((0 != timers[idx].count) ||
+                                  (next <= timers[idx].expiry));
+        }
+        timer_wheel_advance(wheel, next, record_expiry, NULL);
+    }
+    CU_ASSERT(on_time);
+    CU_ASSERT(in_order);
+
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        CU_ASSERT(1 == timers[idx].count);
+        CU_ASSERT(timers[idx].expiry == timers[idx].fired);
+    }
+    CU_ASSERT(0 == timer_wheel_size(wheel));
+
+    // A tick the wheel has moved past expires on the next one it reaches
+    timers[0] = (test_timer_t){ 0, 0, 0 };
+    CU_ASSERT(0 == timer_wheel_add(wheel, 5, &timers[0], NULL));
+    CU_ASSERT(0 == timer_wheel_advance(wheel, FAR_TICK, record_expiry, NULL));
+    CU_ASSERT(1 == timer_wheel_advance(
+                       wheel, FAR_TICK + 1, record_expiry, NULL));
+    CU_ASSERT((FAR_TICK + 1) == timers[0].fired);
+    CU_ASSERT(0 == timer_wheel_destroy(&wheel));
+
+    // A wheel stopped on the first tick of a pending slot still cascades it
+    // when a sooner timer is added after it stopped
+    wheel = timer_wheel_create(SMALL, NULL);
+    CU_ASSERT_FATAL(NULL != wheel);
+    timers[0] = (test_timer_t){ 100, 0, 0 };
+    timers[1] = (test_timer_t){ 70, 0, 0 };
+    CU_ASSERT(0 == timer_wheel_advance(wheel, 62, record_expiry, NULL));
+    CU_ASSERT(0 == timer_wheel_add(wheel, 100, &timers[0], NULL));
+    CU_ASSERT(0 == timer_wheel_advance(wheel, 63, record_expiry, NULL));
+    CU_ASSERT(0 == timer_wheel_add(wheel, 70, &timers[1], NULL));
+    CU_ASSERT(2 == timer_wheel_advance(wheel, 200, record_expiry, NULL));
+    CU_ASSERT(100 == timers[0].fired);
+    CU_ASSERT(70 == timers[1].fired);
+
+    CU_ASSERT(0 == timer_wheel_destroy(&wheel));
+}
+
+void test_timer_wheel_many()
+{
+    timer_wheel_t * wheel     = NULL;
+    timer_handle_t  handle    = TIMER_INVALID_HANDLE;
+    uint64_t        now       = 0;
+    size_t          expired   = 0;
+    size_t          cancelled = 0;
+    bool            on_time   = true;
+
+    wheel = timer_wheel_create(0, NULL);
+    CU_ASSERT_FATAL(NULL != wheel);
+
+    // Every third timer is cancelled before it expires
+    for (size_t idx = 0; idx < COUNT; idx++)
+    {
+        timers[idx] = (test_timer_t){ (uint64_t)rand() % RANGE, 0, 0 };
+        CU_ASSERT(0 == timer_wheel_add(
+                           wheel, timers[idx].expiry, &timers[idx], &handle));
+        if (0 == (idx % 3))
+        {
+            CU_ASSERT(0 == timer_wheel_cancel(wheel, handle, NULL));
+            cancelled++;
+        }
+    }
+    CU_ASSERT((COUNT - cancelled) == timer_wheel_size(wheel));
+
+    // Uneven steps land in the middle of slots of every level
+    last_tick = 0;
+    in_order  = true;
+    while (now < RANGE)
+    {
+        now += (uint64_t)rand() % MAX_STEP;
+        expired += timer_wheel_advance(wheel, now, record_expiry, NULL);
+    }
+    CU_ASSERT(in_order);
+    CU_ASSERT((COUNT - cancelled) == expired);
+    CU_ASSERT(0 == timer_wheel_size(wheel));
+
+    for (size_t idx = 0; idx < COUNT; idx++)
+    {
+        on_time = on_time &&
+                  (((0 == (idx % 3)) && (0 == timers[idx].count)) ||
+                   ((1 == timers[idx].count) &&
+                    (timers[idx].expiry == timers[idx].fired)));
+    }
+    CU_ASSERT(on_time);
+
+    CU_ASSERT(0 == timer_wheel_destroy(&wheel));
+}
+
+void test_timer_wheel_rearm()
+{
+    timer_wheel_t * wheel  = NULL;
+    timer_handle_t  handle = TIMER_INVALID_HANDLE;
+    timer_handle_t  stale  = TIMER_INVALID_HANDLE;
+    void *          data   = NULL;
+
+    wheel = timer_wheel_create(SMALL, count_free);
+    CU_ASSERT_FATAL(NULL != wheel);
+
+    // A timer re-added by its callback keeps its handle until it stops
+    timers[0] = (test_timer_t){ 0, 0, 0 };
+    CU_ASSERT(0 == timer_wheel_add(wheel, PERIOD, &timers[0], &handle));
+    CU_ASSERT((PERIODS - 1) == timer_wheel_advance(
+                                   wheel, PERIOD * (PERIODS - 1),
+                                   rearm_expiry, NULL));
+    CU_ASSERT(0 == timer_wheel_cancel(wheel, handle, &data));
+    CU_ASSERT(&timers[0] == data);
+    CU_ASSERT(0 != timer_wheel_cancel(wheel, handle, &data));
+
+    // A handle to a released timer never matches the timer reusing its
+    // entry
+    stale = handle;
+    CU_ASSERT(0 == timer_wheel_add(wheel, 1, &timers[1], &handle));
+    CU_ASSERT(stale != handle);
+    CU_ASSERT(0 != timer_wheel_cancel(wheel, stale, NULL));
+    CU_ASSERT(0 != timer_wheel_cancel(wheel, TIMER_INVALID_HANDLE, NULL));
+    CU_ASSERT(0 == timer_wheel_cancel(wheel, handle, NULL));
+
+    // Callbacks may add timers, which expire on later ticks
+    timers[1].count = 0;
+    CU_ASSERT(0 == timer_wheel_add(
+                       wheel, timer_wheel_now(wheel), &timers[1], NULL));
+    CU_ASSERT(1 == timer_wheel_advance(
+                       wheel, timer_wheel_now(wheel), add_expiry, wheel));
+    CU_ASSERT(1 == timer_wheel_size(wheel));
+
+    // Timers still pending are released with the customfree
+    CU_ASSERT(0 == timer_wheel_add(wheel, FAR_TICK, &timers[1], NULL));
+    CU_ASSERT(0 == timer_wheel_destroy(&wheel));
+    CU_ASSERT(2 == timers[1].count);
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing timer_wheel_create():", test_timer_wheel_create },
+
+        { "Testing expiry on every level:", test_timer_wheel_expiry },
+
+        { "Testing many timers:", test_timer_wheel_many },
+
+        { "Testing re-added and cancelled timers:", test_timer_wheel_rearm },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
@@ -0,0 +1,256 @@
+#include "ws_deque.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define CAPACITY    4
+#define ITEMS       8
+#define THIEVES     6
+#define BURST       64
+#define TOTAL_ITEMS 200000
+
+// The deque to be used by the single threaded tests
+ws_deque_t * deque = NULL;
+
+// NOLINTNEXTLINE
+int data[ITEMS] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+// Shared state for the stress test
+ws_deque_t * shared_deque = NULL;
+size_t       items[TOTAL_ITEMS];
+atomic_int   taken[TOTAL_ITEMS];
+atomic_bool  owner_done;
+atomic_int   order_errors;
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void test_ws_deque_init()
+{
+    // Zero capacity is rejected
+    CU_ASSERT(NULL == ws_deque_init(0));
+
+    deque = ws_deque_init(CAPACITY);
+    CU_ASSERT_FATAL(NULL != deque);
+    CU_ASSERT(0 == ws_deque_size(deque));
+}
+
+void test_ws_deque_push_pop()
+{
+    // Should catch invalid arguments
+    CU_ASSERT(0 != ws_deque_push(NULL, &data[0]));
+    CU_ASSERT(0 != ws_deque_push(deque, NULL));
+    CU_ASSERT(NULL == ws_deque_pop(NULL));
+    CU_ASSERT(NULL == ws_deque_steal(NULL));
+
+    // Empty deque returns NULL from both ends
+    CU_ASSERT(NULL == ws_deque_pop(deque));
+    CU_ASSERT(NULL == ws_deque_steal(deque));
+
+    // Push past the initial capacity so the array has to grow
+    for (int idx = 0; idx < ITEMS; idx++)
+    {
+        CU_ASSERT(0 == ws_deque_push(deque, &data[idx]));
+    }
+    CU_ASSERT(ITEMS == ws_deque_size(deque));
+
+    // The owner sees LIFO order
+    for (int idx = ITEMS - 1; idx >= 0; idx--)
+    {
+        CU_ASSERT(&data[idx] == ws_deque_pop(deque));
+    }
+    CU_ASSERT(NULL == ws_deque_pop(deque));
+    CU_ASSERT(0 == ws_deque_size(deque));
+}
+
+void test_ws_deque_steal()
+{
+    for (int idx = 0; idx < ITEMS; idx++)
+    {
+        CU_ASSERT(0 == ws_deque_push(deque, &data[idx]));
+    }
+
+    // Thieves see FIFO order while the owner keeps taking the newest
+    CU_ASSERT(&data[0] == ws_deque_steal(deque));
+    CU_ASSERT(&data[1] == ws_deque_steal(deque));
+    CU_ASSERT(&data[ITEMS - 1] == ws_deque_pop(deque));
+    CU_ASSERT(&data[2] == ws_deque_steal(deque));
+    CU_ASSERT((ITEMS - 4) == ws_deque_size(deque));
+
+    // Both ends meet on the last item exactly once
+    for (int idx = 3; idx < (ITEMS - 2); idx++)
+    {
+        CU_ASSERT(&data[idx] == ws_deque_steal(deque));
+    }
+    CU_ASSERT(&data[ITEMS - 2] == ws_deque_pop(deque));
+    CU_ASSERT(NULL == ws_deque_steal(deque));
+    CU_ASSERT(NULL == ws_deque_pop(deque));
+}
+
+void * ws_deque_thief(void * arg)
+{
+    size_t * item     = NULL;
+    size_t   previous = 0;
+    bool     first    = true;
+
+    (void)arg;
+    for (;;)
+    {
+        item = ws_deque_steal(shared_deque);
+        if (NULL == item)
+        {
+            if (atomic_load(&owner_done) && (0 == ws_deque_size(shared_deque)))
+            {
+                break;
+            }
+
+            sched_yield();
+            continue;
+        }
+
+        // Steals come off the top, so one thief sees values only increase
+        if ((!first) && (*item <= previous))
+        {
+            atomic_fetch_add(&order_errors, 1);
+        }
+        first    = false;
+        previous = *item;
+        atomic_fetch_add(&taken[*item], 1);
+    }
+
+    return NULL;
+}
+
+void test_ws_deque_stress()
+{
+    pthread_t thieves[THIEVES];
+    size_t *  item   = NULL;
+    size_t    next   = 0;
+    int       errors = 0;
+
+    // A tiny initial array makes the owner grow it while thieves read it
+    shared_deque = ws_deque_init(2);
+    CU_ASSERT_FATAL(NULL != shared_deque);
+
+    atomic_store(&owner_done, false);
+    atomic_store(&order_errors, 0);
+    for (size_t idx = 0; idx < TOTAL_ITEMS; idx++)
+    {
+        items[idx] = idx;
+        atomic_init(&taken[idx], 0);
+    }
+
+    for (int idx = 0; idx < THIEVES; idx++)
+    {
+        pthread_create(&thieves[idx], NULL, ws_deque_thief, NULL);
+    }
+
+    // The owner pushes bursts and pops part of each back, racing the
+    // thieves for the last item whenever the deque runs low
+    while (next < TOTAL_ITEMS)
+    {
+        for (int idx = 0; (idx < BURST) && (next < TOTAL_ITEMS); idx++)
+        {
+            CU_ASSERT(0 == ws_deque_push(shared_deque, &items[next]));
+            next++;
+        }
+
+        for (int idx = 0; idx < (BURST / 2); idx++)
+        {
+            item = ws_deque_pop(shared_deque);
+            if (NULL == item)
+            {
+                break;
+            }
+            atomic_fetch_add(&taken[*item], 1);
+        }
+    }
+
+    while (NULL != (item = ws_deque_pop(shared_deque)))
+    {
+        atomic_fetch_add(&taken[*item], 1);
+    }
+    atomic_store(&owner_done, true);
+
+    for (int idx = 0; idx < THIEVES; idx++)
+    {
+        pthread_join(thieves[idx], NULL);
+    }
+
+    // Every item was taken exactly once, by the owner or by one thief
+    for (size_t idx = 0; idx < TOTAL_ITEMS; idx++)
+    {
+        if (1 != atomic_load(&taken[idx]))
+        {
+            errors++;
+        }
+    }
+
+    CU_ASSERT(0 == errors);
+    CU_ASSERT(0 == atomic_load(&order_errors));
+    CU_ASSERT(0 == ws_deque_size(shared_deque));
+    CU_ASSERT(0 == ws_deque_destroy(&shared_deque));
+}
+
+void test_ws_deque_destroy()
+{
+    ws_deque_t * invalid_deque = NULL;
+
+    CU_ASSERT(0 != ws_deque_destroy(&invalid_deque));
+    CU_ASSERT(0 == ws_deque_destroy(&deque));
+    CU_ASSERT(NULL == deque);
+    CU_ASSERT(0 != ws_deque_destroy(&deque));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing ws_deque_init():", test_ws_deque_init },
+
+        { "Testing owner push/pop:", test_ws_deque_push_pop },
+
+        { "Testing ws_deque_steal():", test_ws_deque_steal },
+
+        { "Testing concurrent owner and thieves:", test_ws_deque_stress },
+
+        { "Testing ws_deque_destroy():", test_ws_deque_destroy },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
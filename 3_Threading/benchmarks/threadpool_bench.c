@@ -0,0 +1,232 @@
+/**
+ * @file threadpool_bench.c
+ *
+ * @brief Measures the latency of microsecond-scale jobs with threads that
+ * park as soon as the queue is empty, against threads that spin and yield
+ * for a while first. Jobs are handed over one at a time with a short gap in
+ * between, so every job finds its threads idle, then in a burst.
+ */
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "threadpool.h"
+#include "utilities.h"
+
+#define THREADS      4
+#define ROUNDS       20000
+#define BURST_JOBS   200000
+#define JOB_NS       1000
+#define GAP_NS       5000
+#define NSEC_PER_SEC 1000000000ULL
+
+/**
+ * @brief A way for idle threads to wait
+ */
+typedef struct bench_mode
+{
+    const char * name;
+    uint32_t     spin_count;
+    uint32_t     yield_count;
+} bench_mode_t;
+
+// The latency of the job of each round, and the round that last ran
+static uint64_t   latencies[ROUNDS];
+static atomic_int finished;
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds
+ *
+ * @return the current time in nanoseconds
+ */
+static uint64_t now_ns(void);
+
+/**
+ * @brief Busy-waits for 'nsec' nanoseconds
+ *
+ * @param nsec the time to wait
+ */
+static void busy_wait(uint64_t nsec);
+
+/**
+ * @brief Records how long after its submission the job started, works for
+ * JOB_NS and marks its round finished
+ *
+ * @param arg the index of the round
+ * @return NULL
+ */
+static void * timed_job(void * arg);
+
+/**
+ * @brief Works for JOB_NS
+ *
+ * @param arg unused
+ * @return NULL
+ */
+static void * short_job(void * arg);
+
+/**
+ * @brief Orders two latencies for qsort()
+ *
+ * @param left_p the first latency
+ * @param right_p the second latency
+ * @return the order of the two
+ */
+static int compare_latency(const void * left_p, const void * right_p);
+
+/**
+ * @brief Runs both measurements with one way of waiting and reports them
+ *
+ * @param mode the way idle threads wait
+ * @return 0 on success, -1 on failure
+ */
+static int run(const bench_mode_t * mode);
+
+int main(void)
+{
+    int          exit_code = E_FAILURE;
+    bench_mode_t modes[]   = {
+        { "park", 0, 0 },
+        { "spin + yield + park",
+          THREADPOOL_DEFAULT_SPIN_COUNT,
+          THREADPOOL_DEFAULT_YIELD_COUNT },
+    };
+
+    printf("%-22s %12s %12s %12s\n",
+           "waiting",
+           "mean ns",
+           "p99 ns",
+           "Mjobs/s");
+
+    for (size_t idx = 0; idx < sizeof(modes) / sizeof(modes[0]); idx++)
+    {
+        if (E_SUCCESS != run(&modes[idx]))
+        {
+            print_error("Benchmark failed.");
+            goto END;
+        }
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * NSEC_PER_SEC) + (uint64_t)now.tv_nsec;
+}
+
+static void busy_wait(uint64_t nsec)
+{
+    uint64_t start = now_ns();
+
+    while ((now_ns() - start) < nsec)
+    {
+    }
+}
+
+static void * timed_job(void * arg)
+{
+    size_t round = (size_t)arg;
+
+    latencies[round] = now_ns() - latencies[round];
+    busy_wait(JOB_NS);
+    atomic_store(&finished, (int)round + 1);
+
+    return NULL;
+}
+
+static void * short_job(void * arg)
+{
+    (void)arg;
+    busy_wait(JOB_NS);
+
+    return NULL;
+}
+
+static int compare_latency(const void * left_p, const void * right_p)
+{
+    uint64_t left  = *(const uint64_t *)left_p;
+    uint64_t right = *(const uint64_t *)right_p;
+
+    return (left > right) - (left < right);
+}
+
+static int run(const bench_mode_t * mode)
+{
+    int              exit_code = E_FAILURE;
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool    = NULL;
+    uint64_t         total   = 0;
+    uint64_t         start   = 0;
+    uint64_t         elapsed = 0;
+
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.spin_count  = mode->spin_count;
+    cfg.yield_count = mode->yield_count;
+    pool            = threadpool_create_ex(&cfg);
+    if (NULL == pool)
+    {
+        print_error("Unable to create threadpool.");
+        goto END;
+    }
+
+    // One job at a time: the latency is how long an idle thread takes to
+    // pick it up
+    atomic_store(&finished, 0);
+    for (size_t round = 0; round < ROUNDS; round++)
+    {
+        busy_wait(GAP_NS);
+        latencies[round] = now_ns();
+        if (E_SUCCESS !=
+            threadpool_add_job(pool, timed_job, NULL, (void *)round))
+        {
+            print_error("Unable to add job.");
+            goto END;
+        }
+
+        while ((int)round + 1 != atomic_load(&finished))
+        {
+            sched_yield();
+        }
+        total += latencies[round];
+    }
+    qsort(latencies, ROUNDS, sizeof(uint64_t), compare_latency);
+
+    // A burst: the threads should never run out of work long enough to park
+    start = now_ns();
+    for (size_t job = 0; job < BURST_JOBS; job++)
+    {
+        if (E_SUCCESS != threadpool_add_job(pool, short_job, NULL, NULL))
+        {
+            print_error("Unable to add job.");
+            goto END;
+        }
+    }
+    threadpool_wait_idle(pool);
+    elapsed = now_ns() - start;
+
+    printf("%-22s %12.0f %12llu %12.3f\n",
+           mode->name,
+           (double)total / (double)ROUNDS,
+           (unsigned long long)latencies[(ROUNDS * 99) / 100],
+           ((double)BURST_JOBS * 1000.0) / (double)elapsed);
+
+    exit_code = E_SUCCESS;
+END:
+    if (NULL != pool)
+    {
+        threadpool_destroy(&pool);
+    }
+    return exit_code;
+}
+
+/*** end of file ***/
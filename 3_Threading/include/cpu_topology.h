@@ -0,0 +1,75 @@
+/**
+ * @file cpu_topology.h
+ *
+ * @brief A module for reading which CPUs belong to which NUMA node
+ *
+ * The topology is read from sysfs ("nodeN/cpulist" under
+ * CPU_TOPOLOGY_SYSFS_PATH) without libnuma. A machine without that directory
+ * is treated as a single node holding every CPU the process may run on.
+ *
+ * @note Uses cpu_set_t, so _GNU_SOURCE must be defined before the first
+ * system header is included.
+ */
+#ifndef _CPU_TOPOLOGY_H
+#define _CPU_TOPOLOGY_H
+
+#include <sched.h>
+#include <stddef.h>
+
+#define CPU_TOPOLOGY_SYSFS_PATH "/sys/devices/system/node"
+
+/**
+ * @brief Opaque type for the NUMA nodes of a machine
+ */
+typedef struct cpu_topology cpu_topology_t;
+
+/**
+ * @brief Parses a sysfs CPU list such as "0-3,8,10-11" into a CPU set.
+ * Trailing whitespace is ignored and an empty list gives an empty set.
+ *
+ * @param list_p The CPU list to parse
+ * @param set_p Where the parsed CPUs are stored
+ * @return int - Returns 0 on success state, -1 on a malformed list
+ */
+int cpu_list_parse(const char *list_p, cpu_set_t *set_p);
+
+/**
+ * @brief Reads the NUMA nodes of the machine. Nodes without CPUs are left
+ * out, and nodes are numbered from 0 in the order of their sysfs ids.
+ *
+ * @param path_p The sysfs node directory, NULL for CPU_TOPOLOGY_SYSFS_PATH
+ * @return cpu_topology_t* - Returns the topology, NULL on error
+ */
+cpu_topology_t *cpu_topology_load(const char *path_p);
+
+/**
+ * @brief Returns the number of nodes in a topology.
+ *
+ * @param topology_p The topology to inspect
+ * @return size_t - Returns the node count, 0 on error
+ */
+size_t cpu_topology_node_count(const cpu_topology_t *topology_p);
+
+/**
+ * @brief Copies the CPUs of a node.
+ *
+ * @param topology_p The topology to inspect
+ * @param node The node, from 0 to cpu_topology_node_count() - 1
+ * @param set_p Where the node's CPUs are stored
+ * @return int - Returns 0 on success state, -1 on error state
+ */
+int cpu_topology_node_cpus(const cpu_topology_t *topology_p,
+                           size_t node,
+                           cpu_set_t *set_p);
+
+/**
+ * @brief Destroys a topology.
+ *
+ * @param topology_pp The address of the topology to destroy
+ * @return int - Returns 0 on success state, -1 on error state
+ */
+int cpu_topology_destroy(cpu_topology_t **topology_pp);
+
+#endif /* _CPU_TOPOLOGY_H */
+
+/*** end of file ***/
@@ -0,0 +1,90 @@
+/**
+ * @file parallel.h
+ *
+ * @brief Data-parallel loops over index ranges, run on a threadpool
+ *
+ * The range is handed out in chunks that start large and shrink as it runs
+ * out, down to the grain size, so threads that finish early pick up the
+ * tail. The calling thread works through chunks alongside the threadpool,
+ * which only ever gets one job per helping thread rather than one per
+ * chunk, and the loop completes even if every thread in the threadpool is
+ * busy.
+ */
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <stddef.h>
+
+#include "threadpool.h"
+
+/**
+ * @brief Runs the loop body over the indexes [begin, end).
+ */
+typedef void (*RANGE_F)(size_t begin, size_t end, void *ctx_p);
+
+/**
+ * @brief Reduces the indexes [begin, end) to a partial result.
+ */
+typedef void *(*RANGE_REDUCE_F)(size_t begin, size_t end, void *ctx_p);
+
+/**
+ * @brief Combines two partial results into one. Must be associative and
+ * commutative, partial results are combined in no particular order.
+ */
+typedef void *(*COMBINE_F)(void *left_p, void *right_p, void *ctx_p);
+
+/**
+ * @brief Calls fn over every index in [begin, end), in chunks, using the
+ * calling thread and the threads of the threadpool. Returns once every
+ * chunk has finished.
+ *
+ * @param pool_p The threadpool to share the loop with
+ * @param begin The first index
+ * @param end One past the last index
+ * @param grain The smallest chunk handed out, 0 for 1
+ * @param fn The loop body
+ * @param ctx_p The last argument passed to fn
+ *
+ * @note May be called from a job running on pool_p.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_parallel_for(threadpool_t *pool_p,
+                            size_t begin,
+                            size_t end,
+                            size_t grain,
+                            RANGE_F fn,
+                            void *ctx_p);
+
+/**
+ * @brief Reduces every index in [begin, end) to one result like
+ * threadpool_parallel_for(). Each chunk is reduced by range_f, and the
+ * partial results are merged with combine_f.
+ *
+ * @param pool_p The threadpool to share the loop with
+ * @param begin The first index
+ * @param end One past the last index
+ * @param grain The smallest chunk handed out, 0 for 1
+ * @param range_f Reduces a chunk to a partial result
+ * @param combine_f Merges two partial results
+ * @param identity_p The result of an empty range, combined into the result
+ * @param ctx_p The last argument passed to range_f and combine_f
+ * @param result_pp Set to the combined result
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_parallel_reduce(threadpool_t *pool_p,
+                               size_t begin,
+                               size_t end,
+                               size_t grain,
+                               RANGE_REDUCE_F range_f,
+                               COMBINE_F combine_f,
+                               void *identity_p,
+                               void *ctx_p,
+                               void **result_pp);
+
+#endif /* _PARALLEL_H */
+
+/*** end of file ***/
@@ -0,0 +1,141 @@
+/**
+ * @file task_graph.h
+ *
+ * @brief Graphs of jobs with dependencies between them, run on a threadpool
+ *
+ * Tasks and the edges between them are declared once, then the graph can be
+ * run any number of times. A task is handed to the threadpool as soon as the
+ * last of its predecessors finishes, with no stage boundaries holding back
+ * tasks whose own inputs are ready. The thread that finishes a task runs one
+ * of the successors it made ready itself instead of queueing it, so chains of
+ * tasks stay on one thread.
+ */
+#ifndef _TASK_GRAPH_H
+#define _TASK_GRAPH_H
+
+#include <stddef.h>
+
+#include "threadpool.h"
+
+/**
+ * @brief A graph of tasks. Not thread-safe while it is being built, and runs
+ * once at a time.
+ */
+typedef struct task_graph task_graph_t;
+
+/**
+ * @brief Creates an empty graph.
+ *
+ * @return task_graph_t* Returns the graph on success, NULL on failure
+ */
+task_graph_t *task_graph_create(void);
+
+/**
+ * @brief Frees a graph and calls the del_f of every task on its arg.
+ *
+ * @param graph_pp The graph to free, set to NULL
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR, the graph is running
+ */
+int task_graph_destroy(task_graph_t **graph_pp);
+
+/**
+ * @brief Adds a task to the graph.
+ *
+ * @param graph_p The graph to add the task to
+ * @param job The job to run for the task
+ * @param del_f Frees arg_p when the graph is destroyed, may be NULL
+ * @param arg_p The argument passed to job on every run, may be NULL
+ * @param task_id_p Set to the id of the task, used to add edges
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int task_graph_add_task(task_graph_t *graph_p,
+                        JOB_F job,
+                        FREE_F del_f,
+                        void *arg_p,
+                        size_t *task_id_p);
+
+/**
+ * @brief Makes the task 'after' wait for the task 'before' to finish.
+ *
+ * @param graph_p The graph holding both tasks
+ * @param before The id of the task that runs first
+ * @param after The id of the task that waits for it
+ *
+ * @note Cycles are only found when the graph is next submitted.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int task_graph_add_edge(task_graph_t *graph_p, size_t before, size_t after);
+
+/**
+ * @brief Starts a run of the graph on a threadpool and returns without
+ * waiting for it. The tasks with no predecessors are queued straight away.
+ *
+ * @param graph_p The graph to run
+ * @param pool_p The threadpool to run its tasks on
+ *
+ * @note A task the threadpool has no room for is run by the thread that made
+ * it ready, the caller for the first tasks, so a run always completes, even
+ * on a full or shut down threadpool.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR, the graph has a cycle or is already running
+ */
+int task_graph_submit(task_graph_t *graph_p, threadpool_t *pool_p);
+
+/**
+ * @brief Waits for the current run of the graph to finish. Returns at once
+ * if the graph is not running.
+ *
+ * @param graph_p The graph to wait for
+ *
+ * @note Must not be called from a task of the graph, or from a job on a
+ * threadpool every thread of which might be waiting too.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int task_graph_wait(task_graph_t *graph_p);
+
+/**
+ * @brief Runs the graph on a threadpool and waits for it to finish, like
+ * task_graph_submit() followed by task_graph_wait().
+ *
+ * @param graph_p The graph to run
+ * @param pool_p The threadpool to run its tasks on
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int task_graph_run(task_graph_t *graph_p, threadpool_t *pool_p);
+
+/**
+ * @brief Gets what a task's job returned on the last run of the graph.
+ *
+ * @param graph_p The graph holding the task
+ * @param task_id The id of the task
+ * @param result_pp Set to the result of the task
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR, the graph is running
+ */
+int task_graph_result(task_graph_t *graph_p,
+                      size_t task_id,
+                      void **result_pp);
+
+/**
+ * @brief Gets the number of tasks in the graph.
+ *
+ * @param graph_p The graph
+ * @return size_t The number of tasks, 0 on NULL
+ */
+size_t task_graph_task_count(task_graph_t *graph_p);
+
+#endif /* _TASK_GRAPH_H */
+
+/*** end of file ***/
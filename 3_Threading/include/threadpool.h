@@ -1,11 +1,25 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "queue.h"
 
 #define MIN_THREADS (size_t)2
+#define DEFAULT_QUEUE_CAPACITY (uint32_t)1024
+#define THREADPOOL_FUTURE_PENDING 1 // The job behind a future has not finished
+#define THREADPOOL_QUEUE_FULL 2     // The job queue had no room for the job
+#define THREADPOOL_DEFAULT_KEEP_ALIVE_MS (uint32_t)60000
+#define THREADPOOL_DEFAULT_SPAWN_DEPTH (size_t)16
+#define THREADPOOL_DEFAULT_STARVATION_LIMIT (uint32_t)32
+#define THREADPOOL_DEFAULT_SPIN_COUNT (uint32_t)128
+#define THREADPOOL_DEFAULT_YIELD_COUNT (uint32_t)4
+#define THREADPOOL_DEFAULT_STRAND_COUNT (size_t)256
+#define THREADPOOL_HISTOGRAM_BUCKETS 40 // Up to 2^38 ns, about 4.5 minutes
+#define THREADPOOL_INVALID_TIMER UINT64_MAX // Refers to no timer
+#define THREADPOOL_JOB_RUNNING 3 // The cancelled job had already started
 
 /**
  * @brief A thread job function. The threadpool should operate on a job of this
@@ -21,11 +35,234 @@ typedef void *(*JOB_F)(void *arg);
  */
 typedef void (*FREE_F)(void *data);
 
+/**
+ * @brief A continuation attached to a future, called with the job's result
+ * and the argument given to threadpool_future_then().
+ */
+typedef void (*CONTINUATION_F)(void *result_p, void *arg_p);
+
+/**
+ * @brief Builds the context of a thread of the threadpool, see
+ * threadpool_worker_ctx(). Runs on the new thread before it takes any job.
+ * @note worker_id is the thread's slot, from 0 to max_threads - 1. A slot
+ * freed by a retired thread is reused by the next thread started.
+ */
+typedef void *(*WORKER_INIT_F)(size_t worker_id, void *arg_p);
+
+/**
+ * @brief Releases the context of a thread as the thread exits, on the thread
+ * itself. arg_p is the same argument WORKER_INIT_F was given.
+ * @note A retired thread's slot is not reused until its teardown returns,
+ * the rest of the threadpool carries on meanwhile.
+ */
+typedef void (*WORKER_TEARDOWN_F)(void *ctx_p, void *arg_p);
+
 /**
  * @brief A threadpool type. Internals to be implemented by trainee.
  */
 typedef struct threadpool threadpool_t;
 
+/**
+ * @brief A handle to the result of a job added with threadpool_submit().
+ * Futures are recycled by the threadpool that created them.
+ */
+typedef struct threadpool_future threadpool_future_t;
+
+/**
+ * @brief A handle to a delayed or periodic job, used to cancel it. Handles
+ * are never reused, so a handle to a timer that has expired is refused
+ * rather than cancelling a later one.
+ */
+typedef uint64_t threadpool_timer_t;
+
+/**
+ * @brief A handle to a job added with threadpool_add_job_cancellable(), used
+ * to cancel it. Tokens are recycled by the threadpool that created them.
+ */
+typedef struct threadpool_token threadpool_token_t;
+
+/**
+ * @brief The data structure backing the job queue.
+ *
+ * THREADPOOL_QUEUE_MUTEX: A growable queue_t guarded by a mutex. It starts at
+ * queue_capacity, absorbs bursts by growing up to queue_limit and shrinks back
+ * once they drain.
+ * THREADPOOL_QUEUE_LOCKFREE: A lock-free MPMC queue fixed at queue_capacity,
+ * producers and workers never take a lock unless a worker has to go to sleep.
+ */
+typedef enum threadpool_queue_type
+{
+    THREADPOOL_QUEUE_MUTEX,
+    THREADPOOL_QUEUE_LOCKFREE
+} threadpool_queue_type_t;
+
+/**
+ * @brief How jobs are handed to threads.
+ *
+ * THREADPOOL_SCHED_SHARED: Every thread takes jobs from the one job queue.
+ * THREADPOOL_SCHED_STEALING: Every thread also owns a work-stealing deque.
+ * Jobs added from inside a running job go to that thread's deque and run
+ * newest first, jobs added from other threads go to the shared job queue,
+ * which acts as the injector. A thread with nothing to do steals the oldest
+ * job from a randomly chosen thread's deque.
+ */
+typedef enum threadpool_sched_type
+{
+    THREADPOOL_SCHED_SHARED,
+    THREADPOOL_SCHED_STEALING
+} threadpool_sched_type_t;
+
+/**
+ * @brief The priority classes jobs are queued in. Every class has its own
+ * lane in the job queue, so bulk work cannot hold up latency-sensitive jobs.
+ */
+typedef enum threadpool_priority
+{
+    THREADPOOL_PRIORITY_HIGH,
+    THREADPOOL_PRIORITY_NORMAL, // Used by threadpool_add_job()
+    THREADPOOL_PRIORITY_LOW,
+    THREADPOOL_PRIORITIES       // The number of priority classes
+} threadpool_priority_t;
+
+/**
+ * @brief How threads choose between the priority lanes.
+ *
+ * THREADPOOL_LANES_STRICT: The highest priority lane with jobs is served,
+ * except that every starvation_limit-th pick serves a lower lane with jobs
+ * first, taking the lower lanes in turn. 0 disables that protection.
+ * THREADPOOL_LANES_WEIGHTED: Picks are shared out between the lanes in
+ * proportion to lane_weights. A lane without jobs passes its pick on to the
+ * next lane in priority order.
+ */
+typedef enum threadpool_lane_policy
+{
+    THREADPOOL_LANES_STRICT,
+    THREADPOOL_LANES_WEIGHTED
+} threadpool_lane_policy_t;
+
+/**
+ * @brief What threadpool_add_job_wait() does while the job queue is full.
+ * Only a THREADPOOL_QUEUE_LOCKFREE queue, or a THREADPOOL_QUEUE_MUTEX queue
+ * with a queue_limit, can fill up.
+ */
+typedef enum threadpool_submit_mode
+{
+    THREADPOOL_SUBMIT_FAIL_FAST, // Give up at once
+    THREADPOOL_SUBMIT_BLOCK,     // Wait until a thread takes a job
+    THREADPOOL_SUBMIT_TIMED      // Wait like BLOCK, for up to timeout_ms
+} threadpool_submit_mode_t;
+
+/**
+ * @brief Where the threads of a threadpool run.
+ *
+ * THREADPOOL_AFFINITY_NONE: Threads float across every CPU.
+ * THREADPOOL_AFFINITY_CPUS: Each thread is pinned to a single CPU, taking
+ * the CPUs in turn.
+ * THREADPOOL_AFFINITY_NUMA: Threads are spread across the NUMA nodes in turn
+ * and pinned to their node's CPUs. Every node has its own job queue, a job is
+ * queued on the node of the thread that adds it and its threads only take
+ * jobs from other nodes once their own queue is empty.
+ */
+typedef enum threadpool_affinity
+{
+    THREADPOOL_AFFINITY_NONE,
+    THREADPOOL_AFFINITY_CPUS,
+    THREADPOOL_AFFINITY_NUMA
+} threadpool_affinity_t;
+
+/**
+ * @brief Creation options for threadpool_create_ex(). Initialize with
+ * threadpool_cfg_init() before overriding individual fields.
+ *
+ * Setting max_threads above thread_count makes the threadpool elastic: it
+ * starts thread_count threads and never drops below them, adds a thread when
+ * every thread is busy and more than spawn_queue_depth jobs are waiting
+ * beyond them, or when a job waited longer than spawn_wait_ms, and retires
+ * threads above thread_count after keep_alive_ms without work.
+ */
+typedef struct threadpool_cfg
+{
+    size_t thread_count;                // The number of threads to create
+    threadpool_queue_type_t queue_type; // The job queue backend
+    uint32_t queue_capacity;            // The initial number of queued jobs
+    uint32_t queue_limit;               // High-water mark, 0 for unbounded
+    threadpool_sched_type_t scheduler;  // How jobs are handed to threads
+    size_t max_threads;                 // Most threads, 0 for thread_count
+    uint32_t keep_alive_ms;             // Idle time before extra threads exit
+    size_t spawn_queue_depth;           // Waiting jobs that add a thread
+    uint32_t spawn_wait_ms;             // Queue wait that adds a thread, or 0
+    threadpool_affinity_t affinity;     // Where the threads run
+    const int *cpus;                    // CPUs to run on, NULL for all allowed
+    size_t cpu_count;                   // The number of entries in cpus
+    const char *numa_path;              // sysfs node directory, NULL default
+
+    // How threads pick between the priority lanes
+    threadpool_lane_policy_t lane_policy;         // STRICT or WEIGHTED
+    uint32_t lane_weights[THREADPOOL_PRIORITIES]; // Lane shares, WEIGHTED
+    uint32_t starvation_limit;                    // Boost period, STRICT
+
+    // How long an idle thread keeps looking for work before it sleeps
+    uint32_t spin_count;  // Most polls while spinning, 0 to skip spinning
+    uint32_t yield_count; // Polls with sched_yield() in between, after that
+
+    bool time_jobs; // Collect the timings of threadpool_stats(), false default
+
+    // Serial queues the keys of threadpool_add_keyed_job() hash to
+    size_t strand_count; // More strands, fewer keys sharing one
+
+    // State every thread keeps across the jobs it runs
+    WORKER_INIT_F worker_init;         // Builds it, NULL for no context
+    WORKER_TEARDOWN_F worker_teardown; // Releases it, may be NULL
+    void *worker_arg_p;                // Passed to both
+} threadpool_cfg_t;
+
+/**
+ * @brief A histogram of durations in power-of-two buckets. Bucket 0 holds
+ * durations of 0 ns, bucket i holds [2^(i-1), 2^i) ns, and the last bucket
+ * also holds everything longer.
+ */
+typedef struct threadpool_histogram
+{
+    uint64_t count;                                 // The number of samples
+    uint64_t sum_ns;                                // The sum of the samples
+    uint64_t max_ns;                                // The longest sample
+    uint64_t buckets[THREADPOOL_HISTOGRAM_BUCKETS]; // Samples per bucket
+} threadpool_histogram_t;
+
+/**
+ * @brief A snapshot of a threadpool's counters. The counters are always
+ * kept, the timings stay at 0 unless the threadpool was created with
+ * time_jobs set.
+ */
+typedef struct threadpool_stats
+{
+    uint64_t submitted;          // Jobs accepted
+    uint64_t completed;          // Jobs that finished running
+    uint64_t cancelled;          // Of those, jobs skipped as cancelled
+    uint64_t rejected;           // Jobs refused: full, shut down, no memory
+    size_t queue_depth;          // Jobs accepted but not started yet
+    size_t queue_high_water;     // The most jobs queued or running at once
+    size_t thread_count;         // Threads running now
+    size_t parked_threads;       // Threads asleep waiting for work
+    uint64_t uptime_ns;          // Time since the threadpool was created
+    uint64_t thread_ns;          // Lifetimes of every thread, summed
+    uint64_t busy_ns;            // Time threads spent running jobs
+    double utilization;          // busy_ns / thread_ns, from 0 to 1
+    threadpool_histogram_t wait; // Time from submission to starting to run
+    threadpool_histogram_t run;  // Time spent running
+} threadpool_stats_t;
+
+/**
+ * @brief Fill a config with the defaults used by threadpool_create().
+ *
+ * @param cfg_p The config to initialize
+ * @param thread_count The number of threads to create in the threadpool
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_cfg_init(threadpool_cfg_t *cfg_p, size_t thread_count);
+
 /**
  * @brief Create a new threadpool and instantiate as required.
  *
@@ -36,6 +273,16 @@ typedef struct threadpool threadpool_t;
  */
 threadpool_t *threadpool_create(size_t thread_count);
 
+/**
+ * @brief Create a new threadpool using the given options.
+ *
+ * @param cfg_p Options initialized by threadpool_cfg_init()
+ *
+ * @return SUCCESS: A threadpool instance of type threadpool_t.
+ *         FAILURE: NULL
+ */
+threadpool_t *threadpool_create_ex(const threadpool_cfg_t *cfg_p);
+
 /**
  * @brief Nice shutdown of threadpool. Do not take any more work.
  * Finish the work that has already been accepted.
@@ -72,8 +319,11 @@ int threadpool_destroy(threadpool_t **pool_pp);
  * @note A valid job must include the function pointer job_f. The job may not
  * include an arg and thus NULL must be accepted as an arg. The free_f may also
  * be NULL.
+ * @note Jobs running in the pool may keep adding jobs while the pool shuts
+ * down; they are part of the work that was already accepted.
  *
  * @return SUCCESS: SUCCESS
+ *         FULL: THREADPOOL_QUEUE_FULL
  *         FAILURE: ERROR
  */
 int threadpool_add_job(threadpool_t *pool_p,
@@ -81,4 +331,435 @@ int threadpool_add_job(threadpool_t *pool_p,
                        FREE_F del_f,
                        void *arg_p);
 
+/**
+ * @brief Add a job to the threadpool like threadpool_add_job(), waiting for
+ * room while the job queue is full. Producers that outpace the threadpool
+ * are slowed down to its pace instead of having their jobs refused.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param mode Whether to wait for room, and for how long
+ * @param timeout_ms The longest wait with THREADPOOL_SUBMIT_TIMED
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p, if not
+ * required, set to NULL.
+ * @param arg_p The argument(s) required by the job, if any.
+ *
+ * @note Called from a job, it never waits: the calling thread would be
+ * waiting for itself to take a job. A waiting caller gives up when the
+ * threadpool shuts down.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FULL: THREADPOOL_QUEUE_FULL, the queue had no room in time
+ *         FAILURE: ERROR
+ */
+int threadpool_add_job_wait(threadpool_t *pool_p,
+                            threadpool_submit_mode_t mode,
+                            uint32_t timeout_ms,
+                            JOB_F job,
+                            FREE_F del_f,
+                            void *arg_p);
+
+/**
+ * @brief Add a job to the threadpool in a priority class.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param priority The priority class of the job
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p, if not
+ * required, set to NULL.
+ * @param arg_p The argument(s) required by the job, if any.
+ *
+ * @note Jobs are FIFO within a priority class. Jobs that are not
+ * THREADPOOL_PRIORITY_NORMAL always go through the job queue, even when
+ * added from a job with THREADPOOL_SCHED_STEALING.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FULL: THREADPOOL_QUEUE_FULL
+ *         FAILURE: ERROR
+ */
+int threadpool_add_job_priority(threadpool_t *pool_p,
+                                threadpool_priority_t priority,
+                                JOB_F job,
+                                FREE_F del_f,
+                                void *arg_p);
+
+/**
+ * @brief Add a job to the job queue of a NUMA node, so it runs next to memory
+ * allocated on that node.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param node The node, from 0 to threadpool_node_count() - 1
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p, if not
+ * required, set to NULL.
+ * @param arg_p The argument(s) required by the job, if any.
+ *
+ * @note Threadpools created without THREADPOOL_AFFINITY_NUMA have a single
+ * node, 0.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FULL: THREADPOOL_QUEUE_FULL
+ *         FAILURE: ERROR
+ */
+int threadpool_add_job_on_node(threadpool_t *pool_p,
+                               size_t node,
+                               JOB_F job,
+                               FREE_F del_f,
+                               void *arg_p);
+
+/**
+ * @brief Add a burst of jobs that share one job function to the threadpool.
+ * The job queue is locked once for the whole burst and only as many sleeping
+ * threads are woken as there are jobs to run.
+ *
+ * @param pool_p The valid pool to execute the jobs.
+ * @param job The job to be executed once for every entry in args_pp.
+ * @param del_f A user defined function to free and clean up each arg, if not
+ * required, set to NULL.
+ * @param args_pp An array of count arguments, one per job. Entries may be NULL.
+ * @param count The number of jobs to add.
+ * @param queued_p If not NULL, set to the number of jobs accepted.
+ *
+ * @note With THREADPOOL_QUEUE_MUTEX the burst is accepted all-or-nothing. With
+ * THREADPOOL_QUEUE_LOCKFREE the first *queued_p jobs may have been accepted
+ * when the queue fills up; the remaining args are left to the caller.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_add_jobs(threadpool_t *pool_p,
+                        JOB_F job,
+                        FREE_F del_f,
+                        void **args_pp,
+                        size_t count,
+                        size_t *queued_p);
+
+/**
+ * @brief Add a job that runs after every job added earlier with the same key,
+ * and before every job added later with it. Jobs with different keys run in
+ * parallel.
+ *
+ * Keys hash to strands, serial queues of jobs that are scheduled like a job
+ * themselves: a thread takes a strand and runs its jobs one after the other,
+ * so jobs of a key never wait on a lock while another thread runs one.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param key The key, such as a session or account id
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p, if not
+ * required, set to NULL.
+ * @param arg_p The argument(s) required by the job, if any.
+ *
+ * @note Keys that hash to the same strand are serialized with each other as
+ * well, see strand_count. threadpool_stats() counts the runs of strands, not
+ * the keyed jobs within them.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FULL: THREADPOOL_QUEUE_FULL
+ *         FAILURE: ERROR
+ */
+int threadpool_add_keyed_job(threadpool_t *pool_p,
+                             uint64_t key,
+                             JOB_F job,
+                             FREE_F del_f,
+                             void *arg_p);
+
+/**
+ * @brief Add a job to the threadpool once delay_ms milliseconds have passed.
+ * Timers are kept in a timing wheel with a resolution of one millisecond,
+ * and a single timer thread queues each job on the job queue as its timer
+ * expires.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param delay_ms The time to wait before the job is queued
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p once the
+ * job has run or its timer was cancelled, if not required, set to NULL.
+ * @param arg_p The argument(s) required by the job, if any.
+ * @param timer_p If not NULL, set to a handle for threadpool_cancel_timer()
+ *
+ * @note A job whose timer expires while the job queue is full is retried a
+ * millisecond later. Timers that have not expired do not count as pending
+ * for threadpool_wait_idle(), and are dropped when the threadpool shuts down.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_add_delayed_job(threadpool_t *pool_p,
+                               uint32_t delay_ms,
+                               JOB_F job,
+                               FREE_F del_f,
+                               void *arg_p,
+                               threadpool_timer_t *timer_p);
+
+/**
+ * @brief Add a job to the threadpool every period_ms milliseconds, the first
+ * time once delay_ms milliseconds have passed, until its timer is cancelled.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param delay_ms The time to wait before the job is first queued
+ * @param period_ms The time between two runs, at least 1
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p once the
+ * timer is cancelled and the last run has finished, if not required, set to
+ * NULL.
+ * @param arg_p The argument(s) required by the job, if any.
+ * @param timer_p If not NULL, set to a handle for threadpool_cancel_timer()
+ *
+ * @note Runs never overlap: a period that comes round while the last run is
+ * still queued or running is skipped, as are periods that passed while the
+ * job queue was full.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_add_periodic_job(threadpool_t *pool_p,
+                                uint32_t delay_ms,
+                                uint32_t period_ms,
+                                JOB_F job,
+                                FREE_F del_f,
+                                void *arg_p,
+                                threadpool_timer_t *timer_p);
+
+/**
+ * @brief Cancel a delayed or periodic job before its timer next expires. A
+ * run that has already been queued still goes ahead.
+ *
+ * @param pool_p The threadpool the job was added to
+ * @param timer The handle of the job's timer
+ *
+ * @note May be called from the job itself, which stops a periodic job.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR, the timer has expired or was cancelled already
+ */
+int threadpool_cancel_timer(threadpool_t *pool_p, threadpool_timer_t timer);
+
+/**
+ * @brief Add a job to the threadpool like threadpool_add_job(), and get a
+ * token that cancels it.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p, if not
+ * required, set to NULL. It runs whether or not the job was cancelled.
+ * @param arg_p The argument(s) required by the job, if any.
+ * @param token_pp Set to the job's token upon success
+ *
+ * @note Every token must be released with threadpool_token_release() before
+ * the threadpool is destroyed.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FULL: THREADPOOL_QUEUE_FULL
+ *         FAILURE: ERROR
+ */
+int threadpool_add_job_cancellable(threadpool_t *pool_p,
+                                   JOB_F job,
+                                   FREE_F del_f,
+                                   void *arg_p,
+                                   threadpool_token_t **token_pp);
+
+/**
+ * @brief Cancel the job behind a token. A job that has not started stays in
+ * the job queue, and is skipped when a thread takes it. A job that is running
+ * is asked to stop, see threadpool_job_cancelled().
+ *
+ * @param token_p The token of the job
+ *
+ * @return SKIPPED: SUCCESS
+ *         RUNNING: THREADPOOL_JOB_RUNNING
+ *         FAILURE: ERROR, the job has finished already
+ */
+int threadpool_cancel_job(threadpool_token_t *token_p);
+
+/**
+ * @brief Check whether the job the calling thread runs has been cancelled.
+ * Long jobs call it now and then, and return early once it is true.
+ *
+ * @return CANCELLED: true
+ *         OTHERWISE: false, also outside of a cancellable job
+ */
+bool threadpool_job_cancelled(void);
+
+/**
+ * @brief Give up a token. The job is not cancelled, and the token is
+ * recycled once the job has finished or been skipped.
+ *
+ * @param token_pp The token to release. Will be set to NULL upon success.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_token_release(threadpool_token_t **token_pp);
+
+/**
+ * @brief Block until every job added to the threadpool has finished, leaving
+ * the threads running for the next batch of work.
+ *
+ * @param pool_p A valid threadpool instance
+ *
+ * @note Jobs added by other threads while waiting, including jobs added by
+ * running jobs, are waited for too. Must not be called from a job.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_wait_idle(threadpool_t *pool_p);
+
+/**
+ * @brief Get the number of threads currently running in the threadpool,
+ * which an elastic threadpool grows and shrinks between thread_count and
+ * max_threads.
+ *
+ * @param pool_p A valid threadpool instance
+ *
+ * @return SUCCESS: The number of threads
+ *         FAILURE: 0
+ */
+size_t threadpool_thread_count(threadpool_t *pool_p);
+
+/**
+ * @brief Get the context the worker_init of the threadpool built for the
+ * calling thread, such as scratch buffers or connections the thread's jobs
+ * share without locking.
+ *
+ * @note Only meaningful inside a job. Jobs a caller runs itself, like the
+ * inline tasks of a task graph, run without a worker context.
+ *
+ * @return SUCCESS: The context, NULL if worker_init returned NULL
+ *         FAILURE: NULL, outside of the threads of a threadpool
+ */
+void *threadpool_worker_ctx(void);
+
+/**
+ * @brief Get the number of NUMA nodes the threadpool keeps a job queue for.
+ *
+ * @param pool_p A valid threadpool instance
+ *
+ * @return SUCCESS: The number of nodes
+ *         FAILURE: 0
+ */
+size_t threadpool_node_count(threadpool_t *pool_p);
+
+/**
+ * @brief Take a snapshot of the threadpool's counters and histograms.
+ *
+ * @param pool_p A valid threadpool instance
+ * @param stats_p Filled with the snapshot
+ *
+ * @note Threads count into their own shards and the snapshot adds them up
+ * without stopping the threadpool, so while jobs run the counters may be a
+ * few jobs apart from each other. A job's future can complete before the
+ * job is counted as completed.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_stats(threadpool_t *pool_p, threadpool_stats_t *stats_p);
+
+/**
+ * @brief Estimate a percentile of a histogram, as the upper bound of the
+ * bucket it falls in.
+ *
+ * @param hist_p The histogram to read
+ * @param percentile The percentile, from 0 to 100
+ *
+ * @return SUCCESS: The duration in nanoseconds, never above max_ns
+ *         FAILURE: 0, also for an empty histogram
+ */
+uint64_t threadpool_histogram_percentile(const threadpool_histogram_t *hist_p,
+                                         double percentile);
+
+/**
+ * @brief Add a job to the threadpool like threadpool_add_job(), and get a
+ * future for the value the job returns.
+ *
+ * @param pool_p The valid pool to execute the job.
+ * @param job The job to be executed by the pool.
+ * @param del_f A user defined function to free and clean up arg_p, if not
+ * required, set to NULL. It runs before the future completes.
+ * @param arg_p The argument(s) required by the job, if any.
+ *
+ * @note Every future must be released with threadpool_future_release() before
+ * the threadpool is destroyed.
+ *
+ * @return SUCCESS: A future for the job's result.
+ *         FAILURE: NULL
+ */
+threadpool_future_t *threadpool_submit(threadpool_t *pool_p,
+                                       JOB_F job,
+                                       FREE_F del_f,
+                                       void *arg_p);
+
+/**
+ * @brief Block until the job behind a future has finished.
+ *
+ * @param future_p The future to wait on
+ * @param result_pp If not NULL, set to the value the job returned
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_future_wait(threadpool_future_t *future_p, void **result_pp);
+
+/**
+ * @brief Block until the job behind a future has finished or timeout_ms
+ * milliseconds have passed.
+ *
+ * @param future_p The future to wait on
+ * @param timeout_ms The longest time to wait, in milliseconds
+ * @param result_pp If not NULL, set to the value the job returned
+ *
+ * @return SUCCESS: SUCCESS
+ *         TIMEOUT: THREADPOOL_FUTURE_PENDING
+ *         FAILURE: ERROR
+ */
+int threadpool_future_timedwait(threadpool_future_t *future_p,
+                                uint32_t timeout_ms,
+                                void **result_pp);
+
+/**
+ * @brief Check whether the job behind a future has finished, without
+ * blocking.
+ *
+ * @param future_p The future to check
+ * @param result_pp If not NULL and the job has finished, set to the value the
+ * job returned
+ *
+ * @return DONE: SUCCESS
+ *         NOT DONE: THREADPOOL_FUTURE_PENDING
+ *         FAILURE: ERROR
+ */
+int threadpool_future_poll(threadpool_future_t *future_p, void **result_pp);
+
+/**
+ * @brief Attach a continuation to a future. It is called with the job's
+ * result on the thread that ran the job, right after the job finishes, or
+ * immediately on the calling thread if the job has already finished.
+ *
+ * @param future_p The future to attach to
+ * @param then_f The continuation to call
+ * @param arg_p The second argument passed to then_f
+ *
+ * @note A future takes a single continuation, attached by the thread that
+ * holds the future.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_future_then(threadpool_future_t *future_p,
+                           CONTINUATION_F then_f,
+                           void *arg_p);
+
+/**
+ * @brief Give up a future. The job still runs, and the future is recycled
+ * once it has finished.
+ *
+ * @param future_pp The future to release. Will be set to NULL upon success.
+ *
+ * @return SUCCESS: SUCCESS
+ *         FAILURE: ERROR
+ */
+int threadpool_future_release(threadpool_future_t **future_pp);
+
 #endif
@@ -0,0 +1,442 @@
+#define _GNU_SOURCE // cpu_set_t, sched_getaffinity()
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_topology.h"
+#include "utilities.h"
+
+#define CPU_LIST_MAX 4096 // Longest cpulist file read, in bytes
+#define NODE_PATH_MAX 512 // Longest path to a cpulist file
+#define NODE_PREFIX "node"
+
+/**
+ * @brief A struct for the NUMA nodes of a machine
+ *
+ */
+struct cpu_topology
+{
+    size_t node_count;  // The number of nodes with CPUs
+    cpu_set_t *nodes_p; // The CPUs of every node
+};
+
+/**
+ * @brief Parses one CPU number from a CPU list.
+ *
+ * @param list_pp The position in the list, moved past the number
+ * @param cpu_p Where the number is stored
+ * @return int - Returns 0 on success state, -1 if it is not a valid CPU
+ */
+static int cpu_list_number(const char **list_pp, int *cpu_p);
+
+/**
+ * @brief Returns the sysfs id of a "nodeN" directory entry.
+ *
+ * @param name_p The directory entry name
+ * @return int - Returns the node id, -1 if the entry is not a node
+ */
+static int node_id(const char *name_p);
+
+/**
+ * @brief Reads the sysfs node ids in a directory, sorted.
+ *
+ * @param dir_p The opened node directory
+ * @param ids_pp Receives the allocated ids
+ * @param count_p Receives the number of ids
+ * @return int - Returns 0 on success state, -1 on error state
+ */
+static int node_ids_read(DIR *dir_p, int **ids_pp, size_t *count_p);
+
+/**
+ * @brief Reads and parses the cpulist file of one node.
+ *
+ * @param path_p The sysfs node directory
+ * @param id The sysfs id of the node
+ * @param set_p Where the node's CPUs are stored
+ * @return int - Returns 0 on success state, -1 on error state
+ */
+static int node_cpus_read(const char *path_p, int id, cpu_set_t *set_p);
+
+int cpu_list_parse(const char *list_p, cpu_set_t *set_p)
+{
+    int exit_code = E_FAILURE;
+    int first = 0;
+    int last = 0;
+
+    if ((NULL == list_p) || (NULL == set_p))
+    {
+        print_error("cpu_list_parse(): NULL argument passed.");
+        goto END;
+    }
+
+    CPU_ZERO(set_p);
+    while (isspace((unsigned char)*list_p))
+    {
+        list_p++;
+    }
+
+    while ('\0' != *list_p)
+    {
+        if (E_SUCCESS != cpu_list_number(&list_p, &first))
+        {
+            goto END;
+        }
+
+        last = first;
+        if ('-' == *list_p)
+        {
+            list_p++;
+            if ((E_SUCCESS != cpu_list_number(&list_p, &last)) ||
+                (first > last))
+            {
+                goto END;
+            }
+        }
+
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            CPU_SET(cpu, set_p);
+        }
+
+        // A comma must be followed by another range
+        if (',' == *list_p)
+        {
+            list_p++;
+            if ('\0' == *list_p)
+            {
+                goto END;
+            }
+            continue;
+        }
+
+        // Only trailing whitespace may follow the last range
+        while (isspace((unsigned char)*list_p))
+        {
+            list_p++;
+        }
+
+        if ('\0' != *list_p)
+        {
+            goto END;
+        }
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+cpu_topology_t *cpu_topology_load(const char *path_p)
+{
+    int exit_code = E_FAILURE;
+    cpu_topology_t *topology_p = NULL;
+    cpu_set_t *set_p = NULL;
+    DIR *dir_p = NULL;
+    int *ids_p = NULL;
+    size_t id_count = 0;
+
+    if (NULL == path_p)
+    {
+        path_p = CPU_TOPOLOGY_SYSFS_PATH;
+    }
+
+    topology_p = calloc(1, sizeof(cpu_topology_t));
+    if (NULL == topology_p)
+    {
+        print_error("cpu_topology_load(): CMR failure.");
+        goto END;
+    }
+
+    // A kernel without NUMA support has no node directory at all
+    dir_p = opendir(path_p);
+    if ((NULL == dir_p) && (ENOENT != errno))
+    {
+        print_error("cpu_topology_load(): Unable to open node directory.");
+        goto END;
+    }
+
+    if (NULL != dir_p)
+    {
+        exit_code = node_ids_read(dir_p, &ids_p, &id_count);
+        if (E_SUCCESS != exit_code)
+        {
+            goto END;
+        }
+    }
+
+    // One spare set for the single node fallback
+    topology_p->nodes_p = calloc(id_count + 1, sizeof(cpu_set_t));
+    if (NULL == topology_p->nodes_p)
+    {
+        print_error("cpu_topology_load(): 'nodes_p' CMR failure.");
+        exit_code = E_FAILURE;
+        goto END;
+    }
+
+    for (size_t idx = 0; idx < id_count; idx++)
+    {
+        set_p = &topology_p->nodes_p[topology_p->node_count];
+        exit_code = node_cpus_read(path_p, ids_p[idx], set_p);
+        if (E_SUCCESS != exit_code)
+        {
+            goto END;
+        }
+
+        // Memory-only nodes have nothing to run threads on
+        if (0 != CPU_COUNT(set_p))
+        {
+            topology_p->node_count++;
+        }
+    }
+
+    // Without NUMA information everything the process may run on is one node
+    if (0 == topology_p->node_count)
+    {
+        exit_code =
+            sched_getaffinity(0, sizeof(cpu_set_t), topology_p->nodes_p);
+        if (E_SUCCESS != exit_code)
+        {
+            print_error("cpu_topology_load(): Unable to read CPU affinity.");
+            goto END;
+        }
+        topology_p->node_count = 1;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    if ((E_SUCCESS != exit_code) && (NULL != topology_p))
+    {
+        cpu_topology_destroy(&topology_p);
+    }
+
+    if (NULL != dir_p)
+    {
+        closedir(dir_p);
+    }
+    free(ids_p);
+    return topology_p;
+}
+
+size_t cpu_topology_node_count(const cpu_topology_t *topology_p)
+{
+    size_t node_count = 0;
+
+    if (NULL == topology_p)
+    {
+        print_error("cpu_topology_node_count(): NULL argument passed.");
+        goto END;
+    }
+
+    node_count = topology_p->node_count;
+
+END:
+    return node_count;
+}
+
+int cpu_topology_node_cpus(const cpu_topology_t *topology_p,
+                           size_t node,
+                           cpu_set_t *set_p)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == topology_p) || (NULL == set_p))
+    {
+        print_error("cpu_topology_node_cpus(): NULL argument passed.");
+        goto END;
+    }
+
+    if (topology_p->node_count <= node)
+    {
+        print_error("cpu_topology_node_cpus(): Invalid node.");
+        goto END;
+    }
+
+    memcpy(set_p, &topology_p->nodes_p[node], sizeof(cpu_set_t));
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int cpu_topology_destroy(cpu_topology_t **topology_pp)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == topology_pp) || (NULL == *topology_pp))
+    {
+        print_error("cpu_topology_destroy(): NULL argument passed.");
+        goto END;
+    }
+
+    free((*topology_pp)->nodes_p);
+    free(*topology_pp);
+    *topology_pp = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static int cpu_list_number(const char **list_pp, int *cpu_p)
+{
+    int exit_code = E_FAILURE;
+    long cpu = 0;
+
+    if (!isdigit((unsigned char)**list_pp))
+    {
+        goto END;
+    }
+
+    while (isdigit((unsigned char)**list_pp))
+    {
+        cpu = (cpu * 10) + (**list_pp - '0');
+        if (CPU_SETSIZE <= cpu)
+        {
+            goto END;
+        }
+        (*list_pp)++;
+    }
+
+    *cpu_p = (int)cpu;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static int node_id(const char *name_p)
+{
+    int id = E_FAILURE;
+    long value = 0;
+    size_t prefix_len = strlen(NODE_PREFIX);
+
+    if ((0 != strncmp(name_p, NODE_PREFIX, prefix_len)) ||
+        ('\0' == name_p[prefix_len]))
+    {
+        goto END;
+    }
+
+    for (const char *digit_p = name_p + prefix_len; '\0' != *digit_p;
+         digit_p++)
+    {
+        if (!isdigit((unsigned char)*digit_p))
+        {
+            goto END;
+        }
+
+        value = (value * 10) + (*digit_p - '0');
+        if (CPU_SETSIZE <= value)
+        {
+            goto END;
+        }
+    }
+
+    id = (int)value;
+END:
+    return id;
+}
+
+static int node_ids_read(DIR *dir_p, int **ids_pp, size_t *count_p)
+{
+    int exit_code = E_FAILURE;
+    struct dirent *entry_p = NULL;
+    int *ids_p = NULL;
+    int *grown_p = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    size_t pos = 0;
+    int id = 0;
+
+    while (NULL != (entry_p = readdir(dir_p)))
+    {
+        id = node_id(entry_p->d_name);
+        if (0 > id)
+        {
+            continue;
+        }
+
+        if (capacity == count)
+        {
+            capacity = (0 == capacity) ? 8 : capacity * 2;
+            grown_p = realloc(ids_p, capacity * sizeof(int));
+            if (NULL == grown_p)
+            {
+                print_error("node_ids_read(): CMR failure.");
+                goto END;
+            }
+            ids_p = grown_p;
+        }
+
+        // Keep the ids sorted, directory order is arbitrary
+        for (pos = count; (0 < pos) && (ids_p[pos - 1] > id); pos--)
+        {
+            ids_p[pos] = ids_p[pos - 1];
+        }
+        ids_p[pos] = id;
+        count++;
+    }
+
+    *ids_pp = ids_p;
+    *count_p = count;
+    ids_p = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    free(ids_p);
+    return exit_code;
+}
+
+static int node_cpus_read(const char *path_p, int id, cpu_set_t *set_p)
+{
+    int exit_code = E_FAILURE;
+    char file_path[NODE_PATH_MAX] = { 0 };
+    char list[CPU_LIST_MAX] = { 0 };
+    FILE *file_p = NULL;
+    int written = 0;
+
+    written = snprintf(file_path,
+                       sizeof(file_path),
+                       "%s/" NODE_PREFIX "%d/cpulist",
+                       path_p,
+                       id);
+    if ((0 > written) || (sizeof(file_path) <= (size_t)written))
+    {
+        print_error("node_cpus_read(): Node path too long.");
+        goto END;
+    }
+
+    file_p = fopen(file_path, "r");
+    if (NULL == file_p)
+    {
+        print_error("node_cpus_read(): Unable to open cpulist.");
+        goto END;
+    }
+
+    // An empty file leaves the list empty, which is a node without CPUs
+    if ((NULL == fgets(list, sizeof(list), file_p)) && (0 != ferror(file_p)))
+    {
+        print_error("node_cpus_read(): Unable to read cpulist.");
+        goto END;
+    }
+
+    if (E_SUCCESS != cpu_list_parse(list, set_p))
+    {
+        print_error("node_cpus_read(): Malformed cpulist.");
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    if (NULL != file_p)
+    {
+        fclose(file_p);
+    }
+    return exit_code;
+}
+
+/*** end of file ***/
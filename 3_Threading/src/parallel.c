@@ -0,0 +1,341 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "parallel.h"
+#include "utilities.h"
+
+#define CHUNK_DIVISOR 2 // Chunks are the rest split this many ways per thread
+
+/**
+ * @brief A struct for one parallel loop. It is shared by the caller and
+ * the helper jobs, and freed by whichever lets go of it last.
+ *
+ */
+typedef struct parallel
+{
+    atomic_size_t next;       // The first index not handed out yet
+    size_t end;               // One past the last index
+    size_t grain;             // The smallest chunk handed out
+    size_t participants;      // The threads sharing the range, with the caller
+    RANGE_F for_f;            // The loop body of threadpool_parallel_for()
+    RANGE_REDUCE_F range_f;   // Reduces a chunk in a reduction
+    COMBINE_F combine_f;      // Merges partial results in a reduction
+    void *ctx_p;              // Passed to every callback
+    pthread_mutex_t mutex;    // Guards result_p and done
+    pthread_cond_t condition; // Signaled once done reaches count
+    void *result_p;           // The partial results merged so far
+    size_t count;             // The number of indexes in the loop
+    size_t done;              // The indexes finished and merged
+    atomic_size_t refs;       // Held by the caller and by every helper job
+} parallel_t;
+
+/**
+ * @brief Sets up a loop, shares it with the threadpool and works on it
+ * until every index has finished.
+ *
+ * @param pool_p The threadpool to share the loop with
+ * @param loop_p The loop, with the range and callbacks filled in. Freed by
+ * the loop.
+ * @param result_pp Set to the merged result of a reduction, may be NULL
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int parallel_run(threadpool_t *pool_p,
+                        parallel_t *loop_p,
+                        void **result_pp);
+
+/**
+ * @brief Hands out the next chunk of a loop: what is left divided between
+ * the participants, but no less than the grain.
+ *
+ * @param loop_p The loop to take a chunk from
+ * @param begin_p Set to the first index of the chunk
+ * @param end_p Set to one past the last index of the chunk
+ * @return bool Returns false once the whole range has been handed out
+ */
+static bool parallel_claim(parallel_t *loop_p, size_t *begin_p, size_t *end_p);
+
+/**
+ * @brief Works through chunks until the range runs out, then merges what
+ * was done into the loop.
+ *
+ * @param loop_p The loop to work on
+ */
+static void parallel_participate(parallel_t *loop_p);
+
+/**
+ * @brief The job run by the threadpool's threads to help with a loop.
+ *
+ * @param loop_p The loop to help with
+ * @return void* Always NULL
+ */
+static void *parallel_helper(void *loop_p);
+
+/**
+ * @brief Drops a reference to a loop, freeing it with the last one.
+ *
+ * @param loop_p The loop to let go of
+ */
+static void parallel_put(parallel_t *loop_p);
+
+int threadpool_parallel_for(threadpool_t *pool_p,
+                            size_t begin,
+                            size_t end,
+                            size_t grain,
+                            RANGE_F fn,
+                            void *ctx_p)
+{
+    int exit_code = E_FAILURE;
+    parallel_t *loop_p = NULL;
+
+    if ((NULL == pool_p) || (NULL == fn))
+    {
+        print_error("threadpool_parallel_for(): NULL argument passed.");
+        goto END;
+    }
+
+    if (begin > end)
+    {
+        print_error("threadpool_parallel_for(): Invalid range.");
+        goto END;
+    }
+
+    loop_p = calloc(1, sizeof(parallel_t));
+    if (NULL == loop_p)
+    {
+        print_error("threadpool_parallel_for(): CMR failure.");
+        goto END;
+    }
+
+    atomic_init(&loop_p->next, begin);
+    loop_p->end = end;
+    loop_p->grain = grain;
+    loop_p->for_f = fn;
+    loop_p->ctx_p = ctx_p;
+
+    exit_code = parallel_run(pool_p, loop_p, NULL);
+
+END:
+    return exit_code;
+}
+
+int threadpool_parallel_reduce(threadpool_t *pool_p,
+                               size_t begin,
+                               size_t end,
+                               size_t grain,
+                               RANGE_REDUCE_F range_f,
+                               COMBINE_F combine_f,
+                               void *identity_p,
+                               void *ctx_p,
+                               void **result_pp)
+{
+    int exit_code = E_FAILURE;
+    parallel_t *loop_p = NULL;
+
+    if ((NULL == pool_p) || (NULL == range_f) || (NULL == combine_f) ||
+        (NULL == result_pp))
+    {
+        print_error("threadpool_parallel_reduce(): NULL argument passed.");
+        goto END;
+    }
+
+    if (begin > end)
+    {
+        print_error("threadpool_parallel_reduce(): Invalid range.");
+        goto END;
+    }
+
+    loop_p = calloc(1, sizeof(parallel_t));
+    if (NULL == loop_p)
+    {
+        print_error("threadpool_parallel_reduce(): CMR failure.");
+        goto END;
+    }
+
+    atomic_init(&loop_p->next, begin);
+    loop_p->end = end;
+    loop_p->grain = grain;
+    loop_p->range_f = range_f;
+    loop_p->combine_f = combine_f;
+    loop_p->ctx_p = ctx_p;
+    loop_p->result_p = identity_p;
+
+    exit_code = parallel_run(pool_p, loop_p, result_pp);
+
+END:
+    return exit_code;
+}
+
+static int parallel_run(threadpool_t *pool_p,
+                        parallel_t *loop_p,
+                        void **result_pp)
+{
+    int exit_code = E_FAILURE;
+    size_t chunks = 0;
+    size_t helpers = 0;
+    size_t added = 0;
+
+    loop_p->count = loop_p->end - atomic_load(&loop_p->next);
+    loop_p->grain = (0 == loop_p->grain) ? 1 : loop_p->grain;
+
+    if (E_SUCCESS != pthread_mutex_init(&loop_p->mutex, NULL))
+    {
+        print_error("parallel_run(): Unable to initialize mutex.");
+        free(loop_p);
+        goto END;
+    }
+
+    if (E_SUCCESS != pthread_cond_init(&loop_p->condition, NULL))
+    {
+        print_error("parallel_run(): Unable to initialize condition.");
+        pthread_mutex_destroy(&loop_p->mutex);
+        free(loop_p);
+        goto END;
+    }
+
+    // One helper per thread, but never more than there are chunks to share
+    chunks = (loop_p->count / loop_p->grain) +
+             ((0 != (loop_p->count % loop_p->grain)) ? 1 : 0);
+    helpers = threadpool_thread_count(pool_p);
+    if (helpers >= chunks)
+    {
+        helpers = (0 == chunks) ? 0 : chunks - 1;
+    }
+    loop_p->participants = helpers + 1;
+    atomic_init(&loop_p->refs, helpers + 1);
+
+    // The caller blocks until the loop is done, so helpers skip ahead
+    for (added = 0; added < helpers; added++)
+    {
+        if (E_SUCCESS != threadpool_add_job_priority(pool_p,
+                                                     THREADPOOL_PRIORITY_HIGH,
+                                                     parallel_helper,
+                                                     NULL,
+                                                     loop_p))
+        {
+            break;
+        }
+    }
+
+    // Whatever the threadpool did not take, the caller does itself
+    if (added != helpers)
+    {
+        atomic_fetch_sub(&loop_p->refs, helpers - added);
+    }
+
+    parallel_participate(loop_p);
+
+    // Helpers still running their last chunk finish it before done is full
+    pthread_mutex_lock(&loop_p->mutex);
+    while (loop_p->count != loop_p->done)
+    {
+        pthread_cond_wait(&loop_p->condition, &loop_p->mutex);
+    }
+
+    if (NULL != result_pp)
+    {
+        *result_pp = loop_p->result_p;
+    }
+    pthread_mutex_unlock(&loop_p->mutex);
+
+    parallel_put(loop_p);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static bool parallel_claim(parallel_t *loop_p, size_t *begin_p, size_t *end_p)
+{
+    bool claimed = false;
+    size_t next = atomic_load(&loop_p->next);
+    size_t chunk = 0;
+
+    do
+    {
+        if (loop_p->end <= next)
+        {
+            goto END;
+        }
+
+        // Large chunks while plenty is left, down to the grain at the tail
+        chunk = (loop_p->end - next) / (CHUNK_DIVISOR * loop_p->participants);
+        chunk = (loop_p->grain > chunk) ? loop_p->grain : chunk;
+        chunk = ((loop_p->end - next) < chunk) ? (loop_p->end - next) : chunk;
+    } while (!atomic_compare_exchange_weak(&loop_p->next, &next, next + chunk));
+
+    *begin_p = next;
+    *end_p = next + chunk;
+    claimed = true;
+
+END:
+    return claimed;
+}
+
+static void parallel_participate(parallel_t *loop_p)
+{
+    size_t begin = 0;
+    size_t end = 0;
+    size_t done = 0;
+    void *partial_p = NULL;
+    void *merged_p = NULL;
+
+    while (parallel_claim(loop_p, &begin, &end))
+    {
+        if (NULL != loop_p->for_f)
+        {
+            loop_p->for_f(begin, end, loop_p->ctx_p);
+        }
+        else
+        {
+            // Merged locally first, the loop's lock is taken once at the end
+            partial_p = loop_p->range_f(begin, end, loop_p->ctx_p);
+            merged_p = (0 == done) ? partial_p
+                                   : loop_p->combine_f(
+                                         merged_p, partial_p, loop_p->ctx_p);
+        }
+        done += end - begin;
+    }
+
+    if (0 == done)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&loop_p->mutex);
+    if (NULL != loop_p->combine_f)
+    {
+        loop_p->result_p =
+            loop_p->combine_f(loop_p->result_p, merged_p, loop_p->ctx_p);
+    }
+
+    loop_p->done += done;
+    if (loop_p->count == loop_p->done)
+    {
+        pthread_cond_signal(&loop_p->condition);
+    }
+    pthread_mutex_unlock(&loop_p->mutex);
+}
+
+static void *parallel_helper(void *loop_p)
+{
+    parallel_participate((parallel_t *)loop_p);
+    parallel_put((parallel_t *)loop_p);
+
+    return NULL;
+}
+
+static void parallel_put(parallel_t *loop_p)
+{
+    if (1 != atomic_fetch_sub(&loop_p->refs, 1))
+    {
+        return;
+    }
+
+    pthread_cond_destroy(&loop_p->condition);
+    pthread_mutex_destroy(&loop_p->mutex);
+    free(loop_p);
+}
+
+/*** end of file ***/
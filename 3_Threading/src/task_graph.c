@@ -0,0 +1,553 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "task_graph.h"
+#include "utilities.h"
+
+#define INITIAL_TASKS      16 // Tasks allocated by the first task added
+#define INITIAL_SUCCESSORS 4  // Edges allocated by a task's first outgoing edge
+
+/**
+ * @brief A struct for one task of a graph.
+ *
+ */
+typedef struct graph_task
+{
+    JOB_F job;                  // The job run for the task
+    FREE_F del_f;               // Frees arg_p when the graph is destroyed
+    void *arg_p;                // Passed to job on every run
+    void *result_p;             // What job returned on the last run
+    size_t *successors;         // The ids of the tasks waiting for this one
+    size_t successor_count;     // The number of entries in successors
+    size_t successor_capacity;  // The number of successors allocated
+    size_t predecessors;        // The number of tasks this one waits for
+    atomic_size_t pending;      // Predecessors not finished on this run
+    struct graph_task *ready_p; // The next task in a thread's ready list
+    task_graph_t *graph_p;      // The graph holding the task
+} graph_task_t;
+
+/**
+ * @brief A struct for a graph of tasks.
+ *
+ */
+struct task_graph
+{
+    graph_task_t *tasks;     // The tasks, indexed by id
+    size_t count;            // The number of tasks
+    size_t capacity;         // The number of tasks allocated
+    bool checked;            // No cycles since the last edge was added
+    threadpool_t *pool_p;    // The threadpool of the current run
+    atomic_size_t remaining; // Tasks of the current run not finished yet
+    pthread_mutex_t mutex;   // Guards running
+    pthread_cond_t finished; // Broadcast when a run finishes
+    bool running;            // A run has been submitted and not finished
+};
+
+/**
+ * @brief Checks that the graph has no cycles, by taking away tasks with no
+ * predecessors left until none remain.
+ *
+ * @param graph_p The graph to check
+ * @return int Returns 0 if the graph has no cycles, -1 otherwise
+ */
+static int graph_check(task_graph_t *graph_p);
+
+/**
+ * @brief Runs a list of ready tasks and every task they make ready in turn.
+ * One ready task is kept for the calling thread, the rest are queued on the
+ * threadpool, or kept too if it has no room for them.
+ *
+ * @param ready_p The first task of the list
+ */
+static void graph_drain(graph_task_t *ready_p);
+
+/**
+ * @brief The job run by the threadpool's threads for a ready task.
+ *
+ * @param task_p The task to run
+ * @return void* Always NULL
+ */
+static void *graph_task_job(void *task_p);
+
+/**
+ * @brief Counts a task, or the submission itself, as finished, ending the
+ * run with the last one.
+ *
+ * @param graph_p The graph that is running
+ */
+static void graph_finish(task_graph_t *graph_p);
+
+task_graph_t *task_graph_create(void)
+{
+    task_graph_t *graph_p = NULL;
+
+    graph_p = calloc(1, sizeof(task_graph_t));
+    if (NULL == graph_p)
+    {
+        print_error("task_graph_create(): CMR failure.");
+        goto END;
+    }
+
+    if (E_SUCCESS != pthread_mutex_init(&graph_p->mutex, NULL))
+    {
+        print_error("task_graph_create(): Unable to initialize mutex.");
+        free(graph_p);
+        graph_p = NULL;
+        goto END;
+    }
+
+    if (E_SUCCESS != pthread_cond_init(&graph_p->finished, NULL))
+    {
+        print_error("task_graph_create(): Unable to initialize condition.");
+        pthread_mutex_destroy(&graph_p->mutex);
+        free(graph_p);
+        graph_p = NULL;
+        goto END;
+    }
+
+    graph_p->checked = true;
+    atomic_init(&graph_p->remaining, 0);
+
+END:
+    return graph_p;
+}
+
+int task_graph_destroy(task_graph_t **graph_pp)
+{
+    int exit_code = E_FAILURE;
+    task_graph_t *graph_p = NULL;
+    bool running = false;
+
+    if ((NULL == graph_pp) || (NULL == *graph_pp))
+    {
+        print_error("task_graph_destroy(): NULL argument passed.");
+        goto END;
+    }
+
+    graph_p = *graph_pp;
+    pthread_mutex_lock(&graph_p->mutex);
+    running = graph_p->running;
+    pthread_mutex_unlock(&graph_p->mutex);
+    if (running)
+    {
+        print_error("task_graph_destroy(): Graph is running.");
+        goto END;
+    }
+
+    for (size_t idx = 0; idx < graph_p->count; idx++)
+    {
+        if (NULL != graph_p->tasks[idx].del_f)
+        {
+            graph_p->tasks[idx].del_f(graph_p->tasks[idx].arg_p);
+        }
+        free(graph_p->tasks[idx].successors);
+    }
+
+    pthread_cond_destroy(&graph_p->finished);
+    pthread_mutex_destroy(&graph_p->mutex);
+    free(graph_p->tasks);
+    free(graph_p);
+    *graph_pp = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int task_graph_add_task(task_graph_t *graph_p,
+                        JOB_F job,
+                        FREE_F del_f,
+                        void *arg_p,
+                        size_t *task_id_p)
+{
+    int exit_code = E_FAILURE;
+    graph_task_t *tasks = NULL;
+    graph_task_t *task_p = NULL;
+    size_t capacity = 0;
+    bool running = false;
+
+    if ((NULL == graph_p) || (NULL == job) || (NULL == task_id_p))
+    {
+        print_error("task_graph_add_task(): NULL argument passed.");
+        goto END;
+    }
+
+    pthread_mutex_lock(&graph_p->mutex);
+    running = graph_p->running;
+    pthread_mutex_unlock(&graph_p->mutex);
+    if (running)
+    {
+        print_error("task_graph_add_task(): Graph is running.");
+        goto END;
+    }
+
+    if (graph_p->count == graph_p->capacity)
+    {
+        capacity = (0 == graph_p->capacity) ? INITIAL_TASKS
+                                            : graph_p->capacity * 2;
+        tasks = realloc(graph_p->tasks, capacity * sizeof(graph_task_t));
+        if (NULL == tasks)
+        {
+            print_error("task_graph_add_task(): CMR failure.");
+            goto END;
+        }
+
+        graph_p->tasks = tasks;
+        graph_p->capacity = capacity;
+    }
+
+    task_p = &graph_p->tasks[graph_p->count];
+    *task_p = (graph_task_t){ 0 };
+    task_p->job = job;
+    task_p->del_f = del_f;
+    task_p->arg_p = arg_p;
+    task_p->graph_p = graph_p;
+    atomic_init(&task_p->pending, 0);
+
+    *task_id_p = graph_p->count;
+    graph_p->count++;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int task_graph_add_edge(task_graph_t *graph_p, size_t before, size_t after)
+{
+    int exit_code = E_FAILURE;
+    graph_task_t *task_p = NULL;
+    size_t *successors = NULL;
+    size_t capacity = 0;
+    bool running = false;
+
+    if (NULL == graph_p)
+    {
+        print_error("task_graph_add_edge(): NULL argument passed.");
+        goto END;
+    }
+
+    if ((before >= graph_p->count) || (after >= graph_p->count) ||
+        (before == after))
+    {
+        print_error("task_graph_add_edge(): Invalid task id.");
+        goto END;
+    }
+
+    pthread_mutex_lock(&graph_p->mutex);
+    running = graph_p->running;
+    pthread_mutex_unlock(&graph_p->mutex);
+    if (running)
+    {
+        print_error("task_graph_add_edge(): Graph is running.");
+        goto END;
+    }
+
+    task_p = &graph_p->tasks[before];
+    if (task_p->successor_count == task_p->successor_capacity)
+    {
+        capacity = (0 == task_p->successor_capacity)
+                       ? INITIAL_SUCCESSORS
+                       : task_p->successor_capacity * 2;
+        successors = realloc(task_p->successors, capacity * sizeof(size_t));
+        if (NULL == successors)
+        {
+            print_error("task_graph_add_edge(): CMR failure.");
+            goto END;
+        }
+
+        task_p->successors = successors;
+        task_p->successor_capacity = capacity;
+    }
+
+    task_p->successors[task_p->successor_count] = after;
+    task_p->successor_count++;
+    graph_p->tasks[after].predecessors++;
+    graph_p->checked = false;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int task_graph_submit(task_graph_t *graph_p, threadpool_t *pool_p)
+{
+    int exit_code = E_FAILURE;
+    graph_task_t *task_p = NULL;
+    graph_task_t *inline_p = NULL;
+
+    if ((NULL == graph_p) || (NULL == pool_p))
+    {
+        print_error("task_graph_submit(): NULL argument passed.");
+        goto END;
+    }
+
+    if ((!graph_p->checked) && (E_SUCCESS != graph_check(graph_p)))
+    {
+        print_error("task_graph_submit(): Graph has a cycle.");
+        goto END;
+    }
+
+    pthread_mutex_lock(&graph_p->mutex);
+    if (graph_p->running)
+    {
+        pthread_mutex_unlock(&graph_p->mutex);
+        print_error("task_graph_submit(): Graph is already running.");
+        goto END;
+    }
+
+    if (0 == graph_p->count)
+    {
+        pthread_mutex_unlock(&graph_p->mutex);
+        exit_code = E_SUCCESS;
+        goto END;
+    }
+
+    graph_p->running = true;
+    pthread_mutex_unlock(&graph_p->mutex);
+
+    // Every count is reset before the first task can finish and decrement
+    // one. The submission holds one more, so the run cannot finish, and the
+    // graph be freed, while the tasks are still being queued.
+    graph_p->pool_p = pool_p;
+    atomic_store(&graph_p->remaining, graph_p->count + 1);
+    for (size_t idx = 0; idx < graph_p->count; idx++)
+    {
+        atomic_store_explicit(&graph_p->tasks[idx].pending,
+                              graph_p->tasks[idx].predecessors,
+                              memory_order_relaxed);
+        graph_p->tasks[idx].ready_p = NULL;
+    }
+
+    for (size_t idx = 0; idx < graph_p->count; idx++)
+    {
+        task_p = &graph_p->tasks[idx];
+        if (0 != task_p->predecessors)
+        {
+            continue;
+        }
+
+        if (E_SUCCESS !=
+            threadpool_add_job(pool_p, graph_task_job, NULL, task_p))
+        {
+            task_p->ready_p = inline_p;
+            inline_p = task_p;
+        }
+    }
+
+    graph_drain(inline_p);
+    graph_finish(graph_p);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int task_graph_wait(task_graph_t *graph_p)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == graph_p)
+    {
+        print_error("task_graph_wait(): NULL argument passed.");
+        goto END;
+    }
+
+    pthread_mutex_lock(&graph_p->mutex);
+    while (graph_p->running)
+    {
+        pthread_cond_wait(&graph_p->finished, &graph_p->mutex);
+    }
+    pthread_mutex_unlock(&graph_p->mutex);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int task_graph_run(task_graph_t *graph_p, threadpool_t *pool_p)
+{
+    int exit_code = E_FAILURE;
+
+    if (E_SUCCESS != task_graph_submit(graph_p, pool_p))
+    {
+        goto END;
+    }
+
+    exit_code = task_graph_wait(graph_p);
+END:
+    return exit_code;
+}
+
+int task_graph_result(task_graph_t *graph_p,
+                      size_t task_id,
+                      void **result_pp)
+{
+    int exit_code = E_FAILURE;
+    bool running = false;
+
+    if ((NULL == graph_p) || (NULL == result_pp))
+    {
+        print_error("task_graph_result(): NULL argument passed.");
+        goto END;
+    }
+
+    if (task_id >= graph_p->count)
+    {
+        print_error("task_graph_result(): Invalid task id.");
+        goto END;
+    }
+
+    pthread_mutex_lock(&graph_p->mutex);
+    running = graph_p->running;
+    pthread_mutex_unlock(&graph_p->mutex);
+    if (running)
+    {
+        print_error("task_graph_result(): Graph is running.");
+        goto END;
+    }
+
+    *result_pp = graph_p->tasks[task_id].result_p;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+size_t task_graph_task_count(task_graph_t *graph_p)
+{
+    return (NULL == graph_p) ? 0 : graph_p->count;
+}
+
+static int graph_check(task_graph_t *graph_p)
+{
+    int exit_code = E_FAILURE;
+    size_t *degrees = NULL;
+    size_t *stack = NULL;
+    size_t depth = 0;
+    size_t visited = 0;
+    size_t id = 0;
+    graph_task_t *task_p = NULL;
+
+    degrees = calloc(graph_p->count, sizeof(size_t));
+    stack = calloc(graph_p->count, sizeof(size_t));
+    if ((NULL == degrees) || (NULL == stack))
+    {
+        print_error("graph_check(): CMR failure.");
+        goto END;
+    }
+
+    for (id = 0; id < graph_p->count; id++)
+    {
+        degrees[id] = graph_p->tasks[id].predecessors;
+        if (0 == degrees[id])
+        {
+            stack[depth] = id;
+            depth++;
+        }
+    }
+
+    // Tasks on a cycle never run out of predecessors and are never visited
+    while (0 != depth)
+    {
+        depth--;
+        task_p = &graph_p->tasks[stack[depth]];
+        visited++;
+
+        for (size_t idx = 0; idx < task_p->successor_count; idx++)
+        {
+            id = task_p->successors[idx];
+            degrees[id]--;
+            if (0 == degrees[id])
+            {
+                stack[depth] = id;
+                depth++;
+            }
+        }
+    }
+
+    if (visited != graph_p->count)
+    {
+        goto END;
+    }
+
+    graph_p->checked = true;
+    exit_code = E_SUCCESS;
+END:
+    free(stack);
+    free(degrees);
+    return exit_code;
+}
+
+static void graph_drain(graph_task_t *ready_p)
+{
+    graph_task_t *task_p = NULL;
+    graph_task_t *queued_p = NULL;
+    graph_task_t *successor_p = NULL;
+    task_graph_t *graph_p = NULL;
+
+    while (NULL != ready_p)
+    {
+        graph_p = ready_p->graph_p;
+
+        // Keep the first ready task for this thread and queue the rest, a
+        // task is unlinked before it is queued since its job walks the list
+        while (NULL != ready_p->ready_p)
+        {
+            queued_p = ready_p->ready_p;
+            ready_p->ready_p = queued_p->ready_p;
+            queued_p->ready_p = NULL;
+            if (E_SUCCESS != threadpool_add_job(graph_p->pool_p,
+                                                graph_task_job,
+                                                NULL,
+                                                queued_p))
+            {
+                queued_p->ready_p = ready_p->ready_p;
+                ready_p->ready_p = queued_p;
+                break;
+            }
+        }
+
+        task_p = ready_p;
+        ready_p = task_p->ready_p;
+        task_p->ready_p = NULL;
+        task_p->result_p = task_p->job(task_p->arg_p);
+
+        for (size_t idx = 0; idx < task_p->successor_count; idx++)
+        {
+            successor_p = &graph_p->tasks[task_p->successors[idx]];
+            if (1 == atomic_fetch_sub(&successor_p->pending, 1))
+            {
+                successor_p->ready_p = ready_p;
+                ready_p = successor_p;
+            }
+        }
+
+        // Every task made ready is on the list, so the run cannot finish
+        // before the list is empty
+        graph_finish(graph_p);
+    }
+}
+
+static void *graph_task_job(void *task_p)
+{
+    graph_drain((graph_task_t *)task_p);
+
+    return NULL;
+}
+
+static void graph_finish(task_graph_t *graph_p)
+{
+    if (1 != atomic_fetch_sub(&graph_p->remaining, 1))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&graph_p->mutex);
+    graph_p->running = false;
+    pthread_cond_broadcast(&graph_p->finished);
+    pthread_mutex_unlock(&graph_p->mutex);
+}
+
+/*** end of file ***/
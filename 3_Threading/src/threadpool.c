@@ -1,18 +1,56 @@
+#define _GNU_SOURCE // sched_setaffinity(), sched_getcpu(), clock_gettime()
+
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "cpu_topology.h"
+#include "mpmc_queue.h"
 #include "signal_handler.h"
+#include "slab.h"
 #include "threadpool.h"
+#include "timer_wheel.h"
 #include "utilities.h"
+#include "ws_deque.h"
 
-#define QUEUE_MAX_CAPACITY 1024 // Maximum size for a queue
 #define ACTIVATE 1              // Activate the threadpool
 #define SHUTDOWN 0              // Shutdown the threadpool
-#define EMPTY 0                 // Work queue is empty
-#define NOT_EMPTY 1             // Work queue is not empty
 #define KEEP_RUNNING 0          // Default signal for the signal handler
+#define WORKER_BATCH_MAX 8      // Most jobs a thread takes per queue access
+#define WORKER_DEQUE_CAPACITY 256 // Initial size of a thread's local deque
+#define FUTURE_WAIT_BUCKETS 16    // Mutex/condition pairs futures wait on
+#define FUTURE_STATE_PENDING 0    // The job has not finished
+#define FUTURE_STATE_CONTINUED 1  // Not finished, a continuation is attached
+#define FUTURE_STATE_DONE 2       // The job has finished, result is set
+#define NSEC_PER_MSEC 1000000L
+#define NSEC_PER_SEC 1000000000L
+#define WORKER_EMPTY 0            // The slot has never run a thread
+#define WORKER_RUNNING 1          // The slot's thread is running
+#define WORKER_EXITED 2           // The slot's thread retired, join to reuse
+#define WORKER_RETIRING 3         // The slot's thread retired, tearing down
+#define NODE_LOCAL SIZE_MAX       // Queue on the node of the adding thread
+#define SPIN_BACKOFF_MAX 64       // Most CPU pauses between two spin polls
+#define SPIN_FLOOR_DIVISOR 16     // Parking never shrinks spinning below this
+#define STATS_SHARDS 16           // Counter shards threads are spread over
+#define STATS_CACHE_LINE 64       // Keeps every shard on its own cache lines
+#define SUBMIT_NO_WAIT 0          // Deadline of a submission that never waits
+#define SUBMIT_FOREVER UINT64_MAX // Deadline of a submission without timeout
+#define TIMER_TICK_NS NSEC_PER_MSEC // The resolution of delayed jobs
+#define TIMER_NO_WAKE UINT64_MAX    // The timer thread sleeps until signaled
+#define TOKEN_STATE_QUEUED 0        // The job has not started
+#define TOKEN_STATE_RUNNING 1       // The job is running
+#define TOKEN_STATE_CANCELLING 2    // Running, and asked to stop
+#define TOKEN_STATE_CANCELLED 3     // Cancelled before it started, skipped
+#define TOKEN_STATE_DONE 4          // The job has finished
+#define STRAND_BATCH_MAX 32         // Jobs a strand runs before it requeues
+#define STRAND_HASH 0x9E3779B97F4A7C15ULL // 2^64 / golden ratio, spreads keys
 
 /**
  * @brief A struct for a job
@@ -20,38 +58,246 @@
  */
 typedef struct job
 {
-    JOB_F job;    // The job to perform
-    FREE_F del_f; // The custom free function for the job
-    void *args_p; // The arguments for the job
+    JOB_F job;                      // The job to perform
+    FREE_F del_f;                   // The custom free function for the job
+    void *args_p;                   // The arguments for the job
+    threadpool_future_t *future_p;  // Completed with the result, may be NULL
+    uint64_t queued_ns;             // When it was queued, if it is timed
+    threadpool_priority_t priority; // The lane it was queued in
+    struct job *next_p;             // The next job of its strand, if keyed
 } job_t;
 
+/**
+ * @brief A struct for a serial queue of keyed jobs. At most one thread runs
+ * a strand at a time, taking its jobs in the order they were added.
+ *
+ */
+typedef struct strand
+{
+    alignas(STATS_CACHE_LINE) pthread_mutex_t mutex; // Guards the fields below
+    struct threadpool *pool_p; // The threadpool the strand runs on
+    job_t *head_p;             // The oldest job waiting
+    job_t *tail_p;             // The newest job waiting
+    bool scheduled;            // A run of the strand is queued or running
+} strand_t;
+
+/**
+ * @brief A struct for a delayed or periodic job, held by the timing wheel
+ * and by its run while one is queued.
+ *
+ */
+typedef struct pool_timer
+{
+    JOB_F job;           // The job to queue on expiry
+    FREE_F del_f;        // Frees args_p once the last reference is dropped
+    void *args_p;        // The arguments for the job
+    uint64_t period;     // Ticks between two runs, 0 for a delayed job
+    atomic_bool queued;  // A run is queued or running
+    atomic_size_t refs;  // Held by the wheel and by a queued run
+} pool_timer_t;
+
+/**
+ * @brief A struct for a cancellation token. It is shared by the job and the
+ * caller of threadpool_add_job_cancellable(), and goes back to the token
+ * slab once both are done.
+ *
+ */
+struct threadpool_token
+{
+    struct threadpool *pool_p; // The threadpool the job runs on
+    JOB_F job;                 // The job to perform
+    FREE_F del_f;              // The custom free function for the job
+    void *args_p;              // The arguments for the job
+    atomic_int state;          // One of the TOKEN_STATE values
+    atomic_int refs;           // Held by the job and by the caller
+};
+
+/**
+ * @brief A histogram of durations, see threadpool_histogram_t
+ *
+ */
+typedef struct stats_histogram
+{
+    _Atomic(uint64_t) count;                                 // Samples
+    _Atomic(uint64_t) sum_ns;                                // Their sum
+    _Atomic(uint64_t) max_ns;                                // The longest
+    _Atomic(uint64_t) buckets[THREADPOOL_HISTOGRAM_BUCKETS]; // Per bucket
+} stats_histogram_t;
+
+/**
+ * @brief A struct for one shard of a threadpool's counters. Threads count
+ * into the shard assigned to them, so counting rarely shares a cache line
+ * with another thread.
+ *
+ */
+typedef struct stats_shard
+{
+    alignas(STATS_CACHE_LINE) _Atomic(uint64_t) submitted; // Jobs accepted
+    _Atomic(uint64_t) rejected;                            // Jobs refused
+    _Atomic(uint64_t) started;                             // Jobs taken
+    _Atomic(uint64_t) completed;                           // Jobs finished
+    _Atomic(uint64_t) cancelled;                           // Jobs skipped
+    _Atomic(uint64_t) busy_ns;                             // Time running
+    stats_histogram_t wait;                                // Time queued
+    stats_histogram_t run;                                 // Time running
+} stats_shard_t;
+
+/**
+ * @brief A struct for a future. It is shared by the job and the caller of
+ * threadpool_submit(), and goes back to the future slab once both are done.
+ *
+ */
+struct threadpool_future
+{
+    struct threadpool *pool_p; // The threadpool the job runs on
+    void *result_p;            // The job's result, set before state is DONE
+    CONTINUATION_F then_f;     // Set before state becomes CONTINUED
+    void *then_arg_p;          // The argument passed to then_f
+    atomic_int state;          // One of the FUTURE_STATE values
+    atomic_int refs;           // Held by the job and by the caller
+    atomic_int waiters;        // Threads asleep waiting for the job
+};
+
+/**
+ * @brief A mutex and condition that waiting threads sleep on. Futures share
+ * a few of them instead of carrying their own.
+ *
+ */
+typedef struct future_bucket
+{
+    pthread_mutex_t mutex;    // Guards the sleep on condition
+    pthread_cond_t condition; // Broadcast when a waited-on future finishes
+} future_bucket_t;
+
+/**
+ * @brief A struct for the job queue, wrapping whichever backend was selected
+ * with one lane per priority class
+ *
+ */
+typedef struct job_queue
+{
+    threadpool_queue_type_t type;                 // The backend in use
+    queue_t *queues_p[THREADPOOL_PRIORITIES];     // THREADPOOL_QUEUE_MUTEX
+    mpmc_queue_t *mpmcs_p[THREADPOOL_PRIORITIES]; // THREADPOOL_QUEUE_LOCKFREE
+    pthread_mutex_t mutex;                        // Guards queues_p
+    bool mutex_initialized;                       // States if mutex is ready
+    threadpool_lane_policy_t policy;              // How lanes are picked
+    uint32_t weights[THREADPOOL_PRIORITIES];      // Lane shares, WEIGHTED
+    uint32_t weight_total;                        // The sum of weights
+    uint32_t starvation_limit;                    // Boost period, STRICT
+    atomic_uint picks;                            // Counts pops
+    atomic_size_t high_waiting; // Jobs in the HIGH lane, never undercounted
+} job_queue_t;
+
+/**
+ * @brief A struct for a thread of the threadpool
+ *
+ */
+typedef struct worker
+{
+    struct threadpool *pool_p; // The threadpool the thread belongs to
+    size_t id;                 // The index of the thread in the threadpool
+    ws_deque_t *deque_p;       // Local jobs, THREADPOOL_SCHED_STEALING only
+    uint32_t seed;             // State for picking a thread to steal from
+    int state;                 // A WORKER_ value, guarded by the pool mutex
+    size_t node;               // The node whose job queue it serves first
+    bool pinned;               // States if the thread is bound to cpus
+    cpu_set_t cpus;            // The CPUs the thread runs on when pinned
+    uint32_t spin_limit;       // Polls before yielding, adapts to the load
+    uint64_t started_ns;       // When the thread started, guarded by mutex
+    void *ctx_p;               // Built by worker_init for the thread
+
+    // The jobs of its batch it has not started, other threads may take them
+    _Atomic(job_t *) batch[WORKER_BATCH_MAX];
+    atomic_size_t batch_left; // The number of them
+} worker_t;
+
 /**
  * @brief A struct for a threadpool
  *
  */
 typedef struct threadpool
 {
-    size_t thread_count;          // The number of current threads
-    size_t max_threads;           // The maximum number of threads
-    queue_t *job_queue;           // A job queue
-    pthread_t *threads;           // The thread list
-    pthread_mutex_t mutex;        // The mutex for a queue
-    pthread_cond_t condition;     // Used for signaling threads
-    bool work_mutex_initialized;  // States if work mutex has been initialized
-    bool queue_mutex_initialized; // States if queue mutex has been initialized
-    bool condition_initialized;   // States if condition has been initialized
-    sig_atomic_t signal;          // A shutdown signal for the threadpool ON/OFF
+    atomic_size_t thread_count;        // The number of current threads
+    size_t min_threads;                // Threads kept alive while idle
+    size_t max_threads;                // The maximum number of threads
+    uint64_t keep_alive_ns;            // Idle time before a thread retires
+    size_t spawn_queue_depth;          // Backlog that adds a thread
+    uint64_t spawn_wait_ns;            // Queue wait that adds a thread, or 0
+    uint32_t spin_count;               // Most polls before a thread yields
+    uint32_t yield_count;              // Yielding polls before it parks
+    bool time_jobs;                    // Jobs are timed for the stats
+    WORKER_INIT_F worker_init;         // Builds every thread's context
+    WORKER_TEARDOWN_F worker_teardown; // Releases it as the thread exits
+    void *worker_arg_p;                // Passed to both
+    stats_shard_t *stats_shards;       // Counters, STATS_SHARDS of them
+    atomic_size_t high_water;          // Most jobs queued or running at once
+    uint64_t created_ns;               // When the threadpool was created
+    uint64_t retired_ns;               // Lifetimes of retired threads, mutex
+    size_t retiring;                   // Retired threads tearing down, mutex
+    bool bounded;                      // States if the job queues can fill up
+    pthread_mutex_t full_mutex;        // Submitters wait for room on this
+    pthread_cond_t not_full;           // Signaled when jobs leave a job queue
+    atomic_size_t full_waiters;        // Submitters waiting for room
+    bool full_mutex_initialized;       // States if full_mutex is ready
+    bool not_full_initialized;         // States if not_full is ready
+    timer_wheel_t *timers;             // Delayed and periodic jobs
+    pthread_mutex_t timer_mutex;       // Guards timers and the timer thread
+    pthread_cond_t timer_condition;    // Wakes the timer thread early
+    pthread_t timer_thread;            // Queues jobs as their timers expire
+    bool timer_started;                // States if timer_thread is running
+    bool timer_stop;                   // Tells the timer thread to exit
+    uint64_t timer_tick;               // The tick the wheel is moving to
+    uint64_t timer_wake;               // The tick the timer thread sleeps to
+    bool timer_mutex_initialized;      // States if timer_mutex is ready
+    bool timer_condition_initialized;  // States if timer_condition is ready
+    threadpool_sched_type_t scheduler; // How jobs are handed to threads
+    threadpool_affinity_t affinity;    // Where the threads run
+    size_t node_count;                 // The number of job queues
+    cpu_set_t *node_cpus;              // The CPUs each node's threads run on
+    job_queue_t *job_queues;           // Per node, the injectors if stealing
+    slab_t *job_slab;                  // Recycles job_t between submissions
+    slab_t *future_slab;               // Recycles threadpool_future_t
+    slab_t *token_slab;                // Recycles threadpool_token_t
+    strand_t *strands;                 // Where keyed jobs wait their turn
+    size_t strand_count;               // The number of strands
+    size_t strands_initialized;        // The number of strands to destroy
+    future_bucket_t buckets[FUTURE_WAIT_BUCKETS]; // Where waiters sleep
+    size_t buckets_initialized;        // The number of buckets to destroy
+    pthread_t *threads;                // The thread list
+    worker_t *workers;                 // Per-thread state, parallel to threads
+    pthread_mutex_t mutex;             // The mutex idle threads sleep on
+    pthread_cond_t condition;          // Used for signaling threads
+    atomic_size_t idle_threads;        // Threads parked or about to park
+    atomic_size_t pending_jobs;        // Jobs queued or running
+    atomic_size_t idle_waiters;        // Threads in threadpool_wait_idle()
+    pthread_cond_t idle_condition;     // Signaled when pending_jobs hits 0
+    bool work_mutex_initialized;       // States if work mutex is initialized
+    bool condition_initialized;        // States if condition is initialized
+    bool idle_condition_initialized;   // States if idle_condition is ready
+    atomic_int signal;                 // A shutdown signal ON/OFF
 } threadpool_t;
 
+// The worker the calling thread runs as, NULL outside of every threadpool
+static _Thread_local worker_t *current_worker_g = NULL;
+
+// The token of the job the calling thread runs, NULL if it has none
+static _Thread_local threadpool_token_t *current_token_g = NULL;
+
+// The stats shard the calling thread counts into, SIZE_MAX until it counts
+static _Thread_local size_t stats_slot_g = SIZE_MAX;
+static atomic_size_t stats_slots_g = 0;
+
 /**
  * @brief Initializes a threadpool by setting up a mutex, work condition, work
  * queue, and allocating threads.
  *
  * @param threadpool_p The threadpool to setup
- * @param thread_count The number of threads to create
+ * @param cfg_p The options to create the threadpool with
  * @return int Returns 0 on success, -1 on failure
  */
-static int threadpool_setup(threadpool_t *threadpool_p, size_t thread_count);
+static int threadpool_setup(threadpool_t *threadpool_p,
+                            const threadpool_cfg_t *cfg_p);
 
 /**
  * @brief Uninitializes a threadpool if threadpool_setup() fails.
@@ -60,442 +306,3912 @@ static int threadpool_setup(threadpool_t *threadpool_p, size_t thread_count);
  */
 static void threadpool_teardown(threadpool_t **threadpool_pp);
 
+/**
+ * @brief Allocates the per-thread state, including the local deques when
+ * the threadpool uses THREADPOOL_SCHED_STEALING.
+ *
+ * @param threadpool_p The threadpool to setup workers for
+ * @param cfg_p The options holding the thread count and scheduler
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int workers_setup(threadpool_t *threadpool_p,
+                         const threadpool_cfg_t *cfg_p);
+
+/**
+ * @brief Releases the per-thread state, along with any job left in a local
+ * deque.
+ *
+ * @param threadpool_p The threadpool to tear workers down for
+ */
+static void workers_teardown(threadpool_t *threadpool_p);
+
+/**
+ * @brief Allocates the strands keyed jobs hash to.
+ *
+ * @param threadpool_p The threadpool to setup strands for
+ * @param cfg_p The options holding the strand count
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int strands_setup(threadpool_t *threadpool_p,
+                         const threadpool_cfg_t *cfg_p);
+
+/**
+ * @brief Releases the strands. Jobs still waiting in them go with the job
+ * slab.
+ *
+ * @param threadpool_p The threadpool to tear strands down for
+ */
+static void strands_teardown(threadpool_t *threadpool_p);
+
+/**
+ * @brief Runs the jobs of a strand in order until it runs dry, queueing the
+ * strand again after STRAND_BATCH_MAX of them so other jobs get a turn.
+ *
+ * @param strand_p The strand to run
+ * @return void* NULL
+ */
+static void *strand_run(void *strand_p);
+
+/**
+ * @brief Returns the worker the calling thread runs as in a threadpool.
+ *
+ * @param threadpool_p The threadpool to look for the calling thread in
+ * @return worker_t* The worker, NULL if the caller is not one of its threads
+ */
+static worker_t *current_worker(threadpool_t *threadpool_p);
+
+/**
+ * @brief Works out the CPUs the threads may run on and, with
+ * THREADPOOL_AFFINITY_NUMA, how they split into nodes, then sets up a job
+ * queue per node.
+ *
+ * @param threadpool_p The threadpool to setup job queues for
+ * @param cfg_p The options holding the affinity and queue settings
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int nodes_setup(threadpool_t *threadpool_p,
+                       const threadpool_cfg_t *cfg_p);
+
+/**
+ * @brief Reads the CPUs the threads may run on: cfg_p->cpus if set, which
+ * must all be available to the process, else every CPU available to it.
+ *
+ * @param cfg_p The options holding the CPU list
+ * @param allowed_p Where the allowed CPUs are stored
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int allowed_cpus(const threadpool_cfg_t *cfg_p, cpu_set_t *allowed_p);
+
+/**
+ * @brief Returns the node a job added by the calling thread is queued on:
+ * the node of the calling worker, else the node of the CPU it runs on.
+ *
+ * @param threadpool_p The threadpool the job is added to
+ * @param worker_p The calling worker, NULL if it is not one
+ * @return size_t The node
+ */
+static size_t local_node(threadpool_t *threadpool_p, worker_t *worker_p);
+
+/**
+ * @brief Reduces a CPU set to its nth CPU, counting from 0.
+ *
+ * @param set_p The set to reduce, holding more than n CPUs
+ * @param nth The position of the CPU to keep
+ */
+static void cpu_nth(cpu_set_t *set_p, size_t nth);
+
+/**
+ * @brief Steals a job from another thread's deque, starting at a random
+ * victim and trying every other thread once.
+ *
+ * @param worker_p The worker looking for work
+ * @return job_t* The stolen job, NULL if nothing could be stolen
+ */
+static job_t *steal_job(worker_t *worker_p);
+
+/**
+ * @brief Takes a job another thread took in a batch but has not started,
+ * so it does not wait behind a long job while this thread has none.
+ *
+ * @param worker_p The worker looking for work
+ * @return job_t* The job, NULL if no batch has one left
+ */
+static job_t *steal_batched_job(worker_t *worker_p);
+
+/**
+ * @brief Finds jobs for a thread without sleeping: the newest job of its own
+ * deque, else a share of its node's job queue, else a share of another
+ * node's, else a job stolen from another thread's deque or batch.
+ *
+ * @param worker_p The worker looking for work
+ * @param jobs_pp Receives up to WORKER_BATCH_MAX jobs
+ * @return size_t The number of jobs found
+ */
+static size_t find_jobs(worker_t *worker_p, job_t **jobs_pp);
+
+/**
+ * @brief Sets up the job queue backend, one lane per priority class.
+ *
+ * @param job_queue_p The job queue to setup
+ * @param cfg_p The options holding the backend type, capacity and lane policy
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int job_queue_setup(job_queue_t *job_queue_p,
+                           const threadpool_cfg_t *cfg_p);
+
+/**
+ * @brief Releases the job queue backend.
+ *
+ * @param job_queue_p The job queue to tear down
+ */
+static void job_queue_teardown(job_queue_t *job_queue_p);
+
+/**
+ * @brief Pushes a job into a lane of the job queue. Safe to call without
+ * holding the threadpool mutex.
+ *
+ * @param job_queue_p The job queue to push into
+ * @param priority The lane to push into
+ * @param job_p The job to push
+ * @return int Returns 0 on success, -1 if the lane is full
+ */
+static int job_queue_push(job_queue_t *job_queue_p,
+                          threadpool_priority_t priority,
+                          job_t *job_p);
+
+/**
+ * @brief Pushes a job like job_queue_push(), and while the lane is full
+ * waits for room until the deadline passes or the threadpool shuts down.
+ *
+ * @param threadpool_p The threadpool the job queue belongs to
+ * @param job_queue_p The job queue to push into
+ * @param priority The lane to push into
+ * @param job_p The job to push
+ * @param deadline_ns The CLOCK_MONOTONIC time to give up at, SUBMIT_NO_WAIT
+ * or SUBMIT_FOREVER
+ * @return int Returns 0 on success, -1 if the lane stayed full
+ */
+static int job_queue_push_wait(threadpool_t *threadpool_p,
+                               job_queue_t *job_queue_p,
+                               threadpool_priority_t priority,
+                               job_t *job_p,
+                               uint64_t deadline_ns);
+
+/**
+ * @brief Wakes the submitters waiting for room, if any, after jobs left a
+ * job queue.
+ *
+ * @param threadpool_p The threadpool whose job queue has room
+ */
+static void room_freed(threadpool_t *threadpool_p);
+
+/**
+ * @brief Pushes a burst of jobs into the THREADPOOL_PRIORITY_NORMAL lane of
+ * the job queue, taking the queue lock once. Safe to call without holding
+ * the threadpool mutex.
+ *
+ * @param job_queue_p The job queue to push into
+ * @param jobs_pp The jobs to push
+ * @param count The number of jobs in jobs_pp
+ * @return size_t The number of leading jobs pushed; with the mutex backend
+ * either all or none
+ */
+static size_t job_queue_push_many(job_queue_t *job_queue_p,
+                                  job_t **jobs_pp,
+                                  size_t count);
+
+/**
+ * @brief Pops up to max jobs from the first lane with jobs, in the order
+ * picked by lane_order(). The mutex backend hands out a share of the lane's
+ * jobs sized so every thread gets work, the lock-free backend pops a single
+ * job. Safe to call without holding the threadpool mutex.
+ *
+ * @param job_queue_p The job queue to pop from
+ * @param jobs_pp Receives the popped jobs in FIFO order
+ * @param max The capacity of jobs_pp
+ * @param thread_count The number of threads sharing the queue
+ * @return size_t The number of jobs popped, 0 if the queue is empty
+ */
+static size_t job_queue_pop_batch(job_queue_t *job_queue_p,
+                                  job_t **jobs_pp,
+                                  size_t max,
+                                  size_t thread_count);
+
+/**
+ * @brief Picks the order the lanes of a job queue are tried in for one pop,
+ * following the lane policy.
+ *
+ * @param job_queue_p The job queue being popped
+ * @param order Receives every lane once, the lane to try first at index 0
+ */
+static void lane_order(job_queue_t *job_queue_p,
+                       threadpool_priority_t order[THREADPOOL_PRIORITIES]);
+
+/**
+ * @brief Takes a THREADPOOL_PRIORITY_HIGH job from the thread's node while
+ * the thread works through a batch of lower priority jobs, so the job does
+ * not wait behind the rest of the batch. Only with THREADPOOL_LANES_STRICT,
+ * weighted lanes share the threads on purpose. Each cut-in counts as a pick
+ * of lane_order(), so the starvation boosts still come due.
+ *
+ * @param worker_p The worker running the batch
+ * @return job_t* The job, NULL if none is waiting
+ */
+static job_t *preempt_job(worker_t *worker_p);
+
+/**
+ * @brief Wakes up to count sleeping threads, if any thread is asleep.
+ *
+ * @param threadpool_p The threadpool to wake threads in
+ * @param count The number of jobs that were just queued
+ */
+static void wake_threads(threadpool_t *threadpool_p, size_t count);
+
+/**
+ * @brief Starts a thread in a free worker slot, joining the slot's retired
+ * thread first. Must be called with the threadpool mutex held.
+ *
+ * @param threadpool_p The threadpool to add a thread to
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int spawn_worker(threadpool_t *threadpool_p);
+
+/**
+ * @brief Adds a thread if the threadpool is elastic, below max_threads and
+ * every thread is busy with a backlog deeper than spawn_queue_depth, or
+ * unconditionally when 'force' is set by a job that waited too long.
+ *
+ * @param threadpool_p The threadpool to grow
+ * @param force Skip the backlog check
+ */
+static void grow_pool(threadpool_t *threadpool_p, bool force);
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return uint64_t The time
+ */
+static uint64_t monotonic_ns(void);
+
+/**
+ * @brief Returns the stats shard the calling thread counts into. Threads
+ * are dealt out to the shards in turn the first time they count.
+ *
+ * @param threadpool_p The threadpool being counted
+ * @return stats_shard_t* The shard
+ */
+static stats_shard_t *stats_shard(threadpool_t *threadpool_p);
+
+/**
+ * @brief Counts jobs accepted and refused by a submission, and raises the
+ * high-water mark.
+ *
+ * @param threadpool_p The threadpool the jobs were submitted to
+ * @param accepted The number of jobs queued
+ * @param rejected The number of jobs refused
+ */
+static void stats_submitted(threadpool_t *threadpool_p,
+                            size_t accepted,
+                            size_t rejected);
+
+/**
+ * @brief Adds a duration to a histogram.
+ *
+ * @param hist_p The histogram to add to
+ * @param ns The duration in nanoseconds
+ */
+static void histogram_record(stats_histogram_t *hist_p, uint64_t ns);
+
+/**
+ * @brief Adds a histogram shard into a snapshot.
+ *
+ * @param hist_p The histogram shard to read
+ * @param total_p The snapshot to add to
+ */
+static void histogram_add(stats_histogram_t *hist_p,
+                          threadpool_histogram_t *total_p);
+
+/**
+ * @brief Counts finished jobs and wakes threadpool_wait_idle() callers once
+ * none are left.
+ *
+ * @param threadpool_p The threadpool the jobs ran on
+ * @param count The number of jobs that finished or were never queued
+ */
+static void jobs_finished(threadpool_t *threadpool_p, size_t count);
+
 /**
  * @brief Used to start each thread in a threadpool.
  *
- * @param pool_p The threadpool to start threads in
+ * @param worker_p The worker_t the thread runs as
  * @return void*
  */
-static void *start_thread(void *pool_p);
+static void *start_thread(void *worker_p);
 
 /**
- * @brief Creates a new job for a thread.
+ * @brief Creates a new job for a thread from the threadpool's job slab.
  *
+ * @param threadpool_p The threadpool the job will run on
  * @param job The job to create
  * @param del_f The delete function
  * @param arg_p The argument to pass
+ * @param future_p The future to complete with the result, may be NULL
  * @return job_t* Returns NULL on error
  */
-static job_t *create_job(JOB_F job, FREE_F del_f, void *arg_p);
+static job_t *create_job(threadpool_t *threadpool_p,
+                         JOB_F job,
+                         FREE_F del_f,
+                         void *arg_p,
+                         threadpool_future_t *future_p);
 
 /**
- * @brief Waits for a new job.
+ * @brief Pauses the CPU for a moment inside a polling loop.
+ */
+static void cpu_relax(void);
+
+/**
+ * @brief Polls for jobs for a while before the thread parks: up to
+ * spin_limit polls with a growing number of CPU pauses in between, then
+ * yield_count polls after sched_yield(). A spin that finds work lets the
+ * thread spin longer next time, and parking makes it spin less.
  *
- * @param threadpool_p The threadpool to pass in
- * @return int Returns 0 on success, -1 on failure
+ * @param worker_p The worker looking for work
+ * @param jobs_pp Receives up to WORKER_BATCH_MAX jobs
+ * @return size_t The number of jobs found, 0 if the thread should park
  */
-static int wait_for_job(threadpool_t *threadpool_p);
+static size_t spin_for_job(worker_t *worker_p, job_t **jobs_pp);
 
 /**
- * @brief Gets the next job from a job queue.
+ * @brief Waits for new jobs. Must be called with the threadpool mutex held.
+ * Threads above min_threads that stay idle for keep_alive_ns retire.
  *
- * @param threadpool_p The threadpool to pass in
- * @param node_p The queue node to pass in
- * @param job_p The job to process
+ * @param worker_p The worker waiting for work
+ * @param jobs_pp Receives up to WORKER_BATCH_MAX jobs
+ * @param count_p Set to the number of jobs received, 0 on shutdown or when
+ * the thread retired
  * @return int Returns 0 on success, -1 on failure
  */
-static int get_next_job(threadpool_t **threadpool_p,
-                        queue_node_t **node_p,
-                        job_t **job_p);
+static int wait_for_job(worker_t *worker_p, job_t **jobs_pp, size_t *count_p);
 
 /**
- * @brief Runs a job.
+ * @brief Gets the next batch of jobs for a thread, sleeping until one
+ * arrives.
+ *
+ * @param worker_p The worker looking for work
+ * @param jobs_pp Receives up to WORKER_BATCH_MAX jobs to process
+ * @param count_p Set to the number of jobs received
+ * @return int Returns 0 on success, -1 on failure or shutdown
+ */
+static int get_next_job(worker_t *worker_p, job_t **jobs_pp, size_t *count_p);
+
+/**
+ * @brief Runs a job and completes its future, if it has one.
  *
  * @param job_p The job to run
  * @return int Returns 0 on success, -1 on failure
  */
 static int process_job(job_t *job_p);
 
-threadpool_t *threadpool_create(size_t thread_count)
-{
-    threadpool_t *threadpool_p = NULL;
-    int exit_code = E_FAILURE;
+/**
+ * @brief Adds a job, and optionally its future, to the threadpool.
+ *
+ * @param pool_p The threadpool to add the job to
+ * @param node The node to queue it on, NODE_LOCAL for the caller's
+ * @param priority The lane to queue it in
+ * @param deadline_ns How long to wait for room, see job_queue_push_wait()
+ * @param job The job to perform
+ * @param del_f The delete function
+ * @param arg_p The argument to pass
+ * @param future_p The future to complete with the result, may be NULL
+ * @return int Returns 0 on success, THREADPOOL_QUEUE_FULL if the job queue
+ * had no room, -1 on failure
+ */
+static int add_job(threadpool_t *pool_p,
+                   size_t node,
+                   threadpool_priority_t priority,
+                   uint64_t deadline_ns,
+                   JOB_F job,
+                   FREE_F del_f,
+                   void *arg_p,
+                   threadpool_future_t *future_p);
 
-    if (MIN_THREADS > thread_count)
-    {
-        print_error("threadpool_create(): Invalid thread_count.");
-        goto END;
-    }
+/**
+ * @brief Adds a delayed or periodic job to the timing wheel, starting the
+ * timer thread with the first one.
+ *
+ * @param pool_p The threadpool to add the job to
+ * @param delay_ms The time until the first run
+ * @param period_ms The time between runs, 0 for a delayed job
+ * @param job The job to perform
+ * @param del_f The delete function
+ * @param arg_p The argument to pass
+ * @param timer_p Set to the handle of the timer, may be NULL
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int add_timer(threadpool_t *pool_p,
+                     uint32_t delay_ms,
+                     uint32_t period_ms,
+                     JOB_F job,
+                     FREE_F del_f,
+                     void *arg_p,
+                     threadpool_timer_t *timer_p);
 
-    threadpool_p = calloc(1, sizeof(threadpool_t));
-    if (NULL == threadpool_p)
-    {
-        print_error("threadpool_create(): 'threadpool_p' CMR failure.");
-        goto END;
-    }
+/**
+ * @brief Creates the timing wheel and starts the timer thread. Called with
+ * timer_mutex held.
+ *
+ * @param threadpool_p The threadpool to start timers for
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int timers_start(threadpool_t *threadpool_p);
 
-    exit_code = threadpool_setup(threadpool_p, thread_count);
-    if (E_SUCCESS != exit_code)
-    {
-        print_error("threadpool_create(): Unable to perform threadpool setup.");
-        threadpool_teardown(&threadpool_p);
-        free(threadpool_p);
-        threadpool_p = NULL;
-        goto END;
+/**
+ * @brief Stops the timer thread, leaving the pending timers in the wheel
+ * until the threadpool is torn down.
+ *
+ * @param threadpool_p The threadpool to stop timers for
+ */
+static void timers_stop(threadpool_t *threadpool_p);
+
+/**
+ * @brief The timer thread: moves the wheel along with the clock and sleeps
+ * until its next tick, or until an earlier timer is added.
+ *
+ * @param threadpool_p The threadpool the timers belong to
+ * @return void* Always NULL
+ */
+static void *timer_thread(void *threadpool_p);
+
+/**
+ * @brief The expiry callback of the wheel, queues the timer's job.
+ *
+ * @param timer_p The timer that expired
+ * @param tick The tick it expired on
+ * @param threadpool_p The threadpool to queue the job on
+ * @return uint64_t The tick to expire on next, TIMER_WHEEL_NEVER once done
+ */
+static uint64_t timer_expired(void *timer_p, uint64_t tick, void *threadpool_p);
+
+/**
+ * @brief The job queued for a timer, runs the timer's job.
+ *
+ * @param timer_p The timer
+ * @return void* Always NULL
+ */
+static void *timer_job(void *timer_p);
+
+/**
+ * @brief Drops one reference to a timer, freeing it and its arguments on the
+ * last one. Matches FREE_F, so the wheel releases pending timers with it.
+ *
+ * @param timer_p The timer to drop
+ */
+static void timer_put(void *timer_p);
+
+/**
+ * @brief Returns the tick of the timing wheel a CLOCK_MONOTONIC time falls
+ * on, counted from the creation of the threadpool.
+ *
+ * @param threadpool_p The threadpool
+ * @param ns The time
+ * @return uint64_t The tick
+ */
+static uint64_t timer_tick_of(threadpool_t *threadpool_p, uint64_t ns);
+
+/**
+ * @brief Runs the job behind a token, unless it was cancelled before it
+ * started, then frees its argument either way.
+ *
+ * @param token_p The token of the job
+ * @return void* The value the job returned, NULL if it was skipped
+ */
+static void *token_job(void *token_p);
+
+/**
+ * @brief Drops one reference to a token, recycling it on the last one.
+ *
+ * @param token_p The token to drop
+ */
+static void token_put(threadpool_token_t *token_p);
+
+/**
+ * @brief Sets up the future slab and the buckets waiters sleep on.
+ *
+ * @param threadpool_p The threadpool to setup futures for
+ * @return int Returns 0 on success, -1 on failure
+ */
+static int futures_setup(threadpool_t *threadpool_p);
+
+/**
+ * @brief Releases the future slab and the wait buckets.
+ *
+ * @param threadpool_p The threadpool to tear futures down for
+ */
+static void futures_teardown(threadpool_t *threadpool_p);
+
+/**
+ * @brief Returns the bucket threads waiting on a future sleep on.
+ *
+ * @param future_p The future being waited on
+ * @return future_bucket_t* The bucket
+ */
+static future_bucket_t *future_bucket(threadpool_future_t *future_p);
+
+/**
+ * @brief Publishes a job's result, runs the continuation if one is attached
+ * and wakes any waiter.
+ *
+ * @param future_p The future of the job that finished
+ * @param result_p The value the job returned
+ */
+static void future_complete(threadpool_future_t *future_p, void *result_p);
+
+/**
+ * @brief Drops one reference to a future, recycling it on the last one.
+ *
+ * @param future_p The future to drop
+ */
+static void future_put(threadpool_future_t *future_p);
+
+/**
+ * @brief Waits for a future to finish, up to an optional deadline.
+ *
+ * @param future_p The future to wait on
+ * @param deadline_p The CLOCK_MONOTONIC time to give up at, NULL to wait
+ * forever
+ * @param result_pp If not NULL, set to the job's result once finished
+ * @return int Returns 0 once finished, THREADPOOL_FUTURE_PENDING if the
+ * deadline passed, -1 on failure
+ */
+static int future_wait_until(threadpool_future_t *future_p,
+                             const struct timespec *deadline_p,
+                             void **result_pp);
+
+int threadpool_cfg_init(threadpool_cfg_t *cfg_p, size_t thread_count)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == cfg_p)
+    {
+        print_error("threadpool_cfg_init(): NULL config passed.");
+        goto END;
+    }
+
+    cfg_p->thread_count = thread_count;
+    cfg_p->queue_type = THREADPOOL_QUEUE_MUTEX;
+    cfg_p->queue_capacity = DEFAULT_QUEUE_CAPACITY;
+    cfg_p->queue_limit = 0;
+    cfg_p->scheduler = THREADPOOL_SCHED_SHARED;
+    cfg_p->max_threads = 0;
+    cfg_p->keep_alive_ms = THREADPOOL_DEFAULT_KEEP_ALIVE_MS;
+    cfg_p->spawn_queue_depth = THREADPOOL_DEFAULT_SPAWN_DEPTH;
+    cfg_p->spawn_wait_ms = 0;
+    cfg_p->affinity = THREADPOOL_AFFINITY_NONE;
+    cfg_p->cpus = NULL;
+    cfg_p->cpu_count = 0;
+    cfg_p->numa_path = NULL;
+    cfg_p->lane_policy = THREADPOOL_LANES_STRICT;
+    cfg_p->lane_weights[THREADPOOL_PRIORITY_HIGH] = 4;
+    cfg_p->lane_weights[THREADPOOL_PRIORITY_NORMAL] = 2;
+    cfg_p->lane_weights[THREADPOOL_PRIORITY_LOW] = 1;
+    cfg_p->starvation_limit = THREADPOOL_DEFAULT_STARVATION_LIMIT;
+    cfg_p->spin_count = THREADPOOL_DEFAULT_SPIN_COUNT;
+    cfg_p->yield_count = THREADPOOL_DEFAULT_YIELD_COUNT;
+    cfg_p->time_jobs = false;
+    cfg_p->strand_count = THREADPOOL_DEFAULT_STRAND_COUNT;
+    cfg_p->worker_init = NULL;
+    cfg_p->worker_teardown = NULL;
+    cfg_p->worker_arg_p = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+threadpool_t *threadpool_create(size_t thread_count)
+{
+    threadpool_cfg_t cfg;
+
+    threadpool_cfg_init(&cfg, thread_count);
+    return threadpool_create_ex(&cfg);
+}
+
+threadpool_t *threadpool_create_ex(const threadpool_cfg_t *cfg_p)
+{
+    threadpool_t *threadpool_p = NULL;
+    int exit_code = E_FAILURE;
+
+    if (NULL == cfg_p)
+    {
+        print_error("threadpool_create(): NULL config passed.");
+        goto END;
+    }
+
+    if (MIN_THREADS > cfg_p->thread_count)
+    {
+        print_error("threadpool_create(): Invalid thread_count.");
+        goto END;
+    }
+
+    if ((0 != cfg_p->max_threads) && (cfg_p->thread_count > cfg_p->max_threads))
+    {
+        print_error("threadpool_create(): Invalid max_threads.");
+        goto END;
+    }
+
+    if (0 == cfg_p->strand_count)
+    {
+        print_error("threadpool_create(): Invalid strand_count.");
+        goto END;
+    }
+
+    threadpool_p = calloc(1, sizeof(threadpool_t));
+    if (NULL == threadpool_p)
+    {
+        print_error("threadpool_create(): 'threadpool_p' CMR failure.");
+        goto END;
+    }
+
+    exit_code = threadpool_setup(threadpool_p, cfg_p);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to perform threadpool setup.");
+        threadpool_teardown(&threadpool_p);
+        free(threadpool_p);
+        threadpool_p = NULL;
+        goto END;
+    }
+
+    threadpool_p->signal = ACTIVATE;
+
+    pthread_mutex_lock(&threadpool_p->mutex);
+    for (size_t idx = 0; idx < cfg_p->thread_count; idx++)
+    {
+        exit_code = spawn_worker(threadpool_p);
+        if (E_SUCCESS != exit_code)
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&threadpool_p->mutex);
+
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): failed to create thread.");
+
+        // Joins the threads that did start before releasing everything
+        threadpool_destroy(&threadpool_p);
+        goto END;
+    }
+
+END:
+    return threadpool_p;
+}
+
+int threadpool_shutdown(threadpool_t *pool_p)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == pool_p)
+    {
+        print_error("threadpool_shutdown(): NULL threadpool passed.");
+        goto END;
+    }
+
+    // No timer expires once the threadpool stops taking jobs
+    timers_stop(pool_p);
+
+    // Set under the mutex so sleeping threads observe it on wakeup
+    pthread_mutex_lock(&pool_p->mutex);
+    pool_p->signal = SHUTDOWN;
+    exit_code = pthread_cond_broadcast(&pool_p->condition);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_shutdown(): Unable to wake up threads.");
+        pthread_mutex_unlock(&pool_p->mutex);
+        goto END;
+    }
+    pthread_mutex_unlock(&pool_p->mutex);
+
+    // Submitters waiting for room give up
+    pthread_mutex_lock(&pool_p->full_mutex);
+    pthread_cond_broadcast(&pool_p->not_full);
+    pthread_mutex_unlock(&pool_p->full_mutex);
+
+    // No thread can start or retire once the signal is set, so every slot
+    // that ever ran a thread is joined, including retired ones
+    for (size_t idx = 0; idx < pool_p->max_threads; idx++)
+    {
+        if (WORKER_EMPTY == pool_p->workers[idx].state)
+        {
+            continue;
+        }
+
+        exit_code = pthread_join(pool_p->threads[idx], NULL);
+        if (E_SUCCESS != exit_code)
+        {
+            print_error("threadpool_shutdown(): Unable to join threads.");
+            goto END;
+        }
+        pool_p->workers[idx].state = WORKER_EMPTY;
+    }
+
+    free(pool_p->threads);
+    pool_p->threads = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+// covers 4.5.2 Demonstrate the ability to use signal handling
+// covers 4.1.25 Demonstrate the ability to manage memory in multi-threaded
+// programs
+int threadpool_destroy(threadpool_t **pool_pp)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == pool_pp) || (NULL == *pool_pp))
+    {
+        print_error("threadpool_destroy(): NULL threadpool passed.");
+        goto END;
+    }
+
+    if (SHUTDOWN != (*pool_pp)->signal)
+    {
+        exit_code = threadpool_shutdown(*pool_pp);
+        if (E_SUCCESS != exit_code)
+        {
+            print_error("threadpool_destroy(): Unable to perform shutdown.");
+            goto END;
+        }
+    }
+
+    threadpool_teardown(pool_pp);
+
+    free(*pool_pp);
+    *pool_pp = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int threadpool_add_job(threadpool_t *pool_p,
+                       JOB_F job,
+                       FREE_F del_f,
+                       void *arg_p)
+{
+    return add_job(pool_p,
+                   NODE_LOCAL,
+                   THREADPOOL_PRIORITY_NORMAL,
+                   SUBMIT_NO_WAIT,
+                   job,
+                   del_f,
+                   arg_p,
+                   NULL);
+}
+
+int threadpool_add_job_wait(threadpool_t *pool_p,
+                            threadpool_submit_mode_t mode,
+                            uint32_t timeout_ms,
+                            JOB_F job,
+                            FREE_F del_f,
+                            void *arg_p)
+{
+    int exit_code = E_FAILURE;
+    uint64_t deadline_ns = SUBMIT_NO_WAIT;
+
+    switch (mode)
+    {
+    case THREADPOOL_SUBMIT_FAIL_FAST:
+        break;
+
+    case THREADPOOL_SUBMIT_BLOCK:
+        deadline_ns = SUBMIT_FOREVER;
+        break;
+
+    case THREADPOOL_SUBMIT_TIMED:
+        deadline_ns = monotonic_ns() + ((uint64_t)timeout_ms *
+                                        (uint64_t)NSEC_PER_MSEC);
+        break;
+
+    default:
+        print_error("threadpool_add_job_wait(): Invalid mode.");
+        goto END;
+    }
+
+    exit_code = add_job(pool_p,
+                        NODE_LOCAL,
+                        THREADPOOL_PRIORITY_NORMAL,
+                        deadline_ns,
+                        job,
+                        del_f,
+                        arg_p,
+                        NULL);
+
+END:
+    return exit_code;
+}
+
+int threadpool_add_job_priority(threadpool_t *pool_p,
+                                threadpool_priority_t priority,
+                                JOB_F job,
+                                FREE_F del_f,
+                                void *arg_p)
+{
+    int exit_code = E_FAILURE;
+
+    if ((THREADPOOL_PRIORITY_HIGH > priority) ||
+        (THREADPOOL_PRIORITIES <= priority))
+    {
+        print_error("threadpool_add_job_priority(): Invalid priority.");
+        goto END;
+    }
+
+    exit_code = add_job(
+        pool_p, NODE_LOCAL, priority, SUBMIT_NO_WAIT, job, del_f, arg_p, NULL);
+
+END:
+    return exit_code;
+}
+
+int threadpool_add_job_on_node(threadpool_t *pool_p,
+                               size_t node,
+                               JOB_F job,
+                               FREE_F del_f,
+                               void *arg_p)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == pool_p)
+    {
+        print_error("threadpool_add_job_on_node(): NULL threadpool passed.");
+        goto END;
+    }
+
+    if (pool_p->node_count <= node)
+    {
+        print_error("threadpool_add_job_on_node(): Invalid node.");
+        goto END;
+    }
+
+    exit_code = add_job(pool_p,
+                        node,
+                        THREADPOOL_PRIORITY_NORMAL,
+                        SUBMIT_NO_WAIT,
+                        job,
+                        del_f,
+                        arg_p,
+                        NULL);
+
+END:
+    return exit_code;
+}
+
+int threadpool_add_jobs(threadpool_t *pool_p,
+                        JOB_F job,
+                        FREE_F del_f,
+                        void **args_pp,
+                        size_t count,
+                        size_t *queued_p)
+{
+    int exit_code = E_FAILURE;
+    job_t **jobs_pp = NULL;
+    size_t created = 0;
+    size_t queued = 0;
+    worker_t *worker_p = NULL;
+
+    if ((NULL == pool_p) || (NULL == job) || (NULL == args_pp))
+    {
+        print_error("threadpool_add_jobs(): NULL argument passed.");
+        goto END;
+    }
+
+    worker_p = current_worker(pool_p);
+    if ((SHUTDOWN == pool_p->signal) && (NULL == worker_p))
+    {
+        print_error("threadpool_add_jobs(): Threadpool already shutdown.");
+        goto END;
+    }
+
+    if (0 == count)
+    {
+        exit_code = E_SUCCESS;
+        goto END;
+    }
+
+    // Build every job before touching the queue so the lock is held only for
+    // the copy into the ring
+    jobs_pp = calloc(count, sizeof(job_t *));
+    if (NULL == jobs_pp)
+    {
+        print_error("threadpool_add_jobs(): 'jobs_pp' CMR failure.");
+        goto END;
+    }
+
+    for (created = 0; created < count; created++)
+    {
+        jobs_pp[created] =
+            create_job(pool_p, job, del_f, args_pp[created], NULL);
+        if (NULL == jobs_pp[created])
+        {
+            print_error("threadpool_add_jobs(): Unable to create job.");
+            goto END;
+        }
+
+        if ((0 != pool_p->spawn_wait_ns) || (true == pool_p->time_jobs))
+        {
+            jobs_pp[created]->queued_ns = monotonic_ns();
+        }
+    }
+
+    atomic_fetch_add(&pool_p->pending_jobs, count);
+    if ((NULL != worker_p) && (NULL != worker_p->deque_p))
+    {
+        while ((queued < count) &&
+               (E_SUCCESS == ws_deque_push(worker_p->deque_p, jobs_pp[queued])))
+        {
+            queued++;
+        }
+    }
+    else
+    {
+        queued = job_queue_push_many(
+            &pool_p->job_queues[local_node(pool_p, worker_p)], jobs_pp, count);
+    }
+
+    if (0 != queued)
+    {
+        wake_threads(pool_p, queued);
+        grow_pool(pool_p, false);
+    }
+
+    if (queued != count)
+    {
+        print_error("threadpool_add_jobs(): Job queue is full.");
+        jobs_finished(pool_p, count - queued);
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    // Jobs the queue did not take are still owned here
+    for (size_t idx = queued; idx < created; idx++)
+    {
+        slab_free(pool_p->job_slab, jobs_pp[idx]);
+    }
+    free(jobs_pp);
+
+    if ((NULL != pool_p) && (NULL != job) && (NULL != args_pp))
+    {
+        stats_submitted(pool_p, queued, count - queued);
+    }
+
+    if (NULL != queued_p)
+    {
+        *queued_p = queued;
+    }
+    return exit_code;
+}
+
+int threadpool_add_keyed_job(threadpool_t *pool_p,
+                             uint64_t key,
+                             JOB_F job,
+                             FREE_F del_f,
+                             void *arg_p)
+{
+    int exit_code = E_FAILURE;
+    job_t *new_job = NULL;
+    strand_t *strand_p = NULL;
+
+    if ((NULL == pool_p) || (NULL == job))
+    {
+        print_error("threadpool_add_keyed_job(): NULL argument passed.");
+        goto END;
+    }
+
+    if ((SHUTDOWN == pool_p->signal) && (NULL == current_worker(pool_p)))
+    {
+        print_error("threadpool_add_keyed_job(): Threadpool already shutdown.");
+        goto END;
+    }
+
+    new_job = create_job(pool_p, job, del_f, arg_p, NULL);
+    if (NULL == new_job)
+    {
+        print_error("threadpool_add_keyed_job(): Unable to create job.");
+        goto END;
+    }
+
+    // Fibonacci hashing, the high bits of the product mix every bit of the
+    // key, so sequential ids spread over the strands
+    strand_p =
+        &pool_p->strands[((key * STRAND_HASH) >> 32) % pool_p->strand_count];
+
+    // An idle strand is queued like a job, a scheduled one picks the job up
+    // on its own. Queueing it under the mutex keeps a failed queueing from
+    // stranding jobs added behind it.
+    pthread_mutex_lock(&strand_p->mutex);
+    if (false == strand_p->scheduled)
+    {
+        exit_code = add_job(pool_p,
+                            NODE_LOCAL,
+                            THREADPOOL_PRIORITY_NORMAL,
+                            SUBMIT_NO_WAIT,
+                            strand_run,
+                            NULL,
+                            strand_p,
+                            NULL);
+        if (E_SUCCESS != exit_code)
+        {
+            pthread_mutex_unlock(&strand_p->mutex);
+            slab_free(pool_p->job_slab, new_job);
+            goto END;
+        }
+        strand_p->scheduled = true;
+    }
+
+    if (NULL == strand_p->tail_p)
+    {
+        strand_p->head_p = new_job;
+    }
+    else
+    {
+        strand_p->tail_p->next_p = new_job;
+    }
+    strand_p->tail_p = new_job;
+    pthread_mutex_unlock(&strand_p->mutex);
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int threadpool_add_delayed_job(threadpool_t *pool_p,
+                               uint32_t delay_ms,
+                               JOB_F job,
+                               FREE_F del_f,
+                               void *arg_p,
+                               threadpool_timer_t *timer_p)
+{
+    return add_timer(pool_p, delay_ms, 0, job, del_f, arg_p, timer_p);
+}
+
+int threadpool_add_periodic_job(threadpool_t *pool_p,
+                                uint32_t delay_ms,
+                                uint32_t period_ms,
+                                JOB_F job,
+                                FREE_F del_f,
+                                void *arg_p,
+                                threadpool_timer_t *timer_p)
+{
+    int exit_code = E_FAILURE;
+
+    if (0 == period_ms)
+    {
+        print_error("threadpool_add_periodic_job(): Invalid period.");
+        goto END;
+    }
+
+    exit_code =
+        add_timer(pool_p, delay_ms, period_ms, job, del_f, arg_p, timer_p);
+END:
+    return exit_code;
+}
+
+int threadpool_cancel_timer(threadpool_t *pool_p, threadpool_timer_t timer)
+{
+    int exit_code = E_FAILURE;
+    void *timer_p = NULL;
+
+    if (NULL == pool_p)
+    {
+        print_error("threadpool_cancel_timer(): NULL threadpool passed.");
+        goto END;
+    }
+
+    pthread_mutex_lock(&pool_p->timer_mutex);
+    if (NULL != pool_p->timers)
+    {
+        exit_code = timer_wheel_cancel(pool_p->timers, timer, &timer_p);
+    }
+    pthread_mutex_unlock(&pool_p->timer_mutex);
+
+    // The wheel's reference, a run that is already queued holds its own
+    if (E_SUCCESS == exit_code)
+    {
+        timer_put(timer_p);
+    }
+
+END:
+    return exit_code;
+}
+
+int threadpool_add_job_cancellable(threadpool_t *pool_p,
+                                   JOB_F job,
+                                   FREE_F del_f,
+                                   void *arg_p,
+                                   threadpool_token_t **token_pp)
+{
+    int exit_code = E_FAILURE;
+    threadpool_token_t *token_p = NULL;
+
+    if ((NULL == pool_p) || (NULL == job) || (NULL == token_pp))
+    {
+        print_error("threadpool_add_job_cancellable(): NULL argument passed.");
+        goto END;
+    }
+
+    token_p = slab_alloc(pool_p->token_slab);
+    if (NULL == token_p)
+    {
+        print_error("threadpool_add_job_cancellable(): CMR failure.");
+        goto END;
+    }
+
+    token_p->pool_p = pool_p;
+    token_p->job = job;
+    token_p->del_f = del_f;
+    token_p->args_p = arg_p;
+    atomic_init(&token_p->state, TOKEN_STATE_QUEUED);
+    atomic_init(&token_p->refs, 2); // One for the job, one for the caller
+
+    // The token frees arg_p, so a job that is skipped still releases it
+    exit_code = add_job(pool_p,
+                        NODE_LOCAL,
+                        THREADPOOL_PRIORITY_NORMAL,
+                        SUBMIT_NO_WAIT,
+                        token_job,
+                        NULL,
+                        token_p,
+                        NULL);
+    if (E_SUCCESS != exit_code)
+    {
+        slab_free(pool_p->token_slab, token_p);
+        goto END;
+    }
+
+    *token_pp = token_p;
+END:
+    return exit_code;
+}
+
+int threadpool_cancel_job(threadpool_token_t *token_p)
+{
+    int exit_code = E_FAILURE;
+    int state = TOKEN_STATE_QUEUED;
+
+    if (NULL == token_p)
+    {
+        print_error("threadpool_cancel_job(): NULL token passed.");
+        goto END;
+    }
+
+    // A queued job is skipped when a thread takes it, a running one is told
+    // to stop. Either exchange fails once the job has moved on.
+    if ((!atomic_compare_exchange_strong(
+            &token_p->state, &state, TOKEN_STATE_CANCELLED)) &&
+        (TOKEN_STATE_RUNNING == state))
+    {
+        atomic_compare_exchange_strong(
+            &token_p->state, &state, TOKEN_STATE_CANCELLING);
+    }
+
+    if ((TOKEN_STATE_QUEUED == state) || (TOKEN_STATE_CANCELLED == state))
+    {
+        exit_code = E_SUCCESS;
+    }
+    else if ((TOKEN_STATE_RUNNING == state) ||
+             (TOKEN_STATE_CANCELLING == state))
+    {
+        exit_code = THREADPOOL_JOB_RUNNING;
+    }
+
+END:
+    return exit_code;
+}
+
+bool threadpool_job_cancelled(void)
+{
+    return (NULL != current_token_g) &&
+           (TOKEN_STATE_CANCELLING == atomic_load(&current_token_g->state));
+}
+
+int threadpool_token_release(threadpool_token_t **token_pp)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == token_pp) || (NULL == *token_pp))
+    {
+        print_error("threadpool_token_release(): NULL token passed.");
+        goto END;
+    }
+
+    token_put(*token_pp);
+    *token_pp = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int threadpool_wait_idle(threadpool_t *pool_p)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == pool_p)
+    {
+        print_error("threadpool_wait_idle(): NULL threadpool passed.");
+        goto END;
+    }
+
+    // The calling job would be waiting for itself
+    if (NULL != current_worker(pool_p))
+    {
+        print_error("threadpool_wait_idle(): Called from a job.");
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+    if (0 == atomic_load(&pool_p->pending_jobs))
+    {
+        goto END;
+    }
+
+    pthread_mutex_lock(&pool_p->mutex);
+    atomic_fetch_add(&pool_p->idle_waiters, 1);
+    while ((E_SUCCESS == exit_code) &&
+           (0 != atomic_load(&pool_p->pending_jobs)))
+    {
+        exit_code =
+            pthread_cond_wait(&pool_p->idle_condition, &pool_p->mutex);
+    }
+    atomic_fetch_sub(&pool_p->idle_waiters, 1);
+    pthread_mutex_unlock(&pool_p->mutex);
+
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_wait_idle(): Unable to wait on condition.");
+        exit_code = E_FAILURE;
+    }
+
+END:
+    return exit_code;
+}
+
+size_t threadpool_node_count(threadpool_t *pool_p)
+{
+    size_t node_count = 0;
+
+    if (NULL == pool_p)
+    {
+        print_error("threadpool_node_count(): NULL threadpool passed.");
+        goto END;
+    }
+
+    node_count = pool_p->node_count;
+
+END:
+    return node_count;
+}
+
+int threadpool_stats(threadpool_t *pool_p, threadpool_stats_t *stats_p)
+{
+    int exit_code = E_FAILURE;
+    stats_shard_t *shard_p = NULL;
+    uint64_t now_ns = 0;
+    uint64_t started = 0;
+
+    if ((NULL == pool_p) || (NULL == stats_p))
+    {
+        print_error("threadpool_stats(): NULL argument passed.");
+        goto END;
+    }
+
+    memset(stats_p, 0, sizeof(threadpool_stats_t));
+    for (size_t idx = 0; idx < STATS_SHARDS; idx++)
+    {
+        shard_p = &pool_p->stats_shards[idx];
+        stats_p->submitted += atomic_load(&shard_p->submitted);
+        stats_p->rejected += atomic_load(&shard_p->rejected);
+        stats_p->completed += atomic_load(&shard_p->completed);
+        stats_p->cancelled += atomic_load(&shard_p->cancelled);
+        stats_p->busy_ns += atomic_load(&shard_p->busy_ns);
+        started += atomic_load(&shard_p->started);
+        histogram_add(&shard_p->wait, &stats_p->wait);
+        histogram_add(&shard_p->run, &stats_p->run);
+    }
+
+    // The shards are read one at a time, so a job may look started before
+    // it looks submitted
+    stats_p->queue_depth =
+        (started < stats_p->submitted) ? stats_p->submitted - started : 0;
+    stats_p->queue_high_water = atomic_load(&pool_p->high_water);
+    stats_p->thread_count = atomic_load(&pool_p->thread_count);
+    stats_p->parked_threads = atomic_load(&pool_p->idle_threads);
+
+    // Thread lifetimes are only updated under the mutex
+    pthread_mutex_lock(&pool_p->mutex);
+    now_ns = monotonic_ns();
+    stats_p->thread_ns = pool_p->retired_ns;
+    for (size_t idx = 0; idx < pool_p->max_threads; idx++)
+    {
+        if (WORKER_RUNNING == pool_p->workers[idx].state)
+        {
+            stats_p->thread_ns += now_ns - pool_p->workers[idx].started_ns;
+        }
+    }
+    pthread_mutex_unlock(&pool_p->mutex);
+
+    stats_p->uptime_ns = now_ns - pool_p->created_ns;
+    if (0 != stats_p->thread_ns)
+    {
+        stats_p->utilization =
+            (double)stats_p->busy_ns / (double)stats_p->thread_ns;
+        stats_p->utilization =
+            (1.0 < stats_p->utilization) ? 1.0 : stats_p->utilization;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+uint64_t threadpool_histogram_percentile(const threadpool_histogram_t *hist_p,
+                                         double percentile)
+{
+    uint64_t value = 0;
+    uint64_t target = 0;
+    uint64_t seen = 0;
+    size_t bucket = 0;
+
+    if ((NULL == hist_p) || (0.0 > percentile) || (100.0 < percentile))
+    {
+        print_error("threadpool_histogram_percentile(): Invalid argument.");
+        goto END;
+    }
+
+    if (0 == hist_p->count)
+    {
+        goto END;
+    }
+
+    // The rank of the sample wanted, counting from 1
+    target = (uint64_t)(((double)hist_p->count * percentile) / 100.0);
+    target = (0 == target) ? 1 : target;
+    for (bucket = 0; bucket < THREADPOOL_HISTOGRAM_BUCKETS - 1; bucket++)
+    {
+        seen += hist_p->buckets[bucket];
+        if (seen >= target)
+        {
+            break;
+        }
+    }
+
+    value = (0 == bucket) ? 0 : ((uint64_t)1 << bucket) - 1;
+    if ((THREADPOOL_HISTOGRAM_BUCKETS - 1 == bucket) ||
+        (hist_p->max_ns < value))
+    {
+        value = hist_p->max_ns;
+    }
+
+END:
+    return value;
+}
+
+size_t threadpool_thread_count(threadpool_t *pool_p)
+{
+    size_t thread_count = 0;
+
+    if (NULL == pool_p)
+    {
+        print_error("threadpool_thread_count(): NULL threadpool passed.");
+        goto END;
+    }
+
+    thread_count = atomic_load(&pool_p->thread_count);
+
+END:
+    return thread_count;
+}
+
+void *threadpool_worker_ctx(void)
+{
+    return (NULL == current_worker_g) ? NULL : current_worker_g->ctx_p;
+}
+
+threadpool_future_t *threadpool_submit(threadpool_t *pool_p,
+                                       JOB_F job,
+                                       FREE_F del_f,
+                                       void *arg_p)
+{
+    threadpool_future_t *future_p = NULL;
+
+    if ((NULL == pool_p) || (NULL == job))
+    {
+        print_error("threadpool_submit(): NULL argument passed.");
+        goto END;
+    }
+
+    future_p = slab_alloc(pool_p->future_slab);
+    if (NULL == future_p)
+    {
+        print_error("threadpool_submit(): Unable to create future.");
+        goto END;
+    }
+
+    future_p->pool_p = pool_p;
+    future_p->result_p = NULL;
+    future_p->then_f = NULL;
+    future_p->then_arg_p = NULL;
+    atomic_init(&future_p->state, FUTURE_STATE_PENDING);
+    atomic_init(&future_p->refs, 2); // One for the job, one for the caller
+    atomic_init(&future_p->waiters, 0);
+
+    if (E_SUCCESS != add_job(pool_p,
+                             NODE_LOCAL,
+                             THREADPOOL_PRIORITY_NORMAL,
+                             SUBMIT_NO_WAIT,
+                             job,
+                             del_f,
+                             arg_p,
+                             future_p))
+    {
+        slab_free(pool_p->future_slab, future_p);
+        future_p = NULL;
+        goto END;
+    }
+
+END:
+    return future_p;
+}
+
+int threadpool_future_wait(threadpool_future_t *future_p, void **result_pp)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == future_p)
+    {
+        print_error("threadpool_future_wait(): NULL future passed.");
+        goto END;
+    }
+
+    exit_code = future_wait_until(future_p, NULL, result_pp);
+
+END:
+    return exit_code;
+}
+
+int threadpool_future_timedwait(threadpool_future_t *future_p,
+                                uint32_t timeout_ms,
+                                void **result_pp)
+{
+    int exit_code = E_FAILURE;
+    struct timespec deadline = { 0 };
+
+    if (NULL == future_p)
+    {
+        print_error("threadpool_future_timedwait(): NULL future passed.");
+        goto END;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (time_t)(timeout_ms / 1000U);
+    deadline.tv_nsec += (long)(timeout_ms % 1000U) * NSEC_PER_MSEC;
+    if (NSEC_PER_SEC <= deadline.tv_nsec)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NSEC_PER_SEC;
+    }
+
+    exit_code = future_wait_until(future_p, &deadline, result_pp);
+
+END:
+    return exit_code;
+}
+
+int threadpool_future_poll(threadpool_future_t *future_p, void **result_pp)
+{
+    int exit_code = E_FAILURE;
+
+    if (NULL == future_p)
+    {
+        print_error("threadpool_future_poll(): NULL future passed.");
+        goto END;
+    }
+
+    if (FUTURE_STATE_DONE != atomic_load(&future_p->state))
+    {
+        exit_code = THREADPOOL_FUTURE_PENDING;
+        goto END;
+    }
+
+    if (NULL != result_pp)
+    {
+        *result_pp = future_p->result_p;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int threadpool_future_then(threadpool_future_t *future_p,
+                           CONTINUATION_F then_f,
+                           void *arg_p)
+{
+    int exit_code = E_FAILURE;
+    int state = FUTURE_STATE_PENDING;
+
+    if ((NULL == future_p) || (NULL == then_f))
+    {
+        print_error("threadpool_future_then(): NULL argument passed.");
+        goto END;
+    }
+
+    if (NULL != future_p->then_f)
+    {
+        print_error("threadpool_future_then(): Continuation already set.");
+        goto END;
+    }
+
+    // Publish the continuation before the job can see the CONTINUED state
+    future_p->then_f = then_f;
+    future_p->then_arg_p = arg_p;
+    if (!atomic_compare_exchange_strong(
+            &future_p->state, &state, FUTURE_STATE_CONTINUED))
+    {
+        // The job already finished and will not look for a continuation
+        then_f(future_p->result_p, arg_p);
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+int threadpool_future_release(threadpool_future_t **future_pp)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == future_pp) || (NULL == *future_pp))
+    {
+        print_error("threadpool_future_release(): NULL future passed.");
+        goto END;
+    }
+
+    future_put(*future_pp);
+    *future_pp = NULL;
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static int add_job(threadpool_t *pool_p,
+                   size_t node,
+                   threadpool_priority_t priority,
+                   uint64_t deadline_ns,
+                   JOB_F job,
+                   FREE_F del_f,
+                   void *arg_p,
+                   threadpool_future_t *future_p)
+{
+    int exit_code = E_FAILURE;
+    job_t *new_job = NULL;
+    worker_t *worker_p = NULL;
+
+    if ((NULL == pool_p) || (NULL == job))
+    {
+        print_error("add_job(): NULL argument passed.");
+        goto END;
+    }
+
+    worker_p = current_worker(pool_p);
+    if ((SHUTDOWN == pool_p->signal) && (NULL == worker_p))
+    {
+        print_error("add_job(): Threadpool already shutdown.");
+        goto END;
+    }
+
+    new_job = create_job(pool_p, job, del_f, arg_p, future_p);
+    if (NULL == new_job)
+    {
+        print_error("add_job(): Unable to create job.");
+        goto END;
+    }
+
+    if ((0 != pool_p->spawn_wait_ns) || (true == pool_p->time_jobs))
+    {
+        new_job->queued_ns = monotonic_ns();
+    }
+
+    // Counted before it is visible so the pool never looks idle while the
+    // job is queued
+    atomic_fetch_add(&pool_p->pending_jobs, 1);
+
+    // Jobs spawned by a running job stay on its thread's deque unless they
+    // were sent to a node or a priority lane
+    if ((NODE_LOCAL == node) && (THREADPOOL_PRIORITY_NORMAL == priority) &&
+        (NULL != worker_p) && (NULL != worker_p->deque_p))
+    {
+        exit_code = ws_deque_push(worker_p->deque_p, new_job);
+    }
+    else
+    {
+        if (NODE_LOCAL == node)
+        {
+            node = local_node(pool_p, worker_p);
+        }
+
+        // A thread of the threadpool waiting for room would wait on itself
+        deadline_ns = (NULL != worker_p) ? SUBMIT_NO_WAIT : deadline_ns;
+        exit_code = job_queue_push_wait(pool_p,
+                                        &pool_p->job_queues[node],
+                                        priority,
+                                        new_job,
+                                        deadline_ns);
+    }
+
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("add_job(): Job queue is full.");
+        slab_free(pool_p->job_slab, new_job);
+        jobs_finished(pool_p, 1);
+        exit_code = THREADPOOL_QUEUE_FULL;
+        goto END;
+    }
+
+    wake_threads(pool_p, 1);
+    grow_pool(pool_p, false);
+
+    exit_code = E_SUCCESS;
+END:
+    // Calls that never reached the threadpool are not counted
+    if ((NULL != pool_p) && (NULL != job))
+    {
+        stats_submitted(pool_p,
+                        (E_SUCCESS == exit_code) ? 1 : 0,
+                        (E_SUCCESS == exit_code) ? 0 : 1);
+    }
+    return exit_code;
+}
+
+static int threadpool_setup(threadpool_t *threadpool_p,
+                            const threadpool_cfg_t *cfg_p)
+{
+    int exit_code = E_FAILURE;
+    pthread_condattr_t attr;
+
+    if ((NULL == threadpool_p) || (NULL == cfg_p))
+    {
+        print_error("threadpool_setup(): NULL argument passed.");
+        goto END;
+    }
+
+    // 1. Setup the mutex
+    exit_code = pthread_mutex_init(&threadpool_p->mutex, NULL);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize work mutex.");
+        goto END;
+    }
+    threadpool_p->work_mutex_initialized = true;
+
+    // 2. Setup the work condition, idle threads time out against
+    // CLOCK_MONOTONIC when they wait to retire
+    exit_code = pthread_condattr_init(&attr);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize condition.");
+        goto END;
+    }
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    exit_code = pthread_cond_init(&threadpool_p->condition, &attr);
+    pthread_condattr_destroy(&attr);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize condition.");
+        goto END;
+    }
+    threadpool_p->condition_initialized = true;
+
+    exit_code = pthread_cond_init(&threadpool_p->idle_condition, NULL);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize condition.");
+        goto END;
+    }
+    threadpool_p->idle_condition_initialized = true;
+
+    // Submitters waiting for room time out against CLOCK_MONOTONIC too
+    exit_code = pthread_mutex_init(&threadpool_p->full_mutex, NULL);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize full mutex.");
+        goto END;
+    }
+    threadpool_p->full_mutex_initialized = true;
+
+    exit_code = pthread_condattr_init(&attr);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize condition.");
+        goto END;
+    }
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    exit_code = pthread_cond_init(&threadpool_p->not_full, &attr);
+    pthread_condattr_destroy(&attr);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize condition.");
+        goto END;
+    }
+    threadpool_p->not_full_initialized = true;
+    atomic_init(&threadpool_p->full_waiters, 0);
+    threadpool_p->bounded = (THREADPOOL_QUEUE_LOCKFREE == cfg_p->queue_type) ||
+                            (0 != cfg_p->queue_limit);
+
+    // The timer thread sleeps against CLOCK_MONOTONIC until its next tick,
+    // the thread and the wheel are only created with the first timer
+    exit_code = pthread_mutex_init(&threadpool_p->timer_mutex, NULL);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize timer mutex.");
+        goto END;
+    }
+    threadpool_p->timer_mutex_initialized = true;
+
+    exit_code = pthread_condattr_init(&attr);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize condition.");
+        goto END;
+    }
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    exit_code = pthread_cond_init(&threadpool_p->timer_condition, &attr);
+    pthread_condattr_destroy(&attr);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize condition.");
+        goto END;
+    }
+    threadpool_p->timer_condition_initialized = true;
+    threadpool_p->timer_wake = TIMER_NO_WAKE;
+
+    // 3. Setup a job queue per node
+    exit_code = nodes_setup(threadpool_p, cfg_p);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to initialize queue.");
+        goto END;
+    }
+    atomic_init(&threadpool_p->idle_threads, 0);
+    atomic_init(&threadpool_p->pending_jobs, 0);
+    atomic_init(&threadpool_p->idle_waiters, 0);
+
+    // 4. Allocate memory for threads, one slot per thread the pool may grow
+    // to
+    threadpool_p->min_threads = cfg_p->thread_count;
+    threadpool_p->max_threads = (0 == cfg_p->max_threads)
+                                    ? cfg_p->thread_count
+                                    : cfg_p->max_threads;
+    threadpool_p->keep_alive_ns = (uint64_t)cfg_p->keep_alive_ms *
+                                  (uint64_t)NSEC_PER_MSEC;
+    threadpool_p->spawn_queue_depth = cfg_p->spawn_queue_depth;
+    threadpool_p->spawn_wait_ns = (uint64_t)cfg_p->spawn_wait_ms *
+                                  (uint64_t)NSEC_PER_MSEC;
+    threadpool_p->spin_count = cfg_p->spin_count;
+    threadpool_p->yield_count = cfg_p->yield_count;
+    threadpool_p->worker_init = cfg_p->worker_init;
+    threadpool_p->worker_teardown = cfg_p->worker_teardown;
+    threadpool_p->worker_arg_p = cfg_p->worker_arg_p;
+    atomic_init(&threadpool_p->thread_count, 0);
+
+    threadpool_p->threads =
+        calloc(threadpool_p->max_threads, sizeof(pthread_t));
+    if (NULL == threadpool_p->threads)
+    {
+        print_error("threadpool_create(): 'threads' CMR failure.");
+        exit_code = E_FAILURE;
+        goto END;
+    }
+
+    // 5. Setup the counters, sizeof() is a multiple of the alignment, as
+    // aligned_alloc() requires
+    threadpool_p->time_jobs = cfg_p->time_jobs;
+    threadpool_p->created_ns = monotonic_ns();
+    atomic_init(&threadpool_p->high_water, 0);
+    threadpool_p->stats_shards =
+        aligned_alloc(alignof(stats_shard_t),
+                      STATS_SHARDS * sizeof(stats_shard_t));
+    if (NULL == threadpool_p->stats_shards)
+    {
+        print_error("threadpool_create(): 'stats_shards' CMR failure.");
+        exit_code = E_FAILURE;
+        goto END;
+    }
+    memset(threadpool_p->stats_shards, 0,
+           STATS_SHARDS * sizeof(stats_shard_t));
+
+    // 6. Setup the job allocator, every submission takes a job_t from it,
+    // and the token allocator for cancellable jobs
+    threadpool_p->job_slab = slab_create(sizeof(job_t), SLAB_DEFAULT_BATCH);
+    if (NULL == threadpool_p->job_slab)
+    {
+        print_error("threadpool_create(): Unable to create job slab.");
+        exit_code = E_FAILURE;
+        goto END;
+    }
+
+    threadpool_p->token_slab =
+        slab_create(sizeof(threadpool_token_t), SLAB_DEFAULT_BATCH);
+    if (NULL == threadpool_p->token_slab)
+    {
+        print_error("threadpool_create(): Unable to create token slab.");
+        exit_code = E_FAILURE;
+        goto END;
+    }
+
+    // 7. Setup the future allocator and the buckets waiters sleep on
+    exit_code = futures_setup(threadpool_p);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to setup futures.");
+        goto END;
+    }
+
+    // 8. Setup the per-thread state
+    exit_code = workers_setup(threadpool_p, cfg_p);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to setup workers.");
+        goto END;
+    }
+
+    // 9. Setup the strands keyed jobs hash to
+    exit_code = strands_setup(threadpool_p, cfg_p);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("threadpool_create(): Unable to setup strands.");
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static int workers_setup(threadpool_t *threadpool_p,
+                         const threadpool_cfg_t *cfg_p)
+{
+    int exit_code = E_FAILURE;
+    worker_t *worker_p = NULL;
+
+    if ((THREADPOOL_SCHED_SHARED != cfg_p->scheduler) &&
+        (THREADPOOL_SCHED_STEALING != cfg_p->scheduler))
+    {
+        print_error("workers_setup(): Invalid scheduler.");
+        goto END;
+    }
+    threadpool_p->scheduler = cfg_p->scheduler;
+
+    threadpool_p->workers = calloc(threadpool_p->max_threads, sizeof(worker_t));
+    if (NULL == threadpool_p->workers)
+    {
+        print_error("workers_setup(): 'workers' CMR failure.");
+        goto END;
+    }
+
+    for (size_t idx = 0; idx < threadpool_p->max_threads; idx++)
+    {
+        worker_p = &threadpool_p->workers[idx];
+        worker_p->pool_p = threadpool_p;
+        worker_p->id = idx;
+        worker_p->seed = (uint32_t)idx + 1; // xorshift state must be non-zero
+        worker_p->spin_limit = cfg_p->spin_count;
+        for (size_t slot = 0; slot < WORKER_BATCH_MAX; slot++)
+        {
+            atomic_init(&worker_p->batch[slot], NULL);
+        }
+        atomic_init(&worker_p->batch_left, 0);
+
+        // Threads are dealt out to the nodes, or to the CPUs, in turn
+        if (THREADPOOL_AFFINITY_NONE != threadpool_p->affinity)
+        {
+            worker_p->node = idx % threadpool_p->node_count;
+            worker_p->pinned = true;
+            memcpy(&worker_p->cpus,
+                   &threadpool_p->node_cpus[worker_p->node],
+                   sizeof(cpu_set_t));
+        }
+
+        if (THREADPOOL_AFFINITY_CPUS == threadpool_p->affinity)
+        {
+            cpu_nth(&worker_p->cpus, idx % CPU_COUNT(&worker_p->cpus));
+        }
+
+        if (THREADPOOL_SCHED_STEALING == cfg_p->scheduler)
+        {
+            worker_p->deque_p = ws_deque_init(WORKER_DEQUE_CAPACITY);
+            if (NULL == worker_p->deque_p)
+            {
+                goto END;
+            }
+        }
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void workers_teardown(threadpool_t *threadpool_p)
+{
+    ws_deque_t *deque_p = NULL;
+
+    if (NULL == threadpool_p->workers)
+    {
+        return;
+    }
+
+    for (size_t idx = 0; idx < threadpool_p->max_threads; idx++)
+    {
+        deque_p = threadpool_p->workers[idx].deque_p;
+        if (NULL == deque_p)
+        {
+            continue;
+        }
+
+        // Only left over when a thread stopped on a caught signal
+        for (job_t *job_p = ws_deque_pop(deque_p); NULL != job_p;
+             job_p = ws_deque_pop(deque_p))
+        {
+            slab_free(threadpool_p->job_slab, job_p);
+        }
+        ws_deque_destroy(&threadpool_p->workers[idx].deque_p);
+    }
+
+    free(threadpool_p->workers);
+    threadpool_p->workers = NULL;
+}
+
+static int strands_setup(threadpool_t *threadpool_p,
+                         const threadpool_cfg_t *cfg_p)
+{
+    int exit_code = E_FAILURE;
+    strand_t *strand_p = NULL;
+
+    // sizeof() is a multiple of the alignment, as aligned_alloc() requires
+    threadpool_p->strands = aligned_alloc(
+        alignof(strand_t), cfg_p->strand_count * sizeof(strand_t));
+    if (NULL == threadpool_p->strands)
+    {
+        print_error("strands_setup(): 'strands' CMR failure.");
+        goto END;
+    }
+    threadpool_p->strand_count = cfg_p->strand_count;
+
+    for (size_t idx = 0; idx < threadpool_p->strand_count; idx++)
+    {
+        strand_p = &threadpool_p->strands[idx];
+        if (E_SUCCESS != pthread_mutex_init(&strand_p->mutex, NULL))
+        {
+            goto END;
+        }
+        strand_p->pool_p = threadpool_p;
+        strand_p->head_p = NULL;
+        strand_p->tail_p = NULL;
+        strand_p->scheduled = false;
+        threadpool_p->strands_initialized++;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void strands_teardown(threadpool_t *threadpool_p)
+{
+    for (size_t idx = 0; idx < threadpool_p->strands_initialized; idx++)
+    {
+        pthread_mutex_destroy(&threadpool_p->strands[idx].mutex);
+    }
+    threadpool_p->strands_initialized = 0;
+
+    free(threadpool_p->strands);
+    threadpool_p->strands = NULL;
+}
+
+static void *strand_run(void *strand_p)
+{
+    strand_t *entry_p = (strand_t *)strand_p;
+    job_t *job_p = NULL;
+    size_t ran = 0;
+    size_t node = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&entry_p->mutex);
+        job_p = entry_p->head_p;
+        if (NULL == job_p)
+        {
+            entry_p->scheduled = false;
+            pthread_mutex_unlock(&entry_p->mutex);
+            break;
+        }
+
+        // A busy key goes to the back of its node's job queue now and then
+        // rather than keeping the thread to itself. Not to the thread's own
+        // deque, which would hand it straight back. With no room there it
+        // carries on for another batch, its jobs are already accepted.
+        if (STRAND_BATCH_MAX <= ran)
+        {
+            ran = 0;
+            node = local_node(entry_p->pool_p, current_worker(entry_p->pool_p));
+            if (E_SUCCESS == add_job(entry_p->pool_p,
+                                     node,
+                                     THREADPOOL_PRIORITY_NORMAL,
+                                     SUBMIT_NO_WAIT,
+                                     strand_run,
+                                     NULL,
+                                     entry_p,
+                                     NULL))
+            {
+                pthread_mutex_unlock(&entry_p->mutex);
+                break;
+            }
+        }
+
+        entry_p->head_p = job_p->next_p;
+        if (NULL == entry_p->head_p)
+        {
+            entry_p->tail_p = NULL;
+        }
+        pthread_mutex_unlock(&entry_p->mutex);
+
+        if (E_SUCCESS != process_job(job_p))
+        {
+            print_error("strand_run(): Unable to execute job.");
+        }
+        slab_free(entry_p->pool_p->job_slab, job_p);
+        ran++;
+    }
+
+    return NULL;
+}
+
+static worker_t *current_worker(threadpool_t *threadpool_p)
+{
+    worker_t *worker_p = current_worker_g;
+
+    if ((NULL != worker_p) && (threadpool_p != worker_p->pool_p))
+    {
+        worker_p = NULL;
+    }
+
+    return worker_p;
+}
+
+static job_t *steal_job(worker_t *worker_p)
+{
+    threadpool_t *threadpool_p = worker_p->pool_p;
+    job_t *job_p = NULL;
+    size_t victim = 0;
+
+    // xorshift32, cheap and good enough to spread thieves across victims
+    worker_p->seed ^= worker_p->seed << 13U;
+    worker_p->seed ^= worker_p->seed >> 17U;
+    worker_p->seed ^= worker_p->seed << 5U;
+    victim = worker_p->seed % threadpool_p->max_threads;
+
+    // Slots without a running thread have empty deques
+    for (size_t tries = 0; tries < threadpool_p->max_threads; tries++)
+    {
+        if (victim != worker_p->id)
+        {
+            job_p = ws_deque_steal(threadpool_p->workers[victim].deque_p);
+            if (NULL != job_p)
+            {
+                break;
+            }
+        }
+
+        victim = (victim + 1) % threadpool_p->max_threads;
+    }
+
+    return job_p;
+}
+
+static job_t *steal_batched_job(worker_t *worker_p)
+{
+    threadpool_t *threadpool_p = worker_p->pool_p;
+    worker_t *victim_p = NULL;
+    job_t *job_p = NULL;
+
+    for (size_t idx = 0; (idx < threadpool_p->max_threads) && (NULL == job_p);
+         idx++)
+    {
+        victim_p = &threadpool_p->workers[idx];
+        if (0 == atomic_load(&victim_p->batch_left))
+        {
+            continue;
+        }
+
+        // From the back, the owner takes its jobs from the front
+        for (size_t slot = WORKER_BATCH_MAX - 1;
+             (0 < slot) && (NULL == job_p);
+             slot--)
+        {
+            if (NULL != atomic_load(&victim_p->batch[slot]))
+            {
+                job_p = atomic_exchange(&victim_p->batch[slot], NULL);
+            }
+        }
+
+        if (NULL != job_p)
+        {
+            atomic_fetch_sub(&victim_p->batch_left, 1);
+        }
+    }
+
+    return job_p;
+}
+
+static size_t find_jobs(worker_t *worker_p, job_t **jobs_pp)
+{
+    threadpool_t *threadpool_p = worker_p->pool_p;
+    size_t count = 0;
+    size_t node_threads = 0;
+    size_t node = 0;
+
+    if (NULL != worker_p->deque_p)
+    {
+        jobs_pp[0] = ws_deque_pop(worker_p->deque_p);
+        if (NULL != jobs_pp[0])
+        {
+            count = 1;
+            goto END;
+        }
+    }
+
+    // Every node's threads split its backlog, and help the other nodes only
+    // once it is empty
+    node_threads = atomic_load(&threadpool_p->thread_count) /
+                   threadpool_p->node_count;
+    node_threads = (0 == node_threads) ? 1 : node_threads;
+    for (size_t idx = 0; (idx < threadpool_p->node_count) && (0 == count);
+         idx++)
+    {
+        node = (worker_p->node + idx) % threadpool_p->node_count;
+        count = job_queue_pop_batch(&threadpool_p->job_queues[node],
+                                    jobs_pp,
+                                    WORKER_BATCH_MAX,
+                                    node_threads);
+    }
+
+    if (0 != count)
+    {
+        room_freed(threadpool_p);
+        goto END;
+    }
+
+    jobs_pp[0] = NULL;
+    if (NULL != worker_p->deque_p)
+    {
+        jobs_pp[0] = steal_job(worker_p);
+    }
+
+    if (NULL == jobs_pp[0])
+    {
+        jobs_pp[0] = steal_batched_job(worker_p);
+    }
+    count = (NULL != jobs_pp[0]) ? 1 : 0;
+
+END:
+    return count;
+}
+
+static int job_queue_setup(job_queue_t *job_queue_p,
+                           const threadpool_cfg_t *cfg_p)
+{
+    int exit_code = E_FAILURE;
+
+    job_queue_p->type = cfg_p->queue_type;
+    job_queue_p->policy = cfg_p->lane_policy;
+    job_queue_p->starvation_limit = cfg_p->starvation_limit;
+    atomic_init(&job_queue_p->picks, 0);
+    atomic_init(&job_queue_p->high_waiting, 0);
+
+    if ((THREADPOOL_LANES_STRICT != cfg_p->lane_policy) &&
+        (THREADPOOL_LANES_WEIGHTED != cfg_p->lane_policy))
+    {
+        print_error("job_queue_setup(): Invalid lane policy.");
+        goto END;
+    }
+
+    for (size_t lane = 0; lane < THREADPOOL_PRIORITIES; lane++)
+    {
+        // A zero weight would starve its lane for good
+        if ((THREADPOOL_LANES_WEIGHTED == cfg_p->lane_policy) &&
+            ((0 == cfg_p->lane_weights[lane]) ||
+             ((UINT32_MAX - job_queue_p->weight_total) <
+              cfg_p->lane_weights[lane])))
+        {
+            print_error("job_queue_setup(): Invalid lane weight.");
+            goto END;
+        }
+        job_queue_p->weights[lane] = cfg_p->lane_weights[lane];
+        job_queue_p->weight_total += cfg_p->lane_weights[lane];
+    }
+
+    switch (cfg_p->queue_type)
+    {
+    case THREADPOOL_QUEUE_MUTEX:
+        exit_code = pthread_mutex_init(&job_queue_p->mutex, NULL);
+        if (E_SUCCESS != exit_code)
+        {
+            print_error("job_queue_setup(): Unable to initialize mutex.");
+            goto END;
+        }
+        job_queue_p->mutex_initialized = true;
+
+        // Jobs are stored inline so a submission costs no extra allocation,
+        // and the lanes grow rather than rejecting jobs during a burst
+        for (size_t lane = 0; lane < THREADPOOL_PRIORITIES; lane++)
+        {
+            job_queue_p->queues_p[lane] =
+                queue_init_growable(cfg_p->queue_capacity,
+                                    cfg_p->queue_limit,
+                                    QUEUE_MODE_INLINE,
+                                    NULL);
+            if (NULL == job_queue_p->queues_p[lane])
+            {
+                exit_code = E_FAILURE;
+                goto END;
+            }
+        }
+        break;
+
+    case THREADPOOL_QUEUE_LOCKFREE:
+        for (size_t lane = 0; lane < THREADPOOL_PRIORITIES; lane++)
+        {
+            job_queue_p->mpmcs_p[lane] =
+                mpmc_queue_init(cfg_p->queue_capacity);
+            if (NULL == job_queue_p->mpmcs_p[lane])
+            {
+                exit_code = E_FAILURE;
+                goto END;
+            }
+        }
+        break;
+
+    default:
+        print_error("job_queue_setup(): Invalid queue type.");
+        exit_code = E_FAILURE;
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void job_queue_teardown(job_queue_t *job_queue_p)
+{
+    for (size_t lane = 0; lane < THREADPOOL_PRIORITIES; lane++)
+    {
+        if (NULL != job_queue_p->queues_p[lane])
+        {
+            queue_destroy(&job_queue_p->queues_p[lane]);
+        }
+
+        if (NULL != job_queue_p->mpmcs_p[lane])
+        {
+            mpmc_queue_destroy(&job_queue_p->mpmcs_p[lane]);
+        }
+    }
+
+    if (true == job_queue_p->mutex_initialized)
+    {
+        pthread_mutex_destroy(&job_queue_p->mutex);
+        job_queue_p->mutex_initialized = false;
+    }
+}
+
+static int job_queue_push(job_queue_t *job_queue_p,
+                          threadpool_priority_t priority,
+                          job_t *job_p)
+{
+    int exit_code = E_FAILURE;
+
+    // Counted before the job is visible, so a pop never takes the count
+    // below the jobs still waiting
+    job_p->priority = priority;
+    if (THREADPOOL_PRIORITY_HIGH == priority)
+    {
+        atomic_fetch_add(&job_queue_p->high_waiting, 1);
+    }
+
+    if (THREADPOOL_QUEUE_LOCKFREE == job_queue_p->type)
+    {
+        exit_code = mpmc_queue_enqueue(job_queue_p->mpmcs_p[priority], job_p);
+        goto END;
+    }
+
+    pthread_mutex_lock(&job_queue_p->mutex);
+    if (E_SUCCESS != queue_fullcheck(job_queue_p->queues_p[priority]))
+    {
+        exit_code = queue_enqueue(job_queue_p->queues_p[priority], job_p);
+    }
+    pthread_mutex_unlock(&job_queue_p->mutex);
+
+END:
+    if ((E_SUCCESS != exit_code) && (THREADPOOL_PRIORITY_HIGH == priority))
+    {
+        atomic_fetch_sub(&job_queue_p->high_waiting, 1);
+    }
+    return exit_code;
+}
+
+static int job_queue_push_wait(threadpool_t *threadpool_p,
+                               job_queue_t *job_queue_p,
+                               threadpool_priority_t priority,
+                               job_t *job_p,
+                               uint64_t deadline_ns)
+{
+    int exit_code = E_FAILURE;
+    int wait_code = E_SUCCESS;
+    struct timespec deadline = { 0 };
+
+    exit_code = job_queue_push(job_queue_p, priority, job_p);
+    if ((E_SUCCESS == exit_code) || (SUBMIT_NO_WAIT == deadline_ns) ||
+        (false == threadpool_p->bounded))
+    {
+        goto END;
+    }
+
+    deadline.tv_sec = (time_t)(deadline_ns / (uint64_t)NSEC_PER_SEC);
+    deadline.tv_nsec = (long)(deadline_ns % (uint64_t)NSEC_PER_SEC);
+
+    // Announced before the retry, like idle threads in wait_for_job(): either
+    // room_freed() sees the waiter, or the retry sees the room
+    pthread_mutex_lock(&threadpool_p->full_mutex);
+    atomic_fetch_add(&threadpool_p->full_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    for (;;)
+    {
+        // Jobs queued after the threads drained the queue would never run
+        if (SHUTDOWN == threadpool_p->signal)
+        {
+            exit_code = E_FAILURE;
+            break;
+        }
+
+        exit_code = job_queue_push(job_queue_p, priority, job_p);
+        if ((E_SUCCESS == exit_code) || (ETIMEDOUT == wait_code))
+        {
+            break;
+        }
+
+        if (SUBMIT_FOREVER == deadline_ns)
+        {
+            wait_code = pthread_cond_wait(&threadpool_p->not_full,
+                                          &threadpool_p->full_mutex);
+        }
+        else
+        {
+            wait_code = pthread_cond_timedwait(&threadpool_p->not_full,
+                                               &threadpool_p->full_mutex,
+                                               &deadline);
+        }
+
+        if ((E_SUCCESS != wait_code) && (ETIMEDOUT != wait_code))
+        {
+            print_error("job_queue_push_wait(): Unable to wait for room.");
+            break;
+        }
+    }
+    atomic_fetch_sub(&threadpool_p->full_waiters, 1);
+    pthread_mutex_unlock(&threadpool_p->full_mutex);
+
+END:
+    return exit_code;
+}
+
+static void room_freed(threadpool_t *threadpool_p)
+{
+    if (false == threadpool_p->bounded)
+    {
+        return;
+    }
+
+    // Pairs with the fence in job_queue_push_wait()
+    atomic_thread_fence(memory_order_seq_cst);
+    if (0 == atomic_load(&threadpool_p->full_waiters))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&threadpool_p->full_mutex);
+    pthread_cond_broadcast(&threadpool_p->not_full);
+    pthread_mutex_unlock(&threadpool_p->full_mutex);
+}
+
+static size_t job_queue_push_many(job_queue_t *job_queue_p,
+                                  job_t **jobs_pp,
+                                  size_t count)
+{
+    size_t pushed = 0;
+    threadpool_priority_t lane = THREADPOOL_PRIORITY_NORMAL;
+
+    if (THREADPOOL_QUEUE_LOCKFREE == job_queue_p->type)
+    {
+        while ((pushed < count) &&
+               (E_SUCCESS == mpmc_queue_enqueue(job_queue_p->mpmcs_p[lane],
+                                                jobs_pp[pushed])))
+        {
+            pushed++;
+        }
+        goto END;
+    }
+
+    if (UINT32_MAX < count)
+    {
+        goto END;
+    }
+
+    pthread_mutex_lock(&job_queue_p->mutex);
+    if (E_SUCCESS == queue_enqueue_many(job_queue_p->queues_p[lane],
+                                        (void **)jobs_pp,
+                                        (uint32_t)count))
+    {
+        pushed = count;
+    }
+    pthread_mutex_unlock(&job_queue_p->mutex);
+
+END:
+    return pushed;
+}
+
+static size_t job_queue_pop_batch(job_queue_t *job_queue_p,
+                                  job_t **jobs_pp,
+                                  size_t max,
+                                  size_t thread_count)
+{
+    size_t popped = 0;
+    size_t share = 0;
+    queue_t *lane_p = NULL;
+    threadpool_priority_t order[THREADPOOL_PRIORITIES];
+    threadpool_priority_t lane = THREADPOOL_PRIORITY_NORMAL;
+
+    lane_order(job_queue_p, order);
+
+    if (THREADPOOL_QUEUE_LOCKFREE == job_queue_p->type)
+    {
+        for (size_t idx = 0; (idx < THREADPOOL_PRIORITIES) && (0 == popped);
+             idx++)
+        {
+            jobs_pp[0] = mpmc_queue_dequeue(job_queue_p->mpmcs_p[order[idx]]);
+            popped = (NULL != jobs_pp[0]) ? 1 : 0;
+            lane = order[idx];
+        }
+        goto END;
+    }
+
+    pthread_mutex_lock(&job_queue_p->mutex);
+    for (size_t idx = 0; (idx < THREADPOOL_PRIORITIES) && (0 == popped);
+         idx++)
+    {
+        lane_p = job_queue_p->queues_p[order[idx]];
+        if (0 == lane_p->currentsz)
+        {
+            continue;
+        }
+
+        // Take an even share of the backlog so a burst is spread across every
+        // thread rather than hoarded by whichever one locked first
+        share = lane_p->currentsz / thread_count;
+        share = (share > max) ? max : share;
+        share = (0 == share) ? 1 : share;
+
+        popped = queue_dequeue_many(lane_p, (void **)jobs_pp, (uint32_t)share);
+        lane = order[idx];
+    }
+    pthread_mutex_unlock(&job_queue_p->mutex);
+
+END:
+    if ((0 != popped) && (THREADPOOL_PRIORITY_HIGH == lane))
+    {
+        atomic_fetch_sub(&job_queue_p->high_waiting, popped);
+    }
+    return popped;
+}
+
+static void lane_order(job_queue_t *job_queue_p,
+                       threadpool_priority_t order[THREADPOOL_PRIORITIES])
+{
+    unsigned int pick = atomic_fetch_add_explicit(
+        &job_queue_p->picks, 1, memory_order_relaxed);
+    threadpool_priority_t first = THREADPOOL_PRIORITY_HIGH;
+    uint32_t position = 0;
+    size_t next = 1;
+
+    if (THREADPOOL_LANES_WEIGHTED == job_queue_p->policy)
+    {
+        // Each lane owns a run of picks as long as its weight
+        position = pick % job_queue_p->weight_total;
+        while (position >= job_queue_p->weights[first])
+        {
+            position -= job_queue_p->weights[first];
+            first++;
+        }
+    }
+    else if ((0 != job_queue_p->starvation_limit) &&
+             (0 == ((pick + 1) % job_queue_p->starvation_limit)))
+    {
+        // Boosts rotate through the lanes below THREADPOOL_PRIORITY_HIGH
+        first = (threadpool_priority_t)(
+            1 + ((pick / job_queue_p->starvation_limit) %
+                 (THREADPOOL_PRIORITIES - 1)));
+    }
+
+    // The other lanes follow in priority order
+    order[0] = first;
+    for (size_t lane = 0; lane < THREADPOOL_PRIORITIES; lane++)
+    {
+        if (first != lane)
+        {
+            order[next] = (threadpool_priority_t)lane;
+            next++;
+        }
+    }
+}
+
+static job_t *preempt_job(worker_t *worker_p)
+{
+    job_queue_t *job_queue_p = &worker_p->pool_p->job_queues[worker_p->node];
+    job_t *job_p = NULL;
+    threadpool_priority_t order[THREADPOOL_PRIORITIES];
+
+    // A relaxed load per batched job, the lane is only locked when it has
+    // jobs
+    if ((THREADPOOL_LANES_STRICT != job_queue_p->policy) ||
+        (0 == atomic_load_explicit(&job_queue_p->high_waiting,
+                                   memory_order_relaxed)))
+    {
+        goto END;
+    }
+
+    lane_order(job_queue_p, order);
+    if (THREADPOOL_PRIORITY_HIGH != order[0])
+    {
+        goto END;
+    }
+
+    if (THREADPOOL_QUEUE_LOCKFREE == job_queue_p->type)
+    {
+        job_p = mpmc_queue_dequeue(
+            job_queue_p->mpmcs_p[THREADPOOL_PRIORITY_HIGH]);
+    }
+    else
+    {
+        pthread_mutex_lock(&job_queue_p->mutex);
+        job_p = queue_dequeue_data(
+            job_queue_p->queues_p[THREADPOOL_PRIORITY_HIGH]);
+        pthread_mutex_unlock(&job_queue_p->mutex);
+    }
+
+    if (NULL != job_p)
+    {
+        atomic_fetch_sub(&job_queue_p->high_waiting, 1);
+        room_freed(worker_p->pool_p);
+    }
+
+END:
+    return job_p;
+}
+
+static void wake_threads(threadpool_t *threadpool_p, size_t count)
+{
+    size_t idle = 0;
+
+    // Pairs with the fence in wait_for_job(): either this load sees the
+    // sleeper's increment, or the sleeper's re-check sees the pushed jobs
+    atomic_thread_fence(memory_order_seq_cst);
+    idle = atomic_load(&threadpool_p->idle_threads);
+    if (0 == idle)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&threadpool_p->mutex);
+    if (count >= idle)
+    {
+        pthread_cond_broadcast(&threadpool_p->condition);
+    }
+    else
+    {
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            pthread_cond_signal(&threadpool_p->condition);
+        }
+    }
+    pthread_mutex_unlock(&threadpool_p->mutex);
+}
+
+// covers 4.5.4 Demonstrate the ability to use threads, locks, conditions,
+// atomics
+static void *start_thread(void *worker_p)
+{
+    // Initialize
+    int exit_code = E_FAILURE;
+    job_t *jobs[WORKER_BATCH_MAX] = {NULL};
+    job_t *job_p = NULL;
+    size_t count = 0;
+    size_t next = 0;
+    size_t ran = 0;
+    size_t cut_ins = 0;
+    threadpool_priority_t lane = THREADPOOL_PRIORITY_NORMAL;
+    stats_shard_t *shard_p = NULL;
+    uint64_t start_ns = 0;
+    uint64_t run_ns = 0;
+
+    if (NULL == worker_p)
+    {
+        goto END;
+    }
+
+    current_worker_g = (worker_t *)worker_p;
+
+    if ((true == current_worker_g->pinned) &&
+        (E_SUCCESS != sched_setaffinity(
+                          0, sizeof(cpu_set_t), &current_worker_g->cpus)))
+    {
+        print_error("start_thread(): Unable to set CPU affinity.");
+    }
+
+    shard_p = stats_shard(current_worker_g->pool_p);
+
+    // Built once the thread is pinned, so memory it touches first is local
+    current_worker_g->ctx_p = NULL;
+    if (NULL != current_worker_g->pool_p->worker_init)
+    {
+        current_worker_g->ctx_p = current_worker_g->pool_p->worker_init(
+            current_worker_g->id, current_worker_g->pool_p->worker_arg_p);
+    }
+
+    // Main loop for processing jobs
+    for (;;)
+    {
+        if (KEEP_RUNNING != signal_flag_g)
+        {
+            print_error("start_thread(): Signal caught.");
+            goto END;
+        }
+
+        exit_code = get_next_job(current_worker_g, jobs, &count);
+        if (E_SUCCESS != exit_code)
+        {
+            goto END;
+        }
+
+        // A job that sat in the queue too long means every thread is stuck
+        if ((0 != current_worker_g->pool_p->spawn_wait_ns) &&
+            (0 != jobs[0]->queued_ns) &&
+            (current_worker_g->pool_p->spawn_wait_ns <
+             (monotonic_ns() - jobs[0]->queued_ns)))
+        {
+            grow_pool(current_worker_g->pool_p, true);
+        }
+
+        // The rest of the batch waits where a thread that runs out of work
+        // can take it, rather than behind a long job. Jobs waiting in the
+        // batch still count as queued.
+        lane = jobs[0]->priority;
+        if (1 < count)
+        {
+            for (size_t idx = 1; idx < count; idx++)
+            {
+                atomic_store(&current_worker_g->batch[idx], jobs[idx]);
+            }
+            atomic_store(&current_worker_g->batch_left, count - 1);
+        }
+
+        // A HIGH job that arrives meanwhile cuts in ahead of the rest of a
+        // lower lane's batch
+        next = 0;
+        ran = 0;
+        cut_ins = 0;
+        while (next < count)
+        {
+            job_p = NULL;
+            if ((0 != next) && (THREADPOOL_PRIORITY_HIGH != lane))
+            {
+                job_p = preempt_job(current_worker_g);
+            }
+
+            if (NULL != job_p)
+            {
+                cut_ins++;
+            }
+            else if (0 == next)
+            {
+                job_p = jobs[0];
+                next++;
+                ran++;
+            }
+            else
+            {
+                job_p = atomic_exchange(&current_worker_g->batch[next], NULL);
+                next++;
+                if (NULL == job_p)
+                {
+                    // Another thread took it
+                    continue;
+                }
+                atomic_fetch_sub(&current_worker_g->batch_left, 1);
+                ran++;
+            }
+
+            atomic_fetch_add_explicit(
+                &shard_p->started, 1, memory_order_relaxed);
+            if (true == current_worker_g->pool_p->time_jobs)
+            {
+                start_ns = monotonic_ns();
+                histogram_record(&shard_p->wait, start_ns - job_p->queued_ns);
+            }
+
+            exit_code = process_job(job_p);
+            if (E_SUCCESS != exit_code)
+            {
+                print_error("start_thread(): Unable to execute job.");
+            }
+
+            if (true == current_worker_g->pool_p->time_jobs)
+            {
+                run_ns = monotonic_ns() - start_ns;
+                histogram_record(&shard_p->run, run_ns);
+                atomic_fetch_add_explicit(
+                    &shard_p->busy_ns, run_ns, memory_order_relaxed);
+            }
+            atomic_fetch_add_explicit(
+                &shard_p->completed, 1, memory_order_relaxed);
+
+            slab_free(current_worker_g->pool_p->job_slab, job_p);
+        }
+        jobs_finished(current_worker_g->pool_p, ran + cut_ins);
+    }
+
+END:
+    // Every exit, retiring, shutting down or catching a signal, releases it
+    if ((NULL != current_worker_g) &&
+        (NULL != current_worker_g->pool_p->worker_teardown))
+    {
+        current_worker_g->pool_p->worker_teardown(
+            current_worker_g->ctx_p, current_worker_g->pool_p->worker_arg_p);
+    }
+
+    // A retired slot is only reused once its teardown is over, so joining
+    // the thread never waits on it
+    if (NULL != current_worker_g)
+    {
+        pthread_mutex_lock(&current_worker_g->pool_p->mutex);
+        if (WORKER_RETIRING == current_worker_g->state)
+        {
+            current_worker_g->pool_p->retiring--;
+            current_worker_g->state = WORKER_EXITED;
+        }
+        pthread_mutex_unlock(&current_worker_g->pool_p->mutex);
+    }
+    current_worker_g = NULL;
+    return NULL;
+}
+
+static void jobs_finished(threadpool_t *threadpool_p, size_t count)
+{
+    if (count != atomic_fetch_sub(&threadpool_p->pending_jobs, count))
+    {
+        return;
+    }
+
+    // A waiter either counted itself before the subtraction above, or it
+    // will see no pending jobs before it goes to sleep
+    if (0 != atomic_load(&threadpool_p->idle_waiters))
+    {
+        pthread_mutex_lock(&threadpool_p->mutex);
+        pthread_cond_broadcast(&threadpool_p->idle_condition);
+        pthread_mutex_unlock(&threadpool_p->mutex);
+    }
+}
+
+static job_t *create_job(threadpool_t *threadpool_p,
+                         JOB_F job,
+                         FREE_F del_f,
+                         void *arg_p,
+                         threadpool_future_t *future_p)
+{
+    job_t *new_job = NULL;
+
+    if (NULL == job)
+    {
+        print_error("threadpool_new_job(): NULL job passed.");
+        goto END;
+    }
+
+    new_job = slab_alloc(threadpool_p->job_slab);
+    if (NULL == new_job)
+    {
+        print_error("threadpool_new_job(): CMR failure.");
+        goto END;
+    }
+
+    new_job->args_p = arg_p;
+    new_job->job = job;
+    new_job->del_f = del_f;
+    new_job->future_p = future_p;
+    new_job->queued_ns = 0;
+    new_job->priority = THREADPOOL_PRIORITY_NORMAL;
+    new_job->next_p = NULL;
+
+END:
+    return new_job;
+}
+
+static int wait_for_job(worker_t *worker_p, job_t **jobs_pp, size_t *count_p)
+{
+    int exit_code = E_FAILURE;
+    threadpool_t *threadpool_p = NULL;
+    struct timespec deadline = { 0 };
+    uint64_t deadline_ns = 0;
+
+    if ((NULL == worker_p) || (NULL == jobs_pp) || (NULL == count_p))
+    {
+        print_error("wait_for_job(): NULL argument passed.");
+        goto END;
+    }
+
+    threadpool_p = worker_p->pool_p;
+
+    // Only threads above the minimum can retire, so only they time out
+    if (threadpool_p->min_threads < threadpool_p->max_threads)
+    {
+        deadline_ns = monotonic_ns() + threadpool_p->keep_alive_ns;
+        deadline.tv_sec = (time_t)(deadline_ns / (uint64_t)NSEC_PER_SEC);
+        deadline.tv_nsec = (long)(deadline_ns % (uint64_t)NSEC_PER_SEC);
+    }
+
+    for (;;)
+    {
+        // Announce the intent to sleep before the final re-check so that a
+        // producer pushing concurrently is guaranteed to signal
+        atomic_fetch_add(&threadpool_p->idle_threads, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        *count_p = find_jobs(worker_p, jobs_pp);
+        if ((0 != *count_p) || (SHUTDOWN == threadpool_p->signal))
+        {
+            atomic_fetch_sub(&threadpool_p->idle_threads, 1);
+            break;
+        }
+
+        if (KEEP_RUNNING != signal_flag_g)
+        {
+            print_error("wait_for_job(): Signal caught.");
+            atomic_fetch_sub(&threadpool_p->idle_threads, 1);
+            goto END;
+        }
+
+        if (threadpool_p->min_threads >=
+            atomic_load(&threadpool_p->thread_count))
+        {
+            exit_code = pthread_cond_wait(&threadpool_p->condition,
+                                          &threadpool_p->mutex);
+        }
+        else
+        {
+            exit_code = pthread_cond_timedwait(
+                &threadpool_p->condition, &threadpool_p->mutex, &deadline);
+        }
+        atomic_fetch_sub(&threadpool_p->idle_threads, 1);
+
+        if (ETIMEDOUT == exit_code)
+        {
+            // Retire unless work arrived with the timeout. The thread count
+            // only changes under the mutex, so the pool never drops below
+            // min_threads
+            *count_p = find_jobs(worker_p, jobs_pp);
+            if ((0 != *count_p) || (SHUTDOWN == threadpool_p->signal))
+            {
+                break;
+            }
+
+            if (threadpool_p->min_threads >=
+                atomic_load(&threadpool_p->thread_count))
+            {
+                continue;
+            }
+
+            atomic_fetch_sub(&threadpool_p->thread_count, 1);
+            threadpool_p->retired_ns += monotonic_ns() - worker_p->started_ns;
+            threadpool_p->retiring++;
+            worker_p->state = WORKER_RETIRING;
+            break;
+        }
+
+        if (E_SUCCESS != exit_code)
+        {
+            print_error("Unable to wait on condition.");
+            goto END;
+        }
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#else
+    atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+static size_t spin_for_job(worker_t *worker_p, job_t **jobs_pp)
+{
+    threadpool_t *threadpool_p = worker_p->pool_p;
+    size_t count = 0;
+    uint32_t backoff = 1;
+    uint32_t floor = 0;
+
+    for (uint32_t spin = 0; spin < worker_p->spin_limit; spin++)
+    {
+        // Backing off keeps spinners from hammering the job queue locks
+        for (uint32_t pause = 0; pause < backoff; pause++)
+        {
+            cpu_relax();
+        }
+        backoff = (SPIN_BACKOFF_MAX > backoff) ? backoff * 2 : backoff;
+
+        if (SHUTDOWN == atomic_load(&threadpool_p->signal))
+        {
+            goto END;
+        }
+
+        count = find_jobs(worker_p, jobs_pp);
+        if (0 != count)
+        {
+            worker_p->spin_limit =
+                (threadpool_p->spin_count / 2 < worker_p->spin_limit)
+                    ? threadpool_p->spin_count
+                    : worker_p->spin_limit * 2;
+            goto END;
+        }
+    }
+
+    // Lets other threads on the same CPU run, a producer among them
+    for (uint32_t yield = 0; yield < threadpool_p->yield_count; yield++)
+    {
+        sched_yield();
+        if (SHUTDOWN == atomic_load(&threadpool_p->signal))
+        {
+            goto END;
+        }
+
+        count = find_jobs(worker_p, jobs_pp);
+        if (0 != count)
+        {
+            goto END;
+        }
+    }
+
+    // Spinning did not pay off, so spin less before parking next time
+    floor = (threadpool_p->spin_count + SPIN_FLOOR_DIVISOR - 1) /
+            SPIN_FLOOR_DIVISOR;
+    worker_p->spin_limit = (floor < worker_p->spin_limit / 2)
+                               ? worker_p->spin_limit / 2
+                               : floor;
+
+END:
+    return count;
+}
+
+static int get_next_job(worker_t *worker_p, job_t **jobs_pp, size_t *count_p)
+{
+    int exit_code = E_FAILURE;
+    threadpool_t *threadpool_p = NULL;
+
+    if ((NULL == worker_p) || (NULL == jobs_pp) || (NULL == count_p))
+    {
+        print_error("get_next_job(): NULL argument passed.");
+        goto END;
+    }
+
+    threadpool_p = worker_p->pool_p;
+
+    // Fast path, no need to touch the sleep mutex while work is available.
+    // Spinning threads are not counted as idle, so producers skip the wakeup
+    *count_p = find_jobs(worker_p, jobs_pp);
+    if (0 == *count_p)
+    {
+        *count_p = spin_for_job(worker_p, jobs_pp);
+    }
+
+    if (0 == *count_p)
+    {
+        pthread_mutex_lock(&threadpool_p->mutex);
+        exit_code = wait_for_job(worker_p, jobs_pp, count_p);
+        pthread_mutex_unlock(&threadpool_p->mutex);
+        if (E_SUCCESS != exit_code)
+        {
+            goto END;
+        }
+    }
+
+    // The queue is drained and the threadpool is shutting down, or the thread
+    // retired
+    if (0 == *count_p)
+    {
+        exit_code = E_FAILURE;
+        goto END;
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static int process_job(job_t *job_p)
+{
+    int exit_code = E_FAILURE;
+    void *result_p = NULL;
+
+    if (NULL == job_p)
+    {
+        print_error("process_job(): NULL job passed.");
+        goto END;
+    }
+
+    if (NULL != job_p->job)
+    {
+        // Attempt to run the job
+        result_p = job_p->job(job_p->args_p);
+    }
+
+    if (NULL != job_p->del_f)
+    {
+        // Attempt to perform cleanup if necessary
+        job_p->del_f(job_p->args_p);
+    }
+
+    // Completed last so a waiter finds the job fully cleaned up
+    if (NULL != job_p->future_p)
+    {
+        future_complete(job_p->future_p, result_p);
+    }
+
+    exit_code = E_SUCCESS;
+END:
+    return exit_code;
+}
+
+static void threadpool_teardown(threadpool_t **threadpool_pp)
+{
+    if ((NULL == threadpool_pp) || (NULL == *threadpool_pp))
+    {
+        print_error("threadpool_destroy(): NULL threadpool passed.");
+        goto END;
+    }
+
+    // 1. Deallocate memory for threads
+    if (NULL != (*threadpool_pp)->threads)
+    {
+        free((*threadpool_pp)->threads);
+    }
+
+    // 2. Destroy the per-thread state, the strands, the counters and the
+    // job queues
+    workers_teardown(*threadpool_pp);
+    strands_teardown(*threadpool_pp);
+    free((*threadpool_pp)->stats_shards);
+    if (NULL != (*threadpool_pp)->job_queues)
+    {
+        for (size_t idx = 0; idx < (*threadpool_pp)->node_count; idx++)
+        {
+            job_queue_teardown(&(*threadpool_pp)->job_queues[idx]);
+        }
+        free((*threadpool_pp)->job_queues);
+    }
+    free((*threadpool_pp)->node_cpus);
+
+    // 3. Drop the timers that never expired, then release every job_t,
+    // including any the job queue still held
+    if (NULL != (*threadpool_pp)->timers)
+    {
+        timer_wheel_destroy(&(*threadpool_pp)->timers);
+    }
+
+    if (NULL != (*threadpool_pp)->job_slab)
+    {
+        slab_destroy(&(*threadpool_pp)->job_slab);
+    }
+
+    if (NULL != (*threadpool_pp)->token_slab)
+    {
+        slab_destroy(&(*threadpool_pp)->token_slab);
+    }
+    futures_teardown(*threadpool_pp);
+
+    // 4. Destroy the work condition
+    if (true == (*threadpool_pp)->condition_initialized)
+    {
+        pthread_cond_destroy(&(*threadpool_pp)->condition);
+    }
+
+    if (true == (*threadpool_pp)->idle_condition_initialized)
+    {
+        pthread_cond_destroy(&(*threadpool_pp)->idle_condition);
+    }
+
+    if (true == (*threadpool_pp)->not_full_initialized)
+    {
+        pthread_cond_destroy(&(*threadpool_pp)->not_full);
+    }
+
+    if (true == (*threadpool_pp)->timer_condition_initialized)
+    {
+        pthread_cond_destroy(&(*threadpool_pp)->timer_condition);
+    }
+
+    // 5. Destroy the mutexes
+    if (true == (*threadpool_pp)->work_mutex_initialized)
+    {
+        pthread_mutex_destroy(&(*threadpool_pp)->mutex);
+    }
+
+    if (true == (*threadpool_pp)->full_mutex_initialized)
+    {
+        pthread_mutex_destroy(&(*threadpool_pp)->full_mutex);
+    }
+
+    if (true == (*threadpool_pp)->timer_mutex_initialized)
+    {
+        pthread_mutex_destroy(&(*threadpool_pp)->timer_mutex);
+    }
+
+END:
+    return;
+}
+
+static int add_timer(threadpool_t *pool_p,
+                     uint32_t delay_ms,
+                     uint32_t period_ms,
+                     JOB_F job,
+                     FREE_F del_f,
+                     void *arg_p,
+                     threadpool_timer_t *timer_p)
+{
+    int exit_code = E_FAILURE;
+    pool_timer_t *entry_p = NULL;
+    timer_handle_t handle = TIMER_INVALID_HANDLE;
+    uint64_t expiry = 0;
+
+    if ((NULL == pool_p) || (NULL == job))
+    {
+        print_error("add_timer(): NULL argument passed.");
+        goto END;
+    }
+
+    if (SHUTDOWN == pool_p->signal)
+    {
+        print_error("add_timer(): Threadpool already shutdown.");
+        goto END;
+    }
+
+    entry_p = calloc(1, sizeof(pool_timer_t));
+    if (NULL == entry_p)
+    {
+        print_error("add_timer(): CMR failure.");
+        goto END;
+    }
+
+    entry_p->job = job;
+    entry_p->del_f = del_f;
+    entry_p->args_p = arg_p;
+    entry_p->period = period_ms;
+    atomic_init(&entry_p->queued, false);
+    atomic_init(&entry_p->refs, 1);
+
+    pthread_mutex_lock(&pool_p->timer_mutex);
+    if (true == pool_p->timer_stop)
+    {
+        print_error("add_timer(): Threadpool already shutdown.");
+        goto UNLOCK;
+    }
+
+    if ((false == pool_p->timer_started) &&
+        (E_SUCCESS != timers_start(pool_p)))
+    {
+        print_error("add_timer(): Unable to start timer thread.");
+        goto UNLOCK;
+    }
+
+    // Rounded up, a job never runs before its delay has passed
+    expiry = timer_tick_of(pool_p,
+                           monotonic_ns() +
+                               ((uint64_t)delay_ms * NSEC_PER_MSEC) +
+                               (TIMER_TICK_NS - 1));
+    if (E_SUCCESS !=
+        timer_wheel_add(pool_p->timers, expiry, entry_p, &handle))
+    {
+        print_error("add_timer(): Unable to add timer.");
+        goto UNLOCK;
+    }
+
+    // Only a timer due before the timer thread wakes up has to wake it
+    if (expiry < pool_p->timer_wake)
+    {
+        pthread_cond_signal(&pool_p->timer_condition);
+    }
+
+    if (NULL != timer_p)
+    {
+        *timer_p = handle;
+    }
+    entry_p = NULL;
+    exit_code = E_SUCCESS;
+
+UNLOCK:
+    pthread_mutex_unlock(&pool_p->timer_mutex);
+
+    // A timer that was never added leaves arg_p to the caller
+    free(entry_p);
+END:
+    return exit_code;
+}
+
+static int timers_start(threadpool_t *threadpool_p)
+{
+    int exit_code = E_FAILURE;
+
+    threadpool_p->timers = timer_wheel_create(0, timer_put);
+    if (NULL == threadpool_p->timers)
+    {
+        print_error("timers_start(): Unable to create timing wheel.");
+        goto END;
+    }
+
+    exit_code = pthread_create(
+        &threadpool_p->timer_thread, NULL, timer_thread, threadpool_p);
+    if (E_SUCCESS != exit_code)
+    {
+        print_error("timers_start(): Unable to create timer thread.");
+        timer_wheel_destroy(&threadpool_p->timers);
+        exit_code = E_FAILURE;
+        goto END;
+    }
+    threadpool_p->timer_started = true;
+
+END:
+    return exit_code;
+}
+
+static void timers_stop(threadpool_t *threadpool_p)
+{
+    bool started = false;
+
+    pthread_mutex_lock(&threadpool_p->timer_mutex);
+    threadpool_p->timer_stop = true;
+    started = threadpool_p->timer_started;
+    threadpool_p->timer_started = false;
+    pthread_cond_signal(&threadpool_p->timer_condition);
+    pthread_mutex_unlock(&threadpool_p->timer_mutex);
+
+    if (true == started)
+    {
+        pthread_join(threadpool_p->timer_thread, NULL);
+    }
+}
+
+static void *timer_thread(void *threadpool_p)
+{
+    threadpool_t *pool_p = (threadpool_t *)threadpool_p;
+    uint64_t next = 0;
+    uint64_t wake_ns = 0;
+    struct timespec deadline = { 0 };
+
+    pthread_mutex_lock(&pool_p->timer_mutex);
+    while (false == pool_p->timer_stop)
+    {
+        pool_p->timer_tick = timer_tick_of(pool_p, monotonic_ns());
+        timer_wheel_advance(
+            pool_p->timers, pool_p->timer_tick, timer_expired, pool_p);
+
+        // Jumps straight to the next tick with a timer, however far off
+        if (E_SUCCESS != timer_wheel_next_tick(pool_p->timers, &next))
+        {
+            pool_p->timer_wake = TIMER_NO_WAKE;
+            pthread_cond_wait(&pool_p->timer_condition, &pool_p->timer_mutex);
+            continue;
+        }
+
+        pool_p->timer_wake = next;
+        wake_ns = pool_p->created_ns + (next * TIMER_TICK_NS);
+        deadline.tv_sec = (time_t)(wake_ns / (uint64_t)NSEC_PER_SEC);
+        deadline.tv_nsec = (long)(wake_ns % (uint64_t)NSEC_PER_SEC);
+        pthread_cond_timedwait(
+            &pool_p->timer_condition, &pool_p->timer_mutex, &deadline);
+    }
+    pthread_mutex_unlock(&pool_p->timer_mutex);
+
+    return NULL;
+}
+
+static uint64_t timer_expired(void *timer_p, uint64_t tick, void *threadpool_p)
+{
+    threadpool_t *pool_p = (threadpool_t *)threadpool_p;
+    pool_timer_t *entry_p = (pool_timer_t *)timer_p;
+    uint64_t next = TIMER_WHEEL_NEVER;
+    int exit_code = E_SUCCESS;
+
+    // Runs never overlap, a periodic job still busy skips this period
+    if (false == atomic_exchange(&entry_p->queued, true))
+    {
+        atomic_fetch_add(&entry_p->refs, 1);
+        exit_code = add_job(pool_p,
+                            NODE_LOCAL,
+                            THREADPOOL_PRIORITY_NORMAL,
+                            SUBMIT_NO_WAIT,
+                            timer_job,
+                            NULL,
+                            entry_p,
+                            NULL);
+        if (E_SUCCESS != exit_code)
+        {
+            atomic_store(&entry_p->queued, false);
+            atomic_fetch_sub(&entry_p->refs, 1);
+        }
+    }
+
+    if (0 != entry_p->period)
+    {
+        // Periods the timer thread fell behind on are skipped, not caught
+        // up on
+        next = tick + entry_p->period;
+        next = (next <= pool_p->timer_tick) ? pool_p->timer_tick + 1 : next;
+    }
+    else if (THREADPOOL_QUEUE_FULL == exit_code)
+    {
+        next = tick + 1;
+    }
+    else
+    {
+        // The wheel's reference, the queued run holds its own
+        timer_put(entry_p);
+    }
+
+    return next;
+}
+
+static void *timer_job(void *timer_p)
+{
+    pool_timer_t *entry_p = (pool_timer_t *)timer_p;
+
+    entry_p->job(entry_p->args_p);
+    atomic_store(&entry_p->queued, false);
+    timer_put(entry_p);
+
+    return NULL;
+}
+
+static void timer_put(void *timer_p)
+{
+    pool_timer_t *entry_p = (pool_timer_t *)timer_p;
+
+    if (1 != atomic_fetch_sub(&entry_p->refs, 1))
+    {
+        return;
+    }
+
+    if (NULL != entry_p->del_f)
+    {
+        entry_p->del_f(entry_p->args_p);
+    }
+    free(entry_p);
+}
+
+static uint64_t timer_tick_of(threadpool_t *threadpool_p, uint64_t ns)
+{
+    return (ns - threadpool_p->created_ns) / (uint64_t)TIMER_TICK_NS;
+}
+
+static void *token_job(void *token_p)
+{
+    threadpool_token_t *entry_p = (threadpool_token_t *)token_p;
+    threadpool_token_t *outer_p = current_token_g;
+    int state = TOKEN_STATE_QUEUED;
+    void *result_p = NULL;
+
+    if (atomic_compare_exchange_strong(
+            &entry_p->state, &state, TOKEN_STATE_RUNNING))
+    {
+        // Restored after, a job may run other jobs while it waits on them
+        current_token_g = entry_p;
+        result_p = entry_p->job(entry_p->args_p);
+        current_token_g = outer_p;
+        atomic_store(&entry_p->state, TOKEN_STATE_DONE);
+    }
+    else
+    {
+        atomic_fetch_add_explicit(&stats_shard(entry_p->pool_p)->cancelled,
+                                  1,
+                                  memory_order_relaxed);
+    }
+
+    if (NULL != entry_p->del_f)
+    {
+        entry_p->del_f(entry_p->args_p);
     }
+    token_put(entry_p);
 
-    threadpool_p->signal = ACTIVATE;
-    threadpool_p->thread_count = thread_count;
-    threadpool_p->max_threads = thread_count;
+    return result_p;
+}
 
-    for (size_t idx = 0; idx < thread_count; idx++)
+static void token_put(threadpool_token_t *token_p)
+{
+    if (1 == atomic_fetch_sub(&token_p->refs, 1))
     {
-        exit_code = pthread_create(
-            &threadpool_p->threads[idx], NULL, start_thread, threadpool_p);
-        if (E_SUCCESS != exit_code)
-        {
-            print_error("threadpool_create(): failed to create thread.");
-            threadpool_teardown(&threadpool_p);
-            free(threadpool_p);
-            threadpool_p = NULL;
-            goto END;
-        }
+        slab_free(token_p->pool_p->token_slab, token_p);
     }
-
-END:
-    return threadpool_p;
 }
 
-int threadpool_shutdown(threadpool_t *pool_p)
+static int futures_setup(threadpool_t *threadpool_p)
 {
     int exit_code = E_FAILURE;
+    pthread_condattr_t attr;
+    future_bucket_t *bucket_p = NULL;
 
-    if (NULL == pool_p)
+    threadpool_p->future_slab =
+        slab_create(sizeof(threadpool_future_t), SLAB_DEFAULT_BATCH);
+    if (NULL == threadpool_p->future_slab)
     {
-        print_error("threadpool_shutdown(): NULL threadpool passed.");
         goto END;
     }
 
-    pool_p->signal = SHUTDOWN;
-
-    pthread_mutex_lock(&pool_p->mutex);
-    exit_code = pthread_cond_broadcast(&pool_p->condition);
-    if (E_SUCCESS != exit_code)
+    // Timed waits measure against CLOCK_MONOTONIC so clock changes are ignored
+    if (E_SUCCESS != pthread_condattr_init(&attr))
     {
-        print_error("threadpool_shutdown(): Unable to wake up threads.");
-        pthread_mutex_unlock(&pool_p->mutex);
         goto END;
     }
-    pthread_mutex_unlock(&pool_p->mutex);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
 
-    for (size_t idx = 0; idx < pool_p->thread_count; idx++)
+    for (size_t idx = 0; idx < FUTURE_WAIT_BUCKETS; idx++)
     {
-        exit_code = pthread_join(pool_p->threads[idx], NULL);
-        if (E_SUCCESS != exit_code)
+        bucket_p = &threadpool_p->buckets[idx];
+        if (E_SUCCESS != pthread_mutex_init(&bucket_p->mutex, NULL))
         {
-            print_error("threadpool_shutdown(): Unable to join threads.");
-            goto END;
+            break;
+        }
+
+        if (E_SUCCESS != pthread_cond_init(&bucket_p->condition, &attr))
+        {
+            pthread_mutex_destroy(&bucket_p->mutex);
+            break;
         }
+        threadpool_p->buckets_initialized++;
     }
+    pthread_condattr_destroy(&attr);
 
-    free(pool_p->threads);
-    pool_p->threads = NULL;
+    if (FUTURE_WAIT_BUCKETS != threadpool_p->buckets_initialized)
+    {
+        goto END;
+    }
 
     exit_code = E_SUCCESS;
 END:
     return exit_code;
 }
 
-// covers 4.5.2 Demonstrate the ability to use signal handling
-// covers 4.1.25 Demonstrate the ability to manage memory in multi-threaded
-// programs
-int threadpool_destroy(threadpool_t **pool_pp)
+static void futures_teardown(threadpool_t *threadpool_p)
 {
-    int exit_code = E_FAILURE;
-
-    if ((NULL == pool_pp) || (NULL == *pool_pp))
+    for (size_t idx = 0; idx < threadpool_p->buckets_initialized; idx++)
     {
-        print_error("threadpool_destroy(): NULL threadpool passed.");
-        goto END;
+        pthread_cond_destroy(&threadpool_p->buckets[idx].condition);
+        pthread_mutex_destroy(&threadpool_p->buckets[idx].mutex);
     }
+    threadpool_p->buckets_initialized = 0;
 
-    if (SHUTDOWN != (*pool_pp)->signal)
+    if (NULL != threadpool_p->future_slab)
     {
-        exit_code = threadpool_shutdown(*pool_pp);
-        if (E_SUCCESS != exit_code)
-        {
-            print_error("threadpool_destroy(): Unable to perform shutdown.");
-            goto END;
-        }
+        slab_destroy(&threadpool_p->future_slab);
     }
+}
 
-    threadpool_teardown(pool_pp);
-
-    free(*pool_pp);
-    *pool_pp = NULL;
+static future_bucket_t *future_bucket(threadpool_future_t *future_p)
+{
+    // Futures are slab objects, the low bits carry no information
+    uintptr_t hash = (uintptr_t)future_p / sizeof(threadpool_future_t);
 
-    exit_code = E_SUCCESS;
-END:
-    return exit_code;
+    return &future_p->pool_p->buckets[hash % FUTURE_WAIT_BUCKETS];
 }
 
-int threadpool_add_job(threadpool_t *pool_p,
-                       JOB_F job,
-                       FREE_F del_f,
-                       void *arg_p)
+static void future_complete(threadpool_future_t *future_p, void *result_p)
 {
-    int exit_code = E_FAILURE;
-    job_t *new_job = NULL;
+    future_bucket_t *bucket_p = NULL;
+    int state = FUTURE_STATE_PENDING;
 
-    if ((NULL == pool_p) || (NULL == job))
+    future_p->result_p = result_p;
+    state = atomic_exchange(&future_p->state, FUTURE_STATE_DONE);
+    if (FUTURE_STATE_CONTINUED == state)
     {
-        print_error("threadpool_add_job(): NULL argument passed.");
-        goto END;
+        future_p->then_f(result_p, future_p->then_arg_p);
     }
 
-    if (SHUTDOWN == pool_p->signal)
+    // A waiter either counted itself before the exchange above, or it will
+    // see DONE before it goes to sleep
+    if (0 != atomic_load(&future_p->waiters))
     {
-        print_error("threadpool_add_job(): Threadpool already shutdown.");
-        goto END;
+        bucket_p = future_bucket(future_p);
+        pthread_mutex_lock(&bucket_p->mutex);
+        pthread_cond_broadcast(&bucket_p->condition);
+        pthread_mutex_unlock(&bucket_p->mutex);
     }
 
-    new_job = create_job(job, del_f, arg_p);
-    if (NULL == new_job)
+    future_put(future_p);
+}
+
+static void future_put(threadpool_future_t *future_p)
+{
+    if (1 == atomic_fetch_sub(&future_p->refs, 1))
     {
-        print_error("threadpool_add_job(): Unable to create job.");
-        goto END;
+        slab_free(future_p->pool_p->future_slab, future_p);
     }
+}
 
-    pthread_mutex_lock(&pool_p->mutex);
-    exit_code = queue_enqueue(pool_p->job_queue, new_job);
-    if (E_SUCCESS != exit_code)
+static int future_wait_until(threadpool_future_t *future_p,
+                             const struct timespec *deadline_p,
+                             void **result_pp)
+{
+    int exit_code = E_SUCCESS;
+    future_bucket_t *bucket_p = NULL;
+
+    if (FUTURE_STATE_DONE != atomic_load(&future_p->state))
     {
-        print_error("threadpool_add_job(): queue_enqueue() failed.");
-        pthread_mutex_unlock(&pool_p->mutex);
-        free(new_job);
+        bucket_p = future_bucket(future_p);
+
+        pthread_mutex_lock(&bucket_p->mutex);
+        atomic_fetch_add(&future_p->waiters, 1);
+        while ((E_SUCCESS == exit_code) &&
+               (FUTURE_STATE_DONE != atomic_load(&future_p->state)))
+        {
+            if (NULL == deadline_p)
+            {
+                exit_code = pthread_cond_wait(&bucket_p->condition,
+                                              &bucket_p->mutex);
+            }
+            else
+            {
+                exit_code = pthread_cond_timedwait(
+                    &bucket_p->condition, &bucket_p->mutex, deadline_p);
+            }
+        }
+        atomic_fetch_sub(&future_p->waiters, 1);
+        pthread_mutex_unlock(&bucket_p->mutex);
+    }
+
+    // The job may have finished just as the wait timed out
+    if (FUTURE_STATE_DONE != atomic_load(&future_p->state))
+    {
+        exit_code = (ETIMEDOUT == exit_code) ? THREADPOOL_FUTURE_PENDING
+                                             : E_FAILURE;
         goto END;
     }
-    pthread_cond_signal(&pool_p->condition);
-    pthread_mutex_unlock(&pool_p->mutex);
+
+    if (NULL != result_pp)
+    {
+        *result_pp = future_p->result_p;
+    }
 
     exit_code = E_SUCCESS;
 END:
     return exit_code;
 }
 
-static int threadpool_setup(threadpool_t *threadpool_p, size_t thread_count)
+static int spawn_worker(threadpool_t *threadpool_p)
 {
     int exit_code = E_FAILURE;
+    worker_t *worker_p = NULL;
+    size_t idx = 0;
 
-    if (NULL == threadpool_p)
-    {
-        print_error("threadpool_setup(): NULL threadpool passed.");
-        goto END;
-    }
-
-    // 1. Setup the mutex
-    exit_code = pthread_mutex_init(&threadpool_p->mutex, NULL);
-    if (E_SUCCESS != exit_code)
+    for (idx = 0; idx < threadpool_p->max_threads; idx++)
     {
-        print_error("threadpool_create(): Unable to initialize work mutex.");
-        goto END;
+        if ((WORKER_EMPTY == threadpool_p->workers[idx].state) ||
+            (WORKER_EXITED == threadpool_p->workers[idx].state))
+        {
+            break;
+        }
     }
-    threadpool_p->work_mutex_initialized = true;
 
-    // 2. Setup the work condition
-    exit_code = pthread_cond_init(&threadpool_p->condition, NULL);
-    if (E_SUCCESS != exit_code)
+    if (threadpool_p->max_threads == idx)
     {
-        print_error("threadpool_create(): Unable to initialize condition.");
         goto END;
     }
-    threadpool_p->condition_initialized = true;
+    worker_p = &threadpool_p->workers[idx];
 
-    // 3. Setup the job queue
-    threadpool_p->job_queue = queue_init(QUEUE_MAX_CAPACITY, NULL);
-    if (NULL == threadpool_p->job_queue)
+    // The retired thread has finished its teardown and given up the mutex
+    // for good, so joining it here cannot block for long
+    if (WORKER_EXITED == worker_p->state)
     {
-        print_error("threadpool_create(): Unable to initialize queue.");
-        goto END;
+        exit_code = pthread_join(threadpool_p->threads[idx], NULL);
+        if (E_SUCCESS != exit_code)
+        {
+            print_error("spawn_worker(): Unable to join thread.");
+            goto END;
+        }
+        worker_p->state = WORKER_EMPTY;
     }
 
-    // 4. Allocate memory for threads
-    threadpool_p->threads = calloc(thread_count, sizeof(pthread_t));
-    if (NULL == threadpool_p->threads)
+    // Counted first, the new thread divides the backlog by the thread count
+    atomic_fetch_add(&threadpool_p->thread_count, 1);
+    worker_p->started_ns = monotonic_ns();
+    exit_code = pthread_create(
+        &threadpool_p->threads[idx], NULL, start_thread, worker_p);
+    if (E_SUCCESS != exit_code)
     {
-        print_error("threadpool_create(): 'threads' CMR failure.");
+        atomic_fetch_sub(&threadpool_p->thread_count, 1);
         goto END;
     }
+    worker_p->state = WORKER_RUNNING;
 
-    exit_code = E_SUCCESS;
 END:
     return exit_code;
 }
 
-// covers 4.5.4 Demonstrate the ability to use threads, locks, conditions,
-// atomics
-static void *start_thread(void *pool_p)
+static void grow_pool(threadpool_t *threadpool_p, bool force)
 {
-    // Initialize
-    int exit_code = E_FAILURE;
-    threadpool_t *threadpool_p = NULL;
-    queue_node_t *node_p = NULL;
-    job_t *job_p = NULL;
+    size_t threads = atomic_load(&threadpool_p->thread_count);
 
-    if (NULL == pool_p)
+    // Checked without the lock first, a fixed or idle pool never takes it
+    if ((threadpool_p->max_threads <= threads) ||
+        (0 != atomic_load(&threadpool_p->idle_threads)))
     {
-        goto END;
+        return;
     }
 
-    threadpool_p = (threadpool_t *)pool_p;
-
-    // Main loop for processing jobs
-    for (;;)
+    if ((false == force) && ((threads + threadpool_p->spawn_queue_depth) >=
+                             atomic_load(&threadpool_p->pending_jobs)))
     {
-        pthread_mutex_lock(&threadpool_p->mutex);
+        return;
+    }
 
-        if (KEEP_RUNNING != signal_flag_g)
+    pthread_mutex_lock(&threadpool_p->mutex);
+    // Threads still tearing down hold on to their slots
+    if ((SHUTDOWN != threadpool_p->signal) &&
+        (threadpool_p->max_threads >
+         (atomic_load(&threadpool_p->thread_count) + threadpool_p->retiring)))
+    {
+        if (E_SUCCESS != spawn_worker(threadpool_p))
         {
-            print_error("wait_for_job(): Signal caught.");
-            pthread_mutex_unlock(&threadpool_p->mutex);
-            goto END;
+            print_error("grow_pool(): Unable to add a thread.");
         }
+    }
+    pthread_mutex_unlock(&threadpool_p->mutex);
+}
 
-        exit_code = wait_for_job(threadpool_p);
-        if (E_SUCCESS != exit_code)
-        {
-            pthread_mutex_unlock(&threadpool_p->mutex);
-        }
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now = { 0 };
 
-        exit_code = get_next_job(&threadpool_p, &node_p, &job_p);
-        if (E_SUCCESS != exit_code)
-        {
-            pthread_mutex_unlock(&threadpool_p->mutex);
-            goto END;
-        }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * (uint64_t)NSEC_PER_SEC) +
+           (uint64_t)now.tv_nsec;
+}
 
-        pthread_mutex_unlock(&threadpool_p->mutex);
+static stats_shard_t *stats_shard(threadpool_t *threadpool_p)
+{
+    if (SIZE_MAX == stats_slot_g)
+    {
+        stats_slot_g = atomic_fetch_add(&stats_slots_g, 1) % STATS_SHARDS;
+    }
 
-        exit_code = process_job(job_p);
-        if (E_SUCCESS != exit_code)
-        {
-            print_error("start_thread(): Unable to execute job.");
-            goto END;
-        }
+    return &threadpool_p->stats_shards[stats_slot_g];
+}
 
-        free(job_p);
-        free(node_p);
-    }
+static void stats_submitted(threadpool_t *threadpool_p,
+                            size_t accepted,
+                            size_t rejected)
+{
+    stats_shard_t *shard_p = stats_shard(threadpool_p);
+    size_t pending = atomic_load(&threadpool_p->pending_jobs);
+    size_t high = atomic_load_explicit(&threadpool_p->high_water,
+                                       memory_order_relaxed);
 
-END:
-    return NULL;
+    atomic_fetch_add_explicit(
+        &shard_p->submitted, accepted, memory_order_relaxed);
+    atomic_fetch_add_explicit(
+        &shard_p->rejected, rejected, memory_order_relaxed);
+
+    // Only written when the mark rises, usually this is a read
+    while ((high < pending) &&
+           !atomic_compare_exchange_weak(
+               &threadpool_p->high_water, &high, pending))
+    {
+    }
 }
 
-static job_t *create_job(JOB_F job, FREE_F del_f, void *arg_p)
+static void histogram_record(stats_histogram_t *hist_p, uint64_t ns)
 {
-    job_t *new_job = NULL;
+    size_t bucket = 0;
+    uint64_t max_ns = atomic_load_explicit(&hist_p->max_ns,
+                                           memory_order_relaxed);
 
-    if (NULL == job)
+    for (uint64_t rest = ns; 0 != rest; rest >>= 1)
     {
-        print_error("threadpool_new_job(): NULL job passed.");
-        goto END;
+        bucket++;
     }
+    bucket = (THREADPOOL_HISTOGRAM_BUCKETS <= bucket)
+                 ? THREADPOOL_HISTOGRAM_BUCKETS - 1
+                 : bucket;
 
-    new_job = calloc(1, sizeof(job_t));
-    if (NULL == new_job)
+    atomic_fetch_add_explicit(&hist_p->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist_p->sum_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(
+        &hist_p->buckets[bucket], 1, memory_order_relaxed);
+    while ((max_ns < ns) &&
+           !atomic_compare_exchange_weak(&hist_p->max_ns, &max_ns, ns))
     {
-        print_error("threadpool_new_job(): CMR failure.");
-        goto END;
     }
+}
 
-    new_job->args_p = arg_p;
-    new_job->job = job;
-    new_job->del_f = del_f;
+static void histogram_add(stats_histogram_t *hist_p,
+                          threadpool_histogram_t *total_p)
+{
+    uint64_t max_ns = atomic_load(&hist_p->max_ns);
 
-END:
-    return new_job;
+    total_p->count += atomic_load(&hist_p->count);
+    total_p->sum_ns += atomic_load(&hist_p->sum_ns);
+    total_p->max_ns = (total_p->max_ns < max_ns) ? max_ns : total_p->max_ns;
+    for (size_t idx = 0; idx < THREADPOOL_HISTOGRAM_BUCKETS; idx++)
+    {
+        total_p->buckets[idx] += atomic_load(&hist_p->buckets[idx]);
+    }
 }
 
-static int wait_for_job(threadpool_t *threadpool_p)
+static int nodes_setup(threadpool_t *threadpool_p,
+                       const threadpool_cfg_t *cfg_p)
 {
     int exit_code = E_FAILURE;
+    cpu_topology_t *topology_p = NULL;
+    cpu_set_t allowed;
+    cpu_set_t *set_p = NULL;
+    size_t topology_nodes = 1;
 
-    if (NULL == threadpool_p)
+    if ((THREADPOOL_AFFINITY_NONE != cfg_p->affinity) &&
+        (THREADPOOL_AFFINITY_CPUS != cfg_p->affinity) &&
+        (THREADPOOL_AFFINITY_NUMA != cfg_p->affinity))
     {
-        print_error("wait_for_job(): NULL threadpool.");
+        print_error("nodes_setup(): Invalid affinity.");
         goto END;
     }
+    threadpool_p->affinity = cfg_p->affinity;
 
-    while ((EMPTY == queue_emptycheck(threadpool_p->job_queue)) &&
-           (SHUTDOWN != threadpool_p->signal))
+    if (THREADPOOL_AFFINITY_NUMA == cfg_p->affinity)
     {
-        if (KEEP_RUNNING != signal_flag_g)
+        topology_p = cpu_topology_load(cfg_p->numa_path);
+        if (NULL == topology_p)
         {
-            print_error("wait_for_job(): Signal caught.");
             goto END;
         }
+        topology_nodes = cpu_topology_node_count(topology_p);
+    }
 
-        exit_code =
-            pthread_cond_wait(&threadpool_p->condition, &threadpool_p->mutex);
-        if (E_SUCCESS != exit_code)
-        {
-            print_error("Unable to wait on condition.");
-            goto END;
-        }
+    threadpool_p->node_cpus = calloc(topology_nodes, sizeof(cpu_set_t));
+    if (NULL == threadpool_p->node_cpus)
+    {
+        print_error("nodes_setup(): 'node_cpus' CMR failure.");
+        goto END;
     }
 
-    exit_code = E_SUCCESS;
-END:
-    return exit_code;
-}
+    if (THREADPOOL_AFFINITY_NONE == cfg_p->affinity)
+    {
+        threadpool_p->node_count = 1;
+    }
+    else if (E_SUCCESS != allowed_cpus(cfg_p, &allowed))
+    {
+        goto END;
+    }
 
-static int get_next_job(threadpool_t **threadpool_p,
-                        queue_node_t **node_p,
-                        job_t **job_p)
-{
-    int exit_code = E_FAILURE;
+    if (THREADPOOL_AFFINITY_CPUS == cfg_p->affinity)
+    {
+        memcpy(threadpool_p->node_cpus, &allowed, sizeof(cpu_set_t));
+        threadpool_p->node_count = 1;
+    }
 
-    if ((NULL == threadpool_p) || (NULL == node_p) || (NULL == job_p))
+    // Nodes left without an allowed CPU get no threads and no job queue
+    for (size_t idx = 0; (NULL != topology_p) && (idx < topology_nodes);
+         idx++)
     {
-        print_error("get_next_job(): NULL argument passed.");
-        goto END;
+        set_p = &threadpool_p->node_cpus[threadpool_p->node_count];
+        cpu_topology_node_cpus(topology_p, idx, set_p);
+        CPU_AND(set_p, set_p, &allowed);
+        if (0 != CPU_COUNT(set_p))
+        {
+            threadpool_p->node_count++;
+        }
     }
 
-    if ((SHUTDOWN == (*threadpool_p)->signal) &&
-        (EMPTY == queue_emptycheck((*threadpool_p)->job_queue)))
+    if (0 == threadpool_p->node_count)
     {
+        print_error("nodes_setup(): No node has an allowed CPU.");
         goto END;
     }
 
-    *node_p = queue_dequeue((*threadpool_p)->job_queue);
-    if (NULL == *node_p)
+    threadpool_p->job_queues =
+        calloc(threadpool_p->node_count, sizeof(job_queue_t));
+    if (NULL == threadpool_p->job_queues)
     {
-        print_error("get_next_job(): NULL node.");
+        print_error("nodes_setup(): 'job_queues' CMR failure.");
         goto END;
     }
 
-    *job_p = (*node_p)->data;
-    if (NULL == *job_p)
+    for (size_t idx = 0; idx < threadpool_p->node_count; idx++)
     {
-        print_error("get_next_job(): NULL job.");
-        goto END;
+        if (E_SUCCESS !=
+            job_queue_setup(&threadpool_p->job_queues[idx], cfg_p))
+        {
+            goto END;
+        }
     }
 
     exit_code = E_SUCCESS;
 END:
+    if (NULL != topology_p)
+    {
+        cpu_topology_destroy(&topology_p);
+    }
     return exit_code;
 }
 
-static int process_job(job_t *job_p)
+static int allowed_cpus(const threadpool_cfg_t *cfg_p, cpu_set_t *allowed_p)
 {
     int exit_code = E_FAILURE;
+    cpu_set_t available;
 
-    if (NULL == job_p)
+    if (E_SUCCESS != sched_getaffinity(0, sizeof(cpu_set_t), &available))
     {
-        print_error("process_job(): NULL job passed.");
+        print_error("allowed_cpus(): Unable to read CPU affinity.");
         goto END;
     }
 
-    if (NULL != job_p->job)
+    if (NULL == cfg_p->cpus)
     {
-        // Attempt to run the job
-        job_p->job(job_p->args_p);
+        memcpy(allowed_p, &available, sizeof(cpu_set_t));
+        exit_code = E_SUCCESS;
+        goto END;
     }
 
-    if (NULL != job_p->del_f)
+    CPU_ZERO(allowed_p);
+    for (size_t idx = 0; idx < cfg_p->cpu_count; idx++)
     {
-        // Attempt to perform cleanup if necessary
-        job_p->del_f(job_p->args_p);
+        if ((0 > cfg_p->cpus[idx]) || (CPU_SETSIZE <= cfg_p->cpus[idx]) ||
+            !CPU_ISSET(cfg_p->cpus[idx], &available))
+        {
+            print_error("allowed_cpus(): Invalid CPU in cpus.");
+            goto END;
+        }
+        CPU_SET(cfg_p->cpus[idx], allowed_p);
+    }
+
+    if (0 == CPU_COUNT(allowed_p))
+    {
+        print_error("allowed_cpus(): Empty cpus.");
+        goto END;
     }
 
     exit_code = E_SUCCESS;
@@ -503,38 +4219,53 @@ END:
     return exit_code;
 }
 
-static void threadpool_teardown(threadpool_t **threadpool_pp)
+static size_t local_node(threadpool_t *threadpool_p, worker_t *worker_p)
 {
-    if ((NULL == threadpool_pp) || (NULL == *threadpool_pp))
+    size_t node = 0;
+    int cpu = 0;
+
+    if (NULL != worker_p)
     {
-        print_error("threadpool_destroy(): NULL threadpool passed.");
+        node = worker_p->node;
         goto END;
     }
 
-    // 1. Deallocate memory for threads
-    if (NULL != (*threadpool_pp)->threads)
+    if (1 == threadpool_p->node_count)
     {
-        free((*threadpool_pp)->threads);
+        goto END;
     }
 
-    // 2. Destroy the job queue
-    if (NULL != (*threadpool_pp)->job_queue)
+    // A CPU outside every node's set leaves the job on node 0
+    cpu = sched_getcpu();
+    for (size_t idx = 0; (0 <= cpu) && (idx < threadpool_p->node_count);
+         idx++)
     {
-        queue_destroy(&(*threadpool_pp)->job_queue);
+        if (CPU_ISSET(cpu, &threadpool_p->node_cpus[idx]))
+        {
+            node = idx;
+            break;
+        }
     }
 
-    // 3. Destroy the work condition
-    if (true == (*threadpool_pp)->condition_initialized)
-    {
-        pthread_cond_destroy(&(*threadpool_pp)->condition);
-    }
+END:
+    return node;
+}
 
-    // 4. Destroy the mutex
-    if (true == (*threadpool_pp)->work_mutex_initialized)
+static void cpu_nth(cpu_set_t *set_p, size_t nth)
+{
+    size_t seen = 0;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
     {
-        pthread_mutex_destroy(&(*threadpool_pp)->mutex);
-    }
+        if (!CPU_ISSET(cpu, set_p))
+        {
+            continue;
+        }
 
-END:
-    return;
+        if (nth != seen)
+        {
+            CPU_CLR(cpu, set_p);
+        }
+        seen++;
+    }
 }
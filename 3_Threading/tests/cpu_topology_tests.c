@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include "cpu_topology.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_PATHS 16
+
+// A fake sysfs node directory, and everything created in it, newest last
+char   sysfs_root[] = "/tmp/cpu_topology_XXXXXX";
+char   created[MAX_PATHS][PATH_MAX];
+size_t created_count = 0;
+
+/**
+ * @brief creates a "nodeN" style directory in the fake sysfs root, with a
+ * cpulist file holding 'cpulist' unless it is NULL
+ *
+ * @param name the directory name
+ * @param cpulist the contents of the cpulist file
+ */
+static void add_node(const char * name, const char * cpulist)
+{
+    FILE * file = NULL;
+
+    snprintf(created[created_count], PATH_MAX, "%s/%s", sysfs_root, name);
+    CU_ASSERT_FATAL(0 == mkdir(created[created_count], 0700));
+    created_count++;
+
+    if (NULL == cpulist)
+    {
+        return;
+    }
+
+    snprintf(created[created_count],
+             PATH_MAX,
+             "%s/%s/cpulist",
+             sysfs_root,
+             name);
+    file = fopen(created[created_count], "w");
+    CU_ASSERT_FATAL(NULL != file);
+    fputs(cpulist, file);
+    fclose(file);
+    created_count++;
+}
+
+int init_suite1(void)
+{
+    return (NULL == mkdtemp(sysfs_root)) ? -1 : 0;
+}
+
+int clean_suite1(void)
+{
+    while (0 < created_count)
+    {
+        created_count--;
+        remove(created[created_count]);
+    }
+
+    return rmdir(sysfs_root);
+}
+
+void test_cpu_list_parse()
+{
+    cpu_set_t set;
+
+    CU_ASSERT(0 == cpu_list_parse("0-3,8,10-11\n", &set));
+    CU_ASSERT(7 == CPU_COUNT(&set));
+    CU_ASSERT(CPU_ISSET(3, &set));
+    CU_ASSERT(!CPU_ISSET(4, &set));
+    CU_ASSERT(CPU_ISSET(11, &set));
+
+    // A node without CPUs has an empty list
+    CU_ASSERT(0 == cpu_list_parse("\n", &set));
+    CU_ASSERT(0 == CPU_COUNT(&set));
+
+    CU_ASSERT(0 == cpu_list_parse(" 5 ", &set));
+    CU_ASSERT((1 == CPU_COUNT(&set)) && CPU_ISSET(5, &set));
+
+    // Should catch malformed lists
+    CU_ASSERT(0 != cpu_list_parse(NULL, &set));
+    CU_ASSERT(0 != cpu_list_parse("3-1", &set));
+    CU_ASSERT(0 != cpu_list_parse("a", &set));
+    CU_ASSERT(0 != cpu_list_parse("1,", &set));
+    CU_ASSERT(0 != cpu_list_parse("1-", &set));
+    CU_ASSERT(0 != cpu_list_parse("0,,1", &set));
+    CU_ASSERT(0 != cpu_list_parse("1 2", &set));
+    CU_ASSERT(0 != cpu_list_parse("99999", &set));
+}
+
+void test_cpu_topology_sysfs()
+{
+    cpu_topology_t * topology = NULL;
+    cpu_set_t        set;
+
+    // Sparse ids, a memory-only node and entries that are not nodes
+    add_node("node0", "0-1\n");
+    add_node("node1", "\n");
+    add_node("node12", "4\n");
+    add_node("node2", "6,7\n");
+    add_node("nodes", NULL);
+    add_node("power", NULL);
+
+    topology = cpu_topology_load(sysfs_root);
+    CU_ASSERT_FATAL(NULL != topology);
+    CU_ASSERT(3 == cpu_topology_node_count(topology));
+
+    // Nodes are numbered in sysfs id order, not directory order
+    CU_ASSERT(0 == cpu_topology_node_cpus(topology, 0, &set));
+    CU_ASSERT((2 == CPU_COUNT(&set)) && CPU_ISSET(1, &set));
+    CU_ASSERT(0 == cpu_topology_node_cpus(topology, 1, &set));
+    CU_ASSERT((2 == CPU_COUNT(&set)) && CPU_ISSET(6, &set));
+    CU_ASSERT(0 == cpu_topology_node_cpus(topology, 2, &set));
+    CU_ASSERT((1 == CPU_COUNT(&set)) && CPU_ISSET(4, &set));
+
+    CU_ASSERT(0 != cpu_topology_node_cpus(topology, 3, &set));
+    CU_ASSERT(0 != cpu_topology_node_cpus(NULL, 0, &set));
+    CU_ASSERT(0 == cpu_topology_destroy(&topology));
+
+    // A node with a broken cpulist fails the whole load
+    add_node("node3", "zero\n");
+    CU_ASSERT(NULL == cpu_topology_load(sysfs_root));
+}
+
+void test_cpu_topology_fallback()
+{
+    cpu_topology_t * topology = NULL;
+    char             missing[PATH_MAX];
+    cpu_set_t        set;
+    cpu_set_t        available;
+
+    // Without a node directory every available CPU forms one node
+    snprintf(missing, sizeof(missing), "%s/missing", sysfs_root);
+    topology = cpu_topology_load(missing);
+    CU_ASSERT_FATAL(NULL != topology);
+    CU_ASSERT(1 == cpu_topology_node_count(topology));
+
+    CU_ASSERT(0 == sched_getaffinity(0, sizeof(cpu_set_t), &available));
+    CU_ASSERT(0 == cpu_topology_node_cpus(topology, 0, &set));
+    CU_ASSERT(CPU_EQUAL(&set, &available));
+    CU_ASSERT(0 == cpu_topology_destroy(&topology));
+
+    // The real machine always has at least one node
+    topology = cpu_topology_load(NULL);
+    CU_ASSERT_FATAL(NULL != topology);
+    CU_ASSERT(1 <= cpu_topology_node_count(topology));
+    CU_ASSERT(0 == cpu_topology_destroy(&topology));
+
+    CU_ASSERT(0 == cpu_topology_node_count(NULL));
+    CU_ASSERT(0 != cpu_topology_destroy(&topology));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing cpu_list_parse():", test_cpu_list_parse },
+
+        { "Testing cpu_topology_load() on sysfs:", test_cpu_topology_sysfs },
+
+        { "Testing cpu_topology_load() fallback:",
+          test_cpu_topology_fallback },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
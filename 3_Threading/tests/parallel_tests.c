@@ -0,0 +1,274 @@
+#include "parallel.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define THREADS 4
+#define ITEMS   100000
+#define GRAIN   64
+
+// Every index writes its own slot, so a slot set twice or not at all shows
+int values[ITEMS];
+
+// Counts the indexes visited and the calls that failed inside jobs, CUnit
+// asserts are not safe to call from pool threads
+atomic_int visited;
+atomic_int job_errors;
+
+// Holds the blocking jobs until the test opens it
+atomic_bool gate_open;
+atomic_int  running;
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void fill_range(size_t begin, size_t end, void * ctx)
+{
+    (void)ctx;
+    for (size_t idx = begin; idx < end; idx++)
+    {
+        values[idx]++;
+    }
+    atomic_fetch_add(&visited, (int)(end - begin));
+}
+
+void * sum_range(size_t begin, size_t end, void * ctx)
+{
+    intptr_t sum = 0;
+
+    (void)ctx;
+    for (size_t idx = begin; idx < end; idx++)
+    {
+        sum += (intptr_t)idx;
+    }
+
+    return (void *)sum;
+}
+
+void * add_sums(void * left, void * right, void * ctx)
+{
+    (void)ctx;
+    return (void *)((intptr_t)left + (intptr_t)right);
+}
+
+void * nested_job(void * arg)
+{
+    void * result = NULL;
+
+    if (0 != threadpool_parallel_reduce((threadpool_t *)arg,
+                                        0,
+                                        ITEMS,
+                                        GRAIN,
+                                        sum_range,
+                                        add_sums,
+                                        (void *)0,
+                                        NULL,
+                                        &result))
+    {
+        atomic_fetch_add(&job_errors, 1);
+    }
+
+    return result;
+}
+
+void * blocking_job(void * arg)
+{
+    (void)arg;
+    atomic_fetch_add(&running, 1);
+    while (!atomic_load(&gate_open))
+    {
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief checks that every index was visited exactly once, then clears them
+ *
+ * @return true if every index was visited once
+ */
+static bool visited_once(void)
+{
+    bool once = (ITEMS == atomic_load(&visited));
+
+    for (size_t idx = 0; idx < ITEMS; idx++)
+    {
+        once        = once && (1 == values[idx]);
+        values[idx] = 0;
+    }
+    atomic_store(&visited, 0);
+
+    return once;
+}
+
+void test_parallel_for()
+{
+    threadpool_t * pool     = NULL;
+    size_t         grains[] = { 0, 1, GRAIN, ITEMS, 2 * ITEMS };
+
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    // Grains smaller, larger and equal to the range all cover it once
+    for (size_t idx = 0; idx < sizeof(grains) / sizeof(grains[0]); idx++)
+    {
+        CU_ASSERT(0 == threadpool_parallel_for(
+                           pool, 0, ITEMS, grains[idx], fill_range, NULL));
+        CU_ASSERT(visited_once());
+    }
+
+    // A range that starts part of the way in stays inside its bounds
+    CU_ASSERT(0 == threadpool_parallel_for(
+                       pool, ITEMS / 2, ITEMS, GRAIN, fill_range, NULL));
+    CU_ASSERT(ITEMS / 2 == atomic_load(&visited));
+    CU_ASSERT((0 == values[(ITEMS / 2) - 1]) && (1 == values[ITEMS / 2]));
+    atomic_store(&visited, 0);
+    for (size_t idx = 0; idx < ITEMS; idx++)
+    {
+        values[idx] = 0;
+    }
+
+    // An empty range does nothing
+    CU_ASSERT(0 ==
+              threadpool_parallel_for(pool, 5, 5, GRAIN, fill_range, NULL));
+    CU_ASSERT(0 == atomic_load(&visited));
+
+    // Should catch invalid arguments
+    CU_ASSERT(0 != threadpool_parallel_for(NULL, 0, 1, 1, fill_range, NULL));
+    CU_ASSERT(0 != threadpool_parallel_for(pool, 0, 1, 1, NULL, NULL));
+    CU_ASSERT(0 != threadpool_parallel_for(pool, 2, 1, 1, fill_range, NULL));
+
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+void test_parallel_reduce()
+{
+    threadpool_t *        pool     = NULL;
+    threadpool_future_t * future   = NULL;
+    void *                result   = NULL;
+    intptr_t              expected = ((intptr_t)ITEMS * (ITEMS - 1)) / 2;
+
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    CU_ASSERT(0 == threadpool_parallel_reduce(
+                       pool, 0, ITEMS, GRAIN, sum_range, add_sums,
+                       (void *)0, NULL, &result));
+    CU_ASSERT(expected == (intptr_t)result);
+
+    // The identity is combined in once, and is the result of an empty range
+    CU_ASSERT(0 == threadpool_parallel_reduce(
+                       pool, 0, ITEMS, 1, sum_range, add_sums,
+                       (void *)1, NULL, &result));
+    CU_ASSERT((expected + 1) == (intptr_t)result);
+    CU_ASSERT(0 == threadpool_parallel_reduce(
+                       pool, 3, 3, GRAIN, sum_range, add_sums,
+                       (void *)42, NULL, &result));
+    CU_ASSERT(42 == (intptr_t)result);
+
+    // A job can run a loop on its own pool
+    future = threadpool_submit(pool, nested_job, NULL, pool);
+    CU_ASSERT_FATAL(NULL != future);
+    CU_ASSERT(0 == threadpool_future_wait(future, &result));
+    CU_ASSERT(expected == (intptr_t)result);
+    CU_ASSERT(0 == threadpool_future_release(&future));
+    CU_ASSERT(0 == atomic_load(&job_errors));
+
+    // Should catch invalid arguments
+    CU_ASSERT(0 != threadpool_parallel_reduce(
+                       NULL, 0, 1, 1, sum_range, add_sums, NULL, NULL,
+                       &result));
+    CU_ASSERT(0 != threadpool_parallel_reduce(
+                       pool, 0, 1, 1, NULL, add_sums, NULL, NULL, &result));
+    CU_ASSERT(0 != threadpool_parallel_reduce(
+                       pool, 0, 1, 1, sum_range, NULL, NULL, NULL, &result));
+    CU_ASSERT(0 != threadpool_parallel_reduce(
+                       pool, 0, 1, 1, sum_range, add_sums, NULL, NULL, NULL));
+    CU_ASSERT(0 != threadpool_parallel_reduce(
+                       pool, 1, 0, 1, sum_range, add_sums, NULL, NULL,
+                       &result));
+
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+void test_parallel_busy_pool()
+{
+    threadpool_t * pool = NULL;
+
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    // With every thread held the caller runs the whole loop by itself
+    atomic_store(&gate_open, false);
+    atomic_store(&running, 0);
+    for (int idx = 0; idx < THREADS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(pool, blocking_job, NULL, NULL));
+    }
+    while (THREADS != atomic_load(&running))
+    {
+        sched_yield();
+    }
+
+    CU_ASSERT(0 == threadpool_parallel_for(
+                       pool, 0, ITEMS, GRAIN, fill_range, NULL));
+    CU_ASSERT(visited_once());
+
+    // The helpers left queued behind find nothing left to do
+    atomic_store(&gate_open, true);
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT(0 == atomic_load(&visited));
+
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing threadpool_parallel_for():", test_parallel_for },
+
+        { "Testing threadpool_parallel_reduce():", test_parallel_reduce },
+
+        { "Testing parallel loops on a busy pool:", test_parallel_busy_pool },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
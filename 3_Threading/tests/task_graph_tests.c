@@ -0,0 +1,322 @@
+#include "task_graph.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define THREADS     4
+#define RUNS        100
+#define WIDE        1000
+#define CHAIN       1000
+#define SMALL_QUEUE 4
+
+// The order in which the tasks of the last run started, by task
+size_t stamps[WIDE + 2];
+
+// Hands out the stamps
+atomic_size_t sequence;
+
+// Counts the tasks that ran, the ones that ran out of order and the args
+// freed, CUnit asserts are not safe to call from pool threads
+atomic_int counter;
+atomic_int out_of_order;
+atomic_int freed;
+
+// Holds the gated task until the test opens it
+atomic_bool gate_open;
+atomic_bool gate_reached;
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void * stamp_job(void * arg)
+{
+    size_t task = (size_t)arg;
+
+    stamps[task] = atomic_fetch_add(&sequence, 1);
+    atomic_fetch_add(&counter, 1);
+
+    return (void *)(task + 1);
+}
+
+void * chain_job(void * arg)
+{
+    if (*(int *)arg != atomic_fetch_add(&counter, 1))
+    {
+        atomic_fetch_add(&out_of_order, 1);
+    }
+
+    return NULL;
+}
+
+void * gated_job(void * arg)
+{
+    (void)arg;
+    atomic_store(&gate_reached, true);
+    while (!atomic_load(&gate_open))
+    {
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+void count_free(void * arg)
+{
+    free(arg);
+    atomic_fetch_add(&freed, 1);
+}
+
+/**
+ * @brief Builds a graph of a root, 'wide' tasks that wait for it and a sink
+ * that waits for them. The root is task 0 and the sink task wide + 1.
+ *
+ * @param wide The number of tasks between the root and the sink
+ * @return the graph, or NULL on failure
+ */
+static task_graph_t * fan_graph(size_t wide)
+{
+    task_graph_t * graph = task_graph_create();
+    size_t         id    = 0;
+    bool           built = (NULL != graph);
+
+    for (size_t task = 0; built && (task < (wide + 2)); task++)
+    {
+        built = (0 == task_graph_add_task(
+                          graph, stamp_job, NULL, (void *)task, &id)) &&
+                (task == id);
+    }
+
+    for (size_t task = 1; built && (task <= wide); task++)
+    {
+        built = (0 == task_graph_add_edge(graph, 0, task)) &&
+                (0 == task_graph_add_edge(graph, task, wide + 1));
+    }
+
+    if ((!built) && (NULL != graph))
+    {
+        task_graph_destroy(&graph);
+    }
+
+    return graph;
+}
+
+void test_task_graph_diamond()
+{
+    threadpool_t * pool   = NULL;
+    task_graph_t * graph  = NULL;
+    void *         result = NULL;
+    bool           order  = true;
+
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+    graph = fan_graph(2);
+    CU_ASSERT_FATAL(NULL != graph);
+    CU_ASSERT(4 == task_graph_task_count(graph));
+
+    // The same graph runs again and again, in dependency order every time
+    atomic_store(&counter, 0);
+    for (int run = 0; run < RUNS; run++)
+    {
+        atomic_store(&sequence, 0);
+        CU_ASSERT(0 == task_graph_run(graph, pool));
+        order = order && (0 == stamps[0]) && (3 == stamps[3]);
+    }
+    CU_ASSERT(order);
+    CU_ASSERT((RUNS * 4) == atomic_load(&counter));
+
+    // Every task keeps what it returned on the last run
+    for (size_t task = 0; task < 4; task++)
+    {
+        CU_ASSERT(0 == task_graph_result(graph, task, &result));
+        CU_ASSERT((task + 1) == (size_t)result);
+    }
+
+    CU_ASSERT(0 == task_graph_destroy(&graph));
+    CU_ASSERT(NULL == graph);
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+void test_task_graph_shapes()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool  = NULL;
+    task_graph_t *   graph = NULL;
+    size_t           id    = 0;
+    int *            arg   = NULL;
+    bool             order = true;
+
+    // A queue far smaller than the fan-out leaves tasks to run inline
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.queue_type     = THREADPOOL_QUEUE_LOCKFREE;
+    cfg.queue_capacity = SMALL_QUEUE;
+    pool               = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    graph = fan_graph(WIDE);
+    CU_ASSERT_FATAL(NULL != graph);
+    for (int run = 0; run < (RUNS / 10); run++)
+    {
+        atomic_store(&sequence, 0);
+        atomic_store(&counter, 0);
+        CU_ASSERT(0 == task_graph_run(graph, pool));
+        CU_ASSERT((WIDE + 2) == atomic_load(&counter));
+        order = order && (0 == stamps[0]) && ((WIDE + 1) == stamps[WIDE + 1]);
+    }
+    CU_ASSERT(order);
+    CU_ASSERT(0 == task_graph_destroy(&graph));
+
+    // A chain runs one task at a time, in order
+    graph = task_graph_create();
+    CU_ASSERT_FATAL(NULL != graph);
+    for (size_t task = 0; task < CHAIN; task++)
+    {
+        arg = malloc(sizeof(int));
+        CU_ASSERT_FATAL(NULL != arg);
+        *arg = (int)task;
+        CU_ASSERT(0 ==
+                  task_graph_add_task(graph, chain_job, count_free, arg, &id));
+        if (0 != task)
+        {
+            CU_ASSERT(0 == task_graph_add_edge(graph, task - 1, task));
+        }
+    }
+
+    atomic_store(&counter, 0);
+    atomic_store(&freed, 0);
+    CU_ASSERT(0 == task_graph_run(graph, pool));
+    CU_ASSERT(CHAIN == atomic_load(&counter));
+    CU_ASSERT(0 == atomic_load(&out_of_order));
+
+    // Destroying the graph frees the arguments of its tasks
+    CU_ASSERT(0 == task_graph_destroy(&graph));
+    CU_ASSERT(CHAIN == atomic_load(&freed));
+
+    // A shut down threadpool leaves every task to the caller
+    graph = fan_graph(WIDE);
+    CU_ASSERT_FATAL(NULL != graph);
+    CU_ASSERT(0 == threadpool_shutdown(pool));
+    atomic_store(&counter, 0);
+    CU_ASSERT(0 == task_graph_run(graph, pool));
+    CU_ASSERT((WIDE + 2) == atomic_load(&counter));
+    CU_ASSERT(0 == task_graph_destroy(&graph));
+
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+void test_task_graph_errors()
+{
+    threadpool_t * pool   = NULL;
+    task_graph_t * graph  = NULL;
+    void *         result = NULL;
+    size_t         ids[3] = { 0 };
+
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+    graph = task_graph_create();
+    CU_ASSERT_FATAL(NULL != graph);
+
+    // An empty graph finishes at once
+    CU_ASSERT(0 == task_graph_run(graph, pool));
+
+    // A cycle is refused when the graph is submitted
+    for (size_t task = 0; task < 3; task++)
+    {
+        CU_ASSERT(0 == task_graph_add_task(
+                           graph, stamp_job, NULL, (void *)task, &ids[task]));
+    }
+    CU_ASSERT(0 == task_graph_add_edge(graph, ids[0], ids[1]));
+    CU_ASSERT(0 == task_graph_add_edge(graph, ids[1], ids[2]));
+    CU_ASSERT(0 == task_graph_add_edge(graph, ids[2], ids[0]));
+    CU_ASSERT(0 != task_graph_submit(graph, pool));
+    CU_ASSERT(0 == task_graph_wait(graph));
+    CU_ASSERT(0 == task_graph_destroy(&graph));
+
+    // A running graph can not be changed, run again or destroyed
+    graph = task_graph_create();
+    CU_ASSERT_FATAL(NULL != graph);
+    CU_ASSERT(0 == task_graph_add_task(graph, gated_job, NULL, NULL, &ids[0]));
+    atomic_store(&gate_open, false);
+    atomic_store(&gate_reached, false);
+    CU_ASSERT(0 == task_graph_submit(graph, pool));
+    while (!atomic_load(&gate_reached))
+    {
+        sched_yield();
+    }
+
+    CU_ASSERT(0 != task_graph_add_task(
+                       graph, stamp_job, NULL, NULL, &ids[1]));
+    CU_ASSERT(0 != task_graph_submit(graph, pool));
+    CU_ASSERT(0 != task_graph_result(graph, ids[0], &result));
+    CU_ASSERT(0 != task_graph_destroy(&graph));
+    atomic_store(&gate_open, true);
+    CU_ASSERT(0 == task_graph_wait(graph));
+    CU_ASSERT(1 == task_graph_task_count(graph));
+
+    // Should catch invalid arguments
+    CU_ASSERT(0 != task_graph_add_edge(graph, ids[0], ids[0]));
+    CU_ASSERT(0 != task_graph_add_edge(graph, ids[0], 1));
+    CU_ASSERT(0 != task_graph_add_edge(NULL, 0, 1));
+    CU_ASSERT(0 != task_graph_add_task(NULL, stamp_job, NULL, NULL, &ids[1]));
+    CU_ASSERT(0 != task_graph_add_task(graph, NULL, NULL, NULL, &ids[1]));
+    CU_ASSERT(0 != task_graph_add_task(graph, stamp_job, NULL, NULL, NULL));
+    CU_ASSERT(0 != task_graph_submit(NULL, pool));
+    CU_ASSERT(0 != task_graph_submit(graph, NULL));
+    CU_ASSERT(0 != task_graph_result(graph, 1, &result));
+    CU_ASSERT(0 != task_graph_result(graph, ids[0], NULL));
+    CU_ASSERT(0 != task_graph_wait(NULL));
+    CU_ASSERT(0 != task_graph_destroy(NULL));
+    CU_ASSERT(0 == task_graph_task_count(NULL));
+
+    CU_ASSERT(0 == task_graph_destroy(&graph));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing a diamond run many times:", test_task_graph_diamond },
+
+        { "Testing wide and deep graphs:", test_task_graph_shapes },
+
+        { "Testing task graph errors:", test_task_graph_errors },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
@@ -0,0 +1,1783 @@
+#define _GNU_SOURCE
+#include "threadpool.h"
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define THREADS     4
+#define JOBS        10000
+#define BURST       500
+#define TREE_DEPTH  14
+#define TREE_LEAVES (1 << TREE_DEPTH)
+#define FUTURES     1000
+#define WAIT_MS     10
+#define PHASES      3
+#define MAX_THREADS 8
+#define KEEP_ALIVE  20
+#define FAKE_NODES  2
+#define LANE_JOBS   64
+#define CUT_IN_JOBS 4
+#define BATCH_JOBS  15
+#define PING_PONGS  200
+#define LONG_SPIN   1000000
+#define HELD_JOBS   10
+#define SMALL_QUEUE 4
+#define TIMERS      100000
+#define SPREAD_MS   100
+#define DELAY_MS    50
+#define PERIOD_MS   5
+#define PERIODS     5
+#define LONG_MS     60000
+#define COUNT_MS    30000
+#define KEYS        16
+#define KEYED_JOBS  1000
+#define TEARDOWN_MS 1000
+
+// Counts the jobs that ran
+atomic_int counter;
+
+// Counts failed submissions from inside jobs, CUnit asserts are not safe to
+// call from pool threads
+atomic_int job_errors;
+
+// The pool the fan-out jobs submit their children to
+threadpool_t * tree_pool = NULL;
+
+// Holds gated jobs until the test opens it
+atomic_bool gate_open;
+
+// The number of counted gated jobs running, and the most seen at once
+atomic_int running;
+atomic_int most_running;
+
+// The priorities of the lane jobs, in the order they ran
+atomic_int lane_runs;
+int        lane_ran[2 * LANE_JOBS];
+
+// The CPUs the affinity jobs must be pinned to
+cpu_set_t expected_cpus;
+
+// The pool a blocked submitter adds to, and what the submission returned
+threadpool_t * full_pool = NULL;
+atomic_int     blocked_result;
+atomic_bool    blocked_done;
+
+// The result and count of continuations that ran
+atomic_intptr_t continued_result;
+atomic_int      continued;
+
+// The pool and handle of the periodic job that cancels itself, when the
+// delayed job ran and the args released by timers
+threadpool_t *        timer_pool = NULL;
+threadpool_timer_t    self_timer = THREADPOOL_INVALID_TIMER;
+atomic_int            periods;
+atomic_uint_least64_t ran_at_ms;
+atomic_int            freed;
+
+/**
+ * @brief the context of a thread in the worker context test
+ *
+ * @param id the slot of the thread
+ * @param jobs the number of jobs the thread ran
+ */
+typedef struct worker_ctx
+{
+    size_t id;
+    int    jobs;
+} worker_ctx_t;
+
+// The next job expected per key, jobs of a key that ran out of order or
+// alongside another job of the key, and which keys have a job running
+int         next_keyed[KEYS];
+atomic_int  keyed_errors;
+atomic_bool key_busy[KEYS];
+
+// The pool a busy key is added to from inside a job, and how many of the
+// key's jobs had run when the job added next to them ran
+threadpool_t * busy_key_pool = NULL;
+atomic_int     busy_key_seen;
+
+// Counts the contexts built and released, and the jobs they ran
+atomic_int worker_inits;
+atomic_int worker_teardowns;
+atomic_int worker_jobs;
+
+int init_suite1(void)
+{
+    return 0;
+}
+
+int clean_suite1(void)
+{
+    return 0;
+}
+
+void * count_job(void * arg)
+{
+    (void)arg;
+    atomic_fetch_add(&counter, 1);
+    return NULL;
+}
+
+void * tree_job(void * arg)
+{
+    intptr_t depth = (intptr_t)arg;
+
+    if (0 == depth)
+    {
+        atomic_fetch_add(&counter, 1);
+        return NULL;
+    }
+
+    // Children are submitted from inside the pool
+    for (int child = 0; child < 2; child++)
+    {
+        if (0 != threadpool_add_job(
+                     tree_pool, tree_job, NULL, (void *)(depth - 1)))
+        {
+            atomic_fetch_add(&job_errors, 1);
+        }
+    }
+
+    return NULL;
+}
+
+void * wait_idle_job(void * arg)
+{
+    // A job can never see its own pool idle
+    if (0 == threadpool_wait_idle((threadpool_t *)arg))
+    {
+        atomic_fetch_add(&job_errors, 1);
+    }
+
+    return NULL;
+}
+
+void * square_job(void * arg)
+{
+    intptr_t value = (intptr_t)arg;
+
+    return (void *)(value * value);
+}
+
+void * gated_job(void * arg)
+{
+    while (!atomic_load(&gate_open))
+    {
+        sched_yield();
+    }
+
+    return arg;
+}
+
+void * entered_gated_job(void * arg)
+{
+    atomic_fetch_add(&counter, 1);
+    return gated_job(arg);
+}
+
+void * counted_gated_job(void * arg)
+{
+    int now = atomic_fetch_add(&running, 1) + 1;
+    int most = atomic_load(&most_running);
+
+    while ((most < now) &&
+           !atomic_compare_exchange_weak(&most_running, &most, now))
+    {
+    }
+
+    gated_job(arg);
+    atomic_fetch_sub(&running, 1);
+    return NULL;
+}
+
+/**
+ * @brief spins until 'target' counted gated jobs are running
+ *
+ * @param target the number of running jobs to wait for
+ * @return true if they started, false if they did not within a few seconds
+ */
+static bool wait_running(int target)
+{
+    for (long spin = 0; spin < 100000000L; spin++)
+    {
+        if (target == atomic_load(&running))
+        {
+            return true;
+        }
+        sched_yield();
+    }
+
+    return false;
+}
+
+void * hold_job(void * arg)
+{
+    atomic_fetch_add(&running, 1);
+    while (!atomic_load((atomic_bool *)arg))
+    {
+        sched_yield();
+    }
+    atomic_fetch_sub(&running, 1);
+
+    return NULL;
+}
+
+void * lane_job(void * arg)
+{
+    lane_ran[atomic_fetch_add(&lane_runs, 1)] = (int)(intptr_t)arg;
+    return NULL;
+}
+
+void * affinity_job(void * arg)
+{
+    cpu_set_t cpus;
+
+    (void)arg;
+    if ((0 != sched_getaffinity(0, sizeof(cpu_set_t), &cpus)) ||
+        !CPU_EQUAL(&cpus, &expected_cpus))
+    {
+        atomic_fetch_add(&job_errors, 1);
+    }
+    atomic_fetch_add(&counter, 1);
+
+    return NULL;
+}
+
+/**
+ * @brief reads the monotonic clock in milliseconds
+ *
+ * @return the current time in milliseconds
+ */
+static uint64_t now_ms(void)
+{
+    struct timespec now = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000);
+}
+
+void * stamp_job(void * arg)
+{
+    (void)arg;
+    atomic_store(&ran_at_ms, now_ms());
+    return NULL;
+}
+
+void * self_cancel_job(void * arg)
+{
+    (void)arg;
+    if ((PERIODS == atomic_fetch_add(&periods, 1) + 1) &&
+        (0 != threadpool_cancel_timer(timer_pool, self_timer)))
+    {
+        atomic_fetch_add(&job_errors, 1);
+    }
+
+    return NULL;
+}
+
+void * cooperative_job(void * arg)
+{
+    (void)arg;
+    atomic_fetch_add(&running, 1);
+    while (!threadpool_job_cancelled())
+    {
+        sched_yield();
+    }
+    atomic_fetch_add(&counter, 1);
+    atomic_fetch_sub(&running, 1);
+
+    return NULL;
+}
+
+void * ctx_init(size_t worker_id, void * arg)
+{
+    worker_ctx_t * ctx = malloc(sizeof(worker_ctx_t));
+
+    if (NULL != ctx)
+    {
+        ctx->id   = worker_id;
+        ctx->jobs = 0;
+    }
+    atomic_fetch_add((atomic_int *)arg, 1);
+
+    return ctx;
+}
+
+void ctx_teardown(void * ctx, void * arg)
+{
+    if ((NULL == ctx) || (&worker_inits != arg))
+    {
+        atomic_fetch_add(&job_errors, 1);
+    }
+    else
+    {
+        atomic_fetch_add(&worker_jobs, ((worker_ctx_t *)ctx)->jobs);
+    }
+    atomic_fetch_add(&worker_teardowns, 1);
+    free(ctx);
+}
+
+void * ctx_job(void * arg)
+{
+    worker_ctx_t * ctx = threadpool_worker_ctx();
+
+    (void)arg;
+    if ((NULL == ctx) || (THREADS <= ctx->id))
+    {
+        atomic_fetch_add(&job_errors, 1);
+        return NULL;
+    }
+
+    // Only its own thread touches a context, no atomics needed
+    ctx->jobs++;
+    return NULL;
+}
+
+void slow_teardown(void * ctx, void * arg)
+{
+    (void)ctx;
+    (void)arg;
+    atomic_fetch_add(&worker_teardowns, 1);
+    usleep(TEARDOWN_MS * 1000);
+}
+
+void * keyed_job(void * arg)
+{
+    int key = (int)((intptr_t)arg / KEYED_JOBS);
+    int seq = (int)((intptr_t)arg % KEYED_JOBS);
+
+    if (atomic_exchange(&key_busy[key], true))
+    {
+        atomic_fetch_add(&keyed_errors, 1);
+    }
+
+    // Only one job of a key runs at a time, so no atomics needed
+    if (seq != next_keyed[key])
+    {
+        atomic_fetch_add(&keyed_errors, 1);
+    }
+    next_keyed[key] = seq + 1;
+
+    atomic_store(&key_busy[key], false);
+    atomic_fetch_add(&counter, 1);
+    return NULL;
+}
+
+void * busy_key_seen_job(void * arg)
+{
+    (void)arg;
+    atomic_store(&busy_key_seen, atomic_load(&counter));
+    return NULL;
+}
+
+void * busy_key_job(void * arg)
+{
+    (void)arg;
+
+    // Both land on this thread's deque, the key's strand on top
+    if (0 != threadpool_add_job(busy_key_pool, busy_key_seen_job, NULL, NULL))
+    {
+        atomic_fetch_add(&job_errors, 1);
+    }
+    for (int idx = 0; idx < KEYED_JOBS; idx++)
+    {
+        if (0 != threadpool_add_keyed_job(
+                     busy_key_pool, 0, count_job, NULL, NULL))
+        {
+            atomic_fetch_add(&job_errors, 1);
+        }
+    }
+
+    return NULL;
+}
+
+void count_free(void * arg)
+{
+    (void)arg;
+    atomic_fetch_add(&freed, 1);
+}
+
+/**
+ * @brief waits for a counter to reach a target
+ *
+ * @param count the counter
+ * @param target the value to wait for
+ * @return true if it got there, false if it did not within COUNT_MS
+ */
+static bool wait_count(atomic_int * count, int target)
+{
+    for (long waited = 0; waited < COUNT_MS; waited++)
+    {
+        if (target <= atomic_load(count))
+        {
+            return true;
+        }
+        usleep(1000);
+    }
+
+    return false;
+}
+
+void record_continuation(void * result_p, void * arg_p)
+{
+    (void)arg_p;
+    atomic_store(&continued_result, (intptr_t)result_p);
+    atomic_fetch_add(&continued, 1);
+}
+
+/**
+ * @brief adds a job to full_pool, waiting for room, then opens the gate
+ *
+ * @param arg unused
+ * @return NULL
+ */
+static void * blocked_submitter(void * arg)
+{
+    (void)arg;
+    atomic_store(&blocked_result,
+                 threadpool_add_job_wait(full_pool,
+                                         THREADPOOL_SUBMIT_BLOCK,
+                                         0,
+                                         count_job,
+                                         NULL,
+                                         NULL));
+    atomic_store(&blocked_done, true);
+    atomic_store(&gate_open, true);
+
+    return NULL;
+}
+
+/**
+ * @brief holds every thread of full_pool at the gate, then fills its job
+ * queue
+ *
+ * @return the number of jobs queued
+ */
+static int fill_pool(void)
+{
+    int queued = 0;
+
+    atomic_store(&gate_open, false);
+    atomic_store(&running, 0);
+    for (size_t idx = 0; idx < MIN_THREADS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(
+                           full_pool, counted_gated_job, NULL, NULL));
+    }
+    CU_ASSERT(wait_running(MIN_THREADS));
+
+    while (0 == threadpool_add_job(full_pool, count_job, NULL, NULL))
+    {
+        queued++;
+    }
+
+    return queued;
+}
+
+/**
+ * @brief creates a pool with the given scheduler and queue backend
+ *
+ * @param scheduler the scheduler to use
+ * @param queue_type the job queue backend to use
+ * @return the new pool, NULL on failure
+ */
+static threadpool_t * create_pool(threadpool_sched_type_t scheduler,
+                                  threadpool_queue_type_t queue_type)
+{
+    threadpool_cfg_t cfg;
+
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.scheduler  = scheduler;
+    cfg.queue_type = queue_type;
+    return threadpool_create_ex(&cfg);
+}
+
+void test_threadpool_create()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool = NULL;
+
+    // Should catch invalid arguments
+    CU_ASSERT(NULL == threadpool_create(MIN_THREADS - 1));
+    CU_ASSERT(NULL == threadpool_create_ex(NULL));
+
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.scheduler = (threadpool_sched_type_t)-1;
+    CU_ASSERT(NULL == threadpool_create_ex(&cfg));
+
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+    CU_ASSERT(NULL == pool);
+}
+
+void test_threadpool_add_job()
+{
+    threadpool_t * pool = NULL;
+
+    for (int sched = THREADPOOL_SCHED_SHARED;
+         sched <= THREADPOOL_SCHED_STEALING;
+         sched++)
+    {
+        for (int type = THREADPOOL_QUEUE_MUTEX;
+             type <= THREADPOOL_QUEUE_LOCKFREE;
+             type++)
+        {
+            pool = create_pool(sched, type);
+            CU_ASSERT_FATAL(NULL != pool);
+            CU_ASSERT(0 != threadpool_add_job(pool, NULL, NULL, NULL));
+
+            atomic_store(&counter, 0);
+            for (int idx = 0; idx < JOBS; idx++)
+            {
+                // The lock-free queue is fixed size, retry while it is full
+                while (0 != threadpool_add_job(pool, count_job, NULL, NULL))
+                {
+                }
+            }
+
+            // Shutdown finishes every accepted job
+            CU_ASSERT(0 == threadpool_shutdown(pool));
+            CU_ASSERT(JOBS == atomic_load(&counter));
+            CU_ASSERT(0 != threadpool_add_job(pool, count_job, NULL, NULL));
+            CU_ASSERT(0 == threadpool_destroy(&pool));
+        }
+    }
+}
+
+void test_threadpool_add_jobs()
+{
+    threadpool_t * pool = NULL;
+    void *         args[BURST] = { NULL };
+    size_t         queued      = 0;
+    size_t         added       = 0;
+
+    for (int sched = THREADPOOL_SCHED_SHARED;
+         sched <= THREADPOOL_SCHED_STEALING;
+         sched++)
+    {
+        pool = create_pool(sched, THREADPOOL_QUEUE_MUTEX);
+        CU_ASSERT_FATAL(NULL != pool);
+        CU_ASSERT(0 != threadpool_add_jobs(pool, NULL, NULL, args, 1, NULL));
+        CU_ASSERT(0 == threadpool_add_jobs(
+                           pool, count_job, NULL, args, 0, NULL));
+
+        atomic_store(&counter, 0);
+        for (added = 0; added < JOBS; added += queued)
+        {
+            queued = 0;
+            threadpool_add_jobs(pool, count_job, NULL, args, BURST, &queued);
+        }
+
+        CU_ASSERT(0 == threadpool_destroy(&pool));
+        CU_ASSERT((int)added == atomic_load(&counter));
+    }
+}
+
+void test_threadpool_batch()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool = NULL;
+    atomic_bool      held = false;
+    atomic_bool      gate = false;
+
+    for (int sched = THREADPOOL_SCHED_SHARED;
+         sched <= THREADPOOL_SCHED_STEALING;
+         sched++)
+    {
+        threadpool_cfg_init(&cfg, MIN_THREADS);
+        cfg.scheduler = sched;
+        pool          = threadpool_create_ex(&cfg);
+        CU_ASSERT_FATAL(NULL != pool);
+
+        atomic_store(&running, 0);
+        atomic_store(&lane_runs, 0);
+        atomic_store(&counter, 0);
+        atomic_store(&gate_open, false);
+        atomic_store(&held, false);
+        atomic_store(&gate, false);
+        CU_ASSERT(0 == threadpool_add_job(pool, hold_job, NULL, &held));
+        CU_ASSERT(0 == threadpool_add_job(pool, hold_job, NULL, &gate));
+        CU_ASSERT_FATAL(wait_running(MIN_THREADS));
+
+        CU_ASSERT(0 == threadpool_add_job(pool, entered_gated_job, NULL, NULL));
+        for (int idx = 0; idx < BATCH_JOBS; idx++)
+        {
+            CU_ASSERT(0 == threadpool_add_job(pool, lane_job, NULL, NULL));
+        }
+
+        // One thread takes the gated job with a batch of the others, the
+        // other thread runs them all while the gated job holds up the first
+        atomic_store(&gate, true);
+        CU_ASSERT_FATAL(wait_count(&counter, 1));
+        atomic_store(&held, true);
+        CU_ASSERT(wait_count(&lane_runs, BATCH_JOBS));
+
+        atomic_store(&gate_open, true);
+        CU_ASSERT(0 == threadpool_wait_idle(pool));
+        CU_ASSERT(BATCH_JOBS == atomic_load(&lane_runs));
+        CU_ASSERT(0 == threadpool_destroy(&pool));
+    }
+}
+
+void test_threadpool_fan_out()
+{
+    for (int sched = THREADPOOL_SCHED_SHARED;
+         sched <= THREADPOOL_SCHED_STEALING;
+         sched++)
+    {
+        tree_pool = create_pool(sched, THREADPOOL_QUEUE_MUTEX);
+        CU_ASSERT_FATAL(NULL != tree_pool);
+
+        atomic_store(&counter, 0);
+        atomic_store(&job_errors, 0);
+        CU_ASSERT(0 == threadpool_add_job(
+                           tree_pool, tree_job, NULL, (void *)TREE_DEPTH));
+
+        // Jobs keep spawning children after shutdown has begun, and every
+        // one of them still runs
+        CU_ASSERT(0 == threadpool_destroy(&tree_pool));
+        CU_ASSERT(TREE_LEAVES == atomic_load(&counter));
+        CU_ASSERT(0 == atomic_load(&job_errors));
+    }
+}
+
+void test_threadpool_future()
+{
+    threadpool_t *        pool     = NULL;
+    threadpool_future_t * future   = NULL;
+    threadpool_future_t * futures[FUTURES];
+    void *                result   = NULL;
+    int                   mismatch = 0;
+
+    // Should catch invalid arguments
+    CU_ASSERT(NULL == threadpool_submit(NULL, square_job, NULL, NULL));
+    CU_ASSERT(0 != threadpool_future_wait(NULL, NULL));
+    CU_ASSERT(0 != threadpool_future_timedwait(NULL, 0, NULL));
+    CU_ASSERT(0 != threadpool_future_poll(NULL, NULL));
+    CU_ASSERT(0 != threadpool_future_then(NULL, record_continuation, NULL));
+    CU_ASSERT(0 != threadpool_future_release(NULL));
+
+    for (int sched = THREADPOOL_SCHED_SHARED;
+         sched <= THREADPOOL_SCHED_STEALING;
+         sched++)
+    {
+        pool = create_pool(sched, THREADPOOL_QUEUE_MUTEX);
+        CU_ASSERT_FATAL(NULL != pool);
+        CU_ASSERT(NULL == threadpool_submit(pool, NULL, NULL, NULL));
+
+        // Nothing is ready while the job is held at the gate
+        atomic_store(&gate_open, false);
+        atomic_store(&continued, 0);
+        future = threadpool_submit(pool, gated_job, NULL, (void *)7);
+        CU_ASSERT_FATAL(NULL != future);
+        CU_ASSERT(THREADPOOL_FUTURE_PENDING ==
+                  threadpool_future_poll(future, &result));
+        CU_ASSERT(THREADPOOL_FUTURE_PENDING ==
+                  threadpool_future_timedwait(future, WAIT_MS, &result));
+
+        // Attached before the job finishes, it runs on the pool's thread
+        CU_ASSERT(0 ==
+                  threadpool_future_then(future, record_continuation, NULL));
+        CU_ASSERT(0 !=
+                  threadpool_future_then(future, record_continuation, NULL));
+
+        atomic_store(&gate_open, true);
+        CU_ASSERT(0 == threadpool_future_wait(future, &result));
+        CU_ASSERT((void *)7 == result);
+        result = NULL;
+        CU_ASSERT(0 == threadpool_future_poll(future, &result));
+        CU_ASSERT((void *)7 == result);
+        CU_ASSERT(0 == threadpool_future_release(&future));
+        CU_ASSERT(NULL == future);
+
+        // Attached after the job finished, it runs right away
+        future = threadpool_submit(pool, square_job, NULL, (void *)3);
+        CU_ASSERT_FATAL(NULL != future);
+        CU_ASSERT(0 == threadpool_future_timedwait(future, 1000, &result));
+        CU_ASSERT((void *)9 == result);
+        while (1 != atomic_load(&continued))
+        {
+            sched_yield();
+        }
+        CU_ASSERT(0 ==
+                  threadpool_future_then(future, record_continuation, NULL));
+        CU_ASSERT(2 == atomic_load(&continued));
+        CU_ASSERT(9 == atomic_load(&continued_result));
+        CU_ASSERT(0 == threadpool_future_release(&future));
+
+        // Futures are recycled, whether released before or after the job
+        for (intptr_t idx = 0; idx < FUTURES; idx++)
+        {
+            futures[idx] = threadpool_submit(pool, square_job, NULL,
+                                             (void *)idx);
+            CU_ASSERT_FATAL(NULL != futures[idx]);
+            if (0 == (idx % 2))
+            {
+                CU_ASSERT(0 == threadpool_future_release(&futures[idx]));
+            }
+        }
+
+        for (intptr_t idx = 1; idx < FUTURES; idx += 2)
+        {
+            if ((0 != threadpool_future_wait(futures[idx], &result)) ||
+                ((void *)(idx * idx) != result))
+            {
+                mismatch++;
+            }
+            threadpool_future_release(&futures[idx]);
+        }
+        CU_ASSERT(0 == mismatch);
+
+        CU_ASSERT(0 == threadpool_destroy(&pool));
+    }
+}
+
+void test_threadpool_wait_idle()
+{
+    CU_ASSERT(0 != threadpool_wait_idle(NULL));
+
+    for (int sched = THREADPOOL_SCHED_SHARED;
+         sched <= THREADPOOL_SCHED_STEALING;
+         sched++)
+    {
+        tree_pool = create_pool(sched, THREADPOOL_QUEUE_MUTEX);
+        CU_ASSERT_FATAL(NULL != tree_pool);
+
+        // Nothing was added yet
+        CU_ASSERT(0 == threadpool_wait_idle(tree_pool));
+
+        atomic_store(&counter, 0);
+        atomic_store(&job_errors, 0);
+        for (int phase = 1; phase <= PHASES; phase++)
+        {
+            for (int idx = 0; idx < JOBS; idx++)
+            {
+                CU_ASSERT(0 == threadpool_add_job(
+                                   tree_pool, count_job, NULL, NULL));
+            }
+
+            // Jobs added by jobs are waited for as well
+            CU_ASSERT(0 == threadpool_add_job(
+                               tree_pool, tree_job, NULL, (void *)TREE_DEPTH));
+            CU_ASSERT(0 == threadpool_add_job(
+                               tree_pool, wait_idle_job, NULL, tree_pool));
+
+            // The threads outlive every phase
+            CU_ASSERT(0 == threadpool_wait_idle(tree_pool));
+            CU_ASSERT((phase * (JOBS + TREE_LEAVES)) ==
+                      atomic_load(&counter));
+        }
+        CU_ASSERT(0 == atomic_load(&job_errors));
+
+        CU_ASSERT(0 == threadpool_destroy(&tree_pool));
+    }
+}
+
+void test_threadpool_elastic()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool = NULL;
+
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.max_threads = MIN_THREADS - 1;
+    CU_ASSERT(NULL == threadpool_create_ex(&cfg));
+    CU_ASSERT(0 == threadpool_thread_count(NULL));
+
+    for (int sched = THREADPOOL_SCHED_SHARED;
+         sched <= THREADPOOL_SCHED_STEALING;
+         sched++)
+    {
+        threadpool_cfg_init(&cfg, MIN_THREADS);
+        cfg.scheduler         = sched;
+        cfg.max_threads       = MAX_THREADS;
+        cfg.keep_alive_ms     = KEEP_ALIVE;
+        cfg.spawn_queue_depth = 0;
+        pool                  = threadpool_create_ex(&cfg);
+        CU_ASSERT_FATAL(NULL != pool);
+        CU_ASSERT(MIN_THREADS == threadpool_thread_count(pool));
+
+        // Every blocked job beyond the running threads adds a thread, up to
+        // max_threads
+        atomic_store(&gate_open, false);
+        atomic_store(&running, 0);
+        atomic_store(&most_running, 0);
+        for (int idx = 1; idx <= MAX_THREADS; idx++)
+        {
+            CU_ASSERT(0 == threadpool_add_job(
+                               pool, counted_gated_job, NULL, NULL));
+            CU_ASSERT_FATAL(wait_running(idx));
+        }
+        CU_ASSERT(MAX_THREADS == threadpool_thread_count(pool));
+
+        CU_ASSERT(0 == threadpool_add_job(
+                           pool, counted_gated_job, NULL, NULL));
+        CU_ASSERT(MAX_THREADS == threadpool_thread_count(pool));
+
+        atomic_store(&gate_open, true);
+        CU_ASSERT(0 == threadpool_wait_idle(pool));
+        CU_ASSERT(MAX_THREADS == atomic_load(&most_running));
+
+        // Idle threads above the minimum retire after the keep-alive
+        for (long spin = 0;
+             (spin < 100000000L) &&
+             (MIN_THREADS != threadpool_thread_count(pool));
+             spin++)
+        {
+            sched_yield();
+        }
+        CU_ASSERT(MIN_THREADS == threadpool_thread_count(pool));
+
+        // The threadpool keeps working after shrinking
+        atomic_store(&counter, 0);
+        for (int idx = 0; idx < JOBS; idx++)
+        {
+            CU_ASSERT(0 == threadpool_add_job(pool, count_job, NULL, NULL));
+        }
+        CU_ASSERT(0 == threadpool_wait_idle(pool));
+        CU_ASSERT(JOBS == atomic_load(&counter));
+
+        CU_ASSERT(0 == threadpool_destroy(&pool));
+    }
+}
+
+void test_threadpool_affinity()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool       = NULL;
+    int              bad_cpus[] = { -1 };
+    int              cpu        = 0;
+    cpu_set_t        available;
+    char             root[]     = "/tmp/threadpool_numa_XXXXXX";
+    char             path[PATH_MAX];
+    FILE *           file = NULL;
+
+    // Should catch CPUs the process cannot run on
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.affinity  = THREADPOOL_AFFINITY_CPUS;
+    cfg.cpus      = bad_cpus;
+    cfg.cpu_count = 1;
+    CU_ASSERT(NULL == threadpool_create_ex(&cfg));
+    cfg.affinity = (threadpool_affinity_t)-1;
+    CU_ASSERT(NULL == threadpool_create_ex(&cfg));
+    CU_ASSERT(0 == threadpool_node_count(NULL));
+
+    // Every thread is pinned to the one CPU it was given
+    CU_ASSERT_FATAL(0 == sched_getaffinity(0, sizeof(cpu_set_t), &available));
+    while (!CPU_ISSET(cpu, &available))
+    {
+        cpu++;
+    }
+    CPU_ZERO(&expected_cpus);
+    CPU_SET(cpu, &expected_cpus);
+
+    cfg.affinity = THREADPOOL_AFFINITY_CPUS;
+    cfg.cpus     = &cpu;
+    pool         = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+    CU_ASSERT(1 == threadpool_node_count(pool));
+    CU_ASSERT(0 != threadpool_add_job_on_node(pool, 1, affinity_job, NULL,
+                                              NULL));
+
+    atomic_store(&counter, 0);
+    atomic_store(&job_errors, 0);
+    for (int idx = 0; idx < JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(pool, affinity_job, NULL, NULL));
+    }
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT(JOBS == atomic_load(&counter));
+    CU_ASSERT(0 == atomic_load(&job_errors));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+
+    // A fake two node machine built from the same CPU
+    CU_ASSERT_FATAL(NULL != mkdtemp(root));
+    for (int node = 0; node < FAKE_NODES; node++)
+    {
+        snprintf(path, sizeof(path), "%s/node%d", root, node);
+        CU_ASSERT_FATAL(0 == mkdir(path, 0700));
+        snprintf(path, sizeof(path), "%s/node%d/cpulist", root, node);
+        file = fopen(path, "w");
+        CU_ASSERT_FATAL(NULL != file);
+        fprintf(file, "%d\n", cpu);
+        fclose(file);
+    }
+
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.affinity  = THREADPOOL_AFFINITY_NUMA;
+    cfg.numa_path = root;
+    pool          = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+    CU_ASSERT(FAKE_NODES == threadpool_node_count(pool));
+
+    // Jobs sent to either node run on that node's CPUs
+    atomic_store(&counter, 0);
+    for (int idx = 0; idx < JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job_on_node(
+                           pool, idx % FAKE_NODES, affinity_job, NULL, NULL));
+    }
+    CU_ASSERT(0 != threadpool_add_job_on_node(
+                       pool, FAKE_NODES, affinity_job, NULL, NULL));
+    CU_ASSERT(0 == threadpool_add_job(pool, affinity_job, NULL, NULL));
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT((JOBS + 1) == atomic_load(&counter));
+    CU_ASSERT(0 == atomic_load(&job_errors));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+
+    for (int node = 0; node < FAKE_NODES; node++)
+    {
+        snprintf(path, sizeof(path), "%s/node%d/cpulist", root, node);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/node%d", root, node);
+        rmdir(path);
+    }
+    rmdir(root);
+}
+
+/**
+ * @brief runs LANE_JOBS low priority jobs queued ahead of LANE_JOBS high
+ * priority jobs on a single free thread, recording the order they ran in
+ *
+ * @param cfg the options to create the pool with
+ * @return the number of low priority jobs among the first LANE_JOBS to run
+ */
+static int run_lanes(threadpool_cfg_t * cfg)
+{
+    threadpool_t * pool = NULL;
+    atomic_bool    held = false;
+    atomic_bool    gate = false;
+    int            low  = 0;
+
+    pool = threadpool_create_ex(cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    // Hold both threads so the lanes fill up before anything is picked
+    atomic_store(&running, 0);
+    atomic_store(&lane_runs, 0);
+    CU_ASSERT(0 == threadpool_add_job(pool, hold_job, NULL, &held));
+    CU_ASSERT(0 == threadpool_add_job(pool, hold_job, NULL, &gate));
+    CU_ASSERT_FATAL(wait_running(MIN_THREADS));
+
+    for (int idx = 0; idx < LANE_JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job_priority(
+                           pool,
+                           THREADPOOL_PRIORITY_LOW,
+                           lane_job,
+                           NULL,
+                           (void *)THREADPOOL_PRIORITY_LOW));
+    }
+    for (int idx = 0; idx < LANE_JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job_priority(
+                           pool,
+                           THREADPOOL_PRIORITY_HIGH,
+                           lane_job,
+                           NULL,
+                           (void *)THREADPOOL_PRIORITY_HIGH));
+    }
+
+    // One thread works through the lanes in the order it picks them
+    atomic_store(&gate, true);
+    CU_ASSERT(wait_running(1));
+    for (long spin = 0;
+         (spin < 100000000L) && ((2 * LANE_JOBS) != atomic_load(&lane_runs));
+         spin++)
+    {
+        sched_yield();
+    }
+    atomic_store(&held, true);
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT((2 * LANE_JOBS) == atomic_load(&lane_runs));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+
+    for (int idx = 0; idx < LANE_JOBS; idx++)
+    {
+        if (THREADPOOL_PRIORITY_LOW == lane_ran[idx])
+        {
+            low++;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * @brief holds a thread on the first job of a batch of normal priority jobs,
+ * adds CUT_IN_JOBS high priority jobs behind the rest of the normal jobs and
+ * records the order the jobs run in
+ *
+ * @return the number of high priority jobs among the first CUT_IN_JOBS to
+ * run
+ */
+static int run_behind_batch(void)
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool = NULL;
+    atomic_bool      held = false;
+    atomic_bool      gate = false;
+    int              high = 0;
+
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.starvation_limit = 0;
+    pool                 = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    atomic_store(&running, 0);
+    atomic_store(&lane_runs, 0);
+    atomic_store(&counter, 0);
+    atomic_store(&gate_open, false);
+    CU_ASSERT(0 == threadpool_add_job(pool, hold_job, NULL, &held));
+    CU_ASSERT(0 == threadpool_add_job(pool, hold_job, NULL, &gate));
+    CU_ASSERT_FATAL(wait_running(MIN_THREADS));
+
+    CU_ASSERT(0 == threadpool_add_job(pool, entered_gated_job, NULL, NULL));
+    for (int idx = 0; idx < LANE_JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job_priority(
+                           pool,
+                           THREADPOOL_PRIORITY_NORMAL,
+                           lane_job,
+                           NULL,
+                           (void *)THREADPOOL_PRIORITY_NORMAL));
+    }
+
+    // The freed thread takes the gated job with a batch of the normal jobs
+    atomic_store(&gate, true);
+    CU_ASSERT_FATAL(wait_count(&counter, 1));
+    for (int idx = 0; idx < CUT_IN_JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job_priority(
+                           pool,
+                           THREADPOOL_PRIORITY_HIGH,
+                           lane_job,
+                           NULL,
+                           (void *)THREADPOOL_PRIORITY_HIGH));
+    }
+
+    atomic_store(&gate_open, true);
+    for (long spin = 0;
+         (spin < 100000000L) &&
+         ((LANE_JOBS + CUT_IN_JOBS) != atomic_load(&lane_runs));
+         spin++)
+    {
+        sched_yield();
+    }
+    atomic_store(&held, true);
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT((LANE_JOBS + CUT_IN_JOBS) == atomic_load(&lane_runs));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+
+    for (int idx = 0; idx < CUT_IN_JOBS; idx++)
+    {
+        if (THREADPOOL_PRIORITY_HIGH == lane_ran[idx])
+        {
+            high++;
+        }
+    }
+
+    return high;
+}
+
+void test_threadpool_priority()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool = NULL;
+    int              low  = 0;
+
+    // Should catch invalid priorities and lane settings
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+    CU_ASSERT(0 != threadpool_add_job_priority(
+                      pool, THREADPOOL_PRIORITIES, count_job, NULL, NULL));
+    CU_ASSERT(0 != threadpool_add_job_priority(
+                      NULL, THREADPOOL_PRIORITY_HIGH, count_job, NULL, NULL));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.lane_policy                            = THREADPOOL_LANES_WEIGHTED;
+    cfg.lane_weights[THREADPOOL_PRIORITY_HIGH] = 0;
+    CU_ASSERT(NULL == threadpool_create_ex(&cfg));
+
+    // Strict lanes run every high priority job first
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.starvation_limit = 0;
+    CU_ASSERT(0 == run_lanes(&cfg));
+
+    // Unless the low priority lane has waited too long
+    cfg.starvation_limit = 2;
+    low                  = run_lanes(&cfg);
+    CU_ASSERT((0 < low) && (LANE_JOBS > low));
+
+    // Nor do they wait behind a batch of lower priority jobs a thread took
+    CU_ASSERT(CUT_IN_JOBS == run_behind_batch());
+
+    // Weighted lanes share the picks, favoring the heavier lane
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.lane_policy = THREADPOOL_LANES_WEIGHTED;
+    low             = run_lanes(&cfg);
+    CU_ASSERT((0 < low) && ((LANE_JOBS / 2) > low));
+
+    // The lock-free backend honors the lanes too
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.queue_type       = THREADPOOL_QUEUE_LOCKFREE;
+    cfg.starvation_limit = 0;
+    CU_ASSERT(0 == run_lanes(&cfg));
+}
+
+void test_threadpool_spin()
+{
+    threadpool_cfg_t      cfg;
+    threadpool_t *        pool   = NULL;
+    threadpool_future_t * future = NULL;
+    void *                result = NULL;
+    int                   errors = 0;
+    uint32_t spins[]  = { 0, THREADPOOL_DEFAULT_SPIN_COUNT, LONG_SPIN };
+    uint32_t yields[] = { 0, THREADPOOL_DEFAULT_YIELD_COUNT, 0 };
+
+    // Parking straight away, the defaults, and spinning far past each job
+    for (size_t mode = 0; mode < sizeof(spins) / sizeof(spins[0]); mode++)
+    {
+        for (int sched = THREADPOOL_SCHED_SHARED;
+             sched <= THREADPOOL_SCHED_STEALING;
+             sched++)
+        {
+            threadpool_cfg_init(&cfg, THREADS);
+            cfg.scheduler   = sched;
+            cfg.spin_count  = spins[mode];
+            cfg.yield_count = yields[mode];
+            pool            = threadpool_create_ex(&cfg);
+            CU_ASSERT_FATAL(NULL != pool);
+
+            // One job at a time, so the threads go idle in between
+            errors = 0;
+            for (intptr_t idx = 0; idx < PING_PONGS; idx++)
+            {
+                future = threadpool_submit(pool, square_job, NULL,
+                                           (void *)idx);
+                if ((NULL == future) ||
+                    (0 != threadpool_future_wait(future, &result)) ||
+                    ((idx * idx) != (intptr_t)result))
+                {
+                    errors++;
+                }
+                threadpool_future_release(&future);
+            }
+            CU_ASSERT(0 == errors);
+
+            // Threads still spinning notice the shutdown
+            CU_ASSERT(0 == threadpool_destroy(&pool));
+        }
+    }
+}
+
+/**
+ * @brief adds up the buckets of a histogram
+ *
+ * @param hist the histogram
+ * @return the number of samples in its buckets
+ */
+static uint64_t bucket_total(const threadpool_histogram_t * hist)
+{
+    uint64_t total = 0;
+
+    for (size_t idx = 0; idx < THREADPOOL_HISTOGRAM_BUCKETS; idx++)
+    {
+        total += hist->buckets[idx];
+    }
+
+    return total;
+}
+
+void test_threadpool_stats()
+{
+    threadpool_cfg_t       cfg;
+    threadpool_t *         pool  = NULL;
+    threadpool_stats_t     stats = { 0 };
+    threadpool_histogram_t hist  = { 0 };
+    void *                 args[BURST] = { NULL };
+
+    // Should catch invalid arguments
+    CU_ASSERT(0 != threadpool_stats(NULL, &stats));
+    CU_ASSERT(0 == threadpool_histogram_percentile(NULL, 50.0));
+    CU_ASSERT(0 == threadpool_histogram_percentile(&hist, 50.0));
+    CU_ASSERT(0 == threadpool_histogram_percentile(&hist, 101.0));
+
+    // 90 samples of 1 ns, then 10 in [512, 1024) ns, the longest 700 ns
+    hist.count       = 100;
+    hist.max_ns      = 700;
+    hist.buckets[1]  = 90;
+    hist.buckets[10] = 10;
+    CU_ASSERT(1 == threadpool_histogram_percentile(&hist, 50.0));
+    CU_ASSERT(1 == threadpool_histogram_percentile(&hist, 90.0));
+    CU_ASSERT(700 == threadpool_histogram_percentile(&hist, 99.0));
+    CU_ASSERT(1 == threadpool_histogram_percentile(&hist, 0.0));
+
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.time_jobs = true;
+    pool          = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+    CU_ASSERT(0 != threadpool_stats(pool, NULL));
+
+    atomic_store(&counter, 0);
+    for (int idx = 0; idx < JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(pool, count_job, NULL, NULL));
+    }
+    CU_ASSERT(0 == threadpool_add_jobs(
+                       pool, count_job, NULL, args, BURST, NULL));
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+
+    CU_ASSERT(0 == threadpool_stats(pool, &stats));
+    CU_ASSERT((JOBS + BURST) == stats.submitted);
+    CU_ASSERT((JOBS + BURST) == stats.completed);
+    CU_ASSERT(0 == stats.rejected);
+    CU_ASSERT(0 == stats.queue_depth);
+    CU_ASSERT((1 <= stats.queue_high_water) &&
+              ((JOBS + BURST) >= stats.queue_high_water));
+    CU_ASSERT(THREADS == stats.thread_count);
+    CU_ASSERT((JOBS + BURST) == stats.wait.count);
+    CU_ASSERT((JOBS + BURST) == bucket_total(&stats.wait));
+    CU_ASSERT((JOBS + BURST) == stats.run.count);
+    CU_ASSERT((JOBS + BURST) == bucket_total(&stats.run));
+    CU_ASSERT(stats.run.max_ns <= stats.run.sum_ns);
+    CU_ASSERT(stats.busy_ns == stats.run.sum_ns);
+    CU_ASSERT((0 < stats.uptime_ns) && (0 < stats.thread_ns));
+    CU_ASSERT((0.0 <= stats.utilization) && (1.0 >= stats.utilization));
+
+    // Jobs behind busy threads are queued, not started
+    atomic_store(&gate_open, false);
+    atomic_store(&running, 0);
+    for (int idx = 0; idx < THREADS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(
+                           pool, counted_gated_job, NULL, NULL));
+    }
+    CU_ASSERT(wait_running(THREADS));
+    for (int idx = 0; idx < HELD_JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(pool, count_job, NULL, NULL));
+    }
+    CU_ASSERT(0 == threadpool_stats(pool, &stats));
+    CU_ASSERT(HELD_JOBS == stats.queue_depth);
+    CU_ASSERT((THREADS + HELD_JOBS) <= stats.queue_high_water);
+    CU_ASSERT(0 == stats.parked_threads);
+
+    atomic_store(&gate_open, true);
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+
+    // Jobs refused after shutdown are counted
+    CU_ASSERT(0 == threadpool_shutdown(pool));
+    CU_ASSERT(0 != threadpool_add_job(pool, count_job, NULL, NULL));
+    CU_ASSERT(0 != threadpool_add_jobs(
+                       pool, count_job, NULL, args, BURST, NULL));
+    CU_ASSERT(0 == threadpool_stats(pool, &stats));
+    CU_ASSERT((1 + BURST) == stats.rejected);
+    CU_ASSERT(stats.submitted == stats.completed);
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+
+    // By default only the counters are kept
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+    CU_ASSERT(0 == threadpool_add_job(pool, count_job, NULL, NULL));
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT(0 == threadpool_stats(pool, &stats));
+    CU_ASSERT(1 == stats.completed);
+    CU_ASSERT((0 == stats.wait.count) && (0 == stats.run.count));
+    CU_ASSERT(0 == stats.busy_ns);
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+void test_threadpool_backpressure()
+{
+    threadpool_cfg_t cfg;
+    pthread_t        submitter;
+    int              queued = 0;
+
+    for (int type = THREADPOOL_QUEUE_MUTEX; type <= THREADPOOL_QUEUE_LOCKFREE;
+         type++)
+    {
+        threadpool_cfg_init(&cfg, MIN_THREADS);
+        cfg.queue_type     = type;
+        cfg.queue_capacity = SMALL_QUEUE;
+        cfg.queue_limit    = SMALL_QUEUE;
+        full_pool          = threadpool_create_ex(&cfg);
+        CU_ASSERT_FATAL(NULL != full_pool);
+
+        // A full queue refuses jobs at once, or once the timeout passes
+        atomic_store(&counter, 0);
+        queued = fill_pool();
+        CU_ASSERT(SMALL_QUEUE <= queued);
+        CU_ASSERT(THREADPOOL_QUEUE_FULL ==
+                  threadpool_add_job(full_pool, count_job, NULL, NULL));
+        CU_ASSERT(THREADPOOL_QUEUE_FULL ==
+                  threadpool_add_job_wait(full_pool,
+                                          THREADPOOL_SUBMIT_FAIL_FAST,
+                                          0,
+                                          count_job,
+                                          NULL,
+                                          NULL));
+        CU_ASSERT(THREADPOOL_QUEUE_FULL ==
+                  threadpool_add_job_wait(full_pool,
+                                          THREADPOOL_SUBMIT_TIMED,
+                                          WAIT_MS,
+                                          count_job,
+                                          NULL,
+                                          NULL));
+        CU_ASSERT(-1 == threadpool_add_job_wait(
+                            full_pool, 3, 0, count_job, NULL, NULL));
+
+        // A blocked submission goes through once the threads take jobs
+        atomic_store(&blocked_done, false);
+        CU_ASSERT_FATAL(0 == pthread_create(
+                                 &submitter, NULL, blocked_submitter, NULL));
+        usleep(WAIT_MS * 1000);
+        CU_ASSERT(false == atomic_load(&blocked_done));
+        atomic_store(&gate_open, true);
+        pthread_join(submitter, NULL);
+        CU_ASSERT(0 == atomic_load(&blocked_result));
+        CU_ASSERT(0 == threadpool_wait_idle(full_pool));
+        CU_ASSERT((queued + 1) == atomic_load(&counter));
+
+        // A submitter still waiting when the pool shuts down gives up, and
+        // then lets the held threads finish
+        fill_pool();
+        atomic_store(&blocked_done, false);
+        CU_ASSERT_FATAL(0 == pthread_create(
+                                 &submitter, NULL, blocked_submitter, NULL));
+        usleep(WAIT_MS * 1000);
+        CU_ASSERT(0 == threadpool_shutdown(full_pool));
+        pthread_join(submitter, NULL);
+        CU_ASSERT(0 != atomic_load(&blocked_result));
+        CU_ASSERT(0 == threadpool_destroy(&full_pool));
+    }
+}
+
+void test_threadpool_timers()
+{
+    threadpool_timer_t timer = THREADPOOL_INVALID_TIMER;
+    uint64_t           start = 0;
+    int                total = 0;
+
+    timer_pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != timer_pool);
+
+    // A delayed job never runs early
+    atomic_store(&ran_at_ms, 0);
+    atomic_store(&freed, 0);
+    start = now_ms();
+    CU_ASSERT(0 == threadpool_add_delayed_job(
+                       timer_pool, DELAY_MS, stamp_job, count_free, NULL,
+                       &timer));
+    CU_ASSERT(wait_count(&freed, 1));
+    CU_ASSERT((start + DELAY_MS) <= atomic_load(&ran_at_ms));
+
+    // Its timer is gone once it expired, a cancelled one never runs
+    CU_ASSERT(0 != threadpool_cancel_timer(timer_pool, timer));
+    CU_ASSERT(0 == threadpool_add_delayed_job(
+                       timer_pool, LONG_MS, count_job, count_free, NULL,
+                       &timer));
+    CU_ASSERT(0 == threadpool_cancel_timer(timer_pool, timer));
+    CU_ASSERT(2 == atomic_load(&freed));
+    CU_ASSERT(0 != threadpool_cancel_timer(timer_pool, timer));
+
+    // A periodic job keeps running until it cancels itself
+    atomic_store(&periods, 0);
+    CU_ASSERT(0 == threadpool_add_periodic_job(timer_pool,
+                                               0,
+                                               PERIOD_MS,
+                                               self_cancel_job,
+                                               count_free,
+                                               NULL,
+                                               &self_timer));
+    CU_ASSERT(wait_count(&freed, 3));
+    usleep(PERIODS * PERIOD_MS * 1000);
+    CU_ASSERT(PERIODS == atomic_load(&periods));
+
+    // Many timers at once, half of them cancelled, each runs once
+    atomic_store(&counter, 0);
+    atomic_store(&freed, 0);
+    for (int idx = 0; idx < TIMERS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_delayed_job(timer_pool,
+                                                  (uint32_t)(idx % SPREAD_MS),
+                                                  count_job,
+                                                  count_free,
+                                                  NULL,
+                                                  &timer));
+        if (0 != (idx % 2))
+        {
+            continue;
+        }
+
+        // Timers due at once may have expired already
+        if (0 == threadpool_cancel_timer(timer_pool, timer))
+        {
+            total++;
+        }
+    }
+    CU_ASSERT(wait_count(&freed, TIMERS));
+    CU_ASSERT(0 == threadpool_wait_idle(timer_pool));
+    CU_ASSERT((TIMERS - total) == atomic_load(&counter));
+    CU_ASSERT(0 == atomic_load(&job_errors));
+
+    // Should catch invalid arguments
+    CU_ASSERT(0 != threadpool_add_delayed_job(
+                       NULL, 0, count_job, NULL, NULL, NULL));
+    CU_ASSERT(0 != threadpool_add_delayed_job(
+                       timer_pool, 0, NULL, NULL, NULL, NULL));
+    CU_ASSERT(0 != threadpool_add_periodic_job(
+                       timer_pool, 0, 0, count_job, NULL, NULL, NULL));
+    CU_ASSERT(0 != threadpool_cancel_timer(NULL, timer));
+    CU_ASSERT(0 != threadpool_cancel_timer(timer_pool,
+                                           THREADPOOL_INVALID_TIMER));
+
+    // Timers still pending when the pool goes away are dropped
+    atomic_store(&freed, 0);
+    CU_ASSERT(0 == threadpool_add_periodic_job(
+                       timer_pool, LONG_MS, LONG_MS, count_job, count_free,
+                       NULL, NULL));
+    CU_ASSERT(0 == threadpool_shutdown(timer_pool));
+    CU_ASSERT(0 != threadpool_add_delayed_job(
+                       timer_pool, 0, count_job, NULL, NULL, NULL));
+    CU_ASSERT(0 == threadpool_destroy(&timer_pool));
+    CU_ASSERT(1 == atomic_load(&freed));
+}
+
+void test_threadpool_cancel()
+{
+    threadpool_t *       pool              = NULL;
+    threadpool_token_t * tokens[HELD_JOBS] = { NULL };
+    threadpool_token_t * token             = NULL;
+    threadpool_stats_t   stats;
+    atomic_bool          release           = false;
+
+    pool = threadpool_create(MIN_THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    // Every thread is held, so the cancellable jobs stay queued
+    atomic_store(&running, 0);
+    for (size_t idx = 0; idx < MIN_THREADS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(pool, hold_job, NULL, &release));
+    }
+    CU_ASSERT(wait_running(MIN_THREADS));
+
+    atomic_store(&counter, 0);
+    atomic_store(&freed, 0);
+    for (int idx = 0; idx < HELD_JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job_cancellable(
+                           pool, count_job, count_free, NULL, &tokens[idx]));
+    }
+
+    // Half of them are cancelled, and cancelling again changes nothing
+    for (int idx = 0; idx < HELD_JOBS; idx += 2)
+    {
+        CU_ASSERT(0 == threadpool_cancel_job(tokens[idx]));
+        CU_ASSERT(0 == threadpool_cancel_job(tokens[idx]));
+    }
+
+    // A released token leaves its job to run
+    CU_ASSERT(0 == threadpool_token_release(&tokens[1]));
+    CU_ASSERT(NULL == tokens[1]);
+
+    // Skipped jobs still free their args
+    atomic_store(&release, true);
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT((HELD_JOBS / 2) == atomic_load(&counter));
+    CU_ASSERT(HELD_JOBS == atomic_load(&freed));
+    CU_ASSERT(0 == threadpool_stats(pool, &stats));
+    CU_ASSERT((HELD_JOBS / 2) == stats.cancelled);
+
+    // A finished job can no longer be cancelled, a skipped one stays so
+    for (int idx = 0; idx < HELD_JOBS; idx++)
+    {
+        if (NULL == tokens[idx])
+        {
+            continue;
+        }
+        CU_ASSERT((0 == (idx % 2)) ==
+                  (0 == threadpool_cancel_job(tokens[idx])));
+        CU_ASSERT(0 == threadpool_token_release(&tokens[idx]));
+    }
+
+    // A running job is asked to stop, and stops once it checks
+    atomic_store(&counter, 0);
+    CU_ASSERT(0 == threadpool_add_job_cancellable(
+                       pool, cooperative_job, NULL, NULL, &token));
+    CU_ASSERT(wait_running(1));
+    CU_ASSERT(THREADPOOL_JOB_RUNNING == threadpool_cancel_job(token));
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT(1 == atomic_load(&counter));
+    CU_ASSERT(0 != threadpool_cancel_job(token));
+    CU_ASSERT(0 == threadpool_token_release(&token));
+    CU_ASSERT(false == threadpool_job_cancelled());
+
+    // Should catch invalid arguments
+    CU_ASSERT(0 != threadpool_add_job_cancellable(
+                       NULL, count_job, NULL, NULL, &token));
+    CU_ASSERT(0 != threadpool_add_job_cancellable(
+                       pool, NULL, NULL, NULL, &token));
+    CU_ASSERT(0 != threadpool_add_job_cancellable(
+                       pool, count_job, NULL, NULL, NULL));
+    CU_ASSERT(0 != threadpool_cancel_job(NULL));
+    CU_ASSERT(0 != threadpool_token_release(NULL));
+    CU_ASSERT(0 != threadpool_token_release(&token));
+
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+void test_threadpool_worker_ctx()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool = NULL;
+
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.worker_init     = ctx_init;
+    cfg.worker_teardown = ctx_teardown;
+    cfg.worker_arg_p    = &worker_inits;
+
+    atomic_store(&worker_inits, 0);
+    atomic_store(&worker_teardowns, 0);
+    atomic_store(&worker_jobs, 0);
+    atomic_store(&job_errors, 0);
+    pool = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    // Every job finds the context of the thread running it
+    for (int idx = 0; idx < JOBS; idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(pool, ctx_job, NULL, NULL));
+    }
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT(NULL == threadpool_worker_ctx());
+
+    // Every thread releases its context as it exits
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+    CU_ASSERT(THREADS == atomic_load(&worker_inits));
+    CU_ASSERT(THREADS == atomic_load(&worker_teardowns));
+    CU_ASSERT(JOBS == atomic_load(&worker_jobs));
+    CU_ASSERT(0 == atomic_load(&job_errors));
+
+    // A thread that retires tears down without holding up the threadpool
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.max_threads       = MAX_THREADS;
+    cfg.keep_alive_ms     = KEEP_ALIVE;
+    cfg.spawn_queue_depth = 0;
+    cfg.worker_teardown   = slow_teardown;
+    pool                  = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != pool);
+
+    atomic_store(&gate_open, false);
+    atomic_store(&running, 0);
+    for (int idx = 1; idx <= (int)(MIN_THREADS + 1); idx++)
+    {
+        CU_ASSERT(0 == threadpool_add_job(
+                           pool, counted_gated_job, NULL, NULL));
+        CU_ASSERT_FATAL(wait_running(idx));
+    }
+    atomic_store(&worker_teardowns, 0);
+    atomic_store(&gate_open, true);
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT_FATAL(wait_count(&worker_teardowns, 1));
+
+    // Adding a thread while the retired one sleeps in its teardown
+    atomic_store(&gate_open, false);
+    atomic_store(&running, 0);
+    for (int idx = 1; idx <= (int)(MIN_THREADS + 1); idx++)
+    {
+        uint64_t start_ms = now_ms();
+
+        CU_ASSERT(0 == threadpool_add_job(
+                           pool, counted_gated_job, NULL, NULL));
+        CU_ASSERT((TEARDOWN_MS / 2) > (now_ms() - start_ms));
+        CU_ASSERT_FATAL(wait_running(idx));
+    }
+    atomic_store(&gate_open, true);
+    CU_ASSERT(0 == threadpool_wait_idle(pool));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+void test_threadpool_keyed()
+{
+    threadpool_cfg_t cfg;
+    threadpool_t *   pool    = NULL;
+    atomic_bool      release = false;
+
+    for (int scheduler = THREADPOOL_SCHED_SHARED;
+         scheduler <= THREADPOOL_SCHED_STEALING;
+         scheduler++)
+    {
+        pool = create_pool(scheduler, THREADPOOL_QUEUE_MUTEX);
+        CU_ASSERT_FATAL(NULL != pool);
+
+        // The jobs of every key run one at a time and in order, interleaved
+        // with the other keys
+        atomic_store(&counter, 0);
+        atomic_store(&keyed_errors, 0);
+        for (int key = 0; key < KEYS; key++)
+        {
+            next_keyed[key] = 0;
+        }
+        for (int seq = 0; seq < KEYED_JOBS; seq++)
+        {
+            for (int key = 0; key < KEYS; key++)
+            {
+                CU_ASSERT(0 == threadpool_add_keyed_job(
+                                   pool,
+                                   (uint64_t)key,
+                                   keyed_job,
+                                   NULL,
+                                   (void *)(intptr_t)((key * KEYED_JOBS) +
+                                                      seq)));
+            }
+        }
+        CU_ASSERT(0 == threadpool_wait_idle(pool));
+        CU_ASSERT((KEYS * KEYED_JOBS) == atomic_load(&counter));
+        CU_ASSERT(0 == atomic_load(&keyed_errors));
+
+        // A key held up by a long job holds up its own jobs only
+        atomic_store(&counter, 0);
+        atomic_store(&running, 0);
+        atomic_store(&release, false);
+        CU_ASSERT(0 == threadpool_add_keyed_job(pool, 0, hold_job, NULL,
+                                                &release));
+        CU_ASSERT(wait_running(1));
+        CU_ASSERT(0 == threadpool_add_keyed_job(pool, 0, count_job, NULL,
+                                                NULL));
+        for (int idx = 0; idx < HELD_JOBS; idx++)
+        {
+            CU_ASSERT(0 == threadpool_add_keyed_job(pool, 1, count_job, NULL,
+                                                    NULL));
+        }
+        CU_ASSERT(wait_count(&counter, HELD_JOBS));
+        usleep(WAIT_MS * 1000);
+        CU_ASSERT(HELD_JOBS == atomic_load(&counter));
+        atomic_store(&release, true);
+        CU_ASSERT(0 == threadpool_wait_idle(pool));
+        CU_ASSERT((HELD_JOBS + 1) == atomic_load(&counter));
+
+        // Keyed jobs added before the shutdown still run
+        atomic_store(&counter, 0);
+        for (int idx = 0; idx < HELD_JOBS; idx++)
+        {
+            CU_ASSERT(0 == threadpool_add_keyed_job(pool, 2, count_job, NULL,
+                                                    NULL));
+        }
+        CU_ASSERT(0 == threadpool_shutdown(pool));
+        CU_ASSERT(HELD_JOBS == atomic_load(&counter));
+        CU_ASSERT(0 != threadpool_add_keyed_job(pool, 2, count_job, NULL,
+                                                NULL));
+        CU_ASSERT(0 == threadpool_destroy(&pool));
+    }
+
+    // A busy key added from inside a job makes way for the job added next to
+    // it, on the one thread left free
+    threadpool_cfg_init(&cfg, MIN_THREADS);
+    cfg.scheduler = THREADPOOL_SCHED_STEALING;
+    busy_key_pool = threadpool_create_ex(&cfg);
+    CU_ASSERT_FATAL(NULL != busy_key_pool);
+    atomic_store(&counter, 0);
+    atomic_store(&running, 0);
+    atomic_store(&job_errors, 0);
+    atomic_store(&busy_key_seen, -1);
+    atomic_store(&release, false);
+    CU_ASSERT(0 == threadpool_add_job(busy_key_pool, hold_job, NULL, &release));
+    CU_ASSERT(wait_running(1));
+    CU_ASSERT(0 == threadpool_add_job(busy_key_pool, busy_key_job, NULL, NULL));
+    CU_ASSERT(wait_count(&counter, KEYED_JOBS));
+    atomic_store(&release, true);
+    CU_ASSERT(0 == threadpool_wait_idle(busy_key_pool));
+    CU_ASSERT(0 == atomic_load(&job_errors));
+    CU_ASSERT((0 <= atomic_load(&busy_key_seen)) &&
+              (KEYED_JOBS > atomic_load(&busy_key_seen)));
+    CU_ASSERT(0 == threadpool_destroy(&busy_key_pool));
+
+    // Should catch invalid arguments
+    threadpool_cfg_init(&cfg, THREADS);
+    cfg.strand_count = 0;
+    CU_ASSERT(NULL == threadpool_create_ex(&cfg));
+    pool = threadpool_create(THREADS);
+    CU_ASSERT_FATAL(NULL != pool);
+    CU_ASSERT(0 != threadpool_add_keyed_job(NULL, 0, count_job, NULL, NULL));
+    CU_ASSERT(0 != threadpool_add_keyed_job(pool, 0, NULL, NULL, NULL));
+    CU_ASSERT(0 == threadpool_destroy(&pool));
+}
+
+int main(void)
+{
+    CU_TestInfo suite1_tests[] = {
+        { "Testing threadpool_create():", test_threadpool_create },
+
+        { "Testing threadpool_add_job():", test_threadpool_add_job },
+
+        { "Testing threadpool_add_jobs():", test_threadpool_add_jobs },
+
+        { "Testing batches behind a long job:", test_threadpool_batch },
+
+        { "Testing jobs adding jobs:", test_threadpool_fan_out },
+
+        { "Testing threadpool_submit() futures:", test_threadpool_future },
+
+        { "Testing threadpool_wait_idle():", test_threadpool_wait_idle },
+
+        { "Testing elastic thread count:", test_threadpool_elastic },
+
+        { "Testing CPU affinity and NUMA nodes:", test_threadpool_affinity },
+
+        { "Testing priority lanes:", test_threadpool_priority },
+
+        { "Testing spin-then-park waiting:", test_threadpool_spin },
+
+        { "Testing threadpool_stats():", test_threadpool_stats },
+
+        { "Testing blocking submission:", test_threadpool_backpressure },
+
+        { "Testing delayed and periodic jobs:", test_threadpool_timers },
+
+        { "Testing job cancellation:", test_threadpool_cancel },
+
+        { "Testing per-thread contexts:", test_threadpool_worker_ctx },
+
+        { "Testing keyed serial jobs:", test_threadpool_keyed },
+        CU_TEST_INFO_NULL
+    };
+
+    CU_SuiteInfo suites[] = {
+        { "Suite-1:", init_suite1, clean_suite1, .pTests = suite1_tests },
+        CU_SUITE_INFO_NULL
+    };
+
+    if (0 != CU_initialize_registry())
+    {
+        return CU_get_error();
+    }
+
+    if (0 != CU_register_suites(suites))
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_basic_show_failures(CU_get_failure_list());
+
+    // NOLINTNEXTLINE
+    int num_failed = CU_get_number_of_failures();
+    CU_cleanup_registry();
+    printf("\n");
+    return num_failed;
+}
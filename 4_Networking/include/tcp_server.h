@@ -6,6 +6,7 @@
 #ifndef _TCP_SERVER_H
 #define _TCP_SERVER_H
 
+#include "arena.h"
 #include "threadpool.h"
 
 /**
@@ -17,8 +18,24 @@
  */
 #define SHUTDOWN 1
 
+/**
+ * @brief Returned by an arena_request_handler_t once the client is done, to
+ * close the connection without reporting an error.
+ */
+#define CONNECTION_DONE 2
+
 typedef int (*request_handler_t)(int);
 
+/**
+ * @brief Handler for start_arena_server(), called once per request.
+ *
+ * The arena is private to the connection and is reset after every request,
+ * so the handler can take scratch memory from it without freeing anything.
+ * Return E_SUCCESS to be called again for the next request on the same
+ * connection, CONNECTION_DONE to close it, or E_FAILURE on error.
+ */
+typedef int (*arena_request_handler_t)(int, arena_t *);
+
 /**
  * @struct server_cfg
  * @brief Holds the configuration settings for the server.
@@ -33,6 +50,20 @@ int start_server(size_t            num_threads,
                  char *            port_p,
                  request_handler_t handler_func);
 
+/**
+ * @brief Runs the server like start_server(), but serves each connection with
+ * a scratch arena taken from a pool sized to the thread count. Once the pool
+ * is warm, handling a request makes no heap allocations of its own.
+ *
+ * @param num_threads Number of threads serving connections.
+ * @param port_p Pointer to port string.
+ * @param handler_func Handler called once per request.
+ * @return 0 (E_SUCCESS) on success, -1 (E_FAILURE) on failure.
+ */
+int start_arena_server(size_t                  num_threads,
+                       char *                  port_p,
+                       arena_request_handler_t handler_func);
+
 #endif /* _SERVER_H */
 
 /*** end of file ***/
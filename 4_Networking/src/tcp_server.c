@@ -19,7 +19,9 @@
 #include <sys/socket.h> // socket()
 #include <unistd.h>     // close()
 
+#include "arena.h"
 #include "signal_handler.h"
+#include "slab.h"
 #include "socket_io.h"
 #include "tcp_server.h"
 #include "utilities.h"
@@ -27,6 +29,7 @@
 #define INVALID_SOCKET          (-1) // Indicates an invalid socket descriptor
 #define BACKLOG_SIZE            10 // Maximum number of pending client connections
 #define MAX_CLIENT_ADDRESS_SIZE 100 // Size for storing client address strings
+#define CONNECTION_ARENA_SIZE   4096 // First chunk size of a connection arena
 
 //
 // -----------------------------STRUCT DEFINITIONS-----------------------------
@@ -34,8 +37,9 @@
 
 typedef struct client_args
 {
-    int               client_fd;
-    request_handler_t handler_func;
+    int                     client_fd;
+    request_handler_t       handler_func;
+    arena_request_handler_t arena_handler_func;
 } client_args_t;
 
 /**
@@ -56,9 +60,16 @@ struct server_cfg
     struct sockaddr_storage client_address; // Stores client address
     int                     client_fd;      // Socket for accepting connections
     request_handler_t       handler_func;
+    arena_request_handler_t arena_handler_func;
     socklen_t               client_len; // Length of client address structure
 };
 
+// Recycles client_args_t between connections, one is taken per accept()
+static slab_t * client_args_slab_g = NULL;
+
+// Scratch arenas for start_arena_server(), one is held per open connection
+static arena_pool_t * arena_pool_g = NULL;
+
 //
 // -----------------------------UTILITY FUNCTIONS-----------------------------
 //
@@ -118,6 +129,20 @@ static int activate_listening_mode(server_cfg_t * config);
 // -----------------------------CORE FUNCTIONALITY-----------------------------
 //
 
+/**
+ * @brief Run the server with whichever of the two handlers is set.
+ *
+ * @param num_threads Number of threads serving connections.
+ * @param port_p Pointer to port string.
+ * @param handler_func Handler called once per connection, or NULL.
+ * @param arena_handler_func Handler called once per request, or NULL.
+ * @return 0 (E_SUCCESS) on success, -1 (E_FAILURE) on failure.
+ */
+static int run_server(size_t                  num_threads,
+                      char *                  port_p,
+                      request_handler_t       handler_func,
+                      arena_request_handler_t arena_handler_func);
+
 /**
  * @brief Main loop for listening for client connections.
  *
@@ -154,6 +179,15 @@ static int accept_connection(server_cfg_t * config);
  */
 static void * handle_client_request(void * args_p);
 
+/**
+ * @brief Handle client request logic with a scratch arena, calling the arena
+ * handler once per request and resetting the arena in between.
+ *
+ * @param args_p Pointer to client arguments.
+ * @return NULL.
+ */
+static void * handle_client_arena_requests(void * args_p);
+
 // +---------------------------------------------------------------------------+
 // |                            MAIN SERVER FUNCTION                           |
 // +---------------------------------------------------------------------------+
@@ -162,9 +196,7 @@ int start_server(size_t            num_threads,
                  char *            port_p,
                  request_handler_t handler_func)
 {
-    int            exit_code    = E_FAILURE;
-    server_cfg_t * config       = NULL;
-    threadpool_t * threadpool_p = NULL;
+    int exit_code = E_FAILURE;
 
     if ((NULL == port_p) || (NULL == handler_func))
     {
@@ -172,6 +204,43 @@ int start_server(size_t            num_threads,
         goto END;
     }
 
+    exit_code = run_server(num_threads, port_p, handler_func, NULL);
+
+END:
+    return exit_code;
+}
+
+int start_arena_server(size_t                  num_threads,
+                       char *                  port_p,
+                       arena_request_handler_t handler_func)
+{
+    int exit_code = E_FAILURE;
+
+    if ((NULL == port_p) || (NULL == handler_func))
+    {
+        print_error("NULL argument passed.");
+        goto END;
+    }
+
+    exit_code = run_server(num_threads, port_p, NULL, handler_func);
+
+END:
+    return exit_code;
+}
+
+// *****************************************************************************
+//                          STATIC FUNCTION DEFINITIONS
+// *****************************************************************************
+
+static int run_server(size_t                  num_threads,
+                      char *                  port_p,
+                      request_handler_t       handler_func,
+                      arena_request_handler_t arena_handler_func)
+{
+    int            exit_code    = E_FAILURE;
+    server_cfg_t * config       = NULL;
+    threadpool_t * threadpool_p = NULL;
+
     if (2 > num_threads)
     {
         print_error("Number of threads must be 2 or more.");
@@ -185,6 +254,26 @@ int start_server(size_t            num_threads,
         goto END;
     }
 
+    client_args_slab_g = slab_create(sizeof(client_args_t), 0);
+    if (NULL == client_args_slab_g)
+    {
+        print_error("start_server(): Unable to create client args slab.");
+        exit_code = E_FAILURE;
+        goto END;
+    }
+
+    // One arena per thread covers every connection being served at once
+    if (NULL != arena_handler_func)
+    {
+        arena_pool_g = arena_pool_create(CONNECTION_ARENA_SIZE, num_threads);
+        if (NULL == arena_pool_g)
+        {
+            print_error("start_server(): Unable to create arena pool.");
+            exit_code = E_FAILURE;
+            goto END;
+        }
+    }
+
     config = calloc(1, sizeof(server_cfg_t));
     if (NULL == config)
     {
@@ -195,7 +284,8 @@ int start_server(size_t            num_threads,
     config->client_len       = 0;
     config->client_fd        = 0;
     config->listening_socket = 0;
-    config->handler_func     = handler_func;
+    config->handler_func       = handler_func;
+    config->arena_handler_func = arena_handler_func;
 
     exit_code = configure_server_address(config, port_p);
     if (E_SUCCESS != exit_code)
@@ -241,13 +331,20 @@ END:
         }
     }
 
+    // Only once every job has run can the arguments be released
+    if (NULL != client_args_slab_g)
+    {
+        slab_destroy(&client_args_slab_g);
+    }
+
+    if (NULL != arena_pool_g)
+    {
+        arena_pool_destroy(&arena_pool_g);
+    }
+
     return exit_code;
 }
 
-// *****************************************************************************
-//                          STATIC FUNCTION DEFINITIONS
-// *****************************************************************************
-
 // Covers [4.1.13] - getaddrinfo()
 static int configure_server_address(server_cfg_t * config, char * port_p)
 {
@@ -468,22 +565,28 @@ static int open_new_connection(server_cfg_t * config,
         goto END;
     }
 
-    client_args_t * args = calloc(1, sizeof(client_args_t));
+    client_args_t * args = slab_alloc(client_args_slab_g);
     if (NULL == args)
     {
         print_error("CMR Failure.");
         goto END;
     }
 
-    args->client_fd    = config->client_fd;
-    args->handler_func = config->handler_func;
+    args->client_fd          = config->client_fd;
+    args->handler_func       = config->handler_func;
+    args->arena_handler_func = config->arena_handler_func;
 
-    exit_code = threadpool_add_job(
-        threadpool_p, handle_client_request, free_args, args);
+    exit_code = threadpool_add_job(threadpool_p,
+                                   (NULL != args->arena_handler_func)
+                                       ? handle_client_arena_requests
+                                       : handle_client_request,
+                                   free_args,
+                                   args);
     if (E_SUCCESS != exit_code)
     {
         print_error("Unable to add job to threadpool.");
         close(config->client_fd);
+        slab_free(client_args_slab_g, args);
         goto END;
     }
 
@@ -543,7 +646,48 @@ END:
     {
         close(new_args_p->client_fd);
     }
-    free(new_args_p);
+    slab_free(client_args_slab_g, new_args_p);
+    return NULL;
+}
+
+static void * handle_client_arena_requests(void * args_p)
+{
+    int             exit_code  = E_FAILURE;
+    client_args_t * new_args_p = (client_args_t *)args_p;
+    arena_t *       arena_p    = NULL;
+
+    arena_p = arena_pool_acquire(arena_pool_g);
+    if (NULL == arena_p)
+    {
+        print_error("Unable to acquire a connection arena.");
+        goto END;
+    }
+
+    // Everything a request allocated is dropped at once before the next
+    while ((signal_flag_g != SIGINT) && (signal_flag_g != SIGUSR1))
+    {
+        exit_code = new_args_p->arena_handler_func(new_args_p->client_fd,
+                                                   arena_p);
+        if (E_SUCCESS != exit_code)
+        {
+            break;
+        }
+
+        arena_reset(arena_p);
+    }
+
+    if (E_FAILURE == exit_code)
+    {
+        print_error("Error handling client request.");
+    }
+
+END:
+    if (NULL != arena_p)
+    {
+        arena_pool_release(arena_pool_g, arena_p);
+    }
+    close(new_args_p->client_fd);
+    slab_free(client_args_slab_g, new_args_p);
     return NULL;
 }
 